@@ -164,8 +164,8 @@ void readDipMicrostepping() {
         }
     }
 
-    // Update the timer based on the new microstepping
-    updateCorrectionTimer();
+    // Update the correction rate based on the new microstepping
+    updateCorrectionRate();
 }
 
 
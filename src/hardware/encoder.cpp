@@ -3,122 +3,11 @@
 // Include timers.h here so there isn't a linking circle
 #include "timers.h"
 
-// A map of the known registers
-uint16_t regMap[MAX_NUM_REG];              //!< Register map */
-
-// Massive bit field table
-const BitField_t bitFields[] = {
-	{REG_ACCESS_RU,  REG_STAT,    0x2,    1,  0x00,  0},       //!< 00 bits 0:0 SRST status watch dog
-	{REG_ACCESS_R,   REG_STAT,    0x2,    1,  0x00,  0},       //!< 01 bits 1:1 SWD status watch dog
-	{REG_ACCESS_R,   REG_STAT,    0x4,    2,  0x00,  0},       //!< 02 bits 2:2 SVR status voltage regulator
-	{REG_ACCESS_R,   REG_STAT,    0x8,    3,  0x00,  0},       //!< 03 bits 3:3 SFUSE status fuses
-	{REG_ACCESS_R,   REG_STAT,    0x10,   4,  0x00,  0},       //!< 04 bits 4:4 SDSPU status digital signal processing unit
-	{REG_ACCESS_RU,  REG_STAT,    0x20,   5,  0x00,  0},       //!< 05 bits 5:5 SOV status overflow
-	{REG_ACCESS_RU,  REG_STAT,    0x40,   6,  0x00,  0},       //!< 06 bits 6:6 SXYOL status X/Y data out limit
-	{REG_ACCESS_RU,  REG_STAT,    0x80,   7,  0x00,  0},       //!< 07 bits 7:7 SMAGOL status magnitude out limit
-	{REG_ACCESS_RES, REG_STAT,    0x100,  8,  0x00,  0},       //!< 08 bits 8:8 reserved
-	{REG_ACCESS_R,   REG_STAT,    0x200,  9,  0x00,  0},       //!< 09 bits 9:9 SADCT status ADC test
-	{REG_ACCESS_R,   REG_STAT,    0x400,  10, 0x00,  0},       //!< 10 bits 10:10 SROM status ROM
-	{REG_ACCESS_RU,  REG_STAT,    0x800,  11, 0x00,  0},       //!< 11 bits 11:11 NOGMRXY no valid GMR XY Values
-	{REG_ACCESS_RU,  REG_STAT,    0x1000, 12, 0x00,  0},       //!< 12 bits 12:12 NOGMRA no valid GMR Angle Value
-	{REG_ACCESS_RW,  REG_STAT,    0x6000, 13, 0x00,  0},       //!< 13 bits 14:13 SNR slave number
-	{REG_ACCESS_RU,  REG_STAT,    0x8000, 15, 0x00,  0},       //!< 14 bits 15:15 RDST read status
-
-	{REG_ACCESS_RW,  REG_ACSTAT,  0x1,    0,  0x00,  1},       //!< 15 bits 0:0 ASRST Activation of Hardware Reset
-	{REG_ACCESS_RWU, REG_ACSTAT,  0x2,    1,  0x00,  1},       //!< 16 bits 1:1 ASWD Enable DSPU Watch dog
-	{REG_ACCESS_RWU, REG_ACSTAT,  0x4,    2,  0x00,  1},       //!< 17 bits 2:2 ASVR Enable Voltage regulator Check
-	{REG_ACCESS_RWU, REG_ACSTAT,  0x8,    3,  0x00,  1},       //!< 18 bits 3:3 ASFUSE Activation Fuse CRC
-	{REG_ACCESS_RWU, REG_ACSTAT,  0x10,   4,  0x00,  1},       //!< 19 bits 4:4 ASDSPU Activation DSPU BIST
-	{REG_ACCESS_RWU, REG_ACSTAT,  0x20,   5,  0x00,  1},       //!< 20 bits 5:5 ASOV Enable of DSPU Overflow Check
-	{REG_ACCESS_RWU, REG_ACSTAT,  0x40,   6,  0x00,  1},       //!< 21 bits 6:6 ASVECXY Activation of X,Y Out of Limit-Check
-	{REG_ACCESS_RWU, REG_ACSTAT,  0x80,   7,  0x00,  1},       //!< 22 bits 7:7 ASVEGMAG Activation of Magnitude Check
-	{REG_ACCESS_RES, REG_ACSTAT,  0x100,  8,  0x00,  1},       //!< 23 bits 8:8 Reserved
-	{REG_ACCESS_RWU, REG_ACSTAT,  0x200,  9,  0x00,  1},       //!< 24 bits 9:9 ASADCT Enable ADC Test vector Check
-	{REG_ACCESS_RWU, REG_ACSTAT,  0x400,  10, 0x00,  1},       //!< 25 bits 10:10 ASFRST Activation of Firmware Reset
-	{REG_ACCESS_RES, REG_ACSTAT,  0xF800, 11, 0x00,  1},       //!< 26 bits 15:11 Reserved
-
-	{REG_ACCESS_RU,  REG_AVAL,    0x7FFF, 0,  0x00,  2},       //!< 27 bits 14:0 ANGVAL Calculated Angle Value (signed 15-bit)
-	{REG_ACCESS_R,   REG_AVAL,    0x8000, 15, 0x00,  2},       //!< 28 bits 15:15 RDAV Read Status, Angle Value
-
-	{REG_ACCESS_RU,  REG_ASPD,    0x7FFF, 0,  0x00,  3},       //!< 29 bits 14:0 ANGSPD Signed value, where the sign bit [14] indicates the direction of the rotation
-	{REG_ACCESS_R,   REG_ASPD,    0x8000, 15, 0x00,  3},       //!< 30 bits 15:15 RDAS Read Status, Angle Speed
-
-	{REG_ACCESS_RU,  REG_AREV,    0xFF,   0,  0x00,  4},       //!< 31 bits 8:0 REVOL Revolution counter. Increments for every full rotation in counter-clockwise direction
-	{REG_ACCESS_RWU, REG_AREV,    0x7E00, 9,  0x00,  4},       //!< 32 bits 14:9 FCNT Internal frame counter. Increments every update period
-	{REG_ACCESS_R,   REG_AREV,    0x8000, 15, 0x00,  4},       //!< 33 its 15:15 RDREV Read Status, Revolution
-
-	{REG_ACCESS_RWU, REG_FSYNC,   0xFF,   0,  0x00,  5},       //!< 34 bits 8:0 TEMPR Signed offset compensated temperature value
-	{REG_ACCESS_RU,  REG_FSYNC,   0xFE00, 9,  0x00,  5},       //!< 35 bits 15:9 FSYNC Frame Synchronization Counter Value
-
-	{REG_ACCESS_RW,  REG_MOD_1,   0x3,    0,  0x00,  6},       //!< 36 bits 1:0 IIFMOD Incremental Interface Mode
-	{REG_ACCESS_RW,  REG_MOD_1,   0x4,    2,  0x00,  6},       //!< 37 bits 2:2 DSPUHOLD if DSPU is on hold, no watch dog reset is performed by DSPU
-	{REG_ACCESS_RES, REG_MOD_1,   0x8,    3,  0x00,  6},       //!< 38 bits 3:3 Reserved1
-	{REG_ACCESS_RW,  REG_MOD_1,   0x10,   4,  0x00,  6},       //!< 39 bits 4:4 CLKSEL switch to external clock at start-up only
-	{REG_ACCESS_RES, REG_MOD_1,   0x3FE0, 5,  0x00,  6},       //!< 40 bits 13:5 Reserved2
-	{REG_ACCESS_RW,  REG_MOD_1,   0x6000, 13, 0x00,  6},       //!< 41 bits 15:14 FIRMD Update Rate Setting
-
-	{REG_ACCESS_RW,  REG_SIL,     0x7,    0,  0x00,  7},       //!< 42 bits 2:0 ADCTVX Test vector X
-	{REG_ACCESS_RW,  REG_SIL,     0x38,   3,  0x00,  7},       //!< 43 bits 5:3 ADCTVY Test vector Y
-	{REG_ACCESS_RW,  REG_SIL,     0x40,   6,  0x00,  7},       //!< 44 bits 6:6 ADCTVEN Sensor elements are internally disconnected and test voltages are connected to ADCs
-	{REG_ACCESS_RES, REG_SIL,     0x380,  7,  0x00,  7},       //!< 45 bits 9:7 Reserved1
-	{REG_ACCESS_RW,  REG_SIL,     0x400,  10, 0x00,  7},       //!< 46 bits 10:10 FUSEREL Triggers reload of default values from laser fuses into configuration registers
-	{REG_ACCESS_RES, REG_SIL,     0x3800, 11, 0x00,  7},       //!< 47 bits 13:11 Reserved2
-	{REG_ACCESS_RW,  REG_SIL,     0x4000, 14, 0x00,  7},       //!< 48 bits 14:14 FILTINV the X- and Y-signals are inverted. The angle output is then shifted by 180°
-	{REG_ACCESS_RW,  REG_SIL,     0x8000, 15, 0x00,  7},       //!< 49 bits 15:15 FILTPAR the raw X-signal is routed also to the raw Y-signal input of the filter so SIN and COS signal should be identical
-
-	{REG_ACCESS_RW,  REG_MOD_2,   0x3,    0,  0x00,  8},       //!< 50 bits 1:0 AUTOCAL Automatic calibration of offset and amplitude synchronicity for applications with full-turn
-	{REG_ACCESS_RW,  REG_MOD_2,   0x4,    2,  0x00,  8},       //!< 51 bits 2:2 PREDICT Prediction of angle value based on current angle speed
-	{REG_ACCESS_RW,  REG_MOD_2,   0x8,    3,  0x00,  8},       //!< 52 bits 3:3 ANGDIR Inverts angle and angle speed values and revolution counter behavior
-	{REG_ACCESS_RW,  REG_MOD_2,   0x7FF0, 4,  0x00,  8},       //!< 53 bits 14:4 ANGRANGE Changes the representation of the angle output by multiplying the output with a factor ANG_RANGE/128
-	{REG_ACCESS_RES, REG_MOD_2,   0x8000, 15, 0x00,  8},       //!< 54 bits 15:15 Reserved1
-
-	{REG_ACCESS_RW,  REG_MOD_3,   0x3,    0,  0x00,  9},       //!< 55 bits 1:0 PADDRV Configuration of Pad-Driver
-	{REG_ACCESS_RW,  REG_MOD_3,   0x4,    2,  0x00,  9},       //!< 56 bits 2:2 SSCOD SSC-Interface Data Pin Output Mode
-	{REG_ACCESS_RW,  REG_MOD_3,   0x8,    3,  0x00,  9},       //!< 57 bits 3:3 SPIKEF Filters voltage spikes on input pads (IFC, SCK and CSQ)
-	{REG_ACCESS_RW,  REG_MOD_3,   0xFFF0, 4,  0x00,  9},       //!< 58 bits 15:4 ANG_BASE Sets the 0° angle position (12 bit value). Angle base is factory-calibrated to make the 0° direction parallel to the edge of the chip
-
-	{REG_ACCESS_RES, REG_OFFX,    0xF,    0,  0x00, 10},       //!< 59 bits 3:0 Reserved1
-	{REG_ACCESS_RW,  REG_OFFX,    0xFFF0, 4,  0x00, 10},       //!< 60 bits 15:4 XOFFSET 12-bit signed integer value of raw X-signal offset correction at 25°C
-
-	{REG_ACCESS_RES, REG_OFFY,    0xF,    0,  0x00, 11},       //!< 61 bits 3:0 Reserved1
-	{REG_ACCESS_RW,  REG_OFFY,    0xFFF0, 4,  0x00, 11},       //!< 62 bits 15:4 YOFFSET 12-bit signed integer value of raw Y-signal offset correction at 25°C
-
-	{REG_ACCESS_RES, REG_SYNCH,   0xF,    0,  0x00, 12},       //!< 63 bits 3:0 Reserved1
-	{REG_ACCESS_RW,  REG_SYNCH,   0xFFF0, 4,  0x00, 12},       //!< 64 bits 15:4 SYNCH 12-bit signed integer value of amplitude synchronicity
-
-	{REG_ACCESS_RW,  REG_IFAB,    0x3,    0,  0x00, 13},       //!< 65 bits 1:0 IFADHYST Hysteresis (multi-purpose)
-	{REG_ACCESS_RW,  REG_IFAB,    0x4,    2,  0x00, 13},       //!< 66 bits 2:2 IFABOD IFA,IFB,IFC Output Mode
-	{REG_ACCESS_RW,  REG_IFAB,    0x8,    3,  0x00, 13},       //!< 67 bits 3:3 FIRUDR Initial filter update rate (FIR)
-	{REG_ACCESS_RW,  REG_IFAB,    0xFFF0, 4,  0x00, 13},       //!< 68 bits 15:4 ORTHO Orthogonality Correction of X and Y Components
-
-	{REG_ACCESS_RW,  REG_MOD_4,   0x3,    0,  0x00, 14},       //!< 69 bits 1:0 IFMD Interface Mode on IFA,IFB,IFC
-	{REG_ACCESS_RES, REG_MOD_4,   0x4,    2,  0x00, 14},       //!< 70 bits 2:2 Reserved1
-	{REG_ACCESS_RW,  REG_MOD_4,   0x18,   3,  0x00, 14},       //!< 71 bits 4:3 IFABRES IIF resolution (multi-purpose)
-	{REG_ACCESS_RW,  REG_MOD_4,   0x1E0,  5,  0x00, 14},       //!< 72 bits 8:5 HSMPLP Hall Switch mode (multi-purpose)
-	{REG_ACCESS_RW,  REG_MOD_4,   0x7E00, 9,  0x00, 14},       //!< 73 bits 15:9 TCOXT 7-bit signed integer value of X-offset temperature coefficient
-
-	{REG_ACCESS_RW,  REG_TCO_Y,   0x7F,   0,  0x00, 15},       //!< 74 bits 7:0 CRCPAR CRC of Parameters
-	{REG_ACCESS_RW,  REG_TCO_Y,   0x80,   8,  0x00, 15},       //!< 75 bits 8:8 SBIST Startup-BIST
-	{REG_ACCESS_RW,  REG_TCO_Y,   0x7E00, 9,  0x00, 15},       //!< 76 bits 15:9 TCOYT 7-bit signed integer value of Y-offset temperature coefficient
-
-	{REG_ACCESS_R,   REG_ADC_X,   0xFFFF, 0,  0x00, 16},       //!< 77 bits 15:0 ADCX ADC value of X-GMR
-
-	{REG_ACCESS_R,   REG_ADC_Y,   0xFFFF, 0,  0x00, 17},       //!< 78 bits 15:0 ADCY ADC value of Y-GMR
-
-	{REG_ACCESS_RU,  REG_D_MAG,   0x3FF,  0,  0x00, 18},       //!< 79 bits 9:0 MAG Unsigned Angle Vector Magnitude after X, Y error compensation (due to temperature)
-	{REG_ACCESS_RES, REG_D_MAG,   0xFC00, 10, 0x00, 18},       //!< 80 bits 15:10 Reserved1
-
-	{REG_ACCESS_RU,  REG_T_RAW,   0x3FF,  0,  0x00, 19},       //!< 81 bits 9:0 TRAW Temperature Sensor Raw-Value at ADC without offset
-	{REG_ACCESS_RES, REG_T_RAW,   0xFC00, 10, 0x00, 19},       //!< 82 bits 14:10 Reserved1
-	{REG_ACCESS_RU,  REG_T_RAW,   0x8000, 15, 0x00, 19},       //!< 83 bits 15:15 TTGL Temperature Sensor Raw-Value Toggle toggles after every new temperature value
-
-	{REG_ACCESS_RU,  REG_IIF_CNT, 0x7FFF, 0,  0x00, 20},       //!< 84 bits 14:0 IIFCNT 14 bit counter value of IIF increments
-	{REG_ACCESS_RES, REG_IIF_CNT, 0x8000, 15, 0x00, 20},       //!< 85 bits 15:14 Reserved1
-
-	{REG_ACCESS_R,   REG_T25O,    0x1FFF, 0,  0x00, 21},       //!< 86 bit 8:0 T250 Signed offset value at 25°C temperature; 1dig=0.36°C
-	{REG_ACCESS_RES, REG_T25O,    0xFE00, 9,  0x00, 21},       //!< 87 bits 15:9 Reserved1
-};
+// For loading the linearization table
+#include "flash.h"
 
+// Sensor update period for each of the update rates (us)
+const double encoderUpdatePeriods[] = { 21.3, 42.7, 85.3, 170.6 };
 
 // Constructor for the encoder
 Encoder::Encoder() {
@@ -159,15 +48,15 @@ Encoder::Encoder() {
     //writeToEncoderRegister(ENCODER_ACT_STATUS_REG, 0x401);
 
     // Setup the moving average calculations
-    speedAvg.begin(RPM_AVG_READINGS);
     rawSpeedAvg.begin(SPEED_AVG_READINGS);
-    accelAvg.begin(ACCEL_AVG_READINGS);
     incrementAvg.begin(ANGLE_AVG_READINGS);
-    absAngleAvg.begin(ANGLE_AVG_READINGS);
+    absPositionAvg.begin(ANGLE_AVG_READINGS);
     rawTempAvg.begin(TEMP_AVG_READINGS);
 
-    // Set the last raw revolution value (used to detect revolution change)
-    lastRawRev = getRawRev();
+    // Load the linearization table (if a calibration saved one)
+    #ifdef ENABLE_ENCODER_LINEARIZATION
+        linearized = readLinearization(linearizationTable, ENCODER_LINEARIZATION_POINTS);
+    #endif
 
     // Populate the average angle reading table
     for (uint8_t index = 0; index < ANGLE_AVG_READINGS; index++) {
@@ -175,13 +64,11 @@ Encoder::Encoder() {
     }
 
     // Set the offsets
-    startupAngleOffset = getRawAngleAvg();
-    startupRevOffset = getRawRev();
+    startupAngleOffset = linearize(getRawIncrementsAvg()) - encoderStepOffset;
 
     // Set the correct starting values for the estimation if using estimation
     #ifdef ENCODER_SPEED_ESTIMATION
-        lastEncoderAngle = getAbsoluteAngleAvg();
-        lastAngleSampleTime = micros();
+        lastAngleSampleTime = cycleCount64();
     #endif
 
     // Set the correct start time for the overtemp protection
@@ -192,123 +79,353 @@ Encoder::Encoder() {
 
 
 // Read the value of a register
+// The data is only written if the read was valid
 errorTypes Encoder::readRegister(uint16_t registerAddress, uint16_t &data) {
 
-    // Disable interrupts
-    disableInterrupts();
+    // A single register is just a burst of one
+    return readMultipleRegisters(registerAddress, &data, 1);
+}
+
+
+// Read multiple registers
+// Every response is checked with the safety word, retrying up to ENCODER_READ_ATTEMPTS times
+// The data is only written if the read was valid
+errorTypes Encoder::readMultipleRegisters(uint16_t registerAddress, uint16_t* data, uint16_t dataLength) {
+
+    // Build the command (the number of data words is in the low bits)
+    uint16_t command = registerAddress | ENCODER_READ_COMMAND | dataLength;
+
+    // Setup TX and RX buffers (the safety word follows the data)
+    // Array lengths are doubled as we're using 8 bit values instead of 16
+    uint16_t rxLength = (dataLength + 1) * 2;
+    uint8_t txbuf[rxLength];
+    uint8_t rxbuf[rxLength];
+    uint16_t rxData[dataLength + 1];
 
     // Create an accumulator for error checking
     errorTypes error = NO_ERROR;
 
-    // Pull CS low to select encoder
-    GPIO_WRITE(ENCODER_CS_PIN, LOW);
+    // Try the read until a valid response is received or we run out of attempts
+    for (uint8_t attempt = 0; attempt < ENCODER_READ_ATTEMPTS; attempt++) {
 
-    // Add read bit to address
-    registerAddress |= ENCODER_READ_COMMAND;
-    registerAddress |= SAFE_HIGH;
+        // Claim the bus
+        claimBus();
 
-    // Setup RX and TX buffers
-    uint8_t rx1buf[2];
-    uint8_t rx2buf[2];
-    uint8_t txbuf[2] = { uint8_t(registerAddress >> 8), uint8_t(registerAddress) };
+        // Pull CS low to select encoder
+        GPIO_WRITE(ENCODER_CS_PIN, LOW);
 
-    // Send address we want to read, response seems to be equal to request
-    HAL_SPI_TransmitReceive(&spiConfig, txbuf, rx1buf, 2, 10);
+        // Send address we want to read, response seems to be equal to request
+        txbuf[0] = uint8_t(command >> 8), txbuf[1] = uint8_t(command);
+        HAL_SPI_TransmitReceive(&spiConfig, txbuf, rxbuf, 2, 10);
 
-    // Set the MOSI pin to open drain
-    GPIO_InitStructure.Pin = GPIO_PIN_7;
-    GPIO_InitStructure.Mode = GPIO_MODE_AF_OD;
-    HAL_GPIO_Init(GPIOA, &GPIO_InitStructure);
+        // Set the MOSI pin to open drain
+        GPIO_InitStructure.Pin = GPIO_PIN_7;
+        GPIO_InitStructure.Mode = GPIO_MODE_AF_OD;
+        HAL_GPIO_Init(GPIOA, &GPIO_InitStructure);
 
-    // Send 0xFFFF (like BTT code), this returns the wanted value
-    txbuf[0] = 0xFF, txbuf[1] = 0xFF;
-    HAL_SPI_TransmitReceive(&spiConfig, txbuf, rx2buf, 2, 10);
+        // Send 0xFFFF (like BTT code), this returns the wanted values and the safety word
+        memset(txbuf, 0xFF, rxLength);
+        HAL_SPI_TransmitReceive(&spiConfig, txbuf, rxbuf, rxLength, 10);
 
-    // Combine the first rxbuf into a single, unsigned 16 bit value
-    //uint16_t combinedRX1Buf = (rx1buf[0] << 8 | rx1buf[1]);
-    //uint16_t combinedRX2Buf = (rx2buf[0] << 8 | rx2buf[1]);
+        // Set MOSI back to Push/Pull
+        GPIO_InitStructure.Mode = GPIO_MODE_AF_PP;
+        HAL_GPIO_Init(GPIOA, &GPIO_InitStructure);
 
-    // Check to see if the communication was valid
-    //error = checkSafety(combinedRX1Buf, registerAddress, &combinedRX2Buf, 1);
+        // Deselect encoder
+        GPIO_WRITE(ENCODER_CS_PIN, HIGH);
 
-    // Set MOSI back to Push/Pull
-    GPIO_InitStructure.Mode = GPIO_MODE_AF_PP;
-    HAL_GPIO_Init(GPIOA, &GPIO_InitStructure);
+        // Combine the received bytes into words
+        for (uint8_t i = 0; i <= dataLength; i++) {
+            rxData[i] = rxbuf[i * 2] << 8 | rxbuf[i * 2 + 1];
+        }
 
-    // Deselect encoder
-    GPIO_WRITE(ENCODER_CS_PIN, HIGH);
+        // Check to see if the communication was valid
+        error = checkSafety(rxData[dataLength], command, rxData, dataLength);
 
-    // Set data in the specified location (depending on errors)
-    if (error == NO_ERROR) {
+        // Valid response, write the received data into the array
+        if (error == NO_ERROR) {
+            memcpy(data, rxData, dataLength * sizeof(uint16_t));
+            releaseBus();
+            return NO_ERROR;
+        }
+
+        // Clear the error flags in the encoder before trying again
+        // (interface errors are caused by the request, not the encoder)
+        if (error != INTERFACE_ACCESS_ERROR) {
+            resetSafety();
+        }
 
-        // No errors, good to set the correct value
-        data = (rx2buf[0] << 8 | rx2buf[1]);
+        // Release the bus between attempts
+        releaseBus();
     }
-    else {
-        // Zero the value if there is an error
-        data = 0;
+
+    // All of the attempts failed, the data is left untouched
+    failedReads++;
+    return error;
+}
+
+
+// Claims the SPI bus for a blocking transaction
+void Encoder::claimBus() {
+
+    // If the background sampling is running, the control loop never touches the bus itself,
+    // so the bus just has to be taken from the DMA. Interrupts can stay enabled for the transaction
+    #ifdef ENCODER_DMA_SAMPLING
+    if (sampling) {
+
+        // Let any burst in flight finish, then block new ones
+        disableInterrupts();
+        finishSample();
+        busClaimed = true;
+        enableInterrupts();
+        return;
+    }
+    #endif
+
+    // Otherwise the transaction could be interrupted by another read, so interrupts must be disabled
+    disableInterrupts();
+}
+
+
+// Releases the SPI bus after a blocking transaction
+void Encoder::releaseBus() {
+
+    // Give the bus back to the DMA if it was claimed from it
+    #ifdef ENCODER_DMA_SAMPLING
+    if (busClaimed) {
+        busClaimed = false;
+        return;
     }
+    #endif
 
-    // All done, we can re-enable interrupts
+    // Otherwise interrupts were disabled for the transaction
     enableInterrupts();
+}
 
-    // Return error
-    return error;
+
+#ifdef ENCODER_DMA_SAMPLING
+
+// Fast switches of the MOSI pin (PA7) between push/pull and open drain (the encoder drives the line while open drain)
+#define ENCODER_MOSI_OPEN_DRAIN() (GPIOA -> CRL |= GPIO_CRL_CNF7_0)
+#define ENCODER_MOSI_PUSH_PULL()  (GPIOA -> CRL &= ~GPIO_CRL_CNF7_0)
+
+// Starts sampling the angle registers in the background
+void Encoder::startSampling() {
+
+    // Nothing to do if the sampling is already running
+    if (sampling) {
+        return;
+    }
+
+    // Build the burst read command (the number of data words is in the low bits)
+    sampleCommandWord = ENCODER_READ_COMMAND | ENCODER_SAMPLE_REG | ENCODER_SAMPLE_WORDS;
+    sampleCommand[0] = uint8_t(sampleCommandWord >> 8);
+    sampleCommand[1] = uint8_t(sampleCommandWord);
+
+    // Build the status read command, used to clear errors in the encoder
+    uint16_t resetCommand = ENCODER_READ_COMMAND + SAFE_HIGH;
+    sampleResetCommand[0] = uint8_t(resetCommand >> 8);
+    sampleResetCommand[1] = uint8_t(resetCommand);
+    safetyResetPending = false;
+
+    // Enable the DMA clock and point both SPI1 channels at the data register
+    // SPI1_RX is DMA1 channel 2, SPI1_TX is DMA1 channel 3
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    DMA1_Channel2 -> CCR = 0;
+    DMA1_Channel3 -> CCR = 0;
+    DMA1_Channel2 -> CPAR = (uint32_t)&(SPI1 -> DR);
+    DMA1_Channel3 -> CPAR = (uint32_t)&(SPI1 -> DR);
+
+    // Only the receive channel needs an interrupt (it finishes after the transmit channel)
+    HAL_NVIC_SetPriority(DMA1_Channel2_IRQn, ENCODER_DMA_IRQ_PRIO, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel2_IRQn);
+
+    // Reset the sample buffers
+    sampleState = SAMPLE_IDLE;
+    latestSampleBuffer = 0;
+    sampleCount = 0;
+
+    // Take the first sample right away so there is always a valid one to read
+    sampling = true;
+    triggerSample();
+    disableInterrupts();
+    finishSample();
+    enableInterrupts();
 }
 
 
-// Read multiple registers
-void Encoder::readMultipleRegisters(uint16_t registerAddress, uint16_t* data, uint16_t dataLength) {
+// Stops the background sampling, returning to blocking reads
+void Encoder::stopSampling() {
 
-    // Disable interrupts
+    // Let any burst in flight finish, then stop
     disableInterrupts();
+    finishSample();
+    sampling = false;
+    enableInterrupts();
+}
 
-    // Pull CS low to select encoder
+
+// Returns if the background sampling is running
+bool Encoder::isSampling() const {
+    return sampling;
+}
+
+
+// Starts a new sample burst if the bus is free
+void Encoder::triggerSample() {
+
+    // Skip if sampling isn't running, the last burst hasn't finished, or a blocking transaction owns the bus
+    if (!sampling || busClaimed || sampleState != SAMPLE_IDLE) {
+        return;
+    }
+
+    // Select the encoder and send the command
+    // If the last sample had an encoder error, this burst reads the status register instead to clear it
     GPIO_WRITE(ENCODER_CS_PIN, LOW);
+    sampleState = SAMPLE_COMMAND;
+    startSampleDMA(sampleCommandRX, (safetyResetPending ? sampleResetCommand : sampleCommand), 2, true);
+}
 
-    // Setup TX and RX buffers
-    registerAddress |= ENCODER_READ_COMMAND + dataLength;
-    uint8_t txbuf[dataLength * 2] = { uint8_t(registerAddress >> 8), uint8_t(registerAddress) };
-    uint8_t rxbuf[dataLength * 2];
 
-    // Send address we want to read, response seems to be equal to request
-    HAL_SPI_TransmitReceive(&spiConfig, txbuf, rxbuf, 2, 10);
+// Starts the DMA channels for one stage of a sample burst
+void Encoder::startSampleDMA(uint8_t* rxBuffer, uint8_t* txBuffer, uint16_t length, bool incrementTX) {
 
-    // Set the MOSI pin to open drain
-    GPIO_InitStructure.Pin = GPIO_PIN_7;
-    GPIO_InitStructure.Mode = GPIO_MODE_AF_OD;
-    HAL_GPIO_Init(GPIOA, &GPIO_InitStructure);
+    // Disable the channels and clear their flags
+    DMA1_Channel2 -> CCR = 0;
+    DMA1_Channel3 -> CCR = 0;
+    DMA1 -> IFCR = DMA_IFCR_CGIF2 | DMA_IFCR_CGIF3;
+
+    // Receive channel (peripheral to memory, interrupt on completion)
+    DMA1_Channel2 -> CMAR = (uint32_t)rxBuffer;
+    DMA1_Channel2 -> CNDTR = length;
+    DMA1_Channel2 -> CCR = DMA_CCR_MINC | DMA_CCR_TCIE | DMA_CCR_PL_1 | DMA_CCR_EN;
+
+    // Transmit channel (memory to peripheral). The idle 0xFF byte is repeated without incrementing
+    DMA1_Channel3 -> CMAR = (uint32_t)txBuffer;
+    DMA1_Channel3 -> CNDTR = length;
+    DMA1_Channel3 -> CCR = DMA_CCR_DIR | (incrementTX ? DMA_CCR_MINC : 0) | DMA_CCR_PL_1 | DMA_CCR_EN;
+
+    // Let the SPI request the transfers (receive must be enabled first)
+    SPI1 -> CR2 |= SPI_CR2_RXDMAEN;
+    SPI1 -> CR2 |= SPI_CR2_TXDMAEN;
+    __HAL_SPI_ENABLE(&spiConfig);
+}
 
-    // Send 0xFFFF (like BTT code), this returns the wanted value
-    // Array length is doubled as we're using 8 bit values instead of 16
-    for (uint8_t i = 0; i < dataLength * 2; i++) {
-        txbuf[i] = 0xFF;
+
+// Moves the sample burst to its next stage
+void Encoder::handleSampleDMA() {
+
+    // Only handle completed transfers
+    if (!(DMA1 -> ISR & DMA_ISR_TCIF2)) {
+        return;
     }
-    HAL_SPI_TransmitReceive(&spiConfig, txbuf, rxbuf, dataLength * 2, 10);
 
-    // Write the received data into the array
-    for (uint8_t i = 0; i < dataLength; i++) {
-        data[i] = rxbuf[i * 2] << 8 | rxbuf[i * 2 + 1];
+    // Stop the requests and clear the flags
+    SPI1 -> CR2 &= ~(SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+    DMA1_Channel2 -> CCR = 0;
+    DMA1_Channel3 -> CCR = 0;
+    DMA1 -> IFCR = DMA_IFCR_CGIF2 | DMA_IFCR_CGIF3;
+
+    // The command was sent, release the data line and clock in the registers
+    if (sampleState == SAMPLE_COMMAND) {
+        ENCODER_MOSI_OPEN_DRAIN();
+        sampleState = SAMPLE_DATA;
+        if (safetyResetPending) {
+            startSampleDMA(sampleResetRX, &sampleIdleTX, sizeof(sampleResetRX), false);
+        }
+        else {
+            startSampleDMA(sampleBuffers[latestSampleBuffer ^ 1], &sampleIdleTX, ENCODER_SAMPLE_BYTES, false);
+        }
     }
 
-    // Set MOSI back to Push/Pull
-    GPIO_InitStructure.Mode = GPIO_MODE_AF_PP;
-    HAL_GPIO_Init(GPIOA, &GPIO_InitStructure);
+    // The registers were read, finish the transaction
+    else if (sampleState == SAMPLE_DATA) {
+        ENCODER_MOSI_PUSH_PULL();
+        GPIO_WRITE(ENCODER_CS_PIN, HIGH);
 
-    // Deselect encoder
-    GPIO_WRITE(ENCODER_CS_PIN, HIGH);
+        // A status read just clears the errors, there's nothing to publish
+        if (safetyResetPending) {
+            safetyResetPending = false;
+        }
+        else {
+            // Combine the received bytes into words (the safety word is last)
+            uint8_t* buffer = sampleBuffers[latestSampleBuffer ^ 1];
+            uint16_t words[ENCODER_SAMPLE_WORDS + 1];
+            for (uint8_t i = 0; i <= ENCODER_SAMPLE_WORDS; i++) {
+                words[i] = (buffer[i * 2] << 8) | buffer[i * 2 + 1];
+            }
+
+            // Only publish the sample if it is valid, otherwise the previous one is kept
+            errorTypes error = checkSafety(words[ENCODER_SAMPLE_WORDS], sampleCommandWord, words, ENCODER_SAMPLE_WORDS);
+            if (error == NO_ERROR) {
+                latestSampleBuffer ^= 1;
+                sampleTimes[latestSampleBuffer] = cycleCount64();
+                sampleCount++;
+            }
+            else if (error != INTERFACE_ACCESS_ERROR) {
+                safetyResetPending = true;
+            }
+        }
+
+        // Ready for the next burst
+        sampleState = SAMPLE_IDLE;
+    }
+}
+
+
+// Waits for a sample burst in flight to finish
+// Warning: interrupts must be disabled, otherwise the DMA interrupt could run at the same time
+void Encoder::finishSample() {
+
+    // Poll the DMA, moving the burst along until it is complete
+    while (sampleState != SAMPLE_IDLE) {
+        handleSampleDMA();
+    }
+}
 
-    // Enable interrupts
+
+// Copies the newest complete sample into the data array
+void Encoder::getSample(uint16_t* data, uint64_t* sampleTime) {
+
+    // The buffer can't be swapped while it is being copied
+    disableInterrupts();
+
+    // Combine the bytes into words
+    uint8_t* buffer = sampleBuffers[latestSampleBuffer];
+    for (uint8_t i = 0; i < ENCODER_SAMPLE_WORDS; i++) {
+        data[i] = (buffer[i * 2] << 8) | buffer[i * 2 + 1];
+    }
+
+    // Copy the time if requested
+    if (sampleTime != NULL) {
+        *sampleTime = sampleTimes[latestSampleBuffer];
+    }
+
+    // Done with the buffer
     enableInterrupts();
 }
 
 
+// Returns the number of samples completed since sampling started
+uint32_t Encoder::getSampleCount() const {
+    return sampleCount;
+}
+
+
+// Interrupt for the SPI1 receive DMA channel
+extern "C" void DMA1_Channel2_IRQHandler(void) {
+    motor.encoder.handleSampleDMA();
+}
+
+#endif // ! ENCODER_DMA_SAMPLING
+
+
 // Write a value to a register
 // ! Untested
 void Encoder::writeToRegister(uint16_t registerAddress, uint16_t data) {
 
-    // Disable the motor timers
-    disableInterrupts();
+    // Claim the bus
+    claimBus();
 
     // Pull CS low to select encoder
     GPIO_WRITE(ENCODER_CS_PIN, LOW);
@@ -337,13 +454,13 @@ void Encoder::writeToRegister(uint16_t registerAddress, uint16_t data) {
     // Deselect encoder
     GPIO_WRITE(ENCODER_CS_PIN, HIGH);
 
-    // Re-enable the motor timers
-    enableInterrupts();
+    // Release the bus
+    releaseBus();
 }
 
 
 // Checks the encoder's response for any errors
-// Warning: this function cannot be interrupted, so make sure that it is called in a function that disables interrupts
+// Doesn't touch the bus, the caller is responsible for calling resetSafety() if needed
 errorTypes Encoder::checkSafety(uint16_t safety, uint16_t command, uint16_t* readreg, uint16_t length) {
 
     // A final accumulator for there was an error
@@ -352,7 +469,6 @@ errorTypes Encoder::checkSafety(uint16_t safety, uint16_t command, uint16_t* rea
     // Check for system errors
 	if (!((safety) & ENCODER_SYSTEM_ERROR_MASK)) {
 		error = SYSTEM_ERROR;
-		resetSafety();
 	}
 
     // Check for interface errors
@@ -363,80 +479,34 @@ errorTypes Encoder::checkSafety(uint16_t safety, uint16_t command, uint16_t* rea
     // Check for invalid angles
     else if (!((safety) & ENCODER_INV_ANGLE_ERROR_MASK)) {
     	error = INVALID_ANGLE_ERROR;
-        resetSafety();
 	}
 
     // If there have been no errors so far, then check the CRC
     else {
 
-        // Check the length of the message, then create the buffer needed to hold it
-		uint16_t lengthOfTemp = length * 2 + 2;
-		uint8_t temp[lengthOfTemp];
-
-        // Read out command to the first two bytes of the message
-		temp[0] = (uint8_t)(command >> 8);
-		temp[1] = (uint8_t)(command);
-
-		for (uint16_t index = 0; index < length; index++) {
-			temp[2 + 2 * index] =     (uint8_t)(readreg[index] >> 8); // Reads the first byte of the 16 bit message
-			temp[2 + 2 * index + 1] = (uint8_t)(readreg[index]);      // Reads the second byte
-		}
-
-		uint8_t crcReceivedFinal = (uint8_t)(safety); // Checks the second byte of the safety
-		uint8_t crc = calcCRC(temp, lengthOfTemp);
-
         // Make sure that the calculated CRC is equal to the sent CRC
-		if (crc != crcReceivedFinal) {
+		if (!checkEncoderCRC(safety, command, readreg, length)) {
 			error = CRC_ERROR;
-            resetSafety();
 		}
         else {
 			error = NO_ERROR;
 		}
 	}
 
+    // Count the error
+    if (error != NO_ERROR) {
+        errorCounts[ENCODER_ERROR_INDEX(error)]++;
+    }
+
     // Return the error that was found (if any)
 	return (error);
 }
 
 
-// Calculates the CRC of an array of 8 bit messages
-uint8_t Encoder::calcCRC(uint8_t *data, uint8_t length) {
-
-    // Create an accumulator for the CRC
-	uint32_t crc;
-
-    // Set the CRC to the seed
-	crc = CRC_SEED;
-
-    // Loop through the message, marking in the CRC if there are any errors
-	for (uint16_t i = 0; i < length; i++)
-	{
-		crc ^= data[i];
-		for (uint8_t bit = 0; bit < 8; bit++)
-		{
-			if ((crc & 0x80) != 0)
-			{
-				crc <<= 1;
-				crc ^= CRC_POLYNOMIAL;
-			}else{
-				crc <<= 1;
-			}
-		}
-	}
-
-    // Check if the CRC has changed at all from the original seeding
-	return ((~crc) & CRC_SEED);
-}
-
-
-// Resets the safety check of the encoder
-// Warning: this function cannot be interrupted, so make sure that it is called in a function that disables interrupts
+// Resets the safety check of the encoder (reading the status register clears its error flags)
+// Warning: the bus must already be claimed by the caller
 void Encoder::resetSafety() {
 
-    // Disable the motor timers
-    disableInterrupts();
-
     // Build the command
 	uint16_t command = ENCODER_READ_COMMAND + SAFE_HIGH;
 
@@ -444,63 +514,243 @@ void Encoder::resetSafety() {
     uint8_t txbuf[2] = { uint8_t(command >> 8), uint8_t(command) };
 	uint8_t rxbuf[2];
 
+    // Pull CS low to select encoder
+    GPIO_WRITE(ENCODER_CS_PIN, LOW);
+
     // Send the command on the first transmission
 	HAL_SPI_TransmitReceive(&spiConfig, txbuf, rxbuf, 2, 10);
 
-    // Only need to read on the 2nd, 3rd, and 4th, so just send a blank tx message
+    // Set the MOSI pin to open drain
+    GPIO_InitStructure.Pin = GPIO_PIN_7;
+    GPIO_InitStructure.Mode = GPIO_MODE_AF_OD;
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStructure);
+
+    // Only need to read on the 2nd and 3rd, so just send a blank tx message
     txbuf[0] = 0xFF, txbuf[1] = 0xFF;
 
-    // TX/RX twice, just reading the response (response doesn't matter)
+    // TX/RX twice, just reading the status and safety word (response doesn't matter)
     HAL_SPI_TransmitReceive(&spiConfig, txbuf, rxbuf, 2, 10);
     HAL_SPI_TransmitReceive(&spiConfig, txbuf, rxbuf, 2, 10);
 
-    // Re-enable the motor timers
-    enableInterrupts();
+    // Set MOSI back to Push/Pull
+    GPIO_InitStructure.Mode = GPIO_MODE_AF_PP;
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStructure);
+
+    // Deselect encoder
+    GPIO_WRITE(ENCODER_CS_PIN, HIGH);
 }
 
 
-// Get a bit field from a register
-uint16_t Encoder::getBitField(BitField_t bitField) {
+// Returns the number of times an error type was seen
+uint32_t Encoder::getErrorCount(errorTypes error) const {
+    return errorCounts[ENCODER_ERROR_INDEX(error)];
+}
 
-    // Check to make sure that the value can be read
-	if ((REG_ACCESS_R & bitField.regAccess) == REG_ACCESS_R) {
-		if ((REG_ACCESS_U & bitField.regAccess) == REG_ACCESS_U) {
-			// ! p->sBus->triggerUpdate();
-		}
 
-        // Return the value at the address (if the read was successful)
-        if (readRegister(addrFields[bitField.posMap].regAddress, regMap[bitField.posMap]) == NO_ERROR) {
-            return ((regMap[bitField.posMap] & bitField.mask) >> bitField.position);
+// Returns the number of reads that failed after all of their attempts
+uint32_t Encoder::getFailedReadCount() const {
+    return failedReads;
+}
+
+
+// Clears all of the error counters
+void Encoder::clearErrorCounts() {
+    memset(errorCounts, 0, sizeof(errorCounts));
+    failedReads = 0;
+    revMismatches = 0;
+}
+
+
+// Reads a register into its shadow copy
+errorTypes Encoder::loadShadowRegister(uint8_t index) {
+
+    // Read the register straight into the shadow
+    errorTypes error = readRegister(ENCODER_REGISTER_ADDRESS(index), shadowRegisters[index]);
+    if (error == NO_ERROR) {
+        shadowLoaded |= (1 << index);
+    }
+    return error;
+}
+
+
+// Writes all of the staged fields to the sensor
+// Each modified register is written once, then read back to make sure that the sensor took the staged fields
+errorTypes Encoder::commitFields() {
+
+    // Keep the first error that happens
+    errorTypes result = NO_ERROR;
+
+    // Go through each of the registers with staged fields
+    for (uint8_t index = 0; index < ENCODER_SHADOW_REGISTERS; index++) {
+        if (stagedBits[index] == 0) {
+            continue;
+        }
+
+        // Write the register
+        uint16_t address = ENCODER_REGISTER_ADDRESS(index);
+        writeToRegister(address, shadowRegisters[index]);
+
+        // Check that the fields read back as written
+        errorTypes error = NO_ERROR;
+        if (verifyBits[index] != 0) {
+            uint16_t readBack;
+            error = readRegister(address, readBack);
+            if ((error == NO_ERROR) && ((readBack ^ shadowRegisters[index]) & verifyBits[index])) {
+                error = INTERFACE_ACCESS_ERROR;
+            }
+            if ((error != NO_ERROR) && (result == NO_ERROR)) {
+                result = error;
+            }
+        }
+
+        // The shadow no longer matches the sensor if the write failed, or if the sensor changes some of the fields itself
+        if ((error != NO_ERROR) || (stagedBits[index] != verifyBits[index])) {
+            shadowLoaded &= ~(1 << index);
         }
+
+        // Nothing is waiting on the register anymore
+        stagedBits[index] = 0;
+        verifyBits[index] = 0;
     }
 
-    // Not able to read that address, just return a -1
-    return -1;
+    // Return the result of the writes
+    return result;
 }
 
 
-// Write out a bit field to the register
-void Encoder::setBitField(BitField_t bitField, uint16_t bitFNewValue) {
+// Forgets the shadow registers (needed if the sensor was reset), along with anything that was staged
+void Encoder::invalidateShadowRegisters() {
+    shadowLoaded = 0;
+    memset(stagedBits, 0, sizeof(stagedBits));
+    memset(verifyBits, 0, sizeof(verifyBits));
+}
 
-    // Write the correct value
-	if ((REG_ACCESS_W & bitField.regAccess) == REG_ACCESS_W) {
-		regMap[bitField.posMap] = (regMap[bitField.posMap] & ~bitField.mask) | ((bitFNewValue << bitField.position) & bitField.mask);
-		writeToRegister(addrFields[bitField.posMap].regAddress, regMap[bitField.posMap]);
-	}
+
+// Sets the update rate of the sensor
+// Faster rates reduce the latency of the angle, slower ones filter more of the noise
+errorTypes Encoder::setUpdateRate(ENCODER_UPDATE_RATE rate) {
+
+    // Make sure that the rate exists (FIR_MD is only 2 bits)
+    if (rate > UPDATE_RATE_171US) {
+        return INTERFACE_ACCESS_ERROR;
+    }
+
+    // Write the rate into FIR_MD
+    errorTypes error = writeField<REG_MOD_1_FIRMD>(rate);
+
+    // Only cache the rate if the sensor took it, the speed conversions need to match the sensor
+    if (error == NO_ERROR) {
+        updateRate = rate;
+        sensorUpdatePeriod = encoderUpdatePeriods[rate];
+    }
+    return error;
+}
+
+
+// Returns the update rate of the sensor
+ENCODER_UPDATE_RATE Encoder::getUpdateRate() const {
+    return updateRate;
+}
+
+
+// Returns the update period of the sensor (us)
+double Encoder::getUpdatePeriod() const {
+    return sensorUpdatePeriod;
+}
+
+
+// Sets if the sensor should predict the angle from the angle speed
+// Prediction removes most of the lag from the filter at speed, but overshoots on sudden changes
+errorTypes Encoder::setPrediction(bool enabled) {
+
+    // Write the setting into PREDICT
+    errorTypes error = writeField<REG_MOD_2_PREDICT>(enabled);
+
+    // Only cache the setting if the sensor took it
+    if (error == NO_ERROR) {
+        prediction = enabled;
+    }
+    return error;
+}
+
+
+// Returns if the sensor is predicting the angle
+bool Encoder::getPrediction() const {
+    return prediction;
+}
+
+
+// Reads a coherent snapshot of the encoder
+// AVAL, ASPD, AREV, and FSYNC are read in a single burst, so the angle and revolutions can't come from different frames
+EncoderSnapshot Encoder::getSnapshot() {
+
+    // Storage for the raw registers and the snapshot
+    uint16_t rawData[ENCODER_SAMPLE_WORDS];
+    EncoderSnapshot snapshot;
+
+    // Use the newest background sample if sampling, otherwise read all of the registers at once
+    #ifdef ENCODER_DMA_SAMPLING
+    if (sampling) {
+        getSample(rawData, &snapshot.timestamp);
+        snapshot.valid = true;
+    }
+    else
+    #endif
+    {
+        // The last valid reading is kept if the read fails, along with its time (so the stale angle isn't taken as a new sample)
+        snapshot.valid = (readMultipleRegisters(ENCODER_SAMPLE_REG, lastValidData, ENCODER_SAMPLE_WORDS) == NO_ERROR);
+        if (snapshot.valid) {
+            lastValidTime = cycleCount64();
+        }
+        memcpy(rawData, lastValidData, sizeof(rawData));
+        snapshot.timestamp = lastValidTime;
+    }
+
+    // Angle is the lower 15 bits
+    snapshot.rawAngle = rawData[SAMPLE_AVAL_INDEX] & DELETE_BIT_15;
+
+    // Speed is a signed 15 bit value (shift up and back down to propagate the sign)
+    snapshot.rawSpeed = (int16_t)(rawData[SAMPLE_ASPD_INDEX] << 1) >> 1;
+
+    // Revolutions are a signed 9 bit value, the frame counter sits above them
+    snapshot.rawRev = (int16_t)(rawData[SAMPLE_AREV_INDEX] << 7) >> 7;
+    snapshot.frameCounter = (rawData[SAMPLE_AREV_INDEX] & GET_FCNT_BITS) >> FCNT_SHIFT;
+
+    // Frame synchronization counter
+    snapshot.frameSync = (rawData[SAMPLE_FSYNC_INDEX] & GET_FSYNC_BITS) >> FSYNC_SHIFT;
+
+    // Unwrap the angle into the multi-turn position
+    trackPosition(snapshot.rawAngle, snapshot.rawRev);
+
+    // The tracked position includes the raw angle, swap it for the linearized one and remove the offsets
+    snapshot.position = trackedPosition - snapshot.rawAngle + linearize(snapshot.rawAngle) - encoderStepOffset - startupAngleOffset;
+    snapshot.revolutions = (int32_t)(trackedPosition >> INCREMENTS_PER_REV_BITS);
+    snapshot.absolutePosition = (int32_t)snapshot.position;
+    snapshot.absoluteAngle = INCREMENTS_TO_DEG(snapshot.absolutePosition);
+    snapshot.speed = rawSpeedToDPS(snapshot.rawSpeed);
+
+    // Return the finished snapshot
+    return snapshot;
 }
 
 
 // Reads the raw momentary value from the angle register of the encoder (unadjusted)
 uint16_t Encoder::getRawIncrements() {
 
-    // Create an accumulator for the raw data
-    uint16_t rawData;
+    // Use the newest background sample if sampling
+    #ifdef ENCODER_DMA_SAMPLING
+    if (sampling) {
+        uint16_t sample[ENCODER_SAMPLE_WORDS];
+        getSample(sample);
+        return sample[SAMPLE_AVAL_INDEX] & DELETE_BIT_15;
+    }
+    #endif
 
-    // Loop until a valid reading
-    while (readRegister(ENCODER_ANGLE_REG, rawData) != NO_ERROR);
+    // Read the register (the last valid reading is kept if the read fails)
+    readRegister(ENCODER_ANGLE_REG, lastValidData[SAMPLE_AVAL_INDEX]);
 
     // Delete the first bit, saving the last 15
-    return rawData & DELETE_BIT_15;
+    return lastValidData[SAMPLE_AVAL_INDEX] & DELETE_BIT_15;
 }
 
 
@@ -518,14 +768,86 @@ uint16_t Encoder::getRawIncrementsAvg() {
 }
 
 
+// Averages a set of raw readings, waiting for a new sensor update between each
+// The readings are taken relative to the first, so a set that crosses between 32767 and 0 is handled correctly
+uint16_t Encoder::getRawIncrementsSettled(uint16_t readings) {
+
+    // The first reading is the reference
+    int32_t firstReading = getRawIncrements();
+    int32_t totalDifference = 0;
+
+    // Take the rest of the readings
+    for (uint16_t reading = 0; reading < readings; reading++) {
+
+        // Wait for the sensor to update
+        delay(1);
+
+        // Add the difference from the first reading
+        totalDifference += WRAP_INCREMENTS((int32_t)getRawIncrements() - firstReading);
+    }
+
+    // Return the average, wrapped back into a revolution
+    return (firstReading + (totalDifference / readings)) & (INCREMENTS_PER_REV - 1);
+}
+
+
+// Corrects the raw increments with the linearization table
+// Constant time, the two nearest points are interpolated between
+int32_t Encoder::linearize(uint16_t rawIncrements) const {
+
+    #ifdef ENABLE_ENCODER_LINEARIZATION
+
+        // Skip the correction if there isn't a table
+        if (!linearized) {
+            return rawIncrements;
+        }
+
+        // Remove the error in the table from the reading
+        return applyLinearization(linearizationTable, rawIncrements);
+
+    #else
+        // No linearization, the raw reading is used
+        return rawIncrements;
+    #endif
+}
+
+
+#ifdef ENABLE_ENCODER_LINEARIZATION
+// Sets the linearization table (NULL removes it)
+void Encoder::setLinearization(const int16_t* table) {
+
+    // The table is used in the correction tick, so it can't be partly written when it is applied
+    disableInterrupts();
+
+    // Copy the table over if there is one
+    if (table != NULL) {
+        memcpy(linearizationTable, table, sizeof(linearizationTable));
+        linearized = true;
+    }
+    else {
+        linearized = false;
+    }
+
+    // Done
+    enableInterrupts();
+}
+
+
+// Returns if a linearization table is being applied
+bool Encoder::isLinearized() const {
+    return linearized;
+}
+#endif
+
+
 // Reads the raw momentary value from the angle of the encoder (unadjusted ???)
 double Encoder::getRawAngle() {
 
     // Create an accumulator for the raw data
-    uint16_t rawData = getRawIncrements();
+    int32_t rawData = getRawIncrements();
 
     // Calc the value (equation from TLE5012 library)
-    return ((360.0 / POW_2_15) * (double)rawData) - encoderStepOffset;
+    return INCREMENTS_TO_DEG((double)(rawData - encoderStepOffset));
 }
 
 
@@ -533,10 +855,10 @@ double Encoder::getRawAngle() {
 double Encoder::getRawAngleAvg() {
 
     // Read the raw average Steps
-    uint16_t rawData = getRawIncrementsAvg();
+    int32_t rawData = getRawIncrementsAvg();
 
     // Calc the value (equation from TLE5012 library)
-    return 360.0 / POW_2_15 * (double)rawData - encoderStepOffset;
+    return INCREMENTS_TO_DEG((double)(rawData - encoderStepOffset));
 }
 
 
@@ -551,46 +873,61 @@ double Encoder::getSmoothAngle() {
 
 // Reads the momentary value for the angle of the encoder (ranges from 0-360)
 double Encoder::getAngle() {
-    return (getRawAngle() - startupAngleOffset);
+    return (getRawAngle() - INCREMENTS_TO_DEG((double)startupAngleOffset));
 }
 
 
 // Reads the average value for the angle of the encoder (ranges from 0-360)
 double Encoder::getAngleAvg() {
-    return (getRawAngleAvg() - startupAngleOffset);
+    return (getRawAngleAvg() - INCREMENTS_TO_DEG((double)startupAngleOffset));
 }
 
 
-// For average velocity calculations instead of hardware readings from the TLE5012
-// Returns the speed of the encoder in deg/s
-// ! Needs fixed yet, readings are off
-double Encoder::getEstimSpeed() {
+// Returns the observer's position estimate (in increments)
+int32_t Encoder::getObserverPosition() const {
+
+    // Copy the position out (64 bit values can't be read in one go)
+    disableInterrupts();
+    int32_t position = observer.getPosition();
+    enableInterrupts();
+    return position;
+}
+
+
+// Returns the observer's velocity estimate (in increments/s)
+int32_t Encoder::getObserverVelocity() const {
+    return observer.getVelocity();
+}
 
-    // Get the newest angle
-    double newAngle = getAbsoluteAngleAvg();
 
-    // Sample time
-    uint32_t currentTime = micros();
+// Returns the observer's acceleration estimate (in increments/s^2)
+int32_t Encoder::getObserverAccel() const {
+    return observer.getAccel();
+}
 
-    // Compute the average velocity
-    double avgVelocity = 1000000.0 * (newAngle - lastEncoderAngle) / (currentTime - lastAngleSampleTime);
 
-    // Correct the last angle and sample time
-    lastEncoderAngle = newAngle;
-    lastAngleSampleTime = currentTime;
+// Returns the speed of the encoder in deg/s (from the observer)
+double Encoder::getEstimSpeed() {
 
-    // Add the value to the averaging list
-    speedAvg.add(avgVelocity);
+    // Make sure that the observer is running
+    if (cacheExpired()) {
+        updateCache();
+    }
 
-    // Return the averaged velocity in deg/s
-    return speedAvg.get();
+    // Save the time of the reading (used to limit the display rate)
+    #ifdef ENCODER_SPEED_ESTIMATION
+        lastAngleSampleTime = cycleCount64();
+    #endif
+
+    // Convert the estimate to degrees
+    return INCREMENTS_TO_DEG((double)observer.getVelocity());
 }
 
 
 #ifdef ENCODER_SPEED_ESTIMATION
 // Returns true if the encoder's minimum speed sample interval has been exceeded
 bool Encoder::sampleTimeExceeded() {
-    return (micros() - lastAngleSampleTime > SPD_EST_MIN_INTERVAL);
+    return (cyclesSince(lastAngleSampleTime) > microsToCycles(SPD_EST_MIN_INTERVAL));
 }
 #endif
 
@@ -599,8 +936,20 @@ int16_t Encoder::getRawSpeed() {
     // Prepare the variables to store data in
 	int16_t rawData;
 
-    // Read the encoder
-    while (readRegister(ENCODER_SPEED_REG, (uint16_t &)rawData) != NO_ERROR);
+    // Use the newest background sample if sampling, otherwise read the encoder
+    #ifdef ENCODER_DMA_SAMPLING
+    if (sampling) {
+        uint16_t sample[ENCODER_SAMPLE_WORDS];
+        getSample(sample);
+        rawData = sample[SAMPLE_ASPD_INDEX];
+    }
+    else
+    #endif
+    {
+        // Read the register (the last valid reading is kept if the read fails)
+        readRegister(ENCODER_SPEED_REG, lastValidData[SAMPLE_ASPD_INDEX]);
+        rawData = lastValidData[SAMPLE_ASPD_INDEX];
+    }
 
     // Delete everything before the 14 LSB's
     rawData <<= 1;
@@ -615,85 +964,41 @@ int16_t Encoder::getRawSpeed() {
 // Reads the speed of the encoder in deg/s
 double Encoder::getSpeed() {
 
-    // Prepare the variables to store data in
-	uint16_t rawData[4];
-
-    // Read the encoder, modifying the array
-    readMultipleRegisters(ENCODER_SPEED_REG, rawData, sizeof(rawData) / sizeof(uint16_t));
-
-	// Get raw speed reading
-	int16_t rawSpeed = rawData[0];
-
-        // Delete everything before the 14 LSB's
-        rawSpeed <<= 1;
-
-        // If bit 14 is set, the value is negative
-        // Propagate sign of integer
-        rawSpeed >>= 1;
-
-	// Get FIR_MD from bits 15 and 16 of register 0x06
-	uint16_t firMD = rawData[3] >> 14;
-
-	// Determine sensor update rate from FIR_MD
-	double firMDVal;
-    switch (firMD) {
-        case 0:
-            firMDVal = 21.3;
-            break;
-        case 1:
-            firMDVal = 42.7;
-            break;
-        case 2:
-            firMDVal = 85.3;
-            break;
-        case 3:
-            firMDVal = 170.6;
-            break;
-        default:
-            firMDVal = 0.0; // ??? zero division
-            break;
-    }
-
-    // Calculate and average angle speed in degree per second
-	rawSpeedAvg.add(rawSpeed);
+    // Use the speed from the cached sample (the sensor update period is cached when the update rate is set)
+    rawSpeedAvg.add(getCachedSnapshot().rawSpeed);
 
     // Return the result in deg/s
-    return (1000000.0 * 0.5 * (360.0 / POW_2_15) * rawSpeedAvg.getDouble() / firMDVal);
+    return rawSpeedToDPS(rawSpeedAvg.getDouble());
 }
 
 
-// Calculates the angular acceleration. Done by looking at position over time^2
-double Encoder::getAccel() {
-
-    // Get the newest angle
-    double newAngle = getAbsoluteAngleAvg();
+// Converts a raw speed reading into deg/s
+double Encoder::rawSpeedToDPS(double rawSpeed) const {
 
-    // Sample time
-    uint32_t currentTime = micros();
+    // The speed register is the angle difference over two sensor updates
+    return (1000000.0 * 0.5 * (360.0 / POW_2_15) * rawSpeed / sensorUpdatePeriod);
+}
 
-    // Compute the average velocity (extra pow at beginning is needed to convert microseconds to seconds)
-    double avgAccel = (newAngle - lastEncoderAngle) / pow(1000000 * (currentTime - lastAngleSampleTime), 2);
 
-    // Correct the last angle and sample time
-    lastEncoderAngle = newAngle;
-    lastAngleSampleTime = currentTime;
+// Returns the angular acceleration of the encoder in deg/s^2 (from the observer)
+double Encoder::getAccel() {
 
-    // Add the value to the averaging list
-    accelAvg.add(avgAccel);
+    // Make sure that the observer is running
+    if (cacheExpired()) {
+        updateCache();
+    }
 
-    // Return the averaged velocity
-    return accelAvg.get();
+    // Convert the estimate to degrees
+    return INCREMENTS_TO_DEG((double)observer.getAccel());
 }
 
 
 // Reads the raw momentary temperature of the encoder
 int16_t Encoder::getRawTemp() {
 
-    // Create an accumulator for the raw data
-    int16_t rawData;
-
-    // Loop until a valid reading
-    while (readRegister(ENCODER_TEMP_REG, (uint16_t &)rawData) != NO_ERROR);
+    // Read the register (the last valid reading is kept if the read fails)
+    readRegister(ENCODER_TEMP_REG, lastValidData[SAMPLE_FSYNC_INDEX]);
+    int16_t rawData = lastValidData[SAMPLE_FSYNC_INDEX];
 
     // Delete everything before the 9 LSB's
     rawData <<= 7;
@@ -766,8 +1071,20 @@ int16_t Encoder::getRawRev() {
     // Create an accumulator for the raw data and converted data
     int16_t rawData;
 
-    // Loop continuously until there is no error
-    while (readRegister(ENCODER_ANGLE_REV_REG, (uint16_t &)rawData) != NO_ERROR);
+    // Use the newest background sample if sampling, otherwise read the encoder
+    #ifdef ENCODER_DMA_SAMPLING
+    if (sampling) {
+        uint16_t sample[ENCODER_SAMPLE_WORDS];
+        getSample(sample);
+        rawData = sample[SAMPLE_AREV_INDEX];
+    }
+    else
+    #endif
+    {
+        // Read the register (the last valid reading is kept if the read fails)
+        readRegister(ENCODER_ANGLE_REV_REG, lastValidData[SAMPLE_AREV_INDEX]);
+        rawData = lastValidData[SAMPLE_AREV_INDEX];
+    }
 
     // Delete the first 7 bits, they are not needed
     // Delete everything before the 9 LSB's
@@ -782,45 +1099,161 @@ int16_t Encoder::getRawRev() {
 }
 
 
-// Gets the revolutions of the motor
+// Gets the revolutions of the motor since startup
 int32_t Encoder::getRev() {
+    return getCachedSnapshot().revolutions;
+}
+
+
+// Unwraps a new angle sample into the multi-turn position
+// The position stays correct as long as samples are less than half a revolution apart. The revolution counter
+// comes from the same frame, so it's used to resolve larger gaps and to catch any disagreement
+void Encoder::trackPosition(uint16_t rawAngle, int16_t rawRev) {
+
+    // The first sample starts the position at the current angle
+    if (!trackerStarted) {
+        trackedPosition = rawAngle;
+        lastTrackedAngle = rawAngle;
+        lastTrackedRev = rawRev;
+        trackerStarted = true;
+        return;
+    }
 
-    // Get the raw value
-    int16_t rawRevNow = getRawRev();
-    if ((lastRawRev > 0) && (rawRevNow < 0)) // overflow
-        revolutions++;
-    else if ((lastRawRev < 0) && (rawRevNow > 0)) // borrow
-        revolutions--;
-    lastRawRev = rawRevNow;
-    return (revolutions * 512 + rawRevNow - startupRevOffset);
+    // Change of the angle, and the shortest way around to it
+    int32_t angleChange = (int32_t)rawAngle - lastTrackedAngle;
+    int32_t wrappedChange = WRAP_INCREMENTS(angleChange);
+
+    // Change according to the revolution counter
+    int32_t revChange = WRAP_REVOLUTIONS((int32_t)rawRev - lastTrackedRev);
+    int32_t counterChange = (revChange * INCREMENTS_PER_REV) + angleChange;
+
+    // Small changes can only be unwrapped one way, so the counter should agree
+    // Larger changes may have been sampled too slowly, so the counter decides
+    if (abs(wrappedChange) < TRACKER_TRUSTED_CHANGE) {
+        if (counterChange != wrappedChange) {
+            revMismatches++;
+        }
+        trackedPosition += wrappedChange;
+    }
+    else {
+        trackedPosition += counterChange;
+    }
+
+    // Save the sample for next time
+    lastTrackedAngle = rawAngle;
+    lastTrackedRev = rawRev;
 }
 
 
-// Gets the absolute angle of the motor
-double Encoder::getAbsoluteAngleAvg() {
+// Returns the number of samples where the unwrapped angle disagreed with the revolution counter
+uint32_t Encoder::getRevMismatchCount() const {
+    return revMismatches;
+}
 
-    // Add a new value to the average
-    absAngleAvg.add((float)((getRev() * 360) + getAngle()));
+
+// Acquires a new sample into the cache
+// The correction tick calls this once, then every reader during the tick shares the sample
+void Encoder::updateCache() {
+
+    // The cache can be updated from both the main loop and the correction tick, so it can't be interrupted
+    disableInterrupts();
+
+    // Take a single sample and add its position to the average and the observer
+    // A failed read repeats the last valid sample, which they already have, so it's left out of both
+    EncoderSnapshot snapshot = getSnapshot();
+    if (snapshot.valid) {
+        absPositionAvg.add(snapshot.absolutePosition);
+        observer.update(snapshot.absolutePosition, snapshot.timestamp);
+    }
+
+    // Publish the new values
+    cachedSnapshot = snapshot;
+    cachedPositionAvg = absPositionAvg.get();
+    cacheTime = cycleCount64();
+    cacheGeneration++;
+
+    // Done with the cache
+    enableInterrupts();
+}
+
+
+// Checks if the cached sample is too old to be used (nothing is updating it, such as when the correction is disabled)
+bool Encoder::cacheExpired() const {
+    return ((cacheGeneration == 0) || (cyclesSince(cacheTime) > microsToCycles(ENCODER_CACHE_MAX_AGE)));
+}
+
+
+// Gets the cached sample, only acquiring a new one if requested or if the cache has expired
+EncoderSnapshot Encoder::getCachedSnapshot(bool fresh) {
+
+    // Update the cache if needed
+    if (fresh || cacheExpired()) {
+        updateCache();
+    }
+
+    // Copy the snapshot out (the correction tick might update it part way through)
+    disableInterrupts();
+    EncoderSnapshot snapshot = cachedSnapshot;
+    enableInterrupts();
+
+    // Return the copy
+    return snapshot;
+}
+
+
+// Returns the generation of the cache (increases by one with every acquisition)
+uint32_t Encoder::getCacheGeneration() const {
+    return cacheGeneration;
+}
+
+
+// Gets the momentary position of the motor since startup (in increments)
+int32_t Encoder::getAbsolutePosition(bool fresh) {
+
+    // Angle and revolutions are from the same frame
+    return getCachedSnapshot(fresh).absolutePosition;
+}
+
+
+// Returns the multi-turn position since startup (increments)
+int64_t Encoder::getPosition(bool fresh) {
+    return getCachedSnapshot(fresh).position;
+}
+
+
+// Gets the average position of the motor since startup (in increments)
+// Only uses integer math, this is the one that should be used in the control loops
+int32_t Encoder::getAbsolutePositionAvg(bool fresh) {
+
+    // Update the cache if needed
+    if (fresh || cacheExpired()) {
+        updateCache();
+    }
 
     // Return the average
-    return absAngleAvg.getDouble();
+    return cachedPositionAvg;
+}
+
+
+// Gets the absolute angle of the motor
+double Encoder::getAbsoluteAngleAvg() {
+
+    // Convert the average position to degrees
+    return INCREMENTS_TO_DEG((double)getAbsolutePositionAvg());
 }
 
 
 // Gets the absolute angle of the motor, just returns a float
 float Encoder::getAbsoluteAngleAvgFloat() {
 
-    // Add a new value to the average
-    absAngleAvg.add((float)((getRev() * 360) + getAngle()));
-
-    // Return the average
-    return absAngleAvg.get();
+    // Convert the average position to degrees
+    return (float)getAbsolutePositionAvg() * (float)(360.0 / POW_2_15);
 }
 
 
-// Sets the encoder's step offset (used for calibration)
+// Sets the encoder's step offset (used for calibration, in degrees)
 void Encoder::setStepOffset(double offset) {
-    encoderStepOffset = offset;
+    encoderStepOffset = DEG_TO_INCREMENTS(offset);
 }
 
 
@@ -828,6 +1261,14 @@ void Encoder::setStepOffset(double offset) {
 void Encoder::zero() {
 
     // Fix offsets
-    startupAngleOffset = getRawAngleAvg();
-    startupRevOffset = getRawRev();
+    int32_t newAngleOffset = linearize(getRawIncrementsAvg()) - encoderStepOffset;
+
+    // Restart the multi-turn tracker, the next sample sets its starting point
+    disableInterrupts();
+    startupAngleOffset = newAngleOffset;
+    trackerStarted = false;
+
+    // The position jumped, so the observer needs restarted
+    observer.restart();
+    enableInterrupts();
 }
\ No newline at end of file
@@ -5,6 +5,12 @@
 #include "Arduino.h"
 #include "config.h"
 #include <MovingAverage.h>
+#include "encoderRegisters.h"
+#include "cycleTimer.h"
+#include "encoderCRC.h"
+#include "fixedPoint.h"
+#include "linearization.h"
+#include "observer.h"
 
 // Register locations (reading)
 #define ENCODER_READ_COMMAND    0x8000 // 8000
@@ -28,6 +34,14 @@
 #define GET_BIT_14_4                0x7FF0    // Used to check the 14th bit?
 #define TEMP_OFFSET                 152.0     // Used to offset the temp reading
 #define TEMP_DIV                    2.776     // Used to divide the temperature
+
+// Multi-turn tracking
+// The revolution counter is 9 bits, so its changes wrap at 512 revolutions
+// Angle changes under a quarter turn are trusted outright, larger ones are resolved with the revolution counter
+#define REV_COUNTER_BITS            9
+#define WRAP_REVOLUTIONS(REV)       ((((REV) + (1 << (REV_COUNTER_BITS - 1))) & ((1 << REV_COUNTER_BITS) - 1)) - (1 << (REV_COUNTER_BITS - 1)))
+#define TRACKER_TRUSTED_CHANGE      (INCREMENTS_PER_REV / 4)
+
 #define DELETE_7_BITS               0x01FF    // Used to delete the first 7 bits of a 16 bit integer
 #define CHANGE_UNIT_TO_INT_9        0x0200    // Used to change an unsigned 9 bit integer into signed
 #define CHECK_BIT_9                 0x0100    // Used to check the 9th bit
@@ -41,9 +55,66 @@
 #define ENCODER_INTERFACE_ERROR_MASK        0x2000    //!< \brief Interface error masks for safety words
 #define ENCODER_INV_ANGLE_ERROR_MASK        0x1000    //!< \brief Angle error masks for safety words
 
-// CRC calculation values
-#define CRC_POLYNOMIAL  0x1D
-#define CRC_SEED        0xFF
+// Number of times a blocking read is attempted before giving up
+#define ENCODER_READ_ATTEMPTS  3
+
+// Number of times the sensor's settings are written at startup before giving up (it keeps its power-on settings)
+#define ENCODER_SETUP_ATTEMPTS 3
+
+// Each sample is a single burst starting at AVAL (AVAL, ASPD, AREV, and FSYNC), followed by the safety word
+// All of the values in a sample come from the same sensor frame
+#define ENCODER_SAMPLE_REG    ENCODER_ANGLE_REG
+#define ENCODER_SAMPLE_WORDS  4
+#define ENCODER_SAMPLE_BYTES  ((ENCODER_SAMPLE_WORDS + 1) * 2)
+
+// Sensor update rates (the FIR_MD setting in MOD_1)
+typedef enum {
+    UPDATE_RATE_21US,
+    UPDATE_RATE_43US,
+    UPDATE_RATE_85US,
+    UPDATE_RATE_171US
+} ENCODER_UPDATE_RATE;
+
+// Positions of the registers in a sample
+typedef enum {
+    SAMPLE_AVAL_INDEX,
+    SAMPLE_ASPD_INDEX,
+    SAMPLE_AREV_INDEX,
+    SAMPLE_FSYNC_INDEX
+} SAMPLE_WORD_INDEX;
+
+// Additional masks for the sample registers
+#define GET_FCNT_BITS     0x7E00    // Frame counter in AREV (bits 14:9)
+#define FCNT_SHIFT        9
+#define GET_FSYNC_BITS    0xFE00    // Frame synchronization counter in FSYNC (bits 15:9)
+#define FSYNC_SHIFT       9
+
+// A coherent snapshot of the encoder. Every value comes from the same sensor frame
+typedef struct {
+    uint16_t rawAngle;       // Angle increments (15 bits)
+    int16_t  rawSpeed;       // Signed angle speed (15 bits)
+    int16_t  rawRev;         // Signed revolution counter (9 bits)
+    uint8_t  frameCounter;   // Frame counter, increments with every sensor update (6 bits)
+    uint8_t  frameSync;      // Frame synchronization counter (7 bits)
+    int32_t  revolutions;    // Revolutions since startup
+    int64_t  position;       // Multi-turn position since startup (increments)
+    int32_t  absolutePosition; // Position since startup (increments, wraps after 65536 revolutions but differences stay correct)
+    double   absoluteAngle;  // Angle since startup (deg)
+    double   speed;          // Angle speed (deg/s)
+    uint64_t timestamp;      // Time the sample was taken (cycle count)
+    bool     valid;          // If the sample is new (a failed read repeats the last valid sample, with the time that it was taken)
+} EncoderSnapshot;
+
+// Background sampling
+#ifdef ENCODER_DMA_SAMPLING
+
+    // Stages of a sample burst
+    typedef enum {
+        SAMPLE_IDLE,
+        SAMPLE_COMMAND,
+        SAMPLE_DATA
+    } SAMPLE_STATE;
+#endif
 
 /**
  * @brief Error types from safety word
@@ -57,203 +128,9 @@ enum errorTypes {
 	CRC_ERROR              = 0xFF   //!< \brief CRC_ERROR = Cyclic Redundancy Check (CRC), which includes the STAT and RESP bits wrong
 };
 
-// Main address fields
-enum Addr_t {
-    REG_STAT         = (0x0000U),    //!< \brief STAT status register
-    REG_ACSTAT       = (0x0010U),    //!< \brief ACSTAT activation status register
-    REG_AVAL         = (0x0020U),    //!< \brief AVAL angle value register
-    REG_ASPD         = (0x0030U),    //!< \brief ASPD angle speed register
-    REG_AREV         = (0x0040U),    //!< \brief AREV angle revolution register
-    REG_FSYNC        = (0x0050U),    //!< \brief FSYNC frame synchronization register
-    REG_MOD_1        = (0x0060U),    //!< \brief MOD_1 interface mode1 register
-    REG_SIL          = (0x0070U),    //!< \brief SIL register
-    REG_MOD_2        = (0x0080U),    //!< \brief MOD_2 interface mode2 register
-    REG_MOD_3        = (0x0090U),    //!< \brief MOD_3 interface mode3 register
-    REG_OFFX         = (0x00A0U),    //!< \brief OFFX offset x
-    REG_OFFY         = (0x00B0U),    //!< \brief OFFY offset y
-    REG_SYNCH        = (0x00C0U),    //!< \brief SYNCH synchronicity
-    REG_IFAB         = (0x00D0U),    //!< \brief IFAB register
-    REG_MOD_4        = (0x00E0U),    //!< \brief MOD_4 interface mode4 register
-    REG_TCO_Y        = (0x00F0U),    //!< \brief TCO_Y temperature coefficient register
-    REG_ADC_X        = (0x0100U),    //!< \brief ADC_X ADC X-raw value
-    REG_ADC_Y        = (0x0110U),    //!< \brief ADC_Y ADC Y-raw value
-    REG_D_MAG        = (0x0140U),    //!< \brief D_MAG angle vector magnitude
-    REG_T_RAW        = (0x0150U),    //!< \brief T_RAW temperature sensor raw-value
-    REG_IIF_CNT      = (0x0200U),    //!< \brief IIF_CNT IIF counter value
-    REG_T25O         = (0x0300U)     //!< \brief T25O temperature 25°c offset value
-};
-
-
-// Register access addresses
-enum Access_t {
-    REG_ACCESS_R    = (0x01U),      //!< \brief Read access register */
-    REG_ACCESS_W    = (0x02U),      //!< \brief Write access register */
-    REG_ACCESS_RW   = (0x03U),      //!< \brief Read & write access register */
-    REG_ACCESS_U    = (0x04U),      //!< \brief Update register */
-    REG_ACCESS_RU   = (0x05U),      //!< \brief Read & update register */
-    REG_ACCESS_RWU  = (0x07U),      //!< \brief Read & write & update register */
-    REG_ACCESS_RES  = (0x10U)       //!< \brief Reserved access register */
-};
-
-// Bitfield structure
-typedef struct {
-    uint8_t  regAccess;              //!< \brief Bitfield register access */
-    uint16_t regAddress;             //!< \brief Bitfiled register address */
-    uint16_t mask;                   //!< \brief Bitfield mask */
-    uint8_t  position;               //!< \brief Bitfiled position */
-    uint8_t  resetValue;             //!< \brief Bitfield register reset value */
-    uint8_t  posMap;                 //!< \brief Bitfield position of register in regMap */
-} BitField_t;
-
-// Address field structure
-typedef struct {
-    uint16_t regAddress;            //!< \brief Addressfield register address */
-    uint8_t  posMap;                //!< \brief Addressfield register regMap position */
-} AddressField_t;
-
-// Address field variable
-static const AddressField_t addrFields[] =
-{
-	{REG_STAT,     1    },    //!< \brief STAT status register
-	{REG_ACSTAT,   2    },    //!< \brief ACSTAT activation status register
-	{REG_AVAL,     3    },    //!< \brief AVAL angle value register
-	{REG_ASPD,     4    },    //!< \brief ASPD angle speed register
-	{REG_AREV,     5    },    //!< \brief AREV angle revolution register
-	{REG_FSYNC,    6    },    //!< \brief FSYNC frame synchronization register
-	{REG_MOD_1,    7    },    //!< \brief MOD_1 interface mode1 register
-	{REG_SIL,      8    },    //!< \brief SIL register
-	{REG_MOD_2,    9    },    //!< \brief MOD_2 interface mode2 register
-	{REG_MOD_3,   10    },    //!< \brief MOD_3 interface mode3 register
-	{REG_OFFX,    11    },    //!< \brief OFFX offset x
-	{REG_OFFY,    12    },    //!< \brief OFFY offset y
-	{REG_SYNCH,   13    },    //!< \brief SYNCH synchronicity
-	{REG_IFAB,    14    },    //!< \brief IFAB register
-	{REG_MOD_4,   15    },    //!< \brief MOD_4 interface mode4 register
-	{REG_TCO_Y,   16    },    //!< \brief TCO_Y temperature coefficient register
-	{REG_ADC_X,   17    },    //!< \brief ADC_X ADC X-raw value
-	{REG_ADC_Y,   18    },    //!< \brief ADC_Y ADC Y-raw value
-	{REG_D_MAG,   19    },    //!< \brief D_MAG angle vector magnitude
-	{REG_T_RAW,   20    },    //!< \brief T_RAW temperature sensor raw-value
-	{REG_IIF_CNT, 21    },    //!< \brief IIF_CNT IIF counter value
-	{REG_T25O,    22    },    //!< \brief T25O temperature 25°c offset value
-};
-
-#define MAX_NUM_REG 0x16      //!< \brief defines the value for temporary data to read all readable registers
-
-
-// Bit fields
-enum BitFieldReg_t
-{
-    REG_STAT_SRST,
-    REG_STAT_SWD,
-    REG_STAT_SVR,
-    REG_STAT_SFUSE,
-    REG_STAT_SDSPU,
-    REG_STAT_SOV,
-    REG_STAT_SXYOL,
-    REG_STAT_SMAGOL,
-    REG_STAT_RESERVED,
-    REG_STAT_SADCT,
-    REG_STAT_SROM,
-    REG_STAT_NOGMRXY,
-    REG_STAT_NOGMRA,
-    REG_STAT_SNR,
-    REG_STAT_RDST,
-
-    REG_ACSTAT_ASRST,
-    REG_ACSTAT_ASWD,
-    REG_ACSTAT_ASVR,
-    REG_ACSTAT_ASFUSE,
-    REG_ACSTAT_ASDSPU,
-    REG_ACSTAT_ASOV,
-    REG_ACSTAT_ASVECXY,
-    REG_ACSTAT_ASVEGMAG,
-    REG_ACSTAT_RESERVED1,
-    REG_ACSTAT_ASADCT,
-    REG_ACSTAT_ASFRST,
-    REG_ACSTAT_RESERVED2,
-
-    REG_AVAL_ANGVAL,
-    REG_AVAL_RDAV,
-
-    REG_ASPD_ANGSPD,
-    REG_ASPD_RDAS,
-
-    REG_AREV_REVOL,
-    REG_AREV_FCNT,
-    REG_AREV_RDREV,
-
-    REG_FSYNC_TEMPR,
-    REG_FSYNC_FSYNC,
-
-    REG_MOD_1_IIFMOD,
-    REG_MOD_1_DSPUHOLD,
-    REG_MOD_1_RESERVED1,
-    REG_MOD_1_CLKSEL,
-    REG_MOD_1_RESERVED2,
-    REG_MOD_1_FIRMD,
-
-    REG_SIL_ADCTVX,
-    REG_SIL_ADCTVY,
-    REG_SIL_ADCTVEN,
-    REG_SIL_RESERVED1,
-    REG_SIL_FUSEREL,
-    REG_SIL_RESERVED2,
-    REG_SIL_FILTINV,
-    REG_SIL_FILTPAR,
-
-    REG_MOD_2_AUTOCAL,
-    REG_MOD_2_PREDICT,
-    REG_MOD_2_ANGDIR,
-    REG_MOD_2_ANGRANGE,
-    REG_MOD_2_RESERVED1,
-
-    REG_MOD_3_PADDRV,
-    REG_MOD_3_SSCOD,
-    REG_MOD_3_SPIKEF,
-    REG_MOD_3_ANG_BASE,
-
-    REG_OFFX_RESERVED1,
-    REG_OFFX_XOFFSET,
-
-    REG_OFFY_RESERVED1,
-    REG_OFFY_YOFFSET,
-
-    REG_SYNCH_RESERVED1,
-    REG_SYNCH_SYNCH,
-
-    REG_IFAB_IFADHYST,
-    REG_IFAB_IFABOD,
-    REG_IFAB_FIRUDR,
-    REG_IFAB_ORTHO,
-
-    REG_MOD_4_IFMD,
-    REG_MOD_4_RESERVED1,
-    REG_MOD_4_IFABRES,
-    REG_MOD_4_HSMPLP,
-    REG_MOD_4_TCOXT,
-
-    REG_TCO_Y_CRCPAR,
-    REG_TCO_Y_SBIST,
-    REG_TCO_Y_TCOYT,
-
-    REG_ADC_X_ADCX,
-
-    REG_ADC_Y_ADCY,
-
-    REG_D_MAG_MAG,
-    REG_D_MAG_RESERVED1,
-
-    REG_T_RAW_TRAW,
-    REG_T_RAW_RESERVED1,
-    REG_T_RAW_TTGL,
-
-    REG_IIF_CNT_IIFCNT,
-    REG_IIF_CNT_RESERVED1,
-
-    REG_T25O_T250,
-    REG_T25O_RESERVED1,
-};
+// Error counters (one for each error type, the CRC error is moved to the end)
+#define ENCODER_ERROR_COUNTERS     6
+#define ENCODER_ERROR_INDEX(error) ((error) == CRC_ERROR ? (ENCODER_ERROR_COUNTERS - 1) : (error))
 
 // Encoder class
 class Encoder {
@@ -265,22 +142,82 @@ class Encoder {
 
         // Low level reading functions
         errorTypes readRegister(uint16_t registerAddress, uint16_t &data);
-        void readMultipleRegisters(uint16_t registerAddress, uint16_t* data, uint16_t dataLength);
-        uint16_t getBitField(BitField_t bitField);
+        errorTypes readMultipleRegisters(uint16_t registerAddress, uint16_t* data, uint16_t dataLength);
 
         // Low level writing functions
         void writeToRegister(uint16_t registerAddress, uint16_t data);
-        void setBitField(BitField_t bitfield, uint16_t bitFNewValue);
+
+        // Bit field accessors (the fields are described in encoderRegisters.h, so the access checks and masks are resolved
+        // at compile time). Writable fields are kept in shadow registers. Staged fields are only written when committed,
+        // so changing several fields of a register only writes it once
+        template <typename FIELD> errorTypes readField(uint16_t &value);
+        template <typename FIELD> errorTypes stageField(uint16_t value);
+        template <typename FIELD> errorTypes writeField(uint16_t value);
+        errorTypes commitFields();
+        void invalidateShadowRegisters();
+
+        // Sensor configuration (written to the sensor, the decoded update period is cached for the speed conversions)
+        errorTypes setUpdateRate(ENCODER_UPDATE_RATE rate);
+        ENCODER_UPDATE_RATE getUpdateRate() const;
+        double getUpdatePeriod() const;
+        errorTypes setPrediction(bool enabled);
+        bool getPrediction() const;
 
         // Error checking
         errorTypes checkSafety(uint16_t safety, uint16_t command, uint16_t* readreg, uint16_t length);
-        uint8_t calcCRC(uint8_t *data, uint8_t length);
         void resetSafety();
 
+        // Error counters
+        uint32_t getErrorCount(errorTypes error) const;
+        uint32_t getFailedReadCount() const;
+        void clearErrorCounts();
+
+        // Background sampling
+        #ifdef ENCODER_DMA_SAMPLING
+
+            // Starts sampling the angle registers in the background (one DMA burst per trigger)
+            void startSampling();
+
+            // Stops the background sampling, returning to blocking reads
+            void stopSampling();
+
+            // Returns if the background sampling is running
+            bool isSampling() const;
+
+            // Starts a new sample burst if the bus is free (called by the correction timer)
+            void triggerSample();
+
+            // Moves the sample burst to its next stage (called by the DMA interrupt)
+            void handleSampleDMA();
+
+            // Copies the newest complete sample into the data array (ENCODER_SAMPLE_WORDS long)
+            // The time that the sample was completed is also copied if requested
+            void getSample(uint16_t* data, uint64_t* sampleTime = NULL);
+
+            // Returns the number of samples completed since sampling started
+            uint32_t getSampleCount() const;
+        #endif
+
         // Fast functions
         uint16_t getRawIncrements();
         uint16_t getRawIncrementsAvg();
 
+        // Averages a set of readings, waiting between each (used for calibration)
+        uint16_t getRawIncrementsSettled(uint16_t readings);
+
+        // Corrects the raw increments with the linearization table (if there is one)
+        int32_t linearize(uint16_t rawIncrements) const;
+
+        // Linearization table
+        #ifdef ENABLE_ENCODER_LINEARIZATION
+
+            // Sets the table (NULL removes it, so the raw readings are used)
+            void setLinearization(const int16_t* table);
+
+            // If a table is being applied
+            bool isLinearized() const;
+        #endif
+
         // High level encoder functions
         // Reads the raw momentary value from the angle of the encoder (unadjusted)
         double getRawAngle();
@@ -297,14 +234,39 @@ class Encoder {
 
         // Reads the average value for the angle of the encoder (ranges from 0-360)
         double getAngleAvg();
+
+        // Observer estimates (updated with every cache update)
+        int32_t getObserverPosition() const;
+        int32_t getObserverVelocity() const;
+        int32_t getObserverAccel() const;
+
+        // Observer estimates in degrees (deg/s and deg/s^2)
         double getEstimSpeed();
+        double getAccel();
+
         int16_t getRawSpeed();
         double getSpeed();
-        double getAccel();
         int16_t getRawTemp();
         double getTemp();
         int16_t getRawRev();
         int32_t getRev();
+
+        // Sample cache (one acquisition per control tick, shared by all of the readers)
+        void updateCache();
+        EncoderSnapshot getCachedSnapshot(bool fresh = false);
+        uint32_t getCacheGeneration() const;
+
+        // Fixed point position since startup (increments, 2^15 per revolution)
+        // The cached value is used unless a fresh one is requested
+        int32_t getAbsolutePosition(bool fresh = false);
+        int32_t getAbsolutePositionAvg(bool fresh = false);
+
+        // Multi-turn position since startup (increments, doesn't wrap)
+        int64_t getPosition(bool fresh = false);
+
+        // Number of samples where the unwrapped angle disagreed with the revolution counter
+        uint32_t getRevMismatchCount() const;
+
         double getAbsoluteAngleAvg();
         float getAbsoluteAngleAvgFloat();
         void setStepOffset(double offset);
@@ -318,33 +280,131 @@ class Encoder {
         #endif
 
     private:
-        // Variables
-        uint32_t lastAngleSampleTime;
-        double lastEncoderAngle = 0;
 
-        // Last state of getRawRev()
-        int16_t lastRawRev = 0;
+        // Claims the SPI bus for a blocking transaction
+        void claimBus();
+
+        // Releases the SPI bus after a blocking transaction
+        void releaseBus();
 
-        // Revolutions extender variable
-        // Total revolutions = (revolutions * 512) + getRawRev()
-        int32_t revolutions = 0;
+        // Background sampling helpers
+        #ifdef ENCODER_DMA_SAMPLING
+
+            // Starts the DMA channels for one stage of a sample burst
+            void startSampleDMA(uint8_t* rxBuffer, uint8_t* txBuffer, uint16_t length, bool incrementTX);
+
+            // Waits for a sample burst in flight to finish (interrupts must be disabled)
+            void finishSample();
+        #endif
+
+        // Reads a coherent snapshot of the encoder (angle, speed, revolutions, and frame counters in one burst)
+        // This advances the multi-turn tracker, so it must only be called through updateCache()
+        EncoderSnapshot getSnapshot();
+
+        // Unwraps a new angle sample into the multi-turn position, cross-checking it against the revolution counter
+        void trackPosition(uint16_t rawAngle, int16_t rawRev);
+
+        // Converts a raw speed reading into deg/s
+        double rawSpeedToDPS(double rawSpeed) const;
+
+        // Checks if the cached sample is too old to be used
+        bool cacheExpired() const;
+
+        // Variables
+        uint64_t lastAngleSampleTime = 0;
+
+        // Position, velocity, and acceleration observer (updated with every cache update)
+        PositionObserver observer;
+
+        // Multi-turn tracker state (raw increments, unwrapped since startup)
+        bool trackerStarted = false;
+        int64_t trackedPosition = 0;
+        uint16_t lastTrackedAngle = 0;
+        int16_t lastTrackedRev = 0;
+        uint32_t revMismatches = 0;
+
+        // Sensor configuration, and the update period (us) decoded from the update rate
+        ENCODER_UPDATE_RATE updateRate = UPDATE_RATE_43US;
+        bool prediction = false;
+        double sensorUpdatePeriod = 42.7;
+
+        // The last valid readings of the sample registers (kept when a read fails), and the time that they were read (cycle count)
+        uint16_t lastValidData[ENCODER_SAMPLE_WORDS] = { 0, 0, 0, 0 };
+        uint64_t lastValidTime = 0;
+
+        // Shadow copies of the writable registers, with a bit for each register that has been loaded from the sensor
+        // The staged bits are the fields waiting to be committed, the verify bits are the ones of those that should read back
+        uint16_t shadowRegisters[ENCODER_SHADOW_REGISTERS];
+        uint16_t shadowLoaded = 0;
+        uint16_t stagedBits[ENCODER_SHADOW_REGISTERS] = { 0 };
+        uint16_t verifyBits[ENCODER_SHADOW_REGISTERS] = { 0 };
+
+        // Reads a register into its shadow copy
+        errorTypes loadShadowRegister(uint8_t index);
+
+        // Error counters
+        uint32_t errorCounts[ENCODER_ERROR_COUNTERS] = { 0, 0, 0, 0, 0, 0 };
+        uint32_t failedReads = 0;
+
+        // Linearization table (correction in increments at the start of each slice of the revolution)
+        #ifdef ENABLE_ENCODER_LINEARIZATION
+            int16_t linearizationTable[ENCODER_LINEARIZATION_POINTS];
+            bool linearized = false;
+        #endif
+
+        // Sample cache
+        EncoderSnapshot cachedSnapshot;
+        volatile int32_t cachedPositionAvg = 0;
+        uint64_t cacheTime = 0;
+        volatile uint32_t cacheGeneration = 0;
 
         // Moving average instances
-        MovingAverage <float> speedAvg;
         MovingAverage <int16_t> rawSpeedAvg;
-        MovingAverage <float> accelAvg;
         MovingAverage <uint16_t> incrementAvg;
-        MovingAverage <float> absAngleAvg;
+        MovingAverage <int32_t, int64_t> absPositionAvg;
         MovingAverage <int16_t> rawTempAvg;
 
-        // The startup angle and rev offsets
-        double startupAngleOffset = 0;
-        int32_t startupRevOffset = 0;
-        double encoderStepOffset = 0;
+        // The startup angle offsets (in increments)
+        int32_t startupAngleOffset = 0;
+        int32_t encoderStepOffset = 0;
 
         // SPI init structure
         SPI_HandleTypeDef spiConfig;
 
+        // Background sampling state
+        #ifdef ENCODER_DMA_SAMPLING
+
+            // If the background sampling is running
+            volatile bool sampling = false;
+
+            // If a blocking transaction currently owns the bus
+            volatile bool busClaimed = false;
+
+            // The stage of the current sample burst
+            volatile SAMPLE_STATE sampleState = SAMPLE_IDLE;
+
+            // The buffer that holds the newest complete sample (the other one is written by the DMA)
+            volatile uint8_t latestSampleBuffer = 0;
+
+            // The number of completed samples
+            volatile uint32_t sampleCount = 0;
+
+            // The time that each sample buffer was completed (cycle count)
+            volatile uint64_t sampleTimes[2] = { 0, 0 };
+
+            // If the last sample had an encoder error (the next burst clears it instead of sampling)
+            volatile bool safetyResetPending = false;
+
+            // Command and receive buffers for the sample bursts
+            uint16_t sampleCommandWord;
+            uint8_t sampleResetCommand[2];
+            uint8_t sampleResetRX[4];
+            uint8_t sampleCommand[2];
+            uint8_t sampleCommandRX[2];
+            uint8_t sampleIdleTX = 0xFF;
+            uint8_t sampleBuffers[2][ENCODER_SAMPLE_BYTES];
+        #endif
+
         // Main initialization structure
         GPIO_InitTypeDef GPIO_InitStructure;
 
@@ -354,5 +414,74 @@ class Encoder {
         #endif
 };
 
+
+
+// Reads a field of the sensor
+// Writable fields come from the shadow registers (including any staged values), the rest are read from the sensor
+template <typename FIELD>
+errorTypes Encoder::readField(uint16_t &value) {
+
+    // Make sure that the field can be read
+    static_assert(FIELD::readable, "The field can't be read!");
+
+    // Writable fields are shadowed, the register only needs read once
+    if (FIELD::writable) {
+        if (!(shadowLoaded & (1 << FIELD::shadowIndex))) {
+            errorTypes error = loadShadowRegister(FIELD::shadowIndex);
+            if (error != NO_ERROR) {
+                return error;
+            }
+        }
+        value = FIELD::extract(shadowRegisters[FIELD::shadowIndex]);
+        return NO_ERROR;
+    }
+
+    // Read the register from the sensor
+    uint16_t data;
+    errorTypes error = readRegister(FIELD::address, data);
+    if (error == NO_ERROR) {
+        value = FIELD::extract(data);
+    }
+    return error;
+}
+
+
+// Stages a new value of a field into its shadow register (written to the sensor by commitFields())
+template <typename FIELD>
+errorTypes Encoder::stageField(uint16_t value) {
+
+    // Make sure that the field can be written
+    static_assert(FIELD::writable, "The field can't be written!");
+
+    // The rest of the register needs to be kept, so load it if it hasn't been already
+    if (!(shadowLoaded & (1 << FIELD::shadowIndex))) {
+        errorTypes error = loadShadowRegister(FIELD::shadowIndex);
+        if (error != NO_ERROR) {
+            return error;
+        }
+    }
+
+    // Update the shadow register, noting which bits need written (and checked if the sensor doesn't change them itself)
+    shadowRegisters[FIELD::shadowIndex] = FIELD::insert(shadowRegisters[FIELD::shadowIndex], value);
+    stagedBits[FIELD::shadowIndex] |= FIELD::mask;
+    if (!FIELD::updated) {
+        verifyBits[FIELD::shadowIndex] |= FIELD::mask;
+    }
+    return NO_ERROR;
+}
+
+
+// Writes a single field to the sensor (along with anything else that was staged)
+template <typename FIELD>
+errorTypes Encoder::writeField(uint16_t value) {
+
+    // Stage the field, then write everything out
+    errorTypes error = stageField<FIELD>(value);
+    if (error != NO_ERROR) {
+        return error;
+    }
+    return commitFields();
+}
+
 #endif
 
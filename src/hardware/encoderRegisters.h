@@ -0,0 +1,254 @@
+#ifndef __TLE5012_REGISTERS_H
+#define __TLE5012_REGISTERS_H
+
+// Standard naming conventions
+#include "stdint.h"
+
+// Main address fields
+enum Addr_t {
+    REG_STAT         = (0x0000U),    //!< \brief STAT status register
+    REG_ACSTAT       = (0x0010U),    //!< \brief ACSTAT activation status register
+    REG_AVAL         = (0x0020U),    //!< \brief AVAL angle value register
+    REG_ASPD         = (0x0030U),    //!< \brief ASPD angle speed register
+    REG_AREV         = (0x0040U),    //!< \brief AREV angle revolution register
+    REG_FSYNC        = (0x0050U),    //!< \brief FSYNC frame synchronization register
+    REG_MOD_1        = (0x0060U),    //!< \brief MOD_1 interface mode1 register
+    REG_SIL          = (0x0070U),    //!< \brief SIL register
+    REG_MOD_2        = (0x0080U),    //!< \brief MOD_2 interface mode2 register
+    REG_MOD_3        = (0x0090U),    //!< \brief MOD_3 interface mode3 register
+    REG_OFFX         = (0x00A0U),    //!< \brief OFFX offset x
+    REG_OFFY         = (0x00B0U),    //!< \brief OFFY offset y
+    REG_SYNCH        = (0x00C0U),    //!< \brief SYNCH synchronicity
+    REG_IFAB         = (0x00D0U),    //!< \brief IFAB register
+    REG_MOD_4        = (0x00E0U),    //!< \brief MOD_4 interface mode4 register
+    REG_TCO_Y        = (0x00F0U),    //!< \brief TCO_Y temperature coefficient register
+    REG_ADC_X        = (0x0100U),    //!< \brief ADC_X ADC X-raw value
+    REG_ADC_Y        = (0x0110U),    //!< \brief ADC_Y ADC Y-raw value
+    REG_D_MAG        = (0x0140U),    //!< \brief D_MAG angle vector magnitude
+    REG_T_RAW        = (0x0150U),    //!< \brief T_RAW temperature sensor raw-value
+    REG_IIF_CNT      = (0x0200U),    //!< \brief IIF_CNT IIF counter value
+    REG_T25O         = (0x0300U)     //!< \brief T25O temperature 25°c offset value
+};
+
+
+// Register access addresses
+enum Access_t {
+    REG_ACCESS_R    = (0x01U),      //!< \brief Read access register */
+    REG_ACCESS_W    = (0x02U),      //!< \brief Write access register */
+    REG_ACCESS_RW   = (0x03U),      //!< \brief Read & write access register */
+    REG_ACCESS_U    = (0x04U),      //!< \brief Update register */
+    REG_ACCESS_RU   = (0x05U),      //!< \brief Read & update register */
+    REG_ACCESS_RWU  = (0x07U),      //!< \brief Read & write & update register */
+    REG_ACCESS_RES  = (0x10U)       //!< \brief Reserved access register */
+};
+
+// The register address sits in bits 9:4 of the command word, so the address of a register is its number shifted up 4
+#define ENCODER_REGISTER_NUMBER(ADDR)   ((ADDR) >> 4)
+#define ENCODER_REGISTER_ADDRESS(NUM)   ((uint16_t)((NUM) << 4))
+
+// The writable registers (STAT to TCO_Y) have shadow copies, so fields can be changed without reading the sensor
+#define ENCODER_SHADOW_REGISTERS 16
+
+
+// Bit field descriptor
+// Everything about the field is a compile time constant, so the accessors reduce to a mask and a shift
+template <uint16_t ADDRESS, uint8_t ACCESS, uint16_t MASK, uint8_t POSITION>
+struct EncoderField {
+    static constexpr uint16_t address = ADDRESS;
+    static constexpr uint8_t  access = ACCESS;
+    static constexpr uint16_t mask = MASK;
+    static constexpr uint8_t  position = POSITION;
+    static constexpr uint8_t  shadowIndex = ENCODER_REGISTER_NUMBER(ADDRESS);
+
+    // If the field can be read or written
+    static constexpr bool readable = ((ACCESS & REG_ACCESS_R) == REG_ACCESS_R);
+    static constexpr bool writable = ((ACCESS & REG_ACCESS_W) == REG_ACCESS_W);
+
+    // If the sensor changes the field on its own (the value written may not read back)
+    static constexpr bool updated = ((ACCESS & REG_ACCESS_U) == REG_ACCESS_U);
+
+    // Checks of the descriptor
+    static_assert((ADDRESS & 0xF) == 0 && ENCODER_REGISTER_NUMBER(ADDRESS) < 64, "The register address doesn't fit in the command word!");
+    static_assert(MASK != 0 && POSITION < 16, "The field is empty!");
+    static_assert(((MASK >> POSITION) & 1) == 1 && ((MASK >> POSITION) << POSITION) == MASK, "The field mask must start at the field position!");
+    static_assert((((MASK >> POSITION) + 1) & (MASK >> POSITION)) == 0, "The field mask must be contiguous!");
+    static_assert(!writable || ENCODER_REGISTER_NUMBER(ADDRESS) < ENCODER_SHADOW_REGISTERS, "Writable fields need a shadow register!");
+
+    // Pulls the field out of a register value
+    static constexpr uint16_t extract(uint16_t registerValue) {
+        return (registerValue & MASK) >> POSITION;
+    }
+
+    // Puts a new value of the field into a register value
+    static constexpr uint16_t insert(uint16_t registerValue, uint16_t fieldValue) {
+        return (registerValue & ~MASK) | ((fieldValue << POSITION) & MASK);
+    }
+};
+
+
+// Bit fields
+typedef EncoderField<REG_STAT,    REG_ACCESS_RU,  0x1,    0>  REG_STAT_SRST;           //!< bits 0:0 SRST status watch dog
+typedef EncoderField<REG_STAT,    REG_ACCESS_R,   0x2,    1>  REG_STAT_SWD;            //!< bits 1:1 SWD status watch dog
+typedef EncoderField<REG_STAT,    REG_ACCESS_R,   0x4,    2>  REG_STAT_SVR;            //!< bits 2:2 SVR status voltage regulator
+typedef EncoderField<REG_STAT,    REG_ACCESS_R,   0x8,    3>  REG_STAT_SFUSE;          //!< bits 3:3 SFUSE status fuses
+typedef EncoderField<REG_STAT,    REG_ACCESS_R,   0x10,   4>  REG_STAT_SDSPU;          //!< bits 4:4 SDSPU status digital signal processing unit
+typedef EncoderField<REG_STAT,    REG_ACCESS_RU,  0x20,   5>  REG_STAT_SOV;            //!< bits 5:5 SOV status overflow
+typedef EncoderField<REG_STAT,    REG_ACCESS_RU,  0x40,   6>  REG_STAT_SXYOL;          //!< bits 6:6 SXYOL status X/Y data out limit
+typedef EncoderField<REG_STAT,    REG_ACCESS_RU,  0x80,   7>  REG_STAT_SMAGOL;         //!< bits 7:7 SMAGOL status magnitude out limit
+typedef EncoderField<REG_STAT,    REG_ACCESS_RES, 0x100,  8>  REG_STAT_RESERVED;       //!< bits 8:8 reserved
+typedef EncoderField<REG_STAT,    REG_ACCESS_R,   0x200,  9>  REG_STAT_SADCT;          //!< bits 9:9 SADCT status ADC test
+typedef EncoderField<REG_STAT,    REG_ACCESS_R,   0x400,  10> REG_STAT_SROM;           //!< bits 10:10 SROM status ROM
+typedef EncoderField<REG_STAT,    REG_ACCESS_RU,  0x800,  11> REG_STAT_NOGMRXY;        //!< bits 11:11 NOGMRXY no valid GMR XY Values
+typedef EncoderField<REG_STAT,    REG_ACCESS_RU,  0x1000, 12> REG_STAT_NOGMRA;         //!< bits 12:12 NOGMRA no valid GMR Angle Value
+typedef EncoderField<REG_STAT,    REG_ACCESS_RW,  0x6000, 13> REG_STAT_SNR;            //!< bits 14:13 SNR slave number
+typedef EncoderField<REG_STAT,    REG_ACCESS_RU,  0x8000, 15> REG_STAT_RDST;           //!< bits 15:15 RDST read status
+
+typedef EncoderField<REG_ACSTAT,  REG_ACCESS_RW,  0x1,    0>  REG_ACSTAT_ASRST;        //!< bits 0:0 ASRST Activation of Hardware Reset
+typedef EncoderField<REG_ACSTAT,  REG_ACCESS_RWU, 0x2,    1>  REG_ACSTAT_ASWD;         //!< bits 1:1 ASWD Enable DSPU Watch dog
+typedef EncoderField<REG_ACSTAT,  REG_ACCESS_RWU, 0x4,    2>  REG_ACSTAT_ASVR;         //!< bits 2:2 ASVR Enable Voltage regulator Check
+typedef EncoderField<REG_ACSTAT,  REG_ACCESS_RWU, 0x8,    3>  REG_ACSTAT_ASFUSE;       //!< bits 3:3 ASFUSE Activation Fuse CRC
+typedef EncoderField<REG_ACSTAT,  REG_ACCESS_RWU, 0x10,   4>  REG_ACSTAT_ASDSPU;       //!< bits 4:4 ASDSPU Activation DSPU BIST
+typedef EncoderField<REG_ACSTAT,  REG_ACCESS_RWU, 0x20,   5>  REG_ACSTAT_ASOV;         //!< bits 5:5 ASOV Enable of DSPU Overflow Check
+typedef EncoderField<REG_ACSTAT,  REG_ACCESS_RWU, 0x40,   6>  REG_ACSTAT_ASVECXY;      //!< bits 6:6 ASVECXY Activation of X,Y Out of Limit-Check
+typedef EncoderField<REG_ACSTAT,  REG_ACCESS_RWU, 0x80,   7>  REG_ACSTAT_ASVEGMAG;     //!< bits 7:7 ASVEGMAG Activation of Magnitude Check
+typedef EncoderField<REG_ACSTAT,  REG_ACCESS_RES, 0x100,  8>  REG_ACSTAT_RESERVED1;    //!< bits 8:8 Reserved
+typedef EncoderField<REG_ACSTAT,  REG_ACCESS_RWU, 0x200,  9>  REG_ACSTAT_ASADCT;       //!< bits 9:9 ASADCT Enable ADC Test vector Check
+typedef EncoderField<REG_ACSTAT,  REG_ACCESS_RWU, 0x400,  10> REG_ACSTAT_ASFRST;       //!< bits 10:10 ASFRST Activation of Firmware Reset
+typedef EncoderField<REG_ACSTAT,  REG_ACCESS_RES, 0xF800, 11> REG_ACSTAT_RESERVED2;    //!< bits 15:11 Reserved
+
+typedef EncoderField<REG_AVAL,    REG_ACCESS_RU,  0x7FFF, 0>  REG_AVAL_ANGVAL;         //!< bits 14:0 ANGVAL Calculated Angle Value (signed 15-bit)
+typedef EncoderField<REG_AVAL,    REG_ACCESS_R,   0x8000, 15> REG_AVAL_RDAV;           //!< bits 15:15 RDAV Read Status, Angle Value
+
+typedef EncoderField<REG_ASPD,    REG_ACCESS_RU,  0x7FFF, 0>  REG_ASPD_ANGSPD;         //!< bits 14:0 ANGSPD Signed value, where the sign bit [14] indicates the direction of the rotation
+typedef EncoderField<REG_ASPD,    REG_ACCESS_R,   0x8000, 15> REG_ASPD_RDAS;           //!< bits 15:15 RDAS Read Status, Angle Speed
+
+typedef EncoderField<REG_AREV,    REG_ACCESS_RU,  0x1FF,  0>  REG_AREV_REVOL;          //!< bits 8:0 REVOL Revolution counter. Increments for every full rotation in counter-clockwise direction
+typedef EncoderField<REG_AREV,    REG_ACCESS_RWU, 0x7E00, 9>  REG_AREV_FCNT;           //!< bits 14:9 FCNT Internal frame counter. Increments every update period
+typedef EncoderField<REG_AREV,    REG_ACCESS_R,   0x8000, 15> REG_AREV_RDREV;          //!< bits 15:15 RDREV Read Status, Revolution
+
+typedef EncoderField<REG_FSYNC,   REG_ACCESS_RWU, 0x1FF,  0>  REG_FSYNC_TEMPR;         //!< bits 8:0 TEMPR Signed offset compensated temperature value
+typedef EncoderField<REG_FSYNC,   REG_ACCESS_RU,  0xFE00, 9>  REG_FSYNC_FSYNC;         //!< bits 15:9 FSYNC Frame Synchronization Counter Value
+
+typedef EncoderField<REG_MOD_1,   REG_ACCESS_RW,  0x3,    0>  REG_MOD_1_IIFMOD;        //!< bits 1:0 IIFMOD Incremental Interface Mode
+typedef EncoderField<REG_MOD_1,   REG_ACCESS_RW,  0x4,    2>  REG_MOD_1_DSPUHOLD;      //!< bits 2:2 DSPUHOLD if DSPU is on hold, no watch dog reset is performed by DSPU
+typedef EncoderField<REG_MOD_1,   REG_ACCESS_RES, 0x8,    3>  REG_MOD_1_RESERVED1;     //!< bits 3:3 Reserved1
+typedef EncoderField<REG_MOD_1,   REG_ACCESS_RW,  0x10,   4>  REG_MOD_1_CLKSEL;        //!< bits 4:4 CLKSEL switch to external clock at start-up only
+typedef EncoderField<REG_MOD_1,   REG_ACCESS_RES, 0x3FE0, 5>  REG_MOD_1_RESERVED2;     //!< bits 13:5 Reserved2
+typedef EncoderField<REG_MOD_1,   REG_ACCESS_RW,  0xC000, 14> REG_MOD_1_FIRMD;         //!< bits 15:14 FIRMD Update Rate Setting
+
+typedef EncoderField<REG_SIL,     REG_ACCESS_RW,  0x7,    0>  REG_SIL_ADCTVX;          //!< bits 2:0 ADCTVX Test vector X
+typedef EncoderField<REG_SIL,     REG_ACCESS_RW,  0x38,   3>  REG_SIL_ADCTVY;          //!< bits 5:3 ADCTVY Test vector Y
+typedef EncoderField<REG_SIL,     REG_ACCESS_RW,  0x40,   6>  REG_SIL_ADCTVEN;         //!< bits 6:6 ADCTVEN Sensor elements are internally disconnected and test voltages are connected to ADCs
+typedef EncoderField<REG_SIL,     REG_ACCESS_RES, 0x380,  7>  REG_SIL_RESERVED1;       //!< bits 9:7 Reserved1
+typedef EncoderField<REG_SIL,     REG_ACCESS_RW,  0x400,  10> REG_SIL_FUSEREL;         //!< bits 10:10 FUSEREL Triggers reload of default values from laser fuses into configuration registers
+typedef EncoderField<REG_SIL,     REG_ACCESS_RES, 0x3800, 11> REG_SIL_RESERVED2;       //!< bits 13:11 Reserved2
+typedef EncoderField<REG_SIL,     REG_ACCESS_RW,  0x4000, 14> REG_SIL_FILTINV;         //!< bits 14:14 FILTINV the X- and Y-signals are inverted. The angle output is then shifted by 180°
+typedef EncoderField<REG_SIL,     REG_ACCESS_RW,  0x8000, 15> REG_SIL_FILTPAR;         //!< bits 15:15 FILTPAR the raw X-signal is routed also to the raw Y-signal input of the filter so SIN and COS signal should be identical
+
+typedef EncoderField<REG_MOD_2,   REG_ACCESS_RW,  0x3,    0>  REG_MOD_2_AUTOCAL;       //!< bits 1:0 AUTOCAL Automatic calibration of offset and amplitude synchronicity for applications with full-turn
+typedef EncoderField<REG_MOD_2,   REG_ACCESS_RW,  0x4,    2>  REG_MOD_2_PREDICT;       //!< bits 2:2 PREDICT Prediction of angle value based on current angle speed
+typedef EncoderField<REG_MOD_2,   REG_ACCESS_RW,  0x8,    3>  REG_MOD_2_ANGDIR;        //!< bits 3:3 ANGDIR Inverts angle and angle speed values and revolution counter behavior
+typedef EncoderField<REG_MOD_2,   REG_ACCESS_RW,  0x7FF0, 4>  REG_MOD_2_ANGRANGE;      //!< bits 14:4 ANGRANGE Changes the representation of the angle output by multiplying the output with a factor ANG_RANGE/128
+typedef EncoderField<REG_MOD_2,   REG_ACCESS_RES, 0x8000, 15> REG_MOD_2_RESERVED1;     //!< bits 15:15 Reserved1
+
+typedef EncoderField<REG_MOD_3,   REG_ACCESS_RW,  0x3,    0>  REG_MOD_3_PADDRV;        //!< bits 1:0 PADDRV Configuration of Pad-Driver
+typedef EncoderField<REG_MOD_3,   REG_ACCESS_RW,  0x4,    2>  REG_MOD_3_SSCOD;         //!< bits 2:2 SSCOD SSC-Interface Data Pin Output Mode
+typedef EncoderField<REG_MOD_3,   REG_ACCESS_RW,  0x8,    3>  REG_MOD_3_SPIKEF;        //!< bits 3:3 SPIKEF Filters voltage spikes on input pads (IFC, SCK and CSQ)
+typedef EncoderField<REG_MOD_3,   REG_ACCESS_RW,  0xFFF0, 4>  REG_MOD_3_ANG_BASE;      //!< bits 15:4 ANG_BASE Sets the 0° angle position (12 bit value). Angle base is factory-calibrated to make the 0° direction parallel to the edge of the chip
+
+typedef EncoderField<REG_OFFX,    REG_ACCESS_RES, 0xF,    0>  REG_OFFX_RESERVED1;      //!< bits 3:0 Reserved1
+typedef EncoderField<REG_OFFX,    REG_ACCESS_RW,  0xFFF0, 4>  REG_OFFX_XOFFSET;        //!< bits 15:4 XOFFSET 12-bit signed integer value of raw X-signal offset correction at 25°C
+
+typedef EncoderField<REG_OFFY,    REG_ACCESS_RES, 0xF,    0>  REG_OFFY_RESERVED1;      //!< bits 3:0 Reserved1
+typedef EncoderField<REG_OFFY,    REG_ACCESS_RW,  0xFFF0, 4>  REG_OFFY_YOFFSET;        //!< bits 15:4 YOFFSET 12-bit signed integer value of raw Y-signal offset correction at 25°C
+
+typedef EncoderField<REG_SYNCH,   REG_ACCESS_RES, 0xF,    0>  REG_SYNCH_RESERVED1;     //!< bits 3:0 Reserved1
+typedef EncoderField<REG_SYNCH,   REG_ACCESS_RW,  0xFFF0, 4>  REG_SYNCH_SYNCH;         //!< bits 15:4 SYNCH 12-bit signed integer value of amplitude synchronicity
+
+typedef EncoderField<REG_IFAB,    REG_ACCESS_RW,  0x3,    0>  REG_IFAB_IFADHYST;       //!< bits 1:0 IFADHYST Hysteresis (multi-purpose)
+typedef EncoderField<REG_IFAB,    REG_ACCESS_RW,  0x4,    2>  REG_IFAB_IFABOD;         //!< bits 2:2 IFABOD IFA,IFB,IFC Output Mode
+typedef EncoderField<REG_IFAB,    REG_ACCESS_RW,  0x8,    3>  REG_IFAB_FIRUDR;         //!< bits 3:3 FIRUDR Initial filter update rate (FIR)
+typedef EncoderField<REG_IFAB,    REG_ACCESS_RW,  0xFFF0, 4>  REG_IFAB_ORTHO;          //!< bits 15:4 ORTHO Orthogonality Correction of X and Y Components
+
+typedef EncoderField<REG_MOD_4,   REG_ACCESS_RW,  0x3,    0>  REG_MOD_4_IFMD;          //!< bits 1:0 IFMD Interface Mode on IFA,IFB,IFC
+typedef EncoderField<REG_MOD_4,   REG_ACCESS_RES, 0x4,    2>  REG_MOD_4_RESERVED1;     //!< bits 2:2 Reserved1
+typedef EncoderField<REG_MOD_4,   REG_ACCESS_RW,  0x18,   3>  REG_MOD_4_IFABRES;       //!< bits 4:3 IFABRES IIF resolution (multi-purpose)
+typedef EncoderField<REG_MOD_4,   REG_ACCESS_RW,  0x1E0,  5>  REG_MOD_4_HSMPLP;        //!< bits 8:5 HSMPLP Hall Switch mode (multi-purpose)
+typedef EncoderField<REG_MOD_4,   REG_ACCESS_RW,  0xFE00, 9>  REG_MOD_4_TCOXT;         //!< bits 15:9 TCOXT 7-bit signed integer value of X-offset temperature coefficient
+
+typedef EncoderField<REG_TCO_Y,   REG_ACCESS_RW,  0xFF,   0>  REG_TCO_Y_CRCPAR;        //!< bits 7:0 CRCPAR CRC of Parameters
+typedef EncoderField<REG_TCO_Y,   REG_ACCESS_RW,  0x100,  8>  REG_TCO_Y_SBIST;         //!< bits 8:8 SBIST Startup-BIST
+typedef EncoderField<REG_TCO_Y,   REG_ACCESS_RW,  0xFE00, 9>  REG_TCO_Y_TCOYT;         //!< bits 15:9 TCOYT 7-bit signed integer value of Y-offset temperature coefficient
+
+typedef EncoderField<REG_ADC_X,   REG_ACCESS_R,   0xFFFF, 0>  REG_ADC_X_ADCX;          //!< bits 15:0 ADCX ADC value of X-GMR
+
+typedef EncoderField<REG_ADC_Y,   REG_ACCESS_R,   0xFFFF, 0>  REG_ADC_Y_ADCY;          //!< bits 15:0 ADCY ADC value of Y-GMR
+
+typedef EncoderField<REG_D_MAG,   REG_ACCESS_RU,  0x3FF,  0>  REG_D_MAG_MAG;           //!< bits 9:0 MAG Unsigned Angle Vector Magnitude after X, Y error compensation (due to temperature)
+typedef EncoderField<REG_D_MAG,   REG_ACCESS_RES, 0xFC00, 10> REG_D_MAG_RESERVED1;     //!< bits 15:10 Reserved1
+
+typedef EncoderField<REG_T_RAW,   REG_ACCESS_RU,  0x3FF,  0>  REG_T_RAW_TRAW;          //!< bits 9:0 TRAW Temperature Sensor Raw-Value at ADC without offset
+typedef EncoderField<REG_T_RAW,   REG_ACCESS_RES, 0x7C00, 10> REG_T_RAW_RESERVED1;     //!< bits 14:10 Reserved1
+typedef EncoderField<REG_T_RAW,   REG_ACCESS_RU,  0x8000, 15> REG_T_RAW_TTGL;          //!< bits 15:15 TTGL Temperature Sensor Raw-Value Toggle toggles after every new temperature value
+
+typedef EncoderField<REG_IIF_CNT, REG_ACCESS_RU,  0x7FFF, 0>  REG_IIF_CNT_IIFCNT;      //!< bits 14:0 IIFCNT 14 bit counter value of IIF increments
+typedef EncoderField<REG_IIF_CNT, REG_ACCESS_RES, 0x8000, 15> REG_IIF_CNT_RESERVED1;   //!< bits 15:15 Reserved1
+
+typedef EncoderField<REG_T25O,    REG_ACCESS_R,   0x1FF,  0>  REG_T25O_T25O;           //!< bits 8:0 T25O Temperature offset value at 25°C
+typedef EncoderField<REG_T25O,    REG_ACCESS_RES, 0xFE00, 9>  REG_T25O_RESERVED1;      //!< bits 15:9 Reserved1
+
+
+// Compile time checks of the map
+// Every register's fields must sit in the same register, cover all 16 bits, and not overlap
+template <typename FIELD>
+constexpr uint16_t fieldsMask() {
+    return FIELD::mask;
+}
+template <typename FIRST, typename SECOND, typename... REST>
+constexpr uint16_t fieldsMask() {
+    return FIRST::mask | fieldsMask<SECOND, REST...>();
+}
+template <typename FIELD>
+constexpr bool fieldsConflict() {
+    return false;
+}
+template <typename FIRST, typename SECOND, typename... REST>
+constexpr bool fieldsConflict() {
+    return (FIRST::address != SECOND::address) || ((FIRST::mask & fieldsMask<SECOND, REST...>()) != 0) || fieldsConflict<SECOND, REST...>();
+}
+template <typename... FIELDS>
+constexpr bool validRegister() {
+    return !fieldsConflict<FIELDS...>() && (fieldsMask<FIELDS...>() == 0xFFFF);
+}
+
+static_assert(validRegister<REG_STAT_SRST, REG_STAT_SWD, REG_STAT_SVR, REG_STAT_SFUSE, REG_STAT_SDSPU, REG_STAT_SOV, REG_STAT_SXYOL, REG_STAT_SMAGOL,
+                            REG_STAT_RESERVED, REG_STAT_SADCT, REG_STAT_SROM, REG_STAT_NOGMRXY, REG_STAT_NOGMRA, REG_STAT_SNR, REG_STAT_RDST>(), "STAT map is invalid!");
+static_assert(validRegister<REG_ACSTAT_ASRST, REG_ACSTAT_ASWD, REG_ACSTAT_ASVR, REG_ACSTAT_ASFUSE, REG_ACSTAT_ASDSPU, REG_ACSTAT_ASOV, REG_ACSTAT_ASVECXY,
+                            REG_ACSTAT_ASVEGMAG, REG_ACSTAT_RESERVED1, REG_ACSTAT_ASADCT, REG_ACSTAT_ASFRST, REG_ACSTAT_RESERVED2>(), "ACSTAT map is invalid!");
+static_assert(validRegister<REG_AVAL_ANGVAL, REG_AVAL_RDAV>(), "AVAL map is invalid!");
+static_assert(validRegister<REG_ASPD_ANGSPD, REG_ASPD_RDAS>(), "ASPD map is invalid!");
+static_assert(validRegister<REG_AREV_REVOL, REG_AREV_FCNT, REG_AREV_RDREV>(), "AREV map is invalid!");
+static_assert(validRegister<REG_FSYNC_TEMPR, REG_FSYNC_FSYNC>(), "FSYNC map is invalid!");
+static_assert(validRegister<REG_MOD_1_IIFMOD, REG_MOD_1_DSPUHOLD, REG_MOD_1_RESERVED1, REG_MOD_1_CLKSEL, REG_MOD_1_RESERVED2, REG_MOD_1_FIRMD>(), "MOD_1 map is invalid!");
+static_assert(validRegister<REG_SIL_ADCTVX, REG_SIL_ADCTVY, REG_SIL_ADCTVEN, REG_SIL_RESERVED1, REG_SIL_FUSEREL, REG_SIL_RESERVED2, REG_SIL_FILTINV, REG_SIL_FILTPAR>(), "SIL map is invalid!");
+static_assert(validRegister<REG_MOD_2_AUTOCAL, REG_MOD_2_PREDICT, REG_MOD_2_ANGDIR, REG_MOD_2_ANGRANGE, REG_MOD_2_RESERVED1>(), "MOD_2 map is invalid!");
+static_assert(validRegister<REG_MOD_3_PADDRV, REG_MOD_3_SSCOD, REG_MOD_3_SPIKEF, REG_MOD_3_ANG_BASE>(), "MOD_3 map is invalid!");
+static_assert(validRegister<REG_OFFX_RESERVED1, REG_OFFX_XOFFSET>(), "OFFX map is invalid!");
+static_assert(validRegister<REG_OFFY_RESERVED1, REG_OFFY_YOFFSET>(), "OFFY map is invalid!");
+static_assert(validRegister<REG_SYNCH_RESERVED1, REG_SYNCH_SYNCH>(), "SYNCH map is invalid!");
+static_assert(validRegister<REG_IFAB_IFADHYST, REG_IFAB_IFABOD, REG_IFAB_FIRUDR, REG_IFAB_ORTHO>(), "IFAB map is invalid!");
+static_assert(validRegister<REG_MOD_4_IFMD, REG_MOD_4_RESERVED1, REG_MOD_4_IFABRES, REG_MOD_4_HSMPLP, REG_MOD_4_TCOXT>(), "MOD_4 map is invalid!");
+static_assert(validRegister<REG_TCO_Y_CRCPAR, REG_TCO_Y_SBIST, REG_TCO_Y_TCOYT>(), "TCO_Y map is invalid!");
+static_assert(validRegister<REG_ADC_X_ADCX>(), "ADC_X map is invalid!");
+static_assert(validRegister<REG_ADC_Y_ADCY>(), "ADC_Y map is invalid!");
+static_assert(validRegister<REG_D_MAG_MAG, REG_D_MAG_RESERVED1>(), "D_MAG map is invalid!");
+static_assert(validRegister<REG_T_RAW_TRAW, REG_T_RAW_RESERVED1, REG_T_RAW_TTGL>(), "T_RAW map is invalid!");
+static_assert(validRegister<REG_IIF_CNT_IIFCNT, REG_IIF_CNT_RESERVED1>(), "IIF_CNT map is invalid!");
+static_assert(validRegister<REG_T25O_T25O, REG_T25O_RESERVED1>(), "T25O map is invalid!");
+
+// The fields that the firmware relies on
+static_assert(REG_MOD_1_FIRMD::mask == 0xC000 && REG_MOD_1_FIRMD::writable, "FIRMD must be bits 15:14 of MOD_1!");
+static_assert(REG_MOD_2_PREDICT::mask == 0x0004 && REG_MOD_2_PREDICT::writable, "PREDICT must be bit 2 of MOD_2!");
+static_assert(REG_MOD_1_FIRMD::insert(0x0001, 3) == 0xC001 && REG_MOD_1_FIRMD::extract(0x8001) == 2, "Field accessors are broken!");
+
+#endif // ! __TLE5012_REGISTERS_H
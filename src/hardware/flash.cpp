@@ -188,6 +188,63 @@ void eraseParameters() {
 }
 
 
+#ifdef ENABLE_ENCODER_LINEARIZATION
+// Reads the encoder linearization table from flash
+// Returns false (leaving the table untouched) if there isn't a valid table of the right length
+bool readLinearization(int16_t* table, uint16_t length) {
+
+    // Check the marker and the number of points
+    if ((readFlashAddress(LINEARIZATION_START_ADDR) != LINEARIZATION_VALID_MARKER) || (readFlashAddress(LINEARIZATION_START_ADDR + 2) != length)) {
+        return false;
+    }
+
+    // Read each of the points
+    for (uint16_t point = 0; point < length; point++) {
+        table[point] = (int16_t)readFlashAddress(LINEARIZATION_START_ADDR + 4 + (point * 2));
+    }
+
+    // Table is valid
+    return true;
+}
+
+
+// Erases the old encoder linearization table, then writes the new one
+void writeLinearization(const int16_t* table, uint16_t length) {
+
+    // Disable the motor timers
+    disableInterrupts();
+
+    // Unlock the flash
+    HAL_FLASH_Unlock();
+
+    // Configure the erase type
+    FLASH_EraseInitTypeDef eraseStruct;
+    eraseStruct.TypeErase = FLASH_TYPEERASE_PAGES;
+    eraseStruct.PageAddress = LINEARIZATION_START_ADDR;
+    eraseStruct.NbPages = 1;
+
+    // Erase the page
+    uint32_t pageError = 0;
+    HAL_FLASHEx_Erase(&eraseStruct, &pageError);
+
+    // Good to go, lock the flash again (writeToFlashAddress has it's own locks and unlocks)
+    HAL_FLASH_Lock();
+
+    // Write the points
+    for (uint16_t point = 0; point < length; point++) {
+        writeToFlashAddress(LINEARIZATION_START_ADDR + 4 + (point * 2), (uint16_t)table[point]);
+    }
+
+    // Write the number of points and the marker last, so an interrupted write leaves an invalid table
+    writeToFlashAddress(LINEARIZATION_START_ADDR + 2, length);
+    writeToFlashAddress(LINEARIZATION_START_ADDR, LINEARIZATION_VALID_MARKER);
+
+    // Re-enable the motor timers
+    enableInterrupts();
+}
+#endif
+
+
 // Writes the currently saved parameters to flash memory for long term storage
 void saveParameters() {
 
@@ -229,7 +286,7 @@ void saveParameters() {
     writeFlash(ENABLE_INVERSION_INDEX, motor.getEnableInversion());
 
     // Microstep multiplier
-    writeFlash(MICROSTEP_MULTIPLIER_INDEX, motor.getMicrostepMultiplier());
+    writeFlash(MICROSTEP_GEARING_INDEX, ((uint32_t)motor.getMicrostepGearNumerator() << 16) | motor.getMicrostepGearDenominator());
 
     // Write the PID values if specified
     #ifdef ENABLE_PID
@@ -243,6 +300,23 @@ void saveParameters() {
         writeFlash(D_TERM_INDEX, (float)pid.getD());
     #endif
 
+    // Cascaded control gains
+    #ifdef ENABLE_CASCADED_CONTROL
+        writeFlash(POSITION_P_INDEX, pid.getPositionP());
+        writeFlash(VELOCITY_P_INDEX, pid.getVelocityP());
+        writeFlash(VELOCITY_I_INDEX, pid.getVelocityI());
+        writeFlash(MAX_VELOCITY_INDEX, pid.getMaxVelocity());
+    #endif
+
+    // Step rate feedforward gains (the current feedforward is part of the dynamic current)
+    #ifdef ENABLE_STEP_FEEDFORWARD
+        writeFlash(VELOCITY_FF_INDEX, pid.getVelocityFF());
+        writeFlash(ACCEL_FF_INDEX, pid.getAccelFF());
+        #ifdef ENABLE_DYNAMIC_CURRENT
+            writeFlash(CURRENT_FF_INDEX, motor.getCurrentFeedforward());
+        #endif
+    #endif
+
     // CAN ID of the motor controller
     #ifdef ENABLE_CAN
         writeFlash(CAN_ID_INDEX, (float)getCANID());
@@ -252,6 +326,16 @@ void saveParameters() {
 
     // If the dip switches were installed incorrectly
     writeFlash(INVERTED_DIPS_INDEX, getDipInverted());
+
+    // Encoder update rate and prediction
+    writeFlash(ENCODER_UPDATE_RATE_INDEX, (uint16_t)motor.encoder.getUpdateRate());
+    writeFlash(ENCODER_PREDICTION_INDEX, motor.encoder.getPrediction());
+
+    // Standstill current reduction
+    #ifdef ENABLE_STANDSTILL_REDUCTION
+        writeFlash(STANDSTILL_DELAY_INDEX, motor.getStandstillDelay());
+        writeFlash(STANDSTILL_CURRENT_INDEX, (uint16_t)motor.getStandstillCurrent());
+    #endif
 }
 
 
@@ -337,8 +421,9 @@ String loadParameters() {
         // Motor Enable Inverted
         motor.setEnableInversion(readFlashBool(ENABLE_INVERSION_INDEX));
 
-        // Motor microstepping multiplier
-        motor.setMicrostepMultiplier(readFlashFloat(MICROSTEP_MULTIPLIER_INDEX));
+        // Motor microstep gearing (numerator in the upper half, denominator in the lower)
+        uint32_t microstepGearing = readFlashU32(MICROSTEP_GEARING_INDEX);
+        motor.setMicrostepGearing(microstepGearing >> 16, microstepGearing & 0xFFFF);
 
         // Only load PID values if PID is enabled
         #ifdef ENABLE_PID
@@ -352,6 +437,23 @@ String loadParameters() {
             pid.setD(readFlashFloat(D_TERM_INDEX));
         #endif
 
+        // Cascaded control gains
+        #ifdef ENABLE_CASCADED_CONTROL
+            pid.setPositionP(readFlashFloat(POSITION_P_INDEX));
+            pid.setVelocityP(readFlashFloat(VELOCITY_P_INDEX));
+            pid.setVelocityI(readFlashFloat(VELOCITY_I_INDEX));
+            pid.setMaxVelocity(readFlashFloat(MAX_VELOCITY_INDEX));
+        #endif
+
+        // Step rate feedforward gains
+        #ifdef ENABLE_STEP_FEEDFORWARD
+            pid.setVelocityFF(readFlashFloat(VELOCITY_FF_INDEX));
+            pid.setAccelFF(readFlashFloat(ACCEL_FF_INDEX));
+            #ifdef ENABLE_DYNAMIC_CURRENT
+                motor.setCurrentFeedforward(readFlashU16(CURRENT_FF_INDEX));
+            #endif
+        #endif
+
         // The CAN ID of the motor
         #ifdef ENABLE_CAN
             setCANID((AXIS_CAN_ID)readFlashFloat(CAN_ID_INDEX));
@@ -360,6 +462,16 @@ String loadParameters() {
         // If the dip switches were installed incorrectly
         setDipInverted(readFlashBool(INVERTED_DIPS_INDEX));
 
+        // Encoder update rate and prediction
+        motor.encoder.setUpdateRate((ENCODER_UPDATE_RATE)readFlashU16(ENCODER_UPDATE_RATE_INDEX));
+        motor.encoder.setPrediction(readFlashBool(ENCODER_PREDICTION_INDEX));
+
+        // Standstill current reduction
+        #ifdef ENABLE_STANDSTILL_REDUCTION
+            motor.setStandstillDelay(readFlashU16(STANDSTILL_DELAY_INDEX));
+            motor.setStandstillCurrent(readFlashU16(STANDSTILL_CURRENT_INDEX));
+        #endif
+
         // If we made it this far, we can set the message to "ok" and move on
         outputMessage = FLASH_LOAD_SUCCESSFUL;
     }
@@ -12,6 +12,11 @@
 // This allows 32 32-bit values to be stored
 #define DATA_START_ADDR      0x0801FC00
 
+// Where the encoder linearization table is saved (the page before the parameters)
+// The first half word is a marker, the second is the number of points, then the points follow
+#define LINEARIZATION_START_ADDR   0x0801F800
+#define LINEARIZATION_VALID_MARKER 0x4C54
+
 // Messages for successful and unsuccessful flash reads
 #define FLASH_LOAD_SUCCESSFUL      F("Flash data loaded")
 #define FLASH_LOAD_UNSUCCESSFUL    F("Flash data non-existent")
@@ -49,7 +54,7 @@ typedef enum {
     MICROSTEPPING_INDEX,
     MOTOR_REVERSED_INDEX,
     ENABLE_INVERSION_INDEX,
-    MICROSTEP_MULTIPLIER_INDEX,
+    MICROSTEP_GEARING_INDEX,
 
     // PID values
     P_TERM_INDEX,
@@ -60,14 +65,33 @@ typedef enum {
     CAN_ID_INDEX,
 
     // Inverted dips
-    INVERTED_DIPS_INDEX
+    INVERTED_DIPS_INDEX,
+
+    // Encoder sensor configuration
+    ENCODER_UPDATE_RATE_INDEX,
+    ENCODER_PREDICTION_INDEX,
+
+    // Standstill current reduction
+    STANDSTILL_DELAY_INDEX,
+    STANDSTILL_CURRENT_INDEX,
+
+    // Cascaded control gains
+    POSITION_P_INDEX,
+    VELOCITY_P_INDEX,
+    VELOCITY_I_INDEX,
+    MAX_VELOCITY_INDEX,
+
+    // Step rate feedforward gains
+    VELOCITY_FF_INDEX,
+    ACCEL_FF_INDEX,
+    CURRENT_FF_INDEX
 
 } FLASH_PARAM_INDEXES;
 
 // The max index of the flash parameters (must be manually updated)
 // Note that the flash CANNOT store more than 32 parameters
 // It would overflow the page the data is stored in
-#define MAX_FLASH_PARAM_INDEX 19
+#define MAX_FLASH_PARAM_INDEX 30
 
 // Functions
 bool isCalibrated();
@@ -89,6 +113,12 @@ void writeFlash(uint32_t parameterIndex, float data);
 // Erase all of the parameters in flash
 void eraseParameters();
 
+// Encoder linearization table
+#ifdef ENABLE_ENCODER_LINEARIZATION
+bool readLinearization(int16_t* table, uint16_t length);
+void writeLinearization(const int16_t* table, uint16_t length);
+#endif
+
 // Load/saving values to flash
 void saveParameters();
 bool checkVersionMatch();
@@ -38,8 +38,11 @@ StepperMotor::StepperMotor() {
 
     // Set that the direction pin should be used as a direction control
     // Clear the encoder mode bit, then set it
+    // Hardware step counting sets the direction itself (the ETR clock can't be used with encoder mode)
     tim2Config.Instance -> SMCR &= ~TIM_SMCR_SMS;
-    tim2Config.Instance -> SMCR |= TIM_ENCODERMODE_TI1;
+    #ifndef ENABLE_HARDWARE_STEP_COUNTING
+        tim2Config.Instance -> SMCR |= TIM_ENCODERMODE_TI1;
+    #endif
 
     // Reset TIM2's counter
     __HAL_TIM_SET_COUNTER(&tim2Config, 0);
@@ -61,11 +64,21 @@ StepperMotor::StepperMotor() {
     pinMode(COIL_A_DIR_2_PIN, OUTPUT);
     pinMode(COIL_B_DIR_1_PIN, OUTPUT);
     pinMode(COIL_B_DIR_2_PIN, OUTPUT);
+    this -> coilDirectionPort = get_GPIO_Port(STM_PORT(COIL_A_DIR_1_PIN));
 
     // Configure the PWM current output pins
     this -> PWMCurrentPinInfoA = analogSetup(COIL_A_POWER_OUTPUT_PIN, MOTOR_PWM_FREQ, 0);
     this -> PWMCurrentPinInfoB = analogSetup(COIL_B_POWER_OUTPUT_PIN, MOTOR_PWM_FREQ, 0);
 
+    // Build the PWM table for the default current
+    #ifdef ENABLE_DYNAMIC_CURRENT
+        setDynamicMaxCurrent(DYNAMIC_MAX_CURRENT);
+        this -> baseCurrentScale = ((uint32_t)(this -> dynamicCurrent) * CURRENT_SCALE_MAX) / (this -> dynamicMaxCurrent);
+        publishCurrentScale();
+    #else
+        buildPWMTable(this -> peakCurrent);
+    #endif
+
     // Disable the motor
     setState(DISABLED, true);
 }
@@ -92,7 +105,7 @@ float StepperMotor::getEstimRPM() {
 float StepperMotor::getDegreesPS() {
     calc:
     while (isStepping)
-    float velocity = 1000000.0 * angleChange / (nowStepingSampleTime - prevStepingSampleTime);
+    float velocity = 1000000.0 * angleChange / cyclesToMicros(nowStepingSampleTime - prevStepingSampleTime);
     if (isStepping)
         goto calc;
     return velocity;
@@ -108,17 +121,26 @@ float  StepperMotor::getSteppingRPM() {
 
 // Returns the angular deviation of the motor from the desired angle
 float StepperMotor::getAngleError() {
-    return (encoder.getAbsoluteAngleAvg() - (this -> desiredAngle));
+    return INCREMENTS_TO_DEG((float)(encoder.getAbsolutePositionAvg() - getDesiredPosition()));
 }
 
 
 // Returns the step deviation of the motor from the desired step
 int32_t StepperMotor::getStepError() {
-    return (round(encoder.getAbsoluteAngleAvg() / (this -> microstepAngle)) - getHardStepCNT());
+    return (positionToMicrosteps(encoder.getAbsolutePositionAvg()) - getHardStepCNT());
 }
 
 
-// Returns the current step of the motor phases (only 1 rotation worth)
+// Converts an encoder position (in increments) to the nearest microstep
+int32_t StepperMotor::positionToMicrosteps(int32_t position) const {
+
+    // Scale by the microsteps in a rotation, then round while shifting back down
+    int64_t scaledPosition = (int64_t)position * (this -> microstepsPerRotation);
+    return (int32_t)((scaledPosition + (INCREMENTS_PER_REV / 2)) >> INCREMENTS_PER_REV_BITS);
+}
+
+
+// Returns the current phase of the motor coils (SINE_STEPS per electrical cycle)
 int32_t StepperMotor::getStepPhase() {
     return (this -> currentStep);
 }
@@ -126,10 +148,53 @@ int32_t StepperMotor::getStepPhase() {
 
 // Returns the desired angle of the motor
 float StepperMotor::getDesiredAngle() {
-    return (this -> desiredAngle);
+    return ((this -> softStepCNT) * (this -> microstepAngle));
+}
+
+
+// Returns the desired position of the motor (in encoder increments)
+int32_t StepperMotor::getDesiredPosition() {
+    return (int32_t)(((int64_t)(this -> softStepCNT) * INCREMENTS_PER_REV) / (this -> microstepsPerRotation));
+}
+
+
+// Step rate estimate
+#ifdef ENABLE_STEP_RATE_ESTIMATE
+
+// Measures the velocity and acceleration of the step input
+void StepperMotor::updateStepRate() {
+
+    // Start the history from here the first time
+    int32_t position = getDesiredPosition();
+    if (!(this -> stepRateStarted)) {
+        this -> lastStepRatePosition = position;
+        this -> stepRateStarted = true;
+    }
+
+    // Differentiate the desired position twice, filtering each
+    int32_t rawVelocity = (position - (this -> lastStepRatePosition)) * (int32_t)CONTROL_UPDATE_FREQ;
+    int32_t filteredVelocity = (this -> stepVelocity) + ((rawVelocity - (this -> stepVelocity)) >> STEP_RATE_FILTER_BITS);
+    int64_t rawAccel = (int64_t)(filteredVelocity - (this -> stepVelocity)) * CONTROL_UPDATE_FREQ;
+    this -> stepAccel += (int32_t)((rawAccel - (this -> stepAccel)) >> STEP_RATE_FILTER_BITS);
+    this -> stepVelocity = filteredVelocity;
+    this -> lastStepRatePosition = position;
 }
 
 
+// Returns the velocity of the step input
+int32_t StepperMotor::getStepVelocity() const {
+    return (this -> stepVelocity);
+}
+
+
+// Returns the acceleration of the step input
+int32_t StepperMotor::getStepAccel() const {
+    return (this -> stepAccel);
+}
+
+#endif // ! ENABLE_STEP_RATE_ESTIMATE
+
+
 // Returns the desired step of the motor
 int32_t StepperMotor::getSoftStepCNT() {
     return (this -> softStepCNT);
@@ -178,6 +243,70 @@ void overflowHandler() {
 }
 
 
+// Hardware step counting
+#ifdef ENABLE_HARDWARE_STEP_COUNTING
+
+// Moves the coils by the steps counted by TIM2 since the last update
+int16_t StepperMotor::followStepCounter() {
+
+    // Check the counting direction against the pin as well, in case its interrupt was held off or missed
+    updateStepCounterDirection();
+
+    // Find the change in the count (16 bit subtraction handles the counter wrapping)
+    uint16_t stepCounterValue = TIM2 -> CNT;
+    int16_t countChange = (int16_t)(stepCounterValue - (this -> lastStepCounterValue));
+
+    // Nothing to do if there weren't any steps
+    if (countChange == 0) {
+        return 0;
+    }
+    this -> lastStepCounterValue = stepCounterValue;
+
+    // Apply the direction reversal and gearing, then move the desired step and coils (same as step())
+    int32_t stepChange = gearSteps(countChange * (this -> reversed));
+    this -> softStepCNT += stepChange;
+    this -> currentStep += stepChange * (this -> microstepPhase);
+
+    // Bring the full current back right away if it was reduced
+    #ifdef ENABLE_STANDSTILL_REDUCTION
+        if (this -> standstillActive) {
+            this -> standstillActive = false;
+            this -> standstillScale = CURRENT_SCALE_MAX;
+            this -> currentScale = (this -> baseCurrentScale);
+        }
+    #endif
+
+    // The servo output moves the coils to the desired position by itself
+    #ifdef ENABLE_SERVO_OUTPUT
+        if (this -> commutationAligned) {
+            return countChange;
+        }
+    #endif
+    this -> driveCoils(this -> currentStep);
+    return countChange;
+}
+
+
+// Sets the counting direction of TIM2 from the direction pin
+void StepperMotor::updateStepCounterDirection() {
+
+    // Count up for a positive direction, down for a negative one
+    if (DIRECTION(GPIO_READ(DIRECTION_PIN)) > 0) {
+        TIM2 -> CR1 &= ~TIM_CR1_DIR;
+    }
+    else {
+        TIM2 -> CR1 |= TIM_CR1_DIR;
+    }
+}
+
+
+// Drops any steps counted since the last update
+void StepperMotor::syncStepCounter() {
+    this -> lastStepCounterValue = TIM2 -> CNT;
+}
+#endif // ! ENABLE_HARDWARE_STEP_COUNTING
+
+
 #ifdef ENABLE_DYNAMIC_CURRENT
 
 // Gets the acceleration factor for dynamic current
@@ -198,8 +327,8 @@ uint16_t StepperMotor::getDynamicMaxCurrent() const {
 // Sets the acceleration factor for dynamic current
 void StepperMotor::setDynamicAccelCurrent(uint16_t newAccelFactor) {
 
-    // Make sure that the value being set is positive (no negatives allowed)
-    if (newAccelFactor >= 0) {
+    // Make sure that the new value isn't a -1 (all functions that fail should return a -1)
+    if (newAccelFactor != (uint16_t)-1) {
         this -> dynamicAccelCurrent = newAccelFactor;
     }
 }
@@ -207,21 +336,79 @@ void StepperMotor::setDynamicAccelCurrent(uint16_t newAccelFactor) {
 // Sets the idle factor for dynamic current
 void StepperMotor::setDynamicIdleCurrent(uint16_t newIdleFactor) {
 
-    // Make sure that the value being set is positive (no negatives allowed)
-    if (newIdleFactor >= 0) {
-        this -> dynamicIdleCurrent = newIdleFactor;
+    // Make sure that the new value isn't a -1 (all functions that fail should return a -1)
+    if (newIdleFactor != (uint16_t)-1) {
+        this -> dynamicIdleCurrent = constrain(newIdleFactor, 0, MAX_RMS_BOARD_CURRENT);
     }
 }
 
 // Sets the max current factor for dynamic current
 void StepperMotor::setDynamicMaxCurrent(uint16_t newMaxCurrent) {
 
-    // Make sure that the value being set is positive (no negatives allowed)
-    if (newMaxCurrent >= 0) {
-        this -> dynamicMaxCurrent = newMaxCurrent;
+    // Make sure that the new value isn't a -1 (all functions that fail should return a -1)
+    if (newMaxCurrent != (uint16_t)-1) {
+        this -> dynamicMaxCurrent = constrain(newMaxCurrent, 1, MAX_RMS_BOARD_CURRENT);
+
+        // The table is built for the max current, the dynamic current scales it down
+        buildPWMTable(constrain((uint16_t)(this -> dynamicMaxCurrent * 1.414), 0, MAX_PEAK_BOARD_CURRENT));
+    }
+}
+
+
+// Computes the dynamic current, then publishes it to the coils
+void StepperMotor::updateDynamicCurrent() {
+
+    // Acceleration from the observer (converted from increments/s^2 to 1000 deg/s^2)
+    int64_t accel = ((int64_t)abs(encoder.getObserverAccel()) * 360) >> INCREMENTS_PER_REV_BITS;
+    int64_t accelCurrent = (accel * (this -> dynamicAccelCurrent)) / 1000;
+
+    // The step input's acceleration comes before the motor's, use it if it needs more current
+    #ifdef ENABLE_STEP_FEEDFORWARD
+        int64_t stepAccel = ((int64_t)abs(this -> stepAccel) * 360) >> INCREMENTS_PER_REV_BITS;
+        accelCurrent = max(accelCurrent, (stepAccel * (this -> currentFeedforward)) / 1000);
+    #endif
+
+    // Tracking error (converted from microsteps to full steps)
+    int64_t errorCurrent = ((int64_t)abs(getStepError()) * DYNAMIC_ERROR_CURRENT) / (this -> microstepDivisor);
+
+    // Find the current needed, limited to the max current
+    int32_t targetCurrent = constrain((this -> dynamicIdleCurrent) + accelCurrent + errorCurrent, 0, (int64_t)(this -> dynamicMaxCurrent));
+
+    // Move toward it, limiting how fast the current can change
+    this -> dynamicCurrent += constrain(targetCurrent - (this -> dynamicCurrent), -DYNAMIC_CURRENT_SLEW, DYNAMIC_CURRENT_SLEW);
+
+    // Publish the current to the coils as a scale of the max current (applied on the next coil update)
+    this -> baseCurrentScale = min(((uint32_t)(this -> dynamicCurrent) * CURRENT_SCALE_MAX) / (this -> dynamicMaxCurrent), (uint32_t)CURRENT_SCALE_MAX);
+    publishCurrentScale();
+}
+
+
+// Gets the current that the dynamic current is set to
+uint16_t StepperMotor::getDynamicCurrent() const {
+    return (this -> dynamicCurrent);
+}
+
+
+// Current feedforward from the step input's acceleration
+#ifdef ENABLE_STEP_FEEDFORWARD
+
+// Gets the current feedforward
+uint16_t StepperMotor::getCurrentFeedforward() const {
+    return (this -> currentFeedforward);
+}
+
+
+// Sets the current feedforward
+void StepperMotor::setCurrentFeedforward(uint16_t newCurrentFeedforward) {
+
+    // Make sure that the new value isn't a -1 (all functions that fail should return a -1)
+    if (newCurrentFeedforward != (uint16_t)-1) {
+        this -> currentFeedforward = newCurrentFeedforward;
     }
 }
 
+#endif // ! ENABLE_STEP_FEEDFORWARD
+
 #else // ! ENABLE_DYNAMIC_CURRENT
 
 // Gets the RMS current of the motor (in mA)
@@ -247,6 +434,9 @@ void StepperMotor::setRMSCurrent(uint16_t rmsCurrent) {
 
         // Also set the peak current
         this -> peakCurrent = constrain((uint16_t)(rmsCurrent * 1.414), 0, MAX_PEAK_BOARD_CURRENT);
+
+        // Rebuild the PWM table to match
+        buildPWMTable(this -> peakCurrent);
     }
 }
 
@@ -262,10 +452,109 @@ void StepperMotor::setPeakCurrent(uint16_t peakCurrent) {
 
         // Also set the RMS current
         this -> rmsCurrent = constrain((uint16_t)(peakCurrent * 0.707), 0, MAX_RMS_BOARD_CURRENT);
+
+        // Rebuild the PWM table to match
+        buildPWMTable(this -> peakCurrent);
     }
 }
 #endif // ! ENABLE_DYNAMIC_CURRENT
 
+
+// Rebuilds the PWM table for a peak current
+void StepperMotor::buildPWMTable(uint16_t tablePeakCurrent) {
+    fillPWMTable(this -> pwmTable, tablePeakCurrent);
+}
+
+// Combines the control task's current scales, then publishes them to the coils
+void StepperMotor::publishCurrentScale() {
+    #ifdef ENABLE_STANDSTILL_REDUCTION
+        this -> currentScale = ((this -> baseCurrentScale) * (this -> standstillScale)) >> CURRENT_SCALE_BITS;
+    #else
+        this -> currentScale = (this -> baseCurrentScale);
+    #endif
+}
+
+
+// Standstill current reduction
+#ifdef ENABLE_STANDSTILL_REDUCTION
+
+// Gets the time without steps before the current is reduced
+uint16_t StepperMotor::getStandstillDelay() const {
+    return (this -> standstillDelay);
+}
+
+
+// Sets the time without steps before the current is reduced
+void StepperMotor::setStandstillDelay(uint16_t delay) {
+
+    // Make sure that the new value isn't a -1 (all functions that fail should return a -1)
+    if (delay != (uint16_t)-1) {
+        this -> standstillDelay = delay;
+    }
+}
+
+
+// Gets the holding current
+uint8_t StepperMotor::getStandstillCurrent() const {
+    return (this -> standstillCurrent);
+}
+
+
+// Sets the holding current
+void StepperMotor::setStandstillCurrent(uint8_t percent) {
+    this -> standstillCurrent = constrain(percent, 0, 100);
+}
+
+
+// Checks if the motor is standing still, ramping the current down if so
+void StepperMotor::updateStandstill() {
+
+    // Any steps or position error restart the timer with the full current
+    // (the step path already restored the current if there was a step, this catches the position errors)
+    if (((this -> softStepCNT) != (this -> standstillStepCNT)) || (abs(getStepError()) > 1) || ((this -> standstillDelay) == 0)) {
+        this -> standstillStepCNT = (this -> softStepCNT);
+        this -> standstillStartTime = millis();
+        if ((this -> standstillScale) != CURRENT_SCALE_MAX) {
+
+            // A step in between would have restored the current and driven its new phase already, so only restore if there wasn't one
+            // (driving the old phase after it would lose the step)
+            disableInterrupts();
+            if ((this -> softStepCNT) == (this -> standstillStepCNT)) {
+                this -> standstillScale = CURRENT_SCALE_MAX;
+                this -> standstillActive = false;
+                publishCurrentScale();
+                driveCoils(this -> drivenPhase);
+            }
+            enableInterrupts();
+        }
+        return;
+    }
+
+    // Ramp the current down once the delay has passed (one step of the scale per update)
+    if ((millis() - (this -> standstillStartTime)) >= (this -> standstillDelay)) {
+        if ((this -> standstillScale) > (((this -> standstillCurrent) * CURRENT_SCALE_MAX) / 100)) {
+
+            // The step interrupt could come in at any point, so make sure that it didn't before reducing the current
+            disableInterrupts();
+            if ((this -> softStepCNT) == (this -> standstillStepCNT)) {
+                this -> standstillScale--;
+                this -> standstillActive = true;
+                publishCurrentScale();
+                driveCoils(this -> drivenPhase);
+            }
+            enableInterrupts();
+        }
+    }
+}
+
+
+// Gets if the current is reduced
+bool StepperMotor::getStandstillActive() const {
+    return (this -> standstillActive);
+}
+#endif // ! ENABLE_STANDSTILL_REDUCTION
+
+
 // Get the microstepping divisor of the motor
 uint16_t StepperMotor::getMicrostepping() const {
     return (this -> microstepDivisor);
@@ -275,8 +564,8 @@ uint16_t StepperMotor::getMicrostepping() const {
 // Set the microstepping divisor of the motor
 void StepperMotor::setMicrostepping(uint16_t setMicrostepping) {
 
-    // Make sure that the new value isn't a -1 (all functions that fail should return a -1)
-    if (setMicrostepping != -1) {
+    // Make sure that the new value isn't a -1 (all functions that fail should return a -1), and that the coils can be driven to it
+    if (setMicrostepping != -1 && setMicrostepping <= MAX_MICROSTEP_DIVISOR) {
 
         // Scale the hardware step counter
         setHardStepCNT(getHardStepCNT() * (setMicrostepping / this -> microstepDivisor));
@@ -287,6 +576,9 @@ void StepperMotor::setMicrostepping(uint16_t setMicrostepping) {
         // Set the microstepping divisor
         this -> microstepDivisor = setMicrostepping;
 
+        // Fix the coil phase change of each microstep
+        this -> microstepPhase = SINE_STEPS_PER_FULL_STEP / (this -> microstepDivisor);
+
         // Fix the microstep angle
         this -> microstepAngle = (this -> fullStepAngle) / (this -> microstepDivisor);
 
@@ -373,25 +665,117 @@ bool StepperMotor::getEnableInversion() const {
 // Set the microstep multiplier
 void StepperMotor::setMicrostepMultiplier(float newMultiplier) {
 
-    // Set the object's value if it is valid
-    if (newMultiplier != -1) {
-        (this -> microstepMultiplier) = newMultiplier;
+    // Make sure that the value is valid
+    if (newMultiplier <= 0) {
+        return;
     }
+
+    // Find the most precise denominator (up to 4 decimal places) that still fits the numerator
+    uint32_t denominator = 10000;
+    while ((denominator > 1) && (round(newMultiplier * denominator) > UINT16_MAX)) {
+        denominator /= 10;
+    }
+    uint32_t numerator = constrain(round(newMultiplier * denominator), 1, UINT16_MAX);
+
+    // Reduce the ratio by the greatest common divisor (i.e. 1.5 is 3/2, not 15000/10000)
+    uint32_t divisor = numerator;
+    uint32_t remainder = denominator;
+    while (remainder != 0) {
+        uint32_t nextRemainder = divisor % remainder;
+        divisor = remainder;
+        remainder = nextRemainder;
+    }
+    setMicrostepGearing(numerator / divisor, denominator / divisor);
 }
 
 
 // Get the microstep multiplier
 float StepperMotor::getMicrostepMultiplier() const {
 
-    // Return the object's value
-    return (this -> microstepMultiplier);
+    // Return the ratio as a decimal
+    return ((float)(this -> gearNumerator) / (this -> gearDenominator));
+}
+
+
+// Sets the microstep gearing ratio
+void StepperMotor::setMicrostepGearing(uint16_t numerator, uint16_t denominator) {
+
+    // Ignore invalid ratios
+    if (numerator == 0 || denominator == 0) {
+        return;
+    }
+
+    // Steps could come in at any time, so update all of the values at once
+    // The carried fraction is from the old ratio, so it's cleared
+    disableInterrupts();
+    this -> gearNumerator = numerator;
+    this -> gearDenominator = denominator;
+    this -> gearWhole = numerator / denominator;
+    this -> gearRemainder = numerator % denominator;
+    this -> gearAccumulator = 0;
+    enableInterrupts();
+}
+
+
+// Gets the numerator of the microstep gearing ratio
+uint16_t StepperMotor::getMicrostepGearNumerator() const {
+    return (this -> gearNumerator);
+}
+
+
+// Gets the denominator of the microstep gearing ratio
+uint16_t StepperMotor::getMicrostepGearDenominator() const {
+    return (this -> gearDenominator);
+}
+
+
+// Converts a single step pulse to microsteps, carrying the fraction to the next pulse
+int32_t StepperMotor::gearStep(int32_t direction) {
+
+    // Moving forward adds the fraction, carrying a microstep once it's a whole one
+    if (direction > 0) {
+        this -> gearAccumulator += (this -> gearRemainder);
+        if ((this -> gearAccumulator) >= (this -> gearDenominator)) {
+            this -> gearAccumulator -= (this -> gearDenominator);
+            return (this -> gearWhole) + 1;
+        }
+        return (this -> gearWhole);
+    }
+
+    // Moving backward undoes exactly what moving forward did, so the position never drifts when reversing
+    else {
+        this -> gearAccumulator -= (this -> gearRemainder);
+        if ((this -> gearAccumulator) < 0) {
+            this -> gearAccumulator += (this -> gearDenominator);
+            return -((this -> gearWhole) + 1);
+        }
+        return -(this -> gearWhole);
+    }
+}
+
+
+// Converts a number of step pulses to microsteps, carrying the fraction to the next pulses
+int32_t StepperMotor::gearSteps(int32_t pulses) {
+
+    // Add the fractions of all of the pulses (pulses are at most 16 bits, so this can't overflow)
+    int32_t microsteps = pulses * (this -> gearWhole);
+    this -> gearAccumulator += pulses * (this -> gearRemainder);
+
+    // Move the whole microsteps out of the accumulator (rounding down, so the accumulator stays positive)
+    int32_t carry = (this -> gearAccumulator) / (int32_t)(this -> gearDenominator);
+    this -> gearAccumulator -= carry * (this -> gearDenominator);
+    if ((this -> gearAccumulator) < 0) {
+        this -> gearAccumulator += (this -> gearDenominator);
+        carry--;
+    }
+    return microsteps + carry;
 }
 
 
 void StepperMotor::simpleStep() {
 
     // Only moving one step in the specified direction
-    this -> currentStep += DIRECTION(GPIO_READ(DIRECTION_PIN)) * (this -> reversed) * (this -> microstepMultiplier);
+    this -> currentStep += gearStep(DIRECTION(GPIO_READ(DIRECTION_PIN)) * (this -> reversed)) * (this -> microstepPhase);
 
     // Drive the coils to their destination
     this -> driveCoils(this -> currentStep);
@@ -406,119 +790,264 @@ void StepperMotor::step(STEP_DIR dir, bool useMultiplier, bool updateDesiredPos)
 
         // Sample times
         prevStepingSampleTime = nowStepingSampleTime;
-        nowStepingSampleTime = micros();
+        nowStepingSampleTime = cycleCount();
 
-    #else // ! ENABLE_STEPPING_VELOCITY
-        float angleChange;
     #endif
 
-    // Main angle change (any inversions * angle of microstep)
-    angleChange = this -> microstepAngle;
+    // Main step change (the desired angle is derived from the steps, so no floating point math is needed)
     int32_t stepChange = 1;
 
-    // Factor in the multiplier if specified
-    if (useMultiplier) {
-        angleChange *= (this -> microstepMultiplier);
-        stepChange *= (this -> microstepMultiplier);
-    }
-
     // Invert the change based on the direction
     if (dir == PIN) {
 
         // Use the DIR_PIN state
-        angleChange *= DIRECTION(GPIO_READ(DIRECTION_PIN)) * (this -> reversed);
+        stepChange = DIRECTION(GPIO_READ(DIRECTION_PIN)) * (this -> reversed);
     }
     //else if (dir == COUNTER_CLOCKWISE) {
         // Nothing to do here, the value is already positive
     //}
     else if (dir == CLOCKWISE) {
-        // Make the angle change in the negative direction
-        angleChange = -angleChange;
+        // Make the step change in the negative direction
+        stepChange = -stepChange;
+    }
+
+    // Apply the gearing if specified
+    if (useMultiplier) {
+        stepChange = gearStep(stepChange);
     }
 
     #ifdef ENABLE_STEPPING_VELOCITY
+        // Angle change (any inversions * angle of microstep)
+        angleChange = stepChange * (this -> microstepAngle);
         isStepping = false;
     #endif
 
-    // Fix the step change's sign
-    stepChange *= getSign(angleChange);
-
-    // Update the desired angle if specified
+    // Update the desired step if specified
     if (updateDesiredPos) {
-
-        // Angles are basically just added to desired, not really much to do here
-        this -> desiredAngle += angleChange;
         this -> softStepCNT += stepChange;
     }
 
-    // Motor's current angle must always be updated to correctly move the coils
-    this -> currentAngle += angleChange;
-    this -> currentStep += stepChange; // Only moving one step in the specified direction
+    // Bring the full current back right away if it was reduced
+    #ifdef ENABLE_STANDSTILL_REDUCTION
+        if (this -> standstillActive) {
+            this -> standstillActive = false;
+            this -> standstillScale = CURRENT_SCALE_MAX;
+            this -> currentScale = (this -> baseCurrentScale);
+        }
+    #endif
+
+    // Motor's current phase must always be updated to correctly move the coils
+    this -> currentStep += stepChange * (this -> microstepPhase); // Only moving one step in the specified direction
+
+    // The servo output moves the coils to the desired position by itself, steps only need to move the desired position
+    #ifdef ENABLE_SERVO_OUTPUT
+        if (updateDesiredPos && (this -> commutationAligned)) {
+            return;
+        }
+    #endif
+
+    // Step pulses are spread over the step period. Any other steps (i.e. corrections) are moved to directly, ending the interpolation
+    #ifdef ENABLE_STEP_INTERPOLATION
+        if ((dir == PIN) && updateDesiredPos) {
+            startInterpolation();
+            return;
+        }
+        this -> interpolationTicks = 0;
+    #endif
 
     // Drive the coils to their destination
     this -> driveCoils(currentStep);
 }
 
 
-// Sets the coils of the motor based on the step count
-void StepperMotor::driveCoils(int32_t steps) {
+// Step interpolation
+#ifdef ENABLE_STEP_INTERPOLATION
 
-    // Correct the steps so that they're within the valid range
-    //steps %= (4 * (this -> microstepDivisor));
+// Starts moving the coils from their current phase to currentStep over the measured step period
+void StepperMotor::startInterpolation() {
 
-    // Calculate the sine and cosine of the angle
-    uint16_t arrayIndex = steps & (SINE_VAL_COUNT - 1);
+    // Measure the time since the last step in cycles (the next step is expected to take just as long)
+    uint32_t stepTime = cycleCount();
+    uint32_t stepPeriod = stepTime - (this -> lastStepTime);
+    this -> lastStepTime = stepTime;
 
-    // Calculate the coil settings
-    int16_t coilAPercent = fastSin(arrayIndex);
-    int16_t coilBPercent = fastCos(arrayIndex);
+    // Start from wherever the coils are, so any distance left from the last step is carried into this one
+    int32_t distance = (this -> currentStep) - (this -> drivenPhase);
 
-    // Equation comes out to be (effort * -1 to 1) depending on the sine/cosine of the phase angle
-    #ifdef ENABLE_DYNAMIC_CURRENT
+    // Slow steps (like the first step of a move) have nothing to time the interpolation from, so they're moved to directly
+    // Distances over 16 bits would overflow the fixed point math (only possible with huge gearing ratios)
+    if ((stepPeriod > microsToCycles(STEP_INTERPOLATION_MAX_PERIOD)) || (abs(distance) > INT16_MAX)) {
+        this -> interpolationTicks = 0;
+        driveCoils(this -> currentStep);
+        return;
+    }
 
-        // Get the current acceleration
-        double angAccel = abs(motor.encoder.getAccel());
+    // Spread the distance evenly over the updates that fit in the step period
+    uint32_t ticks = max((cyclesToMicros(stepPeriod) * (STEP_INTERPOLATION_FREQ / 100)) / 10000, (uint32_t)1);
+    this -> interpolationStart = (this -> drivenPhase);
+    this -> interpolationTarget = (this -> currentStep);
+    this -> interpolationOffset = 0;
+    this -> interpolationIncrement = (distance * 65536) / (int32_t)ticks;
+    this -> interpolationTicks = ticks;
+}
 
-        // Compute the coil power
-        int16_t coilAPower = ((int16_t)(((angAccel * (this -> dynamicAccelCurrent)) + (this -> dynamicIdleCurrent)) * 1.414) * coilAPercent) >> SINE_POWER;
-        int16_t coilBPower = ((int16_t)(((angAccel * (this -> dynamicAccelCurrent)) + (this -> dynamicIdleCurrent)) * 1.414) * coilBPercent) >> SINE_POWER;
-    #else
-        // Just use static current multipiers
-        int16_t coilAPower = ((int16_t)(this -> peakCurrent) * coilAPercent) >> SINE_POWER; // i.e. / SINE_MAX
-        int16_t coilBPower = ((int16_t)(this -> peakCurrent) * coilBPercent) >> SINE_POWER; // i.e. / SINE_MAX
-    #endif
 
-    // Check the if the coil should be energized to move backward or forward
-    if (coilAPower > 0) {
+// Moves the coils to the next interpolated position of the last step
+void StepperMotor::interpolateStep() {
 
-        // Set first channel for forward movement
-        setCoilA(COIL_STATE::FORWARD, coilAPower);
+    // Nothing to do once the target is reached
+    if ((this -> interpolationTicks) == 0) {
+        return;
     }
-    else if (coilAPower < 0) {
 
-        // Set first channel for backward movement
-        setCoilA(COIL_STATE::BACKWARD, -coilAPower);
+    // A step could restart the interpolation part way through, so block it until the coils are updated
+    disableInterrupts();
+    if ((this -> interpolationTicks) != 0) {
+
+        // Land exactly on the target with the last update, so the rounding never builds up
+        this -> interpolationTicks--;
+        if ((this -> interpolationTicks) == 0) {
+            driveCoils(this -> interpolationTarget);
+        }
+        else {
+            this -> interpolationOffset += (this -> interpolationIncrement);
+            driveCoils((this -> interpolationStart) + ((this -> interpolationOffset) >> 16));
+        }
     }
-    else {
-        setCoilA(BRAKE);
+    enableInterrupts();
+}
+#endif // ! ENABLE_STEP_INTERPOLATION
+
+
+// Sets the coils of the motor based on the phase (SINE_STEPS per electrical cycle)
+void StepperMotor::driveCoils(int32_t phase, uint32_t outputScale) {
+
+    // Start timing the update
+    #ifdef CHECK_DRIVE_COILS_TIME
+        uint32_t startCycles = cycleCount();
+    #endif
+
+    // Keep the phase (used for the commutation offset, and to update the current at standstill)
+    this -> drivenPhase = phase;
+
+    // Look up the PWM values from the table, scaled by both of the current scales
+    int32_t coilAPWM, coilBPWM;
+    lookupCoilPWM(this -> pwmTable, phase, (outputScale * (this -> currentScale)) >> CURRENT_SCALE_BITS, coilAPWM, coilBPWM);
+
+    // Set the direction of each of the coils from the sign (0 brakes the coil)
+    setCoilDirections((coilAPWM > 0) ? FORWARD : ((coilAPWM < 0) ? BACKWARD : BRAKE),
+                      (coilBPWM > 0) ? FORWARD : ((coilBPWM < 0) ? BACKWARD : BRAKE));
+
+    // Update both of the PWM values together, so they take effect at the same update event
+    analogSetPair(&PWMCurrentPinInfoA, abs(coilAPWM), &PWMCurrentPinInfoB, abs(coilBPWM));
+
+    // Record the time taken (the step and correction interrupts both call this, so the max covers both)
+    #ifdef CHECK_DRIVE_COILS_TIME
+        this -> driveCoilsCycles = cycleCount() - startCycles;
+        this -> driveCoilsMaxCycles = max(this -> driveCoilsMaxCycles, this -> driveCoilsCycles);
+    #endif
+}
+
+
+// Timing of the coil updates
+#ifdef CHECK_DRIVE_COILS_TIME
+// Gets the CPU cycles taken by the last driveCoils() call
+uint32_t StepperMotor::getDriveCoilsCycles() const {
+    return (this -> driveCoilsCycles);
+}
+
+
+// Gets the most CPU cycles that a driveCoils() call has taken
+uint32_t StepperMotor::getDriveCoilsMaxCycles() const {
+    return (this -> driveCoilsMaxCycles);
+}
+
+
+// Clears the most cycles taken by a driveCoils() call
+void StepperMotor::resetDriveCoilsMaxCycles() {
+    this -> driveCoilsMaxCycles = 0;
+}
+#endif // ! CHECK_DRIVE_COILS_TIME
+
+
+// Closed loop commutation
+#ifdef ENABLE_ROTOR_COMMUTATION
+
+// Converts the cached encoder position to a coil phase
+int32_t StepperMotor::rotorPhase() const {
+
+    // Coil phase change in a full rotation, then scale the position by it
+    int64_t phasePerRotation = (int64_t)(this -> microstepsPerRotation) * (this -> microstepPhase);
+    return (int32_t)((motor.encoder.getPosition() * phasePerRotation) >> INCREMENTS_PER_REV_BITS);
+}
+
+
+// Drives the coils ahead of the measured rotor angle
+#ifdef ENABLE_PHASE_LEAD
+void StepperMotor::driveCoilsLead(int32_t direction) {
+
+    // The coils can't be commutated from the rotor until the offset is known, just step instead
+    if (!(this -> commutationAligned)) {
+        step((direction > 0) ? COUNTER_CLOCKWISE : CLOCKWISE, false, false);
+        return;
     }
 
+    // Convert the observer velocity (increments/s) to a coil phase velocity (phase/s)
+    int64_t phasePerRotation = (int64_t)(this -> microstepsPerRotation) * (this -> microstepPhase);
+    int64_t phaseVelocity = (abs(motor.encoder.getObserverVelocity()) * phasePerRotation) >> INCREMENTS_PER_REV_BITS;
+
+    // The coil current lags by a fixed time, so the lead has to grow with the speed to make up for it
+    int32_t lead = min((phaseVelocity * PHASE_LEAD_TIME_US) / 1000000, (int64_t)(PHASE_LEAD_MAX * SINE_STEPS / 360));
+
+    // Drive the coils ahead of the rotor in the direction of the desired position
+    driveCoils(rotorPhase() + (this -> commutationOffset) + direction * ((int32_t)(PHASE_LEAD_ADVANCE * SINE_STEPS / 360) + lead));
+    this -> leadActive = true;
+}
+#endif // ! ENABLE_PHASE_LEAD
+
 
-    // Check the if the coil should be energized to move backward or forward
-    if (coilBPower > 0) {
+// Drives the coils from a PID output
+#ifdef ENABLE_SERVO_OUTPUT
+void StepperMotor::driveServo(int32_t output) {
 
-        // Set first channel for forward movement
-        setCoilB(COIL_STATE::FORWARD, coilBPower);
+    // The offset has to be measured before the coils can be driven from the rotor (done the first time the motor is in position)
+    // Until then, fall back to stepping toward the desired position
+    if (!(this -> commutationAligned)) {
+        if (abs(getStepError()) <= 1) {
+            holdRotor();
+        }
+        else {
+            step((output > 0) ? COUNTER_CLOCKWISE : CLOCKWISE, false, false);
+        }
+        return;
     }
-    else if (coilBPower < 0) {
 
-        // Set first channel for backward movement
-        setCoilB(BACKWARD, -coilBPower);
+    // The angle ahead of the rotor (up to 90 electrical degrees) and the current both scale with the output
+    // The torque is the current times the sine of the angle, so it keeps increasing with the output
+    // Drive the coils, keeping the phase so that stepping continues from here if the mode changes
+    this -> currentStep = rotorPhase() + (this -> commutationOffset) + servoLoadAngle(output);
+    driveCoils(this -> currentStep, servoCurrentScale(output));
+}
+#endif // ! ENABLE_SERVO_OUTPUT
+
+
+// Holds the rotor where it is
+void StepperMotor::holdRotor() {
+
+    // The rotor is settled at the last driven phase, so the difference is the commutation offset
+    if (!(this -> commutationAligned)) {
+        this -> commutationOffset = (this -> drivenPhase) - rotorPhase();
+        this -> commutationAligned = true;
     }
-    else {
-        setCoilB(BRAKE);
+    else if (this -> leadActive) {
+
+        // Pull the coils back to the rotor, then continue stepping from there
+        this -> currentStep = rotorPhase() + (this -> commutationOffset);
+        driveCoils(this -> currentStep);
+        this -> leadActive = false;
     }
 }
+#endif // ! ENABLE_ROTOR_COMMUTATION
 
 
 // Sets the coils of the motor based on the angle (angle should be in degrees)
@@ -550,43 +1079,37 @@ void StepperMotor::driveCoilsAngle(float degAngle) {
 
     // Round the microstep angle, it has to be a whole value of the number of microsteps available
     // Also ensures that the coils are being driven to the major step positions (increases torque)
-    uint16_t roundedMicrosteps = round(microstepAngle);
+    int32_t roundedMicrosteps = round(microstepAngle);
 
     // Drive the coils to the found microstep
-    driveCoils(roundedMicrosteps);
+    driveCoils(roundedMicrosteps * (this -> microstepPhase));
 }
 
 
-// Function for setting the A coil state and current
-void StepperMotor::setCoilA(COIL_STATE desiredState, uint16_t current) {
+// Builds the port BSRR value that sets a coil's direction pins for a state (upper half resets pins, lower half sets them)
+constexpr uint32_t coilDirectionBits(COIL_STATE state, uint32_t pin1, uint32_t pin2) {
+    return (state == FORWARD)  ? (pin1 | (pin2 << 16)) :
+           (state == BACKWARD) ? ((pin1 << 16) | pin2) :
+           (state == BRAKE)    ? (pin1 | pin2) :
+           (state == COAST)    ? ((pin1 << 16) | (pin2 << 16)) : 0;
+}
 
-    // Check if the desired coil state is different from the previous, if so, we need to set the output pins
-    if (desiredState != previousCoilStateA) {
+// Port BSRR values for each of the coil states (indexed by COIL_STATE)
+#define COIL_DIRECTION_TABLE(pin1, pin2) { \
+    coilDirectionBits(COIL_NOT_SET, STM_GPIO_PIN(pin1), STM_GPIO_PIN(pin2)), \
+    coilDirectionBits(FORWARD,      STM_GPIO_PIN(pin1), STM_GPIO_PIN(pin2)), \
+    coilDirectionBits(BACKWARD,     STM_GPIO_PIN(pin1), STM_GPIO_PIN(pin2)), \
+    coilDirectionBits(BRAKE,        STM_GPIO_PIN(pin1), STM_GPIO_PIN(pin2)), \
+    coilDirectionBits(COAST,        STM_GPIO_PIN(pin1), STM_GPIO_PIN(pin2)) }
+static constexpr uint32_t coilADirectionBits[] = COIL_DIRECTION_TABLE(COIL_A_DIR_1_PIN, COIL_A_DIR_2_PIN);
+static constexpr uint32_t coilBDirectionBits[] = COIL_DIRECTION_TABLE(COIL_B_DIR_1_PIN, COIL_B_DIR_2_PIN);
 
-        // Disable the coil
-        analogSet(&PWMCurrentPinInfoA, 0);
 
-        // Decide the state of the direction pins
-        if (desiredState == FORWARD) {
-            GPIO_WRITE(COIL_A_DIR_1_PIN, HIGH);
-            GPIO_WRITE(COIL_A_DIR_2_PIN, LOW);
-        }
-        else if (desiredState == BACKWARD) {
-            GPIO_WRITE(COIL_A_DIR_1_PIN, LOW);
-            GPIO_WRITE(COIL_A_DIR_2_PIN, HIGH);
-        }
-        else if (desiredState == BRAKE) {
-            GPIO_WRITE(COIL_A_DIR_1_PIN, HIGH);
-            GPIO_WRITE(COIL_A_DIR_2_PIN, HIGH);
-        }
-        else if (desiredState == COAST) {
-            GPIO_WRITE(COIL_A_DIR_1_PIN, LOW);
-            GPIO_WRITE(COIL_A_DIR_2_PIN, LOW);
-        }
+// Function for setting the A coil state and current
+void StepperMotor::setCoilA(COIL_STATE desiredState, uint16_t current) {
 
-        // Update the previous state of the coil with the new one
-        previousCoilStateA = desiredState;
-    }
+    // Set the direction, leaving the B coil alone
+    setCoilDirections(desiredState, this -> previousCoilStateB);
 
     // Update the output pin with the correct current
     analogSet(&PWMCurrentPinInfoA, currentToPWM(current));
@@ -596,47 +1119,32 @@ void StepperMotor::setCoilA(COIL_STATE desiredState, uint16_t current) {
 // Function for setting the B coil state and current
 void StepperMotor::setCoilB(COIL_STATE desiredState, uint16_t current) {
 
-    // Check if the desired coil state is different from the previous, if so, we need to set the output pins
-    if (desiredState != previousCoilStateB) {
-
-        // Disable the coil
-        analogSet(&PWMCurrentPinInfoB, 0);
-
-        // Decide the state of the direction pins
-        if (desiredState == FORWARD) {
-            GPIO_WRITE(COIL_B_DIR_1_PIN, HIGH);
-            GPIO_WRITE(COIL_B_DIR_2_PIN, LOW);
-        }
-        else if (desiredState == BACKWARD) {
-            GPIO_WRITE(COIL_B_DIR_1_PIN, LOW);
-            GPIO_WRITE(COIL_B_DIR_2_PIN, HIGH);
-        }
-        else if (desiredState == BRAKE) {
-            GPIO_WRITE(COIL_B_DIR_1_PIN, HIGH);
-            GPIO_WRITE(COIL_B_DIR_2_PIN, HIGH);
-        }
-        else if (desiredState == COAST) {
-            GPIO_WRITE(COIL_B_DIR_1_PIN, LOW);
-            GPIO_WRITE(COIL_B_DIR_2_PIN, LOW);
-        }
-
-        // Update the previous state of the coil with the new one
-        previousCoilStateB = desiredState;
-    }
+    // Set the direction, leaving the A coil alone
+    setCoilDirections(this -> previousCoilStateA, desiredState);
 
     // Update the output pin with the correct current
     analogSet(&PWMCurrentPinInfoB, currentToPWM(current));
 }
 
 
-// Calculates the current of each of the coils (with mapping)(current in mA)
-uint32_t StepperMotor::currentToPWM(uint16_t current) const {
+// Sets the direction pins of both coils
+void StepperMotor::setCoilDirections(COIL_STATE desiredStateA, COIL_STATE desiredStateB) {
 
-    // Calculate the value to set the PWM interface to (based on algebraically manipulated equations from the datasheet)
-    uint32_t PWMValue = (CURRENT_SENSE_RESISTOR * PWM_MAX_VALUE * abs(current)) / (BOARD_VOLTAGE * 100);
+    // Collect the pin changes of each of the coils that changed state
+    uint32_t directionBits = 0;
+    if (desiredStateA != previousCoilStateA) {
+        directionBits |= coilADirectionBits[desiredStateA];
+        previousCoilStateA = desiredStateA;
+    }
+    if (desiredStateB != previousCoilStateB) {
+        directionBits |= coilBDirectionBits[desiredStateB];
+        previousCoilStateB = desiredStateB;
+    }
 
-    // Constrain the PWM value, then return it
-    return constrain(PWMValue, 0, PWM_MAX_VALUE);
+    // Set all of the pins at once, so the coils never pass through an in-between state
+    if (directionBits != 0) {
+        this -> coilDirectionPort -> BSRR = directionBits;
+    }
 }
 
 
@@ -655,10 +1163,13 @@ void StepperMotor::setState(MOTOR_STATE newState, bool clearErrors) {
 
                     // Drive the coils the current angle of the shaft (just locks the output in place)
                     driveCoilsAngle(encoder.getRawAngleAvg());
-
-                    // The motor's current angle needs corrected
-                    currentAngle = encoder.getRawAngleAvg();
                     this -> state = ENABLED;
+
+                    // The rotor could have moved while disabled, so the commutation offset has to be measured again
+                    #ifdef ENABLE_ROTOR_COMMUTATION
+                        this -> commutationAligned = false;
+                        this -> leadActive = false;
+                    #endif
                     break;
 
                 // Same as enabled, just forced
@@ -666,10 +1177,13 @@ void StepperMotor::setState(MOTOR_STATE newState, bool clearErrors) {
 
                     // Drive the coils the current angle of the shaft (just locks the output in place)
                     driveCoilsAngle(encoder.getRawAngleAvg());
-
-                    // The motor's current angle needs corrected
-                    currentAngle = encoder.getRawAngleAvg();
                     this -> state = FORCED_ENABLED;
+
+                    // The rotor could have moved while disabled, so the commutation offset has to be measured again
+                    #ifdef ENABLE_ROTOR_COMMUTATION
+                        this -> commutationAligned = false;
+                        this -> leadActive = false;
+                    #endif
                     break;
 
                 // No other special processing needed, just disable the coils and set the state
@@ -692,10 +1206,13 @@ void StepperMotor::setState(MOTOR_STATE newState, bool clearErrors) {
 
                         // Drive the coils the current angle of the shaft (just locks the output in place)
                         driveCoilsAngle(encoder.getRawAngleAvg());
-
-                        // The motor's current angle needs corrected
-                        currentAngle = encoder.getRawAngleAvg();
                         this -> state = ENABLED;
+
+                        // The rotor could have moved while disabled, so the commutation offset has to be measured again
+                        #ifdef ENABLE_ROTOR_COMMUTATION
+                            this -> commutationAligned = false;
+                            this -> leadActive = false;
+                        #endif
                         break;
 
                     // No other special processing needed, just disable the coils and set the state
@@ -737,22 +1254,19 @@ void StepperMotor::calibrate() {
     // Disable the motor timers (the motor needs to be left alone during calibration)
     disableMotorTimers();
 
+    // Build the linearization table first, so the step offset below is measured with it applied
+    #ifdef ENABLE_ENCODER_LINEARIZATION
+        calibrateLinearization();
+    #endif
+
     // Set the coils of the motor to move to step 0 (meaning the separation between full steps)
     driveCoils(0);
 
     // Delay three seconds, giving the motor time to settle
     delay(3000);
 
-    // Force the encoder to be read a couple of times, wiping the previous position out of the average
-    // (this reading needs to be as precise as possible)
-    for (uint8_t readings = 0; readings < (ANGLE_AVG_READINGS * 2); readings++) {
-
-        // Get the angle, then wait for 10ms to allow encoder to update
-        encoder.getRawAngleAvg();
-    }
-
-    // Measure encoder offset
-    float stepOffset = encoder.getRawAngleAvg();
+    // Measure encoder offset (this reading needs to be as precise as possible)
+    float stepOffset = INCREMENTS_TO_DEG((float)encoder.linearize(encoder.getRawIncrementsSettled(ANGLE_AVG_READINGS * 2)));
 
     // Add/subtract the full step angle till the rawStepOffset is within the range of a full step
     while (stepOffset < 0) {
@@ -778,6 +1292,144 @@ void StepperMotor::calibrate() {
     NVIC_SystemReset();
 }
 
+
+#ifdef ENABLE_ENCODER_LINEARIZATION
+// Sweeps every full step in both directions, then builds and saves the encoder linearization table
+// The error at each full step is the difference between the reading and a perfectly even spacing of the steps
+void StepperMotor::calibrateLinearization() {
+
+    // The sweep needs the uncorrected readings
+    encoder.setLinearization(NULL);
+
+    // Full steps in a revolution, and the coil phase change of a full step (a full electrical cycle is 4 full steps)
+    int32_t fullSteps = round(360.0 / (this -> fullStepAngle));
+    int32_t fullStepDrive = SINE_STEPS_PER_FULL_STEP;
+
+    // Storage for the readings of each of the full steps
+    int32_t* readings = new int32_t[fullSteps];
+
+    // Sweep forward, reading each of the full steps
+    for (int32_t step = 0; step < fullSteps; step++) {
+        driveCoils(step * fullStepDrive);
+        delay(LINEARIZATION_SETTLE_TIME);
+        readings[step] = encoder.getRawIncrementsSettled(ANGLE_AVG_READINGS);
+    }
+
+    // Sweep backward, averaging with the forward reading (cancels out the hysteresis and the load angle)
+    for (int32_t step = fullSteps - 1; step >= 0; step--) {
+        driveCoils(step * fullStepDrive);
+        delay(LINEARIZATION_SETTLE_TIME);
+        readings[step] += WRAP_INCREMENTS((int32_t)encoder.getRawIncrementsSettled(ANGLE_AVG_READINGS) - readings[step]) / 2;
+    }
+
+    // Build the table from the readings
+    int16_t table[ENCODER_LINEARIZATION_POINTS];
+    buildLinearizationTable(readings, fullSteps, table);
+
+    // Done with the readings
+    delete[] readings;
+
+    // Save the table, then start using it
+    writeLinearization(table, ENCODER_LINEARIZATION_POINTS);
+    encoder.setLinearization(table);
+}
+#endif
+
+
+// Measures the angle noise and step latency of the encoder at each of the sensor update rates
+// The noise is measured while holding the motor. The latency is the time from driving the coils a full step until the
+// encoder sees half of it. The motor's mechanical response is the same for every rate, so the differences between
+// the latencies come from the sensor
+String StepperMotor::benchmarkEncoder(bool prediction) {
+
+    // The motor needs to be left alone during the benchmark
+    disableMotorTimers();
+
+    // Save the current settings so they can be restored afterwards
+    ENCODER_UPDATE_RATE previousRate = encoder.getUpdateRate();
+    bool previousPrediction = encoder.getPrediction();
+
+    // The size of a full step in coil phase, and half of one in encoder increments
+    int32_t fullStepDrive = SINE_STEPS_PER_FULL_STEP;
+    int32_t halfStepIncrements = DEG_TO_INCREMENTS((this -> fullStepAngle) / 2);
+
+    // Hold the motor where it is
+    driveCoils(this -> currentStep);
+
+    // Benchmark each of the rates
+    String results;
+    for (uint8_t rate = UPDATE_RATE_21US; rate <= UPDATE_RATE_171US; rate++) {
+
+        // Configure the sensor, skipping the rate if the sensor doesn't take it
+        if ((encoder.setUpdateRate((ENCODER_UPDATE_RATE)rate) != NO_ERROR) || (encoder.setPrediction(prediction) != NO_ERROR)) {
+            results += "R: " + String(rate) + " | Not accepted by the encoder\n";
+            continue;
+        }
+        delay(ENCODER_BENCHMARK_SETTLE_TIME);
+
+        // Take the noise readings, one per sensor update (relative to the first reading, so the wrap can't interfere)
+        uint32_t samplePeriod = ceil(encoder.getUpdatePeriod());
+        int32_t firstReading = encoder.getRawIncrements();
+        int32_t minDifference = 0;
+        int32_t maxDifference = 0;
+        int64_t totalDifference = 0;
+        int64_t totalSquaredDifference = 0;
+        for (uint16_t sample = 0; sample < ENCODER_BENCHMARK_SAMPLES; sample++) {
+            delayMicroseconds(samplePeriod);
+            int32_t difference = WRAP_INCREMENTS((int32_t)encoder.getRawIncrements() - firstReading);
+            minDifference = min(minDifference, difference);
+            maxDifference = max(maxDifference, difference);
+            totalDifference += difference;
+            totalSquaredDifference += difference * difference;
+        }
+
+        // Standard deviation of the readings (increments)
+        double mean = (double)totalDifference / ENCODER_BENCHMARK_SAMPLES;
+        double noise = sqrt(max(0.0, ((double)totalSquaredDifference / ENCODER_BENCHMARK_SAMPLES) - (mean * mean)));
+
+        // Step forward and back, timing how long the encoder takes to see half of each step
+        uint32_t totalLatency = 0;
+        uint16_t seenSteps = 0;
+        for (uint16_t step = 0; step < ENCODER_BENCHMARK_STEPS; step++) {
+
+            // Drive the coils to the next step
+            int32_t startReading = encoder.getRawIncrements();
+            uint32_t startTime = cycleCount();
+            driveCoils((this -> currentStep) + ((step % 2 == 0) ? fullStepDrive : 0));
+
+            // Wait for the encoder to see the step
+            while ((uint32_t)(cycleCount() - startTime) < microsToCycles(ENCODER_BENCHMARK_TIMEOUT)) {
+                if (abs(WRAP_INCREMENTS((int32_t)encoder.getRawIncrements() - startReading)) >= halfStepIncrements) {
+                    totalLatency += cyclesToMicros(cycleCount() - startTime);
+                    seenSteps++;
+                    break;
+                }
+            }
+
+            // Let the motor settle before the next step
+            delay(ENCODER_BENCHMARK_SETTLE_TIME);
+        }
+
+        // Add the results of the rate
+        results += "R: " + String(rate) + " (" + String(encoder.getUpdatePeriod()) + "us) | P: " + String(prediction) + " | NOISE: " + String(noise) + " RMS, " + String(maxDifference - minDifference) + " P-P | LATENCY: ";
+        if (seenSteps > 0) {
+            results += String(totalLatency / seenSteps) + "us\n";
+        }
+        else {
+            results += "Steps not seen\n";
+        }
+    }
+
+    // Restore the previous settings, then give the motor back
+    encoder.setUpdateRate(previousRate);
+    encoder.setPrediction(previousPrediction);
+    enableMotorTimers();
+
+    // Return the results
+    return results;
+}
+
+
 // Returns -1 if the number is less than 0, 1 otherwise
 int32_t StepperMotor::getSign(float num) {
     if (num < 0) {
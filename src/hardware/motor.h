@@ -12,6 +12,8 @@
 //#include "cmath"
 //#include <math.h>
 #include "fastSine.h"
+#include "coilPWM.h"
+#include "servoOutput.h"
 
 // Import the pin mapping
 #include "config.h"
@@ -19,6 +21,11 @@
 // Maximum value for timer counters
 #define TIM_MAX_VALUE (uint16_t)65535
 
+
+// The desired position only moves in whole steps, so the step input's velocity and acceleration are low pass filtered
+// (each update moves 1/2^BITS of the way)
+#define STEP_RATE_FILTER_BITS 4
+
 // Enumeration for coil states
 typedef enum {
     COIL_NOT_SET,
@@ -83,6 +90,9 @@ class StepperMotor {
         // Returns the desired angle of the motor
         float getDesiredAngle();
 
+        // Returns the desired position of the motor (in encoder increments)
+        int32_t getDesiredPosition();
+
         // Returns the desired step of the motor
         int32_t getSoftStepCNT();
 
@@ -92,9 +102,43 @@ class StepperMotor {
         // Returns the count according to the TIM2 hardware step counter
         int32_t getHardStepCNT() const;
 
+        // Hardware step counting
+        #ifdef ENABLE_HARDWARE_STEP_COUNTING
+
+            // Moves the coils by the steps counted by TIM2 since the last update, returning the number of steps counted
+            int16_t followStepCounter();
+
+            // Sets the counting direction of TIM2 from the direction pin (called when the pin changes)
+            void updateStepCounterDirection();
+
+            // Drops any steps counted since the last update (used when the steps shouldn't be followed)
+            void syncStepCounter();
+        #endif
+
         // Sets the count for the TIM2 hardware step counter
         void setHardStepCNT(int32_t newCNT);
 
+        // Step interpolation
+        #ifdef ENABLE_STEP_INTERPOLATION
+
+            // Moves the coils to the next interpolated position of the last step (called at STEP_INTERPOLATION_FREQ)
+            void interpolateStep();
+        #endif
+
+        // Step rate estimate
+        #ifdef ENABLE_STEP_RATE_ESTIMATE
+
+            // Measures the velocity and acceleration of the step input from the change in the desired position
+            // (called on every control loop update)
+            void updateStepRate();
+
+            // Gets the velocity of the step input (increments/s)
+            int32_t getStepVelocity() const;
+
+            // Gets the acceleration of the step input (increments/s^2)
+            int32_t getStepAccel() const;
+        #endif
+
         // Dynamic current
         #ifdef ENABLE_DYNAMIC_CURRENT
 
@@ -116,6 +160,23 @@ class StepperMotor {
         // Sets the max current factor for dynamic current
         void setDynamicMaxCurrent(uint16_t newMaxCurrent);
 
+        // Computes the dynamic current from the estimated acceleration and tracking error, then publishes it to the coils
+        // Called from the correction, never from the step path
+        void updateDynamicCurrent();
+
+        // Gets the current that the dynamic current is set to (RMS, in mA)
+        uint16_t getDynamicCurrent() const;
+
+        // Current feedforward from the step input's acceleration
+        #ifdef ENABLE_STEP_FEEDFORWARD
+
+            // Gets the current feedforward (mA per 1000 deg/s^2)
+            uint16_t getCurrentFeedforward() const;
+
+            // Sets the current feedforward (mA per 1000 deg/s^2)
+            void setCurrentFeedforward(uint16_t newCurrentFeedforward);
+        #endif
+
         #else // ! ENABLE_DYNAMIC_CURRENT
 
         // Gets the RMS current of the motor (in mA)
@@ -132,6 +193,28 @@ class StepperMotor {
         #endif
 
 
+        // Standstill current reduction
+        #ifdef ENABLE_STANDSTILL_REDUCTION
+
+            // Gets the time (ms) without steps before the current is reduced (0 is disabled)
+            uint16_t getStandstillDelay() const;
+
+            // Sets the time (ms) without steps before the current is reduced (0 disables the reduction)
+            void setStandstillDelay(uint16_t delay);
+
+            // Gets the holding current (percent of the full current)
+            uint8_t getStandstillCurrent() const;
+
+            // Sets the holding current (percent of the full current)
+            void setStandstillCurrent(uint8_t percent);
+
+            // Checks if the motor is standing still, ramping the current down if so (called from the correction)
+            void updateStandstill();
+
+            // Gets if the current is reduced
+            bool getStandstillActive() const;
+        #endif
+
         // Gets the microstepping mode of the motor
         uint16_t getMicrostepping() const;
 
@@ -163,33 +246,70 @@ class StepperMotor {
         // Get if the motor enable pin is inverted
         bool getEnableInversion() const;
 
-        // Set the microstep multiplier
+        // Set the microstep multiplier (converted to the closest gearing ratio)
         void setMicrostepMultiplier(float newMultiplier);
 
-        // Get the microstep multiplier
+        // Get the microstep multiplier (the gearing ratio as a decimal)
         float getMicrostepMultiplier() const;
 
+        // Sets the microstep gearing ratio (numerator / denominator microsteps per step pulse). Zeros are ignored
+        void setMicrostepGearing(uint16_t numerator, uint16_t denominator);
+
+        // Gets the numerator of the microstep gearing ratio
+        uint16_t getMicrostepGearNumerator() const;
+
+        // Gets the denominator of the microstep gearing ratio
+        uint16_t getMicrostepGearDenominator() const;
+
         // Test
         void simpleStep();
 
         // Calculates the coil values for the motor and updates the set angle.
         void step(STEP_DIR dir = PIN, bool useMultiplier = true, bool updateDesiredPos = true);
 
-        // Sets the coils to hold the motor at the desired step number
-        void driveCoils(int32_t steps);
+        // Sets the coils to hold the motor at the desired phase (SINE_STEPS per electrical cycle)
+        // The current can be scaled down (CURRENT_SCALE_MAX is the full current), on top of the scale set by the control task
+        void driveCoils(int32_t phase, uint32_t outputScale = CURRENT_SCALE_MAX);
 
         // Sets the coils to hold the motor at the desired phase angle
         void driveCoilsAngle(float angle);
 
+        // Timing of the coil updates
+        #ifdef CHECK_DRIVE_COILS_TIME
+
+            // Gets the CPU cycles taken by the last driveCoils() call
+            uint32_t getDriveCoilsCycles() const;
+
+            // Gets the most CPU cycles that a driveCoils() call has taken
+            uint32_t getDriveCoilsMaxCycles() const;
+
+            // Clears the most cycles taken by a driveCoils() call
+            void resetDriveCoilsMaxCycles();
+        #endif
+
+        // Closed loop commutation
+        #ifdef ENABLE_ROTOR_COMMUTATION
+
+            // Holds the rotor where it is after driving ahead of it (the first call after enabling measures the commutation offset)
+            void holdRotor();
+        #endif
+
+        #ifdef ENABLE_PHASE_LEAD
+            // Drives the coils ahead of the measured rotor angle, plus a lead for the speed (direction is 1 or -1)
+            void driveCoilsLead(int32_t direction);
+        #endif
+
+        #ifdef ENABLE_SERVO_OUTPUT
+            // Drives the coils from a PID output, setting the angle ahead of the rotor and the current
+            void driveServo(int32_t output);
+        #endif
+
         // Sets the state of the A coil
         void setCoilA(COIL_STATE desiredState, uint16_t current = 0);
 
         // Sets the state of the B coil
         void setCoilB(COIL_STATE desiredState, uint16_t current = 0);
 
-        // Calculates the correct PWM setting based on an input current
-        uint32_t currentToPWM(uint16_t current) const;
-
         // Sets the current state of the motor
         void setState(MOTOR_STATE newState, bool clearErrors = false);
 
@@ -202,6 +322,14 @@ class StepperMotor {
         // Calibrates the encoder and PID loop
         void calibrate();
 
+        // Builds and saves the encoder linearization table (part of the calibration)
+        #ifdef ENABLE_ENCODER_LINEARIZATION
+            void calibrateLinearization();
+        #endif
+
+        // Measures the angle noise and step latency of the encoder at each of the sensor update rates
+        String benchmarkEncoder(bool prediction);
+
         // Encoder object
         Encoder encoder;
 
@@ -215,23 +343,87 @@ class StepperMotor {
         // Function for getting the sign of the number (returns -1 if number is less than 0, 1 if 0 or above)
         int32_t getSign(float num);
 
-        // Keeps the desired angle of the motor
-        float desiredAngle = 0;
+        // Converts an encoder position (in increments) to the nearest microstep
+        int32_t positionToMicrosteps(int32_t position) const;
 
-        // Keeps the desired step of the motor
-        int32_t softStepCNT = 0;
+        // Closed loop commutation
+        #ifdef ENABLE_ROTOR_COMMUTATION
+
+            // Converts the cached encoder position to a coil phase (SINE_STEPS per electrical cycle, without the commutation offset)
+            int32_t rotorPhase() const;
+        #endif
 
-        // Keeps the current angle of the motor
-        float currentAngle = 0;
+        // Sets the direction pins of both coils with a single write (only changed coils are written)
+        void setCoilDirections(COIL_STATE desiredStateA, COIL_STATE desiredStateB);
 
-        // Keeps the current steps of the motor
+        // Rebuilds the PWM table for a peak current (must be called whenever the current changes)
+        void buildPWMTable(uint16_t tablePeakCurrent);
+
+        // Combines the control task's current scales, then publishes them to the coils
+        void publishCurrentScale();
+
+        // Keeps the desired step of the motor (the desired angle is derived from it)
+        int32_t softStepCNT = 0;
+
+        // Keeps the current phase of the motor coils (SINE_STEPS per electrical cycle)
         int32_t currentStep = 0;
 
+        // The last phase that the coils were driven to (not always currentStep, i.e. when enabling)
+        int32_t drivenPhase = 0;
+
+        // Closed loop commutation
+        #ifdef ENABLE_ROTOR_COMMUTATION
+
+            // Difference between the coil phase and the phase from the encoder position (found while holding)
+            int32_t commutationOffset = 0;
+
+            // If the commutation offset has been measured since enabling, and if the coils are being driven ahead of the rotor
+            bool commutationAligned = false;
+            bool leadActive = false;
+        #endif
+
+        // TIM2 count at the last step counter update (the change is taken in 16 bits, so the overflows don't matter)
+        #ifdef ENABLE_HARDWARE_STEP_COUNTING
+            uint16_t lastStepCounterValue = 0;
+        #endif
+
+        // Step interpolation
+        #ifdef ENABLE_STEP_INTERPOLATION
+
+            // Starts moving the coils from their current phase to currentStep over the measured step period
+            void startInterpolation();
+
+            // Time of the last step pulse (cycle count)
+            uint32_t lastStepTime = 0;
+
+            // The phase that the interpolation started from and is moving to
+            int32_t interpolationStart = 0;
+            int32_t interpolationTarget = 0;
+
+            // Distance moved from the start, and the distance moved per update (16.16 fixed point phase)
+            int32_t interpolationOffset = 0;
+            int32_t interpolationIncrement = 0;
+
+            // Updates left until the target is reached (0 when not interpolating)
+            volatile uint32_t interpolationTicks = 0;
+        #endif
+
+        // Step rate estimate
+        #ifdef ENABLE_STEP_RATE_ESTIMATE
+
+            // Desired position of the last update (increments), and the filtered velocity and acceleration of the step input
+            // (increments/s and increments/s^2)
+            int32_t lastStepRatePosition = 0;
+            int32_t stepVelocity = 0;
+            int32_t stepAccel = 0;
+            bool stepRateStarted = false;
+        #endif
+
         #ifdef ENABLE_STEPPING_VELOCITY
             // variables to calculate the stepping interface velocity
             float angleChange = 0.0;
-            uint32_t prevStepingSampleTime = 0; // micros()
-            uint32_t nowStepingSampleTime = 0; // micros()
+            uint32_t prevStepingSampleTime = 0; // cycleCount()
+            uint32_t nowStepingSampleTime = 0; // cycleCount()
             // isStepping == true mean that three variables above can be changed
             bool isStepping = false;
         #endif
@@ -242,6 +434,14 @@ class StepperMotor {
             uint16_t dynamicAccelCurrent = DYNAMIC_ACCEL_CURRENT;
             uint16_t dynamicIdleCurrent = DYNAMIC_IDLE_CURRENT;
             uint16_t dynamicMaxCurrent = DYNAMIC_MAX_CURRENT;
+
+            // The current that the dynamic current is set to (RMS, in mA)
+            uint16_t dynamicCurrent = DYNAMIC_IDLE_CURRENT;
+
+            // Current feedforward (mA per 1000 deg/s^2 of the step input's acceleration)
+            #ifdef ENABLE_STEP_FEEDFORWARD
+                uint16_t currentFeedforward = DEFAULT_CURRENT_FF;
+            #endif
         #else
             // RMS Current (in mA)
             uint16_t rmsCurrent = (uint16_t)STATIC_RMS_CURRENT;
@@ -249,9 +449,45 @@ class StepperMotor {
             uint16_t peakCurrent = (rmsCurrent * 1.414);
         #endif
 
+        // Signed PWM compare values for each entry of the sine table at the peak current (the dynamic max current with dynamic current)
+        // Indexed by electrical phase, so it only needs to be rebuilt when the current changes
+        int16_t pwmTable[SINE_VAL_COUNT];
+
+        // Scale of the coil current, set by the control task (dynamic current and standstill reduction). CURRENT_SCALE_MAX is the full current
+        // Written as a single word, so the step path always sees a complete value
+        volatile uint32_t currentScale = CURRENT_SCALE_MAX;
+
+        // Scale of the current before the standstill reduction (set by the dynamic current)
+        volatile uint32_t baseCurrentScale = CURRENT_SCALE_MAX;
+
+        // CPU cycles taken by the last driveCoils() call, and the most that a call has taken
+        #ifdef CHECK_DRIVE_COILS_TIME
+            volatile uint32_t driveCoilsCycles = 0;
+            volatile uint32_t driveCoilsMaxCycles = 0;
+        #endif
+
+        // Standstill current reduction
+        #ifdef ENABLE_STANDSTILL_REDUCTION
+
+            // Settings
+            uint16_t standstillDelay = STANDSTILL_DELAY;
+            uint8_t standstillCurrent = STANDSTILL_CURRENT;
+
+            // Desired step when the standstill timer was last restarted, and the time it restarted (ms)
+            int32_t standstillStepCNT = 0;
+            uint32_t standstillStartTime = 0;
+
+            // Current scale of the reduction, and if it's active (the step path restores the full current if so)
+            uint32_t standstillScale = CURRENT_SCALE_MAX;
+            volatile bool standstillActive = false;
+        #endif
+
         // Microstepping divisor
         uint16_t microstepDivisor = 1;
 
+        // Coil phase change for each microstep (SINE_STEPS_PER_FULL_STEP / microstepping divisor)
+        int32_t microstepPhase = SINE_STEPS_PER_FULL_STEP / microstepDivisor;
+
         // Angle of a full step
         float fullStepAngle = 1.8;
 
@@ -272,8 +508,22 @@ class StepperMotor {
         // If the motor enable is inverted
         bool enableInverted = false;
 
-        // Microstep multiplier (used to move a custom number of microsteps per step pulse)
-        uint32_t microstepMultiplier = MICROSTEP_MULTIPLIER;
+        // Microstep gearing ratio (used to move a custom number of microsteps per step pulse)
+        uint16_t gearNumerator = MICROSTEP_GEAR_NUMERATOR;
+        uint16_t gearDenominator = MICROSTEP_GEAR_DENOMINATOR;
+
+        // The ratio split into whole microsteps and the fraction left over per pulse (precomputed so the step path only adds)
+        int32_t gearWhole = MICROSTEP_GEAR_NUMERATOR / MICROSTEP_GEAR_DENOMINATOR;
+        int32_t gearRemainder = MICROSTEP_GEAR_NUMERATOR % MICROSTEP_GEAR_DENOMINATOR;
+
+        // Fraction of a microstep carried between pulses (in 1/gearDenominator microsteps, always 0 to gearDenominator - 1)
+        int32_t gearAccumulator = 0;
+
+        // Converts a single step pulse to microsteps, carrying the fraction to the next pulse (direction is 1 or -1)
+        int32_t gearStep(int32_t direction);
+
+        // Converts a number of step pulses to microsteps, carrying the fraction to the next pulses
+        int32_t gearSteps(int32_t pulses);
 
         // Analog info structures for PWM current pins
         analogInfo PWMCurrentPinInfoA;
@@ -283,6 +533,9 @@ class StepperMotor {
         COIL_STATE previousCoilStateA = COIL_NOT_SET;
         COIL_STATE previousCoilStateB = COIL_NOT_SET;
 
+        // Port of the coil direction pins
+        GPIO_TypeDef *coilDirectionPort;
+
         // Configuration for TIM2
         TIM_HandleTypeDef tim2Config;
         TIM_ClockConfigTypeDef tim2ClkConfig;
@@ -5,7 +5,7 @@
 #pragma GCC optimize ("-Ofast")
 
 // Timer uses:
-// - TIM1 - Used to time correction calculations
+// - TIM1 - Used to time the control loop at CONTROL_UPDATE_FREQ (and the coil updates if ENABLE_HARDWARE_STEP_COUNTING or ENABLE_STEP_INTERPOLATION)
 // - TIM2 - Used to count steps (stores master record of steps)
 // - TIM3 - Used to generate PWM signal for motor
 // - TIM4 - Used to schedule steps for the motor (used by PID and direct stepping)
@@ -13,14 +13,49 @@
 // Create a new timer instance
 HardwareTimer *correctionTimer = new HardwareTimer(TIM1);
 
-// The frequency at which to update the correction timer
-uint32_t correctionUpdateFreq = round(STEP_UPDATE_FREQ * motor.getMicrostepping());
+// The rate that the basic correction steps the motor back into position (steps/s, set by the microstepping)
+uint32_t correctionStepRate = STEP_UPDATE_FREQ * motor.getMicrostepping();
+
+// Accumulates the correction step rate every tick, a correction step is due every time that it passes CONTROL_UPDATE_FREQ
+uint32_t correctionStepAccumulator = 0;
+
+// The correction timer rate. Runs at the coil update rate if the coils are updated at a fixed rate, otherwise at the control rate
+#ifdef ENABLE_FIXED_RATE_COMMUTATION
+    #define CORRECTION_TIMER_FREQ COMMUTATION_UPDATE_FREQ
+#else
+    #define CORRECTION_TIMER_FREQ CONTROL_UPDATE_FREQ
+#endif
+
+// Control loop timing (in CPU cycles). Each tick has to finish within a single period of the correction timer
+uint32_t controlTickBudget = 1;
+uint32_t controlStageCycles[CONTROL_STAGE_COUNT] = { 0 };
+uint32_t controlStageMaxCycles[CONTROL_STAGE_COUNT] = { 0 };
+uint32_t controlTickMaxCycles = 0;
+uint32_t controlTickCount = 0;
+uint32_t controlOverrunCount = 0;
 
 // If step correction is enabled (helps to prevent enabling the timer when it is already enabled)
 bool stepCorrection = false;
 
 // A counter for the number of position faults (used for stall detection)
-uint16_t outOfPosCount = 0;
+uint32_t outOfPosCount = 0;
+
+// The correction timer runs at the coil update rate, so the correction only runs on every few updates
+#ifdef ENABLE_FIXED_RATE_COMMUTATION
+    const uint32_t correctionDivider = COMMUTATION_UPDATE_FREQ / CONTROL_UPDATE_FREQ;
+    uint32_t correctionTicks = 0;
+#endif
+
+// Step counter statistics: the most steps counted in a single coil update, the most cycles that an update took, and the number
+// of updates that went over their period. Also the longest time that the interrupts were blocked for (cycles), as the
+// direction pin's interrupt can't set the counting direction until then
+#ifdef ENABLE_HARDWARE_STEP_COUNTING
+    uint32_t stepCounterPeakSteps = 0;
+    uint32_t commutationMaxCycles = 0;
+    uint32_t commutationOverrunCount = 0;
+    uint32_t interruptBlockStartCycles = 0;
+    uint32_t interruptBlockMaxCycles = 0;
+#endif
 
 // The number of times the current blocks on the interrupts. All blocks must be cleared to allow the interrupts to start again
 // A block count is needed for nested functions. This ensures that function 1 (cannot be interrupted) will not re-enable the
@@ -71,8 +106,9 @@ void setupMotorTimers() {
 
     // Interupts are in order of importance as follows -
     // - 5 - hardware step counter overflow handling
-    // - 6 - step pin change
-    // - 7.0 - position correction (or PID interval update)
+    // - 5 - encoder sample DMA completion (if ENCODER_DMA_SAMPLING)
+    // - 6 - step pin change (direction pin change if ENABLE_HARDWARE_STEP_COUNTING)
+    // - 7.0 - control loop (position correction or PID update)
     // - 7.1 - scheduled steps (if ENABLE_DIRECT_STEPPING or ENABLE_PID)
 
     // Check if StallFault is enabled
@@ -87,22 +123,45 @@ void setupMotorTimers() {
     // Attach the interupt to the step pin (subpriority is set in PlatformIO config file)
     // A normal step pin triggers on the rising edge. However, as explained here: https://github.com/CAP1Sup/Intellistep/pull/50#discussion_r663051004
     // the optocoupler inverts the signal. Therefore, the falling edge is the correct value.
-    attachInterrupt(STEP_PIN, stepMotor, FALLING); // input is pull-upped to VDD
+    // With hardware step counting TIM2 counts the steps, so only the direction needs to be watched
+    #ifdef ENABLE_HARDWARE_STEP_COUNTING
+        attachInterrupt(DIRECTION_PIN, stepDirectionChanged, CHANGE);
+        stepDirectionChanged();
+    #else
+        attachInterrupt(STEP_PIN, stepMotor, FALLING); // input is pull-upped to VDD
+    #endif
 
     // Setup the timer for steps
     correctionTimer -> pause();
     correctionTimer -> setInterruptPriority(7, 0);
     correctionTimer -> setMode(1, TIMER_OUTPUT_COMPARE); // Disables the output, since we only need the timed interrupt
 
-    // Set the update rate and the variable that stores it
-    correctionUpdateFreq = round(STEP_UPDATE_FREQ * motor.getMicrostepping());
-    correctionTimer -> setOverflow(correctionUpdateFreq, HERTZ_FORMAT);
+    // Each control loop tick has to fit in a period of the correction timer
+    controlTickBudget = (cyclesPerMicro * 1000000) / CORRECTION_TIMER_FREQ;
+
+    // Set the correction step rate for the current microstepping
+    updateCorrectionRate();
+    #ifdef ENABLE_FIXED_RATE_COMMUTATION
 
-    // Finish setting up the correction timer
-    #ifndef CHECK_STEPPING_RATE
-        correctionTimer -> attachInterrupt(correctMotor);
+        // The timer runs at the coil update rate, the correction is divided down from it
+        correctionTimer -> setOverflow(COMMUTATION_UPDATE_FREQ, HERTZ_FORMAT);
+        correctionTimer -> attachInterrupt(commutateMotor);
+        correctionTimer -> refresh();
+
+        // The coils always need to follow the steps, so start the timer right away
+        #ifdef ENABLE_HARDWARE_STEP_COUNTING
+            motor.syncStepCounter();
+        #endif
+        correctionTimer -> resume();
+    #else
+        correctionTimer -> setOverflow(CONTROL_UPDATE_FREQ, HERTZ_FORMAT);
+
+        // Finish setting up the correction timer
+        #ifndef CHECK_STEPPING_RATE
+            correctionTimer -> attachInterrupt(correctMotor);
+        #endif
+        correctionTimer -> refresh();
     #endif
-    correctionTimer -> refresh();
 
     // Setup step schedule timer if it is enabled
     #if (defined(ENABLE_DIRECT_STEPPING) || defined(ENABLE_PID))
@@ -120,12 +179,27 @@ void setupMotorTimers() {
 void disableMotorTimers() {
 
     // Detach the step interrupt
-    detachInterrupt(STEP_PIN);
+    #ifdef ENABLE_HARDWARE_STEP_COUNTING
+        detachInterrupt(DIRECTION_PIN);
+    #else
+        detachInterrupt(STEP_PIN);
+    #endif
+
+    // The timer runs even without step correction
+    #ifdef ENABLE_FIXED_RATE_COMMUTATION
+        correctionTimer -> pause();
+        syncInstructions();
+    #endif
 
     // Disable the correctional timer
     if (stepCorrection) {
         correctionTimer -> pause();
         syncInstructions();
+
+        // Nothing will trigger the encoder samples anymore
+        #ifdef ENCODER_DMA_SAMPLING
+            motor.encoder.stopSampling();
+        #endif
     }
 
     // Disable the stepping timer if it is enabled
@@ -139,13 +213,34 @@ void disableMotorTimers() {
 void enableMotorTimers() {
 
     // Attach the step interrupt
-    attachInterrupt(STEP_PIN, stepMotor, FALLING); // input is pull-upped to VDD
+    #ifdef ENABLE_HARDWARE_STEP_COUNTING
+
+        // Steps counted while the timers were disabled are dropped, just like they would be with the step interrupt
+        attachInterrupt(DIRECTION_PIN, stepDirectionChanged, CHANGE);
+        stepDirectionChanged();
+        motor.syncStepCounter();
+    #else
+        attachInterrupt(STEP_PIN, stepMotor, FALLING); // input is pull-upped to VDD
+    #endif
 
     // Enable the correctional timer
     if (stepCorrection) {
+
+        // Start the encoder sampling first, so the first tick has a valid sample
+        #ifdef ENCODER_DMA_SAMPLING
+            motor.encoder.startSampling();
+        #endif
+
+        correctionTimer -> resume();
+        syncInstructions();
+    }
+    #ifdef ENABLE_FIXED_RATE_COMMUTATION
+    else {
+        // The coils still need to follow the steps
         correctionTimer -> resume();
         syncInstructions();
     }
+    #endif
 }
 
 
@@ -156,6 +251,11 @@ void disableInterrupts() {
     if (interruptBlockCount == 0) {
         __disable_irq();
         syncInstructions();
+
+        // Start timing the block
+        #ifdef ENABLE_HARDWARE_STEP_COUNTING
+            interruptBlockStartCycles = cycleCount();
+        #endif
     }
 
    // Add one to the interrupt block counter
@@ -171,6 +271,12 @@ void enableInterrupts() {
 
     // If all of the blocks are gone, then re-enable the interrupts
     if (interruptBlockCount == 0) {
+
+        // Record the time that the interrupts were blocked for
+        #ifdef ENABLE_HARDWARE_STEP_COUNTING
+            interruptBlockMaxCycles = max(interruptBlockMaxCycles, cycleCount() - interruptBlockStartCycles);
+        #endif
+
         __enable_irq();
         syncInstructions();
     }
@@ -182,6 +288,12 @@ void enableStepCorrection() {
 
     // Enable the timer if it isn't already, then set the variable
     if (!stepCorrection) {
+
+        // Start the encoder sampling first, so the first tick has a valid sample
+        #ifdef ENCODER_DMA_SAMPLING
+            motor.encoder.startSampling();
+        #endif
+
         correctionTimer -> resume();
         stepCorrection = true;
         syncInstructions();
@@ -195,12 +307,19 @@ void disableStepCorrection() {
     // Check if the timer is disabled
     if (stepCorrection) {
 
-        // Disable the timer
-        correctionTimer -> pause();
+        // Disable the timer (it keeps running for the coil updates with hardware step counting or step interpolation)
+        #ifndef ENABLE_FIXED_RATE_COMMUTATION
+            correctionTimer -> pause();
+        #endif
 
         // Set that there will be no more step correction
         stepCorrection = false;
         syncInstructions();
+
+        // Nothing will trigger the encoder samples anymore, go back to blocking reads
+        #ifdef ENCODER_DMA_SAMPLING
+            motor.encoder.stopSampling();
+        #endif
     }
 
     // Disable the stepping timer if needed
@@ -210,25 +329,9 @@ void disableStepCorrection() {
 }
 
 
-// Set the speed of the step correction timer
-void updateCorrectionTimer() {
-
-    // Check the previous value of the timer, only changing if it is different
-    if (correctionUpdateFreq != (uint32_t)round(STEP_UPDATE_FREQ * (uint32_t)motor.getMicrostepping())) {
-
-        // Compute the new freq, then set it
-        correctionUpdateFreq = (uint32_t)round(STEP_UPDATE_FREQ * motor.getMicrostepping());
-        correctionTimer -> setOverflow(correctionUpdateFreq, HERTZ_FORMAT);
-
-        // Refresh the timer, then enable it if step correction is enabled
-        correctionTimer -> refresh();
-        if (stepCorrection) {
-            correctionTimer -> resume();
-        }
-
-        // Sync the instruction barrier
-        syncInstructions();
-    }
+// Update the rate of the correction steps (the control loop rate is fixed, only the step rate follows the microstepping)
+void updateCorrectionRate() {
+    correctionStepRate = STEP_UPDATE_FREQ * motor.getMicrostepping();
 }
 
 
@@ -248,14 +351,204 @@ void stepMotor() {
 }
 
 
-// Need to declare a function to power the motor coils for the step interrupt
+// Fixed rate coil updates
+#ifdef ENABLE_FIXED_RATE_COMMUTATION
+// Moves the coils to the hardware step count (or along the interpolated step), then runs the correction if it's due
+void commutateMotor() {
+
+    #ifdef CHECK_STEPPING_RATE
+        GPIO_WRITE(LED_PIN, HIGH);
+    #endif
+
+    // Move the coils by the counted steps, or to the next interpolated position
+    #ifdef ENABLE_HARDWARE_STEP_COUNTING
+        uint32_t updateStartCycles = cycleCount();
+        stepCounterPeakSteps = max(stepCounterPeakSteps, (uint32_t)abs(motor.followStepCounter()));
+    #else
+        motor.interpolateStep();
+    #endif
+
+    #ifdef CHECK_STEPPING_RATE
+        GPIO_WRITE(LED_PIN, LOW);
+    #endif
+
+    // Run the correction at its own rate
+    if (stepCorrection) {
+        correctionTicks++;
+        if (correctionTicks >= correctionDivider) {
+            correctionTicks = 0;
+            correctMotor();
+        }
+    }
+
+    // Check if the whole update (with the correction) fit in its period
+    #ifdef ENABLE_HARDWARE_STEP_COUNTING
+        uint32_t updateCycles = cycleCount() - updateStartCycles;
+        commutationMaxCycles = max(commutationMaxCycles, updateCycles);
+        if (updateCycles > controlTickBudget) {
+            commutationOverrunCount++;
+        }
+    #endif
+}
+#endif // ! ENABLE_FIXED_RATE_COMMUTATION
+
+
+// Hardware step counting
+#ifdef ENABLE_HARDWARE_STEP_COUNTING
+// Updates the step counting direction
+void stepDirectionChanged() {
+    motor.updateStepCounterDirection();
+}
+
+
+// Returns the step counter statistics as a string
+String getStepCounterReport() {
+
+    // Copy the values first, so they're all from the same update
+    disableInterrupts();
+    uint32_t peakSteps = stepCounterPeakSteps;
+    uint32_t maxCycles = commutationMaxCycles;
+    uint32_t overrunCount = commutationOverrunCount;
+    uint32_t blockCycles = interruptBlockMaxCycles;
+    enableInterrupts();
+
+    // The peak is the most steps in an update, and the rate that it's equal to. The block is the shortest direction setup time
+    // that the counting can take, the configured one has to be longer
+    return "Peak: " + String(peakSteps) + " steps/update (" + String(peakSteps * STEP_COUNTER_UPDATE_FREQ) + " steps/s) | Max: " +
+        String(maxCycles) + " (" + String((maxCycles * 100) / controlTickBudget) + "%) | Overruns: " + String(overrunCount) +
+        " | Block: " + String(cyclesToMicros(blockCycles)) + "us (setup " + String(STEP_COUNTER_DIR_SETUP_TIME) + "us)";
+}
+
+
+// Clears the step counter statistics
+void resetStepCounterStats() {
+    disableInterrupts();
+    stepCounterPeakSteps = 0;
+    commutationMaxCycles = 0;
+    commutationOverrunCount = 0;
+    enableInterrupts();
+
+    // The block that was just used to clear the stats is counted again, so clear the max last
+    interruptBlockMaxCycles = 0;
+}
+#endif // ! ENABLE_HARDWARE_STEP_COUNTING
+
+
+// Runs a single tick of the control loop. The stages always run in the same order:
+// acquire (encoder sample, enable pin) -> estimate (motor state, current, position error) -> control (correction) -> output (coils, step timer, StallFault)
 void correctMotor() {
     #ifdef CHECK_CORRECT_MOTOR_RATE
         GPIO_WRITE(LED_PIN, HIGH);
     #endif
 
+    // Start timing the tick
+    uint32_t tickStartCycles = cycleCount();
+    uint32_t stageStartCycles = tickStartCycles;
+
+    // ! Acquire
+    // Acquire this tick's encoder sample (everything below uses the cached one)
+    motor.encoder.updateCache();
+
     // Check to see the state of the enable pin
-    if ((GPIO_READ(ENABLE_PIN) != motor.getEnableInversion()) && (motor.getState() != FORCED_ENABLED)) {
+    bool motorEnabled = (GPIO_READ(ENABLE_PIN) == motor.getEnableInversion()) || (motor.getState() == FORCED_ENABLED);
+    endControlStage(ACQUIRE_STAGE, stageStartCycles);
+
+    // ! Estimate
+    // Measure the step input's velocity and acceleration (even while disabled, so it's settled once the motor is enabled)
+    #ifdef ENABLE_STEP_RATE_ESTIMATE
+        motor.updateStepRate();
+    #endif
+
+    int32_t stepDeviation = 0;
+    if (motorEnabled) {
+
+        // Enable the motor if it's not already (just energizes the coils to hold it in position)
+        motor.setState(ENABLED);
+
+        // Update the current for the next coil updates
+        #ifdef ENABLE_DYNAMIC_CURRENT
+            motor.updateDynamicCurrent();
+        #endif
+        #ifdef ENABLE_STANDSTILL_REDUCTION
+            motor.updateStandstill();
+        #endif
+
+        // Get the angular deviation
+        stepDeviation = motor.getStepError();
+    }
+
+    // Check to make sure that the motor is in range (it hasn't skipped steps)
+    bool outOfPosition = motorEnabled && (abs(stepDeviation) > 1);
+    endControlStage(ESTIMATE_STAGE, stageStartCycles);
+
+    // ! Control
+    #if defined(ENABLE_SERVO_OUTPUT)
+
+        // The servo output runs on every update, even in position (holds the rotor and keeps the I term running)
+        int32_t pidOutput = 0;
+        if (motorEnabled) {
+            pidOutput = pid.compute();
+        }
+
+    #elif defined(ENABLE_CASCADED_CONTROL)
+
+        // Like the PID, the cascaded control only runs out of position (its output isn't used in position, so the velocity
+        // integral would wind up). It starts fresh every time that the motor is enabled
+        int32_t pidOutput = 0;
+        if (outOfPosition) {
+            pidOutput = pid.compute();
+        }
+        else if (!motorEnabled) {
+            pid.reset();
+        }
+
+    #elif defined(ENABLE_PID)
+
+        // Run the PID calcalations
+        int32_t pidOutput = 0;
+        if (outOfPosition) {
+            pidOutput = pid.compute();
+        }
+
+    #elif !defined(ENABLE_PHASE_LEAD)
+
+        // The correction steps at its own rate (set by the microstepping), so it moves the same distance per second at every microstep setting
+        // The rate is accumulated each tick, a step is due every time it passes the tick rate
+        uint32_t correctionSteps = 0;
+        if (outOfPosition) {
+            correctionStepAccumulator += correctionStepRate;
+            correctionSteps = min(correctionStepAccumulator / CONTROL_UPDATE_FREQ, (uint32_t)(abs(stepDeviation) - 1));
+            correctionStepAccumulator -= correctionSteps * CONTROL_UPDATE_FREQ;
+            correctionStepAccumulator = min(correctionStepAccumulator, CONTROL_UPDATE_FREQ);
+        }
+        else {
+            // Step right away on the first tick out of position
+            correctionStepAccumulator = CONTROL_UPDATE_FREQ - min(correctionStepRate, CONTROL_UPDATE_FREQ);
+        }
+    #endif
+
+    // While the autotune is running, its relay replaces the controller (it drives the motor even in position)
+    #ifdef ENABLE_PID_AUTOTUNE
+        if (getAutotuneState() == AUTOTUNE_RUNNING) {
+            if (motorEnabled) {
+                pidOutput = updateAutotune();
+                outOfPosition = true;
+            }
+            else {
+                stopAutotune();
+            }
+
+            // The controller starts fresh once the relay is done, and the relay moving the motor isn't a fault
+            pid.reset();
+            #ifdef ENABLE_STALLFAULT
+                outOfPosCount = 0;
+            #endif
+        }
+    #endif
+    endControlStage(CONTROL_STAGE, stageStartCycles);
+
+    // ! Output
+    if (!motorEnabled) {
 
         // The enable pin is off, the motor should be disabled
         motor.setState(DISABLED);
@@ -273,163 +566,246 @@ void correctMotor() {
             GPIO_WRITE(LED_PIN, LOW);
         #endif
     }
-    else {
+    else if (outOfPosition) {
 
-        // Enable the motor if it's not already (just energizes the coils to hold it in position)
-        motor.setState(ENABLED);
+        // Run PID stepping if enabled
+        #if defined(ENABLE_SERVO_OUTPUT)
 
-        // Get the angular deviation
-        int32_t stepDeviation = motor.getStepError();
+            // Drive the coils directly from the PID output
+            motor.driveServo(pidOutput);
 
-        // Check to make sure that the motor is in range (it hasn't skipped steps)
-        if (abs(stepDeviation) > 1) {
+        #elif defined(ENABLE_PID)
 
-            // Run PID stepping if enabled
-            #ifdef ENABLE_PID
+            // Find the step rate from the output
+            uint32_t stepFreq = abs(pidOutput); //(DEFAULT_PID_STEP_MAX - abs(pidOutput));
 
-                // Run the PID calcalations
-                int32_t pidOutput = round(pid.compute());
-                uint32_t stepFreq = abs(pidOutput); //(DEFAULT_PID_STEP_MAX - abs(pidOutput));
+            // Check if the value is 0 (meaning that the timer needs disabled)
+            if (stepFreq == 0) {
 
-                // Check if the value is 0 (meaning that the timer needs disabled)
-                if (stepFreq == 0) {
-
-                    // The timer needs disabled
-                    disableStepScheduleTimer();
+                // The timer needs disabled
+                disableStepScheduleTimer();
+            }
+            else {
+                // Set the direction
+                if (pidOutput > 0) {
+                    scheduledStepDir = COUNTER_CLOCKWISE;
                 }
                 else {
-                    // Set the direction
-                    if (pidOutput > 0) {
-                        scheduledStepDir = COUNTER_CLOCKWISE;
-                    }
-                    else {
-                        scheduledStepDir = CLOCKWISE;
-                    }
-
-                    // Set that we don't want to decrement the counter
-                    decrementRemainingSteps = false;
-
-                    // Check if there's a movement threshold
-                    #if (DEFAULT_PID_DISABLE_THRESHOLD > 0)
+                    scheduledStepDir = CLOCKWISE;
+                }
 
-                        // Check to make sure that the movement threshold is exceeded, otherwise disable the motor
-                        if (stepFreq > DEFAULT_PID_DISABLE_THRESHOLD) {
+                // Set that we don't want to decrement the counter
+                decrementRemainingSteps = false;
 
-                            // Set the speed
-                            stepScheduleTimer -> setOverflow(stepFreq, HERTZ_FORMAT);
+                // Check if there's a movement threshold
+                #if (DEFAULT_PID_DISABLE_THRESHOLD > 0)
 
-                            // Enable the timer if it isn't already
-                            enableStepScheduleTimer();
+                    // Check to make sure that the movement threshold is exceeded, otherwise disable the motor
+                    if (stepFreq > DEFAULT_PID_DISABLE_THRESHOLD) {
 
-                            // Enable the motor
-                            motor.setState(ENABLED);
-                        }
-                        else {
-                            // No correction needed, pause the timer
-                            disableStepScheduleTimer();
-                            motor.setState(DISABLED);
-                        }
-                    #else
-                        // Set the motor timer to call the stepping routine at specified time intervals
+                        // Set the speed
                         stepScheduleTimer -> setOverflow(stepFreq, HERTZ_FORMAT);
 
                         // Enable the timer if it isn't already
                         enableStepScheduleTimer();
-                    #endif
-                }
-
-            #else // ! ENABLE_PID
-                // Just "dumb" correction based on direction
-                // Set the stepper to move in the correct direction
-                if (/*motor.getStepPhase() != */ true) {
-                    if (stepDeviation > 0) {
 
-                        // Motor is at a position larger than the desired one
-                        // Use the current angle to find the current step, then subtract 1
-                        motor.step(CLOCKWISE, false, false);
-                        //motor.driveCoils(round(getAbsoluteAngle() / (motor.getMicrostepAngle()) - (motor.getMicrostepping())));
+                        // Enable the motor
+                        motor.setState(ENABLED);
                     }
                     else {
-                        // Motor is at a position smaller than the desired one
-                        // Use the current angle to find the current step, then add 1
-                        motor.step(COUNTER_CLOCKWISE, false, false);
-                        //motor.driveCoils(round(getAbsoluteAngle() / (motor.getMicrostepAngle()) + (motor.getMicrostepping())));
+                        // No correction needed, pause the timer
+                        disableStepScheduleTimer();
+                        motor.setState(DISABLED);
                     }
-                }
-            #endif // ! ENABLE_PID
+                #else
+                    // Set the motor timer to call the stepping routine at specified time intervals
+                    stepScheduleTimer -> setOverflow(stepFreq, HERTZ_FORMAT);
 
+                    // Enable the timer if it isn't already
+                    enableStepScheduleTimer();
+                #endif
+            }
 
-            // Only use StallFault code if needed
-            #ifdef ENABLE_STALLFAULT
+        #elif defined(ENABLE_PHASE_LEAD)
 
-                // Check to see if the out of position faults have exceeded the maximum amounts
-                if (outOfPosCount > (STEP_FAULT_TIME * ((STEP_UPDATE_FREQ * motor.getMicrostepping()) - 1)) || abs(stepDeviation) > STEP_FAULT_STEP_COUNT) {
-
-                    // Setup the StallFault pin if it isn't already
-                    // We need to wait for a fault because otherwise the programmer will be unable to program the board
-                    #ifdef STALLFAULT_PIN
-                    if (!stallFaultPinSetup) {
-
-                        // Setup the StallFault pin
-                        LL_GPIO_InitTypeDef GPIO_InitStruct;
-                        GPIO_InitStruct.Pin = STM_LL_GPIO_PIN(STALLFAULT_PIN);
-                        GPIO_InitStruct.Mode = LL_GPIO_MODE_OUTPUT;
-                        GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_HIGH;
-                        GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
-                        GPIO_InitStruct.Pull = LL_GPIO_PULL_UP;
-                        LL_GPIO_Init(get_GPIO_Port(STM_PORT(STALLFAULT_PIN)), &GPIO_InitStruct);
-
-                        // The StallFault pin is all set up
-                        stallFaultPinSetup = true;
-                    }
+            // Drive the coils ahead of the rotor, toward the desired position
+            motor.driveCoilsLead((stepDeviation > 0) ? -1 : 1);
 
-                    // The maximum count has been exceeded, trigger an endstop pulse
-                    GPIO_WRITE(STALLFAULT_PIN, HIGH);
-                    #endif
+        #else // ! ENABLE_PID
+            // Just "dumb" correction based on direction
+            // Set the stepper to move in the correct direction
+            for (uint32_t correctionStep = 0; correctionStep < correctionSteps; correctionStep++) {
+                if (stepDeviation > 0) {
 
-                    // Also give an indicator on the LED
-                    GPIO_WRITE(LED_PIN, HIGH);
+                    // Motor is at a position larger than the desired one
+                    // Use the current angle to find the current step, then subtract 1
+                    motor.step(CLOCKWISE, false, false);
                 }
                 else {
-                    // Just count up, motor is out of position but not out of faults
-                    outOfPosCount++;
+                    // Motor is at a position smaller than the desired one
+                    // Use the current angle to find the current step, then add 1
+                    motor.step(COUNTER_CLOCKWISE, false, false);
                 }
-            #endif
-        }
-        else { // Motor is in correct position
+            }
+        #endif // ! ENABLE_PID
 
-            // Disable the PID correction timer if PID is enabled
-            #ifdef ENABLE_PID
-                disableStepScheduleTimer();
-            #endif
 
-            // Only if StallFault is enabled
-            #ifdef ENABLE_STALLFAULT
+        // Only use StallFault code if needed
+        #ifdef ENABLE_STALLFAULT
 
-            // Reset the out of position count and the StallFault pin
-            outOfPosCount = 0;
+            // Check to see if the out of position faults have exceeded the maximum amounts
+            if (outOfPosCount > (STEP_FAULT_TIME * CONTROL_UPDATE_FREQ) || abs(stepDeviation) > STEP_FAULT_STEP_COUNT) {
+
+                // Setup the StallFault pin if it isn't already
+                // We need to wait for a fault because otherwise the programmer will be unable to program the board
+                #ifdef STALLFAULT_PIN
+                if (!stallFaultPinSetup) {
+
+                    // Setup the StallFault pin
+                    LL_GPIO_InitTypeDef GPIO_InitStruct;
+                    GPIO_InitStruct.Pin = STM_LL_GPIO_PIN(STALLFAULT_PIN);
+                    GPIO_InitStruct.Mode = LL_GPIO_MODE_OUTPUT;
+                    GPIO_InitStruct.Speed = LL_GPIO_SPEED_FREQ_HIGH;
+                    GPIO_InitStruct.OutputType = LL_GPIO_OUTPUT_PUSHPULL;
+                    GPIO_InitStruct.Pull = LL_GPIO_PULL_UP;
+                    LL_GPIO_Init(get_GPIO_Port(STM_PORT(STALLFAULT_PIN)), &GPIO_InitStruct);
+
+                    // The StallFault pin is all set up
+                    stallFaultPinSetup = true;
+                }
 
-            // Pull the StallFault low if it's setup
-            // No need to check the validity of the pin here, it wouldn't be setup if it wasn't valid
-            #ifdef STALLFAULT_PIN
-            if (stallFaultPinSetup) {
-                GPIO_WRITE(STALLFAULT_PIN, LOW);
+                // The maximum count has been exceeded, trigger an endstop pulse
+                GPIO_WRITE(STALLFAULT_PIN, HIGH);
+                #endif
+
+                // Also give an indicator on the LED
+                GPIO_WRITE(LED_PIN, HIGH);
             }
-            #endif
+            else {
+                // Just count up, motor is out of position but not out of faults
+                outOfPosCount++;
+            }
+        #endif
+    }
+    else { // Motor is in correct position
 
-            // Also toggle the LED for visual purposes
-            GPIO_WRITE(LED_PIN, LOW);
+        // Disable the PID correction timer if PID is enabled
+        #ifdef ENABLE_PID
+            disableStepScheduleTimer();
+        #endif
 
-            #endif // ! ENABLE_STALLFAULT
+        // Stop driving ahead of the rotor
+        #ifdef ENABLE_PHASE_LEAD
+            motor.holdRotor();
+        #endif
+
+        // The servo output runs on every update, even in position (holds the rotor and keeps the I term running)
+        #ifdef ENABLE_SERVO_OUTPUT
+            motor.driveServo(pidOutput);
+        #endif
+
+        // Only if StallFault is enabled
+        #ifdef ENABLE_STALLFAULT
+
+        // Reset the out of position count and the StallFault pin
+        outOfPosCount = 0;
+
+        // Pull the StallFault low if it's setup
+        // No need to check the validity of the pin here, it wouldn't be setup if it wasn't valid
+        #ifdef STALLFAULT_PIN
+        if (stallFaultPinSetup) {
+            GPIO_WRITE(STALLFAULT_PIN, LOW);
         }
+        #endif
+
+        // Also toggle the LED for visual purposes
+        GPIO_WRITE(LED_PIN, LOW);
 
+        #endif // ! ENABLE_STALLFAULT
     }
+
+    // Start reading the next encoder sample in the background, it will be ready for the next tick
+    #ifdef ENCODER_DMA_SAMPLING
+        motor.encoder.triggerSample();
+    #endif
+    endControlStage(OUTPUT_STAGE, stageStartCycles);
+
+    // Check if the whole tick fit in its period
+    uint32_t tickCycles = stageStartCycles - tickStartCycles;
+    controlTickCount++;
+    controlTickMaxCycles = max(controlTickMaxCycles, tickCycles);
+    if (tickCycles > controlTickBudget) {
+        controlOverrunCount++;
+    }
+
     #ifdef CHECK_CORRECT_MOTOR_RATE
         GPIO_WRITE(LED_PIN, LOW);
     #endif
 }
 
 
+// Records the cycles taken by a stage of the control loop, then starts timing the next one
+void endControlStage(CONTROL_LOOP_STAGE stage, uint32_t &stageStartCycles) {
+    uint32_t stageEndCycles = cycleCount();
+    controlStageCycles[stage] = stageEndCycles - stageStartCycles;
+    controlStageMaxCycles[stage] = max(controlStageMaxCycles[stage], controlStageCycles[stage]);
+    stageStartCycles = stageEndCycles;
+}
+
+
+// Returns the timing of the control loop stages as a string
+String getControlLoopReport() {
+
+    // Copy the values first, so they're all from the same tick
+    disableInterrupts();
+    uint32_t stageCycles[CONTROL_STAGE_COUNT];
+    uint32_t stageMaxCycles[CONTROL_STAGE_COUNT];
+    for (uint8_t stage = 0; stage < CONTROL_STAGE_COUNT; stage++) {
+        stageCycles[stage] = controlStageCycles[stage];
+        stageMaxCycles[stage] = controlStageMaxCycles[stage];
+    }
+    uint32_t tickCount = controlTickCount;
+    uint32_t tickMaxCycles = controlTickMaxCycles;
+    uint32_t overrunCount = controlOverrunCount;
+    #ifdef CHECK_DRIVE_COILS_TIME
+        uint32_t coilCycles = motor.getDriveCoilsCycles();
+        uint32_t coilMaxCycles = motor.getDriveCoilsMaxCycles();
+    #endif
+    enableInterrupts();
+
+    // The budget is a period of the correction timer, which runs faster than the control loop with fixed rate commutation
+    String report = "Rate: " + String(CONTROL_UPDATE_FREQ) + "Hz | Timer: " + String(CORRECTION_TIMER_FREQ) + "Hz | Budget: " + String(controlTickBudget) + " cycles";
+
+    // Each stage as the cycles of the last tick / the most cycles that it has taken
+    const char* stageNames[CONTROL_STAGE_COUNT] = { "Acquire", "Estimate", "Control", "Output" };
+    for (uint8_t stage = 0; stage < CONTROL_STAGE_COUNT; stage++) {
+        report += " | " + String(stageNames[stage]) + ": " + String(stageCycles[stage]) + "/" + String(stageMaxCycles[stage]);
+    }
+
+    // The coil updates (from both the step and correction interrupts) as the cycles of the last call / the most cycles taken
+    #ifdef CHECK_DRIVE_COILS_TIME
+        report += " | Coils: " + String(coilCycles) + "/" + String(coilMaxCycles);
+    #endif
+    return report + " | Max: " + String(tickMaxCycles) + " (" + String((tickMaxCycles * 100) / controlTickBudget) + "%) | Ticks: " + String(tickCount) + " | Overruns: " + String(overrunCount);
+}
+
+
+// Clears the maximum stage times and the tick and overrun counts
+void resetControlLoopStats() {
+    disableInterrupts();
+    for (uint8_t stage = 0; stage < CONTROL_STAGE_COUNT; stage++) {
+        controlStageMaxCycles[stage] = 0;
+    }
+    controlTickMaxCycles = 0;
+    controlTickCount = 0;
+    controlOverrunCount = 0;
+    #ifdef CHECK_DRIVE_COILS_TIME
+        motor.resetDriveCoilsMaxCycles();
+    #endif
+    enableInterrupts();
+}
+
+
 // Direct stepping
 #ifdef ENABLE_DIRECT_STEPPING
 // Configure a specific number of steps to execute at a set rate (rate is in Hz)
@@ -469,11 +845,16 @@ void stepScheduleHandler() {
             // Pause the step timer (will be re-enabled by the PID loop)
             disableStepScheduleTimer();
 
-            // Resume the correctional timer if it is enabled
+            // Resume the correctional timer if it is enabled (always needed for fixed rate coil updates, any steps counted during the move are followed now)
+            #ifdef ENABLE_FIXED_RATE_COMMUTATION
+                correctionTimer -> resume();
+                syncInstructions();
+            #else
             if (stepCorrection) {
                 correctionTimer -> resume();
                 syncInstructions();
             }
+            #endif
         }
     }
     else {
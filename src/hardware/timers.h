@@ -7,6 +7,17 @@
 #include "main.h"
 #include "led.h"
 #include "pid.h"
+#include "cycleTimer.h"
+#include "autotune.h"
+
+// The stages of a control loop tick, in the order that they run
+typedef enum {
+    ACQUIRE_STAGE,
+    ESTIMATE_STAGE,
+    CONTROL_STAGE,
+    OUTPUT_STAGE,
+    CONTROL_STAGE_COUNT
+} CONTROL_LOOP_STAGE;
 
 // Variables
 // Expose the StepperPID instance to other files
@@ -41,8 +52,8 @@ void enableStepCorrection();
 // Disables step correction
 void disableStepCorrection();
 
-// Updates the step correction frequency (called when microstepping is changed)
-void updateCorrectionTimer();
+// Updates the correction step rate (called when microstepping is changed)
+void updateCorrectionRate();
 
 // Function that steps the motor
 void stepMotor();
@@ -50,9 +61,36 @@ void stepMotor();
 // Function that steps motor without adjusting the desired angle
 void stepMotorNoDesiredAngle();
 
-// Function to correct motor position if it is out of place
+// Runs a tick of the control loop (corrects the motor position if it is out of place)
 void correctMotor();
 
+// Records the cycles taken by a stage of the control loop, then starts timing the next one
+void endControlStage(CONTROL_LOOP_STAGE stage, uint32_t &stageStartCycles);
+
+// Returns the timing of the control loop stages (cycles of the last tick and the max), the tick budget, and the overrun count
+String getControlLoopReport();
+
+// Clears the maximum stage times and the tick and overrun counts
+void resetControlLoopStats();
+
+// Fixed rate coil updates
+#ifdef ENABLE_FIXED_RATE_COMMUTATION
+// Moves the coils to the hardware step count (or along the interpolated step), then runs the correction if it's due
+void commutateMotor();
+#endif // ! ENABLE_FIXED_RATE_COMMUTATION
+
+// Hardware step counting
+#ifdef ENABLE_HARDWARE_STEP_COUNTING
+// Updates the step counting direction (direction pin interrupt)
+void stepDirectionChanged();
+
+// Returns the step counter statistics (most steps in a coil update, update time and overruns, and the longest interrupt block)
+String getStepCounterReport();
+
+// Clears the step counter statistics
+void resetStepCounterStats();
+#endif // ! ENABLE_HARDWARE_STEP_COUNTING
+
 // Direct stepping
 #ifdef ENABLE_DIRECT_STEPPING
 // Schedule steps for the motor to execute (rate is in Hz)
@@ -12,19 +12,19 @@
 
 
 // A class used to store and calculate the values to be smoothed.
-template <typename T>
+// The total type can be set to an integer type so that integer values are averaged without any floating point math
+template <typename T, typename TotalType = double>
 class MovingAverage {
   private:
     uint16_t readingsFactor = 10; // The smoothing factor. In average mode, this is the number of readings to average.
     uint16_t readingsPosition = 0; // Current position in the array
     uint16_t readingsNum = 0; // Number of readings currently being averaged
-    T *readings; // Array of readings
+    T *readings = nullptr; // Array of readings
                  // readings[readingsFactor]
                  // readings are stored in an array in an unusual sequence to win/remove one subtraction in code
                  // X(0), X(readingsFactor-1), ..., X(2), X(1)
 
-    // ! Dynamically decide which type to use for the total
-    double runningTotal = 0.0; // A cache of the total of the array, speeds up getting the average
+    TotalType runningTotal = 0; // A cache of the total of the array, speeds up getting the average
 
   public:
     MovingAverage();
@@ -39,20 +39,20 @@ class MovingAverage {
 
 
 // Constructor
-template <typename T>
-MovingAverage<T>::MovingAverage () {}
+template <typename T, typename TotalType>
+MovingAverage<T, TotalType>::MovingAverage () {}
 
 
 // Destructor
-template <typename T>
-MovingAverage<T>::~MovingAverage () { // Destructor
+template <typename T, typename TotalType>
+MovingAverage<T, TotalType>::~MovingAverage () { // Destructor
     delete[] readings;
 }
 
 
 // Initialize the array for storing sensor values
-template <typename T>
-void MovingAverage<T>::begin (uint16_t smoothFactor) {
+template <typename T, typename TotalType>
+void MovingAverage<T, TotalType>::begin (uint16_t smoothFactor) {
 
     // Store the number of readings in the array
     readingsFactor = smoothFactor;
@@ -68,8 +68,8 @@ void MovingAverage<T>::begin (uint16_t smoothFactor) {
 
 
 // Add a value to the array
-template <typename T>
-void MovingAverage<T>::add (T newReading) {
+template <typename T, typename TotalType>
+void MovingAverage<T, TotalType>::add (T newReading) {
 
     // Keep record of the number of readings being averaged
     // This will count up to the array size then stay at that number
@@ -101,22 +101,22 @@ void MovingAverage<T>::add (T newReading) {
 
 
 // Get the smoothed result
-template <typename T>
-T MovingAverage<T>::get() {
+template <typename T, typename TotalType>
+T MovingAverage<T, TotalType>::get() {
     return (runningTotal / readingsNum);
 }
 
 
 // Get the smoothed result as double type
-template <typename T>
-double MovingAverage<T>::getDouble() {
-    return runningTotal / readingsNum;
+template <typename T, typename TotalType>
+double MovingAverage<T, TotalType>::getDouble() {
+    return (double)runningTotal / readingsNum;
 }
 
 
 // Gets the last result stored
-template <typename T>
-T MovingAverage<T>::getLast() {
+template <typename T, typename TotalType>
+T MovingAverage<T, TotalType>::getLast() {
 
     // Just return the last reading
     if (readingsPosition == 0) {
@@ -129,11 +129,11 @@ T MovingAverage<T>::getLast() {
 
 
 // Clears all stored values
-template <typename T>
-void MovingAverage<T>::clear () {
+template <typename T, typename TotalType>
+void MovingAverage<T, TotalType>::clear () {
 
     // Reset the counters
     readingsPosition = 0;
     readingsNum = 0;
-    runningTotal = 0.0;
+    runningTotal = 0;
 }
\ No newline at end of file
@@ -0,0 +1,217 @@
+// Import the header file
+#include "autotune.h"
+
+// Only compile this file if the autotune is enabled
+#ifdef ENABLE_PID_AUTOTUNE
+
+// For the motor, the PID, and saving the gains
+#include "main.h"
+#include "timers.h"
+#include "flash.h"
+
+// State of the autotune (set by both the control loop and the main loop)
+static volatile AUTOTUNE_STATE autotuneState = AUTOTUNE_IDLE;
+
+// Relay settings (output, and increments of error)
+static int32_t relayOutput = 0;
+static int32_t relayMaxOutput = 0;
+static int32_t relayHysteresis = 0;
+static int32_t targetAmplitude = 0;
+static int32_t abortAmplitude = 0;
+
+// The current side of the relay, and the number of times that it has switched to the high side
+static bool relayHigh = false;
+static uint32_t relayCycles = 0;
+
+// Updates since the start of the cycle, and the largest and smallest errors of the cycle (increments)
+static uint32_t cycleUpdates = 0;
+static int32_t cycleMaxError = 0;
+static int32_t cycleMinError = 0;
+
+// Totals of the cycles measured at the current relay output (updates, and increments)
+static uint32_t measuredCycles = 0;
+static uint32_t measuredUpdates = 0;
+static int32_t measuredAmplitude = 0;
+
+
+// Starts the relay around the desired position
+void startAutotune(float amplitude, int32_t startOutput, int32_t maxOutput) {
+
+    // Set up the relay (the control loop can't run while it's being changed)
+    disableInterrupts();
+    relayMaxOutput = max(maxOutput, (int32_t)1);
+    relayOutput = constrain(startOutput, (int32_t)1, relayMaxOutput);
+    relayHysteresis = DEG_TO_INCREMENTS(AUTOTUNE_HYSTERESIS);
+    targetAmplitude = max(DEG_TO_INCREMENTS(amplitude), 2 * relayHysteresis);
+    abortAmplitude = AUTOTUNE_ABORT_FACTOR * targetAmplitude;
+
+    // The relay starts on the low side, so the first cycle starts once the motor is pushed behind the desired position
+    relayHigh = false;
+    relayCycles = 0;
+    cycleUpdates = 0;
+    measuredCycles = 0;
+    measuredUpdates = 0;
+    measuredAmplitude = 0;
+
+    // The control loop can start running the relay
+    autotuneState = AUTOTUNE_RUNNING;
+    enableInterrupts();
+}
+
+
+// Stops the relay if it's running
+void stopAutotune() {
+    disableInterrupts();
+    if (autotuneState == AUTOTUNE_RUNNING) {
+        autotuneState = AUTOTUNE_ABORTED;
+    }
+    enableInterrupts();
+}
+
+
+// Returns the state of the autotune
+AUTOTUNE_STATE getAutotuneState() {
+    return autotuneState;
+}
+
+
+// Runs the relay for a control loop update
+int32_t updateAutotune() {
+
+    // Get the error from the desired position (same sign as the PID's)
+    int32_t error = motor.getDesiredPosition() - motor.encoder.getAbsolutePositionAvg();
+
+    // Stop if the motor gets too far away (something is pushing it, or it isn't oscillating like it should)
+    if (abs(error) > abortAmplitude) {
+        autotuneState = AUTOTUNE_ABORTED;
+        return 0;
+    }
+
+    // Track the extremes of the cycle
+    cycleUpdates++;
+    cycleMaxError = max(cycleMaxError, error);
+    cycleMinError = min(cycleMinError, error);
+
+    // Switch the relay once the error is past the hysteresis
+    if (!relayHigh && (error > relayHysteresis)) {
+        relayHigh = true;
+
+        // Each switch to the high side ends a cycle. The first full cycle is skipped, it starts with the motor at rest
+        if (relayCycles >= 2) {
+            int32_t amplitude = (cycleMaxError - cycleMinError) / 2;
+
+            // Check if the amplitude is within 25% of the target
+            if ((4 * amplitude < 3 * targetAmplitude) || (4 * amplitude > 5 * targetAmplitude)) {
+
+                // It isn't, scale the relay output toward the target (by at most a factor of 2 each cycle)
+                // The measurement starts over at the new output
+                int32_t scaledOutput = (int32_t)(((int64_t)relayOutput * targetAmplitude) / max(amplitude, (int32_t)1));
+                relayOutput = constrain(constrain(scaledOutput, relayOutput / 2, relayOutput * 2), (int32_t)1, relayMaxOutput);
+                measuredCycles = 0;
+                measuredUpdates = 0;
+                measuredAmplitude = 0;
+            }
+            else {
+                // Add the cycle to the measurement
+                measuredCycles++;
+                measuredUpdates += cycleUpdates;
+                measuredAmplitude += amplitude;
+
+                // Finish once there are enough cycles
+                if (measuredCycles >= AUTOTUNE_CYCLES) {
+                    autotuneState = AUTOTUNE_DONE;
+                    return 0;
+                }
+            }
+        }
+
+        // Start the next cycle
+        relayCycles++;
+        cycleUpdates = 0;
+        cycleMaxError = error;
+        cycleMinError = error;
+    }
+    else if (relayHigh && (error < -relayHysteresis)) {
+        relayHigh = false;
+    }
+
+    // Return the relay output
+    return (relayHigh ? relayOutput : -relayOutput);
+}
+
+
+// Runs a whole autotune, then sets the gains found
+String runAutotune(float amplitude, bool save) {
+
+    // The motor has to be enabled for the relay to move it
+    MOTOR_STATE motorState = motor.getState();
+    if ((motorState != ENABLED) && (motorState != FORCED_ENABLED)) {
+        return F("The motor must be enabled to autotune");
+    }
+
+    // Start the relay at the output that the current gains would give at the amplitude. The output is a current with the
+    // servo output, and a step rate without it
+    #ifdef ENABLE_CASCADED_CONTROL
+        float startGain = pid.getPositionP() * pid.getVelocityP();
+    #else
+        float startGain = pid.getP();
+    #endif
+    #ifdef ENABLE_SERVO_OUTPUT
+        int32_t maxOutput = SERVO_FULL_OUTPUT;
+    #else
+        int32_t maxOutput = DEFAULT_PID_STEP_MAX;
+    #endif
+    startAutotune(amplitude, (int32_t)constrain(startGain * amplitude, (float)1, (float)maxOutput), maxOutput);
+
+    // Wait for the relay to finish
+    uint32_t startTime = millis();
+    while (getAutotuneState() == AUTOTUNE_RUNNING) {
+        if ((millis() - startTime) > AUTOTUNE_TIMEOUT) {
+            stopAutotune();
+        }
+        delay(10);
+    }
+
+    // Check that the measurement finished
+    if (getAutotuneState() != AUTOTUNE_DONE) {
+        return F("Autotune failed. Check that the motor is free to move, or try a different amplitude");
+    }
+
+    // Find the ultimate period (ms) and the amplitude (deg) from the average of the measured cycles
+    float ultimatePeriod = (1000.0 * measuredUpdates) / ((float)measuredCycles * CONTROL_UPDATE_FREQ);
+    float measuredAmplitudeDeg = INCREMENTS_TO_DEG((float)measuredAmplitude / measuredCycles);
+
+    // Find the ultimate gain (output per deg). The hysteresis delays the switches, so it's taken out of the amplitude
+    float ultimateGain = (4.0 * relayOutput) / (PI * sqrt((measuredAmplitudeDeg * measuredAmplitudeDeg) - (AUTOTUNE_HYSTERESIS * AUTOTUNE_HYSTERESIS)));
+
+    // Find the gains with the Ziegler-Nichols rules (P = 0.6 Ku, Ti = Pu / 2, Td = Pu / 8)
+    float proportional = 0.6 * ultimateGain;
+    #ifdef ENABLE_CASCADED_CONTROL
+        // The cascade works out to a PID on the position error. The position loop gain is 1 / Td, and the velocity loop gains
+        // are P * Td and P * Td / Ti (so that multiplied by the position loop gain they give P, and P / Ti)
+        pid.setPositionP(8000.0 / ultimatePeriod);
+        pid.setVelocityP(proportional * ultimatePeriod / 8000.0);
+        pid.setVelocityI(proportional / 4);
+    #else
+        // The I term is per deg ms, and the D term is per deg/ms
+        pid.setP(proportional);
+        pid.setI(2 * proportional / ultimatePeriod);
+        pid.setD(proportional * ultimatePeriod / 8);
+    #endif
+
+    // Save the gains if asked
+    if (save) {
+        saveParameters();
+    }
+
+    // Report the measurement and the gains
+    String report = "Ku: " + String(ultimateGain) + " | Pu: " + String(ultimatePeriod) + "ms | ";
+    #ifdef ENABLE_CASCADED_CONTROL
+        report += "P: " + String(pid.getPositionP()) + " | V: " + String(pid.getVelocityP()) + " | I: " + String(pid.getVelocityI());
+    #else
+        report += "P: " + String(pid.getP()) + " | I: " + String(pid.getI()) + " | D: " + String(pid.getD());
+    #endif
+    return report;
+}
+
+#endif // ! ENABLE_PID_AUTOTUNE
@@ -0,0 +1,45 @@
+#ifndef __AUTOTUNE_H__
+#define __AUTOTUNE_H__
+
+// Include main config
+#include "config.h"
+
+// Only build this file if the autotune is enabled
+#ifdef ENABLE_PID_AUTOTUNE
+
+// Include Arduino library
+#include "Arduino.h"
+
+// Relay (Astrom-Hagglund) autotune
+// While it runs, a relay replaces the controller. The output is +d while the motor is behind the desired position and -d while
+// it's ahead, which makes the motor oscillate at the frequency where the loop has 180 degrees of phase lag (the ultimate period).
+// The amplitude of the oscillation gives the gain at that frequency, so the ultimate gain is 4d / (pi * amplitude)
+// The relay output is adjusted until the amplitude is close to the target, so the motor never moves further than asked
+
+// States of the autotune
+typedef enum {
+    AUTOTUNE_IDLE,
+    AUTOTUNE_RUNNING,
+    AUTOTUNE_DONE,
+    AUTOTUNE_ABORTED
+} AUTOTUNE_STATE;
+
+// Starts the relay around the desired position. The amplitude is the target oscillation (deg), and the outputs are the relay
+// output to start with and the largest output that the relay can be adjusted to
+void startAutotune(float amplitude, int32_t startOutput, int32_t maxOutput);
+
+// Stops the relay if it's running (the controller takes over on the next update)
+void stopAutotune();
+
+// Returns the state of the autotune
+AUTOTUNE_STATE getAutotuneState();
+
+// Runs the relay for a control loop update, returning its output (called by the control loop while the autotune is running)
+int32_t updateAutotune();
+
+// Runs a whole autotune (blocks until it's done), then sets the gains found and saves them if asked. Returns a report
+String runAutotune(float amplitude, bool save);
+
+#endif // ! ENABLE_PID_AUTOTUNE
+
+#endif // ! __AUTOTUNE_H__
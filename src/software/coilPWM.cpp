@@ -0,0 +1,26 @@
+// Import the header file
+#include "coilPWM.h"
+
+// Calculates the PWM setting of a coil for a current (mA)
+uint32_t currentToPWM(uint16_t current) {
+
+    // Calculate the value to set the PWM interface to (based on algebraically manipulated equations from the datasheet)
+    uint32_t PWMValue = (CURRENT_SENSE_RESISTOR * PWM_MAX_VALUE * current) / (BOARD_VOLTAGE * 100);
+
+    // Constrain the PWM value, then return it
+    return constrain(PWMValue, 0, PWM_MAX_VALUE);
+}
+
+
+// Fills a table with the signed PWM value of each entry of the sine table at a peak current (mA)
+void fillPWMTable(int16_t table[SINE_VAL_COUNT], uint16_t peakCurrent) {
+
+    // Each entry is a single aligned write, so an interrupt only ever sees a mix of old and new valid values while this runs
+    for (uint16_t index = 0; index < SINE_VAL_COUNT; index++) {
+
+        // Scale the sine by the peak current, then convert it to a PWM value (keeping the sign for the direction)
+        int32_t current = ((int32_t)peakCurrent * sineTable.values[index]) >> SINE_POWER; // i.e. / SINE_MAX
+        int32_t pwm = currentToPWM(abs(current));
+        table[index] = (current < 0) ? -pwm : pwm;
+    }
+}
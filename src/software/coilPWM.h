@@ -0,0 +1,41 @@
+#ifndef __COIL_PWM_H__
+#define __COIL_PWM_H__
+
+// For type definitions
+#include "Arduino.h"
+
+// Include main config
+#include "config.h"
+
+// For the sine table and the phase lookup
+#include "fastSine.h"
+
+// Scale applied to the coil current (fixed point, CURRENT_SCALE_MAX is the full current)
+#define CURRENT_SCALE_BITS 8
+#define CURRENT_SCALE_MAX  (1 << CURRENT_SCALE_BITS)
+
+// Calculates the PWM setting of a coil for a current (mA)
+uint32_t currentToPWM(uint16_t current);
+
+// Fills a table with the signed PWM value of each entry of the sine table at a peak current (mA)
+void fillPWMTable(int16_t table[SINE_VAL_COUNT], uint16_t peakCurrent);
+
+// Looks up the signed PWM values of both coils for a phase (SINE_STEPS per electrical cycle), then scales them down
+// (CURRENT_SCALE_MAX is the full current). The B coil is a quarter cycle ahead
+inline void lookupCoilPWM(const int16_t table[SINE_VAL_COUNT], uint32_t phase, int32_t scale, int32_t &coilAPWM, int32_t &coilBPWM) {
+
+    // Correct the phase so that it's within a single electrical cycle
+    uint32_t cyclePhase = phase & (SINE_STEPS - 1);
+
+    // Just look up the precomputed PWM values
+    coilAPWM = lookupPhase(table, cyclePhase);
+    coilBPWM = lookupPhase(table, cyclePhase + (SINE_STEPS / 4));
+
+    // Scale the current down if needed (the PWM is proportional to the current)
+    if (scale != CURRENT_SCALE_MAX) {
+        coilAPWM = (coilAPWM * scale) >> CURRENT_SCALE_BITS;
+        coilBPWM = (coilBPWM * scale) >> CURRENT_SCALE_BITS;
+    }
+}
+
+#endif // ! __COIL_PWM_H__
@@ -0,0 +1,55 @@
+// Import the header file
+#include "cycleTimer.h"
+
+// Cycles in a microsecond (defaults to the 128MHz clock until the timer is set up)
+uint32_t cyclesPerMicro = 128;
+
+// The upper half of the 64 bit count, and the last value of the counter (used to catch the wraps)
+static uint32_t cycleCountHigh = 0;
+static uint32_t lastCycleCount = 0;
+
+// Host builds that don't simulate the clock get a stopped counter and no interrupts (a test replaces these to drive the time)
+#ifdef CYCLE_TIMER_MOCK
+    __attribute__((weak)) uint32_t mockCycleCount() { return 0; }
+    __attribute__((weak)) void mockDisableInterrupts() {}
+    __attribute__((weak)) void mockEnableInterrupts() {}
+#endif
+
+
+// Starts the cycle counter
+void setupCycleTimer(uint32_t coreClock) {
+
+    // Set the conversions (the clock is always a whole number of MHz)
+    cyclesPerMicro = (coreClock >= 1000000) ? (coreClock / 1000000) : 1;
+
+    // Enable the trace unit, then the cycle counter
+    #ifndef CYCLE_TIMER_MOCK
+        CoreDebug -> DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT -> CYCCNT = 0;
+        DWT -> CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    #endif
+
+    // Start the extension from the current count
+    cycleCountHigh = 0;
+    lastCycleCount = cycleCount();
+}
+
+
+// Returns the 64 bit cycle count
+uint64_t cycleCount64() {
+
+    // The count can be extended from both the interrupts and the main loop, so it can't be interrupted
+    CYCLE_TIMER_DISABLE_INTERRUPTS();
+
+    // The counter only goes up, so it has wrapped if it is lower than the last time
+    uint32_t count = cycleCount();
+    if (count < lastCycleCount) {
+        cycleCountHigh++;
+    }
+    lastCycleCount = count;
+    uint64_t extendedCount = ((uint64_t)cycleCountHigh << 32) | count;
+
+    // Done
+    CYCLE_TIMER_ENABLE_INTERRUPTS();
+    return extendedCount;
+}
@@ -0,0 +1,63 @@
+#ifndef __CYCLE_TIMER_H__
+#define __CYCLE_TIMER_H__
+
+// For type definitions and the core registers
+#include "Arduino.h"
+
+// Cycle counter timing
+// Everything that needs precise timing (the control loop, the observer, and the instrumentation) is timed with the DWT cycle counter.
+// Reading it is a single load, unlike micros() which has to combine SysTick with the tick count. The 32 bit count wraps every
+// 33.5s at 128MHz, so a 64 bit count is extended from it for anything that can be longer than that.
+// Host builds can define CYCLE_TIMER_MOCK and supply the counter and the critical section (mockCycleCount(),
+// mockDisableInterrupts(), and mockEnableInterrupts()), so the control code can be run with a simulated clock
+
+#ifdef CYCLE_TIMER_MOCK
+    // Supplied by the host build
+    uint32_t mockCycleCount();
+    void mockDisableInterrupts();
+    void mockEnableInterrupts();
+    #define CYCLE_COUNTER_READ()              mockCycleCount()
+    #define CYCLE_TIMER_DISABLE_INTERRUPTS()  mockDisableInterrupts()
+    #define CYCLE_TIMER_ENABLE_INTERRUPTS()   mockEnableInterrupts()
+    #define CYCLE_TIMER_DEFAULT_CLOCK         128000000
+#else
+    // The interrupt blocks are counted by timers.cpp, so they can be nested
+    void disableInterrupts();
+    void enableInterrupts();
+    #define CYCLE_COUNTER_READ()              (DWT -> CYCCNT)
+    #define CYCLE_TIMER_DISABLE_INTERRUPTS()  disableInterrupts()
+    #define CYCLE_TIMER_ENABLE_INTERRUPTS()   enableInterrupts()
+    #define CYCLE_TIMER_DEFAULT_CLOCK         SystemCoreClock
+#endif
+
+// Starts the cycle counter. The core clock is the rate that it counts at (must be called after the clock is configured)
+void setupCycleTimer(uint32_t coreClock = CYCLE_TIMER_DEFAULT_CLOCK);
+
+// Returns the 64 bit cycle count, extended from the 32 bit counter
+// Has to be called at least once every wrap of the counter (the control loop calls it on every tick)
+uint64_t cycleCount64();
+
+// The number of cycles in a microsecond (set by setupCycleTimer)
+extern uint32_t cyclesPerMicro;
+
+// Returns the 32 bit cycle count (differences are correct across a wrap, as long as they're shorter than a wrap)
+inline uint32_t cycleCount() {
+    return CYCLE_COUNTER_READ();
+}
+
+// Converts cycles to microseconds (rounded down)
+inline uint32_t cyclesToMicros(uint32_t cycles) {
+    return (cycles / cyclesPerMicro);
+}
+
+// Converts microseconds to cycles
+inline uint32_t microsToCycles(uint32_t micros) {
+    return (micros * cyclesPerMicro);
+}
+
+// Returns the cycles since a 64 bit cycle count
+inline uint64_t cyclesSince(uint64_t startCycles) {
+    return (cycleCount64() - startCycles);
+}
+
+#endif // ! __CYCLE_TIMER_H__
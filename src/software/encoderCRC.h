@@ -0,0 +1,17 @@
+#ifndef __ENCODER_CRC_H__
+#define __ENCODER_CRC_H__
+
+// Only needs the fixed width types, so it can be built and tested on the host
+#include <stdint.h>
+
+// CRC calculation values (SAE J1850, as used by the safety word of the TLE5012B)
+#define CRC_POLYNOMIAL  0x1D
+#define CRC_SEED        0xFF
+
+// Calculates the CRC of an array of 8 bit messages
+uint8_t calcEncoderCRC(const uint8_t *data, uint8_t length);
+
+// Checks the CRC in the low byte of a safety word against the command and the data words of the transfer
+bool checkEncoderCRC(uint16_t safety, uint16_t command, const uint16_t *words, uint16_t length);
+
+#endif // ! __ENCODER_CRC_H__
@@ -24,6 +24,29 @@ analogInfo analogSetup(PinName pin, uint32_t freq, uint32_t startingValue) {
     // Get the channel for the pin, then set that in the analogInfo as well
     pinInfo.channel = STM_PIN_CHANNEL(pinmap_function(pin, PinMap_PWM));
 
+    // Save the timer registers (CCR1 to CCR4 are consecutive)
+    pinInfo.timer = Instance;
+    pinInfo.compareRegister = &(Instance->CCR1) + (pinInfo.channel - 1);
+    pinInfo.period = (Instance->ARR) + 1;
+
+    // Enable the preload of the compare and reload registers
+    // New values are only latched at the update event, so the duty cycle never changes partway through a period
+    Instance->CR1 |= TIM_CR1_ARPE;
+    switch (pinInfo.channel) {
+        case 1:
+            Instance->CCMR1 |= TIM_CCMR1_OC1PE;
+            break;
+        case 2:
+            Instance->CCMR1 |= TIM_CCMR1_OC2PE;
+            break;
+        case 3:
+            Instance->CCMR2 |= TIM_CCMR2_OC3PE;
+            break;
+        case 4:
+            Instance->CCMR2 |= TIM_CCMR2_OC4PE;
+            break;
+    }
+
     // Return the analogInfo
     return pinInfo;
 }
@@ -36,6 +59,17 @@ void analogSet(analogInfo* pinInfo, uint32_t value) {
     // Very bad things could happen if this is not checked properly
     value = constrain(value, 0, PWM_MAX_VALUE);
 
-    // Only need to set the capture compare
-    pinInfo->HTPointer->setCaptureCompare(pinInfo->channel, value, PWM_COMPARE_FORMAT);
+    // Scale the value to the timer's period, then write the compare register (takes effect at the next update event)
+    *(pinInfo->compareRegister) = (value * (pinInfo->period)) >> PWM_COMPARE_FORMAT;
+}
+
+
+// Sets the values of two pins on the same timer, making sure that both take effect at the same update event
+void analogSetPair(analogInfo* pinInfoA, uint32_t valueA, analogInfo* pinInfoB, uint32_t valueB) {
+
+    // Block the update event while writing, otherwise it could land between the two writes
+    pinInfoA->timer->CR1 |= TIM_CR1_UDIS;
+    analogSet(pinInfoA, valueA);
+    analogSet(pinInfoB, valueB);
+    pinInfoA->timer->CR1 &= ~TIM_CR1_UDIS;
 }
\ No newline at end of file
@@ -15,10 +15,18 @@ class analogInfo {
         PinName pin;
         HardwareTimer *HTPointer;
         uint32_t channel;
+
+        // Timer registers, resolved once so that the compare value can be written directly
+        TIM_TypeDef *timer;
+        volatile uint32_t *compareRegister;
+
+        // Timer ticks per PWM period (used to scale the value to the compare register)
+        uint32_t period;
 };
 
 // Functions
 analogInfo analogSetup(PinName pin, uint32_t freq, uint32_t startingValue);
 void analogSet(analogInfo* pinInfo, uint32_t value);
+void analogSetPair(analogInfo* pinInfoA, uint32_t valueA, analogInfo* pinInfoB, uint32_t valueB);
 
 #endif // ! __FAST_ANALOG_WRITE__
\ No newline at end of file
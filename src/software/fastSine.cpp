@@ -1,23 +1,11 @@
 #include "fastSine.h"
 
 // Main sine lookup table
-// SINE_MAX == 2^SINE_POWER == 2^14 == 16384
-// sin() == sineTable[index] / SINE_MAX == sineTable[index] >> SINE_POWER
-const int16_t sineTable[SINE_VAL_COUNT] = {
-     0,    803,   1605,   2404,   3196,   3980,   4756,   5519,
-  6269,   7005,   7723,   8423,   9102,   9759,  10393,  11002,
- 11585,  12139,  12665,  13159,  13622,  14053,  14449,  14810,
- 15136,  15426,  15678,  15892,  16069,  16206,  16305,  16364,
- 16384,  16364,  16305,  16206,  16069,  15892,  15678,  15426,
- 15136,  14810,  14449,  14053,  13622,  13159,  12665,  12139,
- 11585,  11002,  10393,   9759,   9102,   8423,   7723,   7005,
-  6269,   5519,   4756,   3980,   3196,   2404,   1605,    803,
-     0,   -803,  -1605,  -2404,  -3196,  -3980,  -4756,  -5519,
- -6269,  -7005,  -7723,  -8423,  -9102,  -9759, -10393, -11002,
--11585, -12139, -12665, -13159, -13622, -14053, -14449, -14810,
--15136, -15426, -15678, -15892, -16069, -16206, -16305, -16364,
--16384, -16364, -16305, -16206, -16069, -15892, -15678, -15426,
--15136, -14810, -14449, -14053, -13622, -13159, -12665, -12139,
--11585, -11002, -10393,  -9759,  -9102,  -8423,  -7723,  -7005,
- -6269,  -5519,  -4756,  -3980,  -3196,  -2404,  -1605,   -803
-};
+// The table is constexpr, so it is computed while compiling and placed in flash
+constexpr SineTable sineTable;
+
+// Checks of the generated table
+static_assert(sineTable.values[0] == 0, "The sine table must start at 0!");
+static_assert(sineTable.values[SINE_VAL_COUNT / 4] == SINE_MAX, "The sine table must peak at SINE_MAX!");
+static_assert(sineTable.values[3 * SINE_VAL_COUNT / 4] == -SINE_MAX, "The sine table must bottom out at -SINE_MAX!");
+static_assert(sineTable.values[SINE_VAL_COUNT / 8] == 11585, "The sine table is inaccurate at 45 degrees!");
@@ -7,11 +7,80 @@
 // For all of the config options
 #include "config.h"
 
+// Resolution of the coil drive (phase units per electrical cycle, which is 4 full steps)
+// Each table entry is split into 2^SINE_INTERPOLATION_BITS units if interpolating
+#ifdef SINE_INTERPOLATION
+    #define SINE_STEPS (SINE_VAL_COUNT << SINE_INTERPOLATION_BITS)
+#else
+    #define SINE_STEPS SINE_VAL_COUNT
+#endif
+#define SINE_STEPS_PER_FULL_STEP (SINE_STEPS / 4)
+
+// Sine lookup table, generated by the compiler
+// SINE_MAX == 2^SINE_POWER == 2^14 == 16384
+// sin() == values[index] / SINE_MAX == values[index] >> SINE_POWER
+// The number of entries is a template parameter so that the other sizes can be checked on the host, the firmware uses
+// SINE_VAL_COUNT (SineTable)
+template <uint32_t ENTRIES>
+struct SineTableOfSize {
+    int16_t values[ENTRIES];
+
+    // Fills in the table
+    constexpr SineTableOfSize() : values() {
+        for (uint32_t index = 0; index < ENTRIES; index++) {
+            values[index] = entry(index);
+        }
+    }
+
+    // Computes a single entry (rounded to the nearest integer)
+    // Only the first quarter of the wave is computed, the rest is mirrored so the table is exactly symmetric
+    static constexpr int16_t entry(uint32_t index) {
+        return (index >= (ENTRIES / 2)) ? -entry(index - (ENTRIES / 2)) :
+               (index > (ENTRIES / 4))  ?  entry((ENTRIES / 2) - index) :
+               (int16_t)(quarterSine(1.5707963267948966 * index / (ENTRIES / 4)) * SINE_MAX + 0.5);
+    }
+
+    // Taylor series of sin(x) for x in [0, pi/2] (the error is below 1e-10 with these terms)
+    static constexpr double quarterSine(double x) {
+        double term = x;
+        double sum = x;
+        for (uint8_t power = 3; power <= 19; power += 2) {
+            term *= -(x * x) / ((power - 1) * power);
+            sum += term;
+        }
+        return sum;
+    }
+};
+typedef SineTableOfSize<SINE_VAL_COUNT> SineTable;
+
 // Public variables
-extern const int16_t sineTable[SINE_VAL_COUNT];
+extern const SineTable sineTable;
+
+// Looks up a phase (SINE_STEPS per electrical cycle) in a table with SINE_VAL_COUNT entries per electrical cycle
+// Used for the sine table, as well as any tables built from it (the number of entries only has to be given for other sizes)
+template <uint32_t ENTRIES = SINE_VAL_COUNT>
+inline int16_t lookupPhase(const int16_t* table, uint32_t phase) {
+
+    #ifdef SINE_INTERPOLATION
+        // Linearly interpolate between the two entries around the phase
+        uint32_t index = (phase >> SINE_INTERPOLATION_BITS) & (ENTRIES - 1);
+        int32_t fraction = phase & ((1 << SINE_INTERPOLATION_BITS) - 1);
+        int32_t low = table[index];
+        int32_t high = table[(index + 1) & (ENTRIES - 1)];
+        return low + ((((high - low) * fraction) + (1 << (SINE_INTERPOLATION_BITS - 1))) >> SINE_INTERPOLATION_BITS);
+    #else
+        return table[phase & (ENTRIES - 1)];
+    #endif
+}
+
+// Sine of a phase (SINE_STEPS per electrical cycle, scaled to SINE_MAX)
+inline int16_t fastSin(uint32_t phase) {
+    return lookupPhase(sineTable.values, phase);
+}
 
-// Main functions
-#define fastSin(angle) (sineTable[angle])
-#define fastCos(angle) (sineTable[(angle + (SINE_VAL_COUNT / 4)) & (SINE_VAL_COUNT - 1)])
+// Cosine of a phase (SINE_STEPS per electrical cycle, scaled to SINE_MAX)
+inline int16_t fastCos(uint32_t phase) {
+    return fastSin(phase + (SINE_STEPS / 4));
+}
 
-#endif // !__FAST_SINE_H__
\ No newline at end of file
+#endif // !__FAST_SINE_H__
@@ -0,0 +1,212 @@
+// Import the header file
+#include "fixedPID.h"
+
+// Only compile this file if PID is enabled
+#ifdef ENABLE_PID
+
+// Returns the Proportional value of the PID loop
+float FixedPID::getP() const {
+    return (this -> kP);
+}
+
+
+// Returns the Integral value fo the PID loop
+float FixedPID::getI() const {
+    return (this -> kI);
+}
+
+
+// Returns the Derivative value for the PID loop
+float FixedPID::getD() const {
+    return (this -> kD);
+}
+
+
+// Returns the maximum value of the I term of the PID loop
+float FixedPID::getMaxI() const {
+    return (this -> maxI);
+}
+
+
+// Sets the Proportional term of the PID loop
+void FixedPID::setP(float newP) {
+
+    // Update the term if the new value isn't negative
+    if (newP >= 0) {
+        kP = newP;
+        kPFixed = PID_FIXED_GAIN(newP);
+    }
+}
+
+
+// Sets the Integral term of the PID loop
+void FixedPID::setI(float newI) {
+
+    // Update the term if the new value isn't negative
+    if (newI >= 0) {
+        kI = newI;
+        kIFixed = PID_FIXED_GAIN(newI);
+    }
+}
+
+
+// Sets the Derivative of the PID loop
+void FixedPID::setD(float newD) {
+
+    // Update the term if the new value isn't negative
+    if (newD >= 0) {
+        kD = newD;
+        kDFixed = PID_FIXED_GAIN(newD);
+    }
+}
+
+
+// Sets the maximum value of the I term of the PID loop
+void FixedPID::setMaxI(float newMaxI) {
+
+    // Update the term if the new value isn't negative
+    if (newMaxI >= 0) {
+        maxI = newMaxI;
+        maxIFixed = DEG_TO_INCREMENTS(newMaxI);
+    }
+}
+
+
+// Runs the PID, returning the output
+int32_t FixedPID::compute(int32_t error, int32_t velocity, int32_t elapsedTime, int64_t feedforward) {
+
+    // Calculate the cumulative error (used with I term), in increment microseconds
+    // The I term is per increment millisecond, so it's divided by 1000 below
+    int64_t newCumulativeError = (this -> cumulativeError) + ((int64_t)error * elapsedTime);
+
+    // Clamp the cumulative error, preventing I term windup
+    this -> cumulativeError = constrain(newCumulativeError, -(int64_t)maxIFixed * 1000, (int64_t)maxIFixed * 1000);
+
+    // The rate error is the negative of the measured velocity (derivative on measurement, so setpoint steps don't kick the output)
+    // This is in increments/s, the D term is in increments/ms so it is divided by 1000 below
+    int32_t rateError = -velocity;
+
+    // Calculate the output with the errors and the coefficients
+    int64_t fixedOutput = ((int64_t)(this -> kPFixed) * error) + (((int64_t)(this -> kIFixed) * (this -> cumulativeError)) / 1000) + (((int64_t)(this -> kDFixed) * rateError) / 1000) + feedforward;
+    return (int32_t)constrain(fixedOutput >> PID_GAIN_SHIFT, -DEFAULT_PID_STEP_MAX, DEFAULT_PID_STEP_MAX);
+}
+
+
+// Clears the integral
+void FixedPID::reset() {
+    this -> cumulativeError = 0;
+}
+
+
+// Cascaded control
+#ifdef ENABLE_CASCADED_CONTROL
+
+// Returns the gain of the position loop
+float FixedCascade::getPositionP() const {
+    return (this -> kPosition);
+}
+
+
+// Returns the proportional gain of the velocity loop
+float FixedCascade::getVelocityP() const {
+    return (this -> kVelocityP);
+}
+
+
+// Returns the integral gain of the velocity loop
+float FixedCascade::getVelocityI() const {
+    return (this -> kVelocityI);
+}
+
+
+// Returns the max velocity that the position loop can command
+float FixedCascade::getMaxVelocity() const {
+    return (this -> maxVelocity);
+}
+
+
+// Sets the gain of the position loop
+void FixedCascade::setPositionP(float newPositionP) {
+
+    // Update the gain if the new value isn't negative
+    if (newPositionP >= 0) {
+        kPosition = newPositionP;
+        kPositionFixed = CASCADE_FIXED_GAIN(newPositionP);
+    }
+}
+
+
+// Sets the proportional gain of the velocity loop
+void FixedCascade::setVelocityP(float newVelocityP) {
+
+    // Update the gain if the new value isn't negative
+    if (newVelocityP >= 0) {
+        kVelocityP = newVelocityP;
+        kVelocityPFixed = PID_FIXED_GAIN(newVelocityP);
+    }
+}
+
+
+// Sets the integral gain of the velocity loop
+void FixedCascade::setVelocityI(float newVelocityI) {
+
+    // Update the gain if the new value isn't negative
+    if (newVelocityI >= 0) {
+        kVelocityI = newVelocityI;
+        kVelocityIUpdate = CASCADE_PER_UPDATE_GAIN(PID_FIXED_GAIN(newVelocityI));
+    }
+}
+
+
+// Sets the max velocity that the position loop can command
+void FixedCascade::setMaxVelocity(float newMaxVelocity) {
+
+    // Update the limit if the new value is positive
+    if (newMaxVelocity > 0) {
+        maxVelocity = newMaxVelocity;
+        maxVelocityFixed = DEG_TO_INCREMENTS(newMaxVelocity);
+    }
+}
+
+
+// Runs the position and velocity loops, returning the output
+int32_t FixedCascade::compute(int32_t error, int32_t velocity, int32_t inputVelocity, int64_t accelFeedforward) {
+
+    // Position loop, the error sets the velocity on top of the step input's (limited to the max velocity)
+    // Without the step input's velocity, the velocity loop would step against every move of the step input
+    int64_t velocityCommand = (((int64_t)(this -> kPositionFixed) * error) >> PID_GAIN_SHIFT) + inputVelocity;
+    int32_t velocitySetpoint = (int32_t)constrain(velocityCommand, -(this -> maxVelocityFixed), (this -> maxVelocityFixed));
+
+    // Velocity loop on the measured velocity
+    int32_t velocityError = velocitySetpoint - velocity;
+    this -> velocityIntegral += (int64_t)(this -> kVelocityIUpdate) * velocityError;
+    int64_t unlimitedOutput = (((int64_t)(this -> kVelocityPFixed) * velocityError) >> PID_GAIN_SHIFT) +
+                              ((this -> velocityIntegral) >> CASCADE_INTEGRAL_SHIFT) + (accelFeedforward >> PID_GAIN_SHIFT);
+    int32_t output = (int32_t)constrain(unlimitedOutput, -DEFAULT_PID_STEP_MAX, DEFAULT_PID_STEP_MAX);
+
+    // Back-calculation anti-windup. While the output is limited, the integral is pulled toward the limit instead of winding up
+    this -> velocityIntegral += (int64_t)(this -> kAntiWindupUpdate) * (output - unlimitedOutput);
+
+    // The integral alone can never need to be past the output limit
+    const int64_t maxIntegral = (int64_t)DEFAULT_PID_STEP_MAX << CASCADE_INTEGRAL_SHIFT;
+    this -> velocityIntegral = constrain(this -> velocityIntegral, -maxIntegral, maxIntegral);
+
+    // Return the output of the velocity loop
+    return output;
+}
+
+
+// Clears the velocity integral
+void FixedCascade::reset() {
+    this -> velocityIntegral = 0;
+}
+
+
+// Returns the output of the velocity integral alone
+int32_t FixedCascade::getIntegralOutput() const {
+    return (int32_t)((this -> velocityIntegral) >> CASCADE_INTEGRAL_SHIFT);
+}
+
+#endif // ! ENABLE_CASCADED_CONTROL
+
+#endif // ! ENABLE_PID
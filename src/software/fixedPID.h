@@ -0,0 +1,131 @@
+#ifndef __FIXED_PID_H__
+#define __FIXED_PID_H__
+
+// Include main config
+#include "config.h"
+
+// Only build this file if PID is enabled
+#ifdef ENABLE_PID
+
+// For the increment units
+#include "fixedPoint.h"
+
+// Gains are converted to fixed point, scaled from degrees to encoder increments
+// Output = (gain * error in increments) >> PID_GAIN_SHIFT
+#define PID_GAIN_SHIFT  16
+#define PID_FIXED_GAIN(GAIN) ((int32_t)round((GAIN) * INCREMENTS_TO_DEG(1L << PID_GAIN_SHIFT)))
+
+// The longest time between computations that is integrated (us)
+#define PID_MAX_ELAPSED_TIME 1000000
+
+// Cascaded control
+#ifdef ENABLE_CASCADED_CONTROL
+
+    // Gains without unit conversions (position loop and anti-windup rate, both 1/s) are just scaled to fixed point
+    #define CASCADE_FIXED_GAIN(GAIN) ((int32_t)round((GAIN) * (1L << PID_GAIN_SHIFT)))
+
+    // The velocity integral is kept with extra fraction bits, as it only changes by a small amount on each update
+    // Output = integral >> CASCADE_INTEGRAL_SHIFT
+    #define CASCADE_INTEGRAL_SHIFT 32
+    #define CASCADE_PER_UPDATE_GAIN(FIXED_GAIN) ((int32_t)(((int64_t)(FIXED_GAIN) << (CASCADE_INTEGRAL_SHIFT - PID_GAIN_SHIFT)) / CONTROL_UPDATE_FREQ))
+#endif
+
+// The math of the PID, without any hardware access (StepperPID supplies the positions and the times)
+// Everything is done with integers, the gains are converted to fixed point when they are set
+class FixedPID {
+
+    public:
+        // Get functions for P, I, and D (output per deg, per deg ms, and per deg/ms), and the I windup limit (deg)
+        float getP() const;
+        float getI() const;
+        float getD() const;
+        float getMaxI() const;
+
+        // Set functions for P, I, and D, and the I windup limit (negative values are ignored)
+        void setP(float newP);
+        void setI(float newI);
+        void setD(float newD);
+        void setMaxI(float newMaxI);
+
+        // Runs the PID on the position error (increments), the measured velocity (increments/s), and the time since the last
+        // computation (us). The feedforward is added to the output before it is shifted down (PID_GAIN_SHIFT fraction bits)
+        int32_t compute(int32_t error, int32_t velocity, int32_t elapsedTime, int64_t feedforward = 0);
+
+        // Clears the integral
+        void reset();
+
+    private:
+        // P, I, and D terms for loop
+        // Term is multiplied by degrees of error to find stepping rate back
+        float kP = DEFAULT_P;
+        float kI = DEFAULT_I;
+        float kD = DEFAULT_D;
+
+        // Fixed point versions of the terms (used in the calculations)
+        int32_t kPFixed = PID_FIXED_GAIN(DEFAULT_P);
+        int32_t kIFixed = PID_FIXED_GAIN(DEFAULT_I);
+        int32_t kDFixed = PID_FIXED_GAIN(DEFAULT_D);
+
+        // I windup clamping (degrees, then increments)
+        float maxI = DEFAULT_MAX_I;
+        int32_t maxIFixed = DEG_TO_INCREMENTS(DEFAULT_MAX_I);
+
+        // Cumulative error (increment microseconds)
+        int64_t cumulativeError = 0;
+};
+
+
+// Cascaded control
+#ifdef ENABLE_CASCADED_CONTROL
+
+// The math of the cascaded control, without any hardware access (StepperPID supplies the positions and the velocities)
+// An outer position loop (P) commands a velocity, and an inner velocity loop (PI) sets the output. Runs once per control loop update
+class FixedCascade {
+
+    public:
+        // Get functions for the gains (position P in 1/s, velocity P and I in output per deg/s and per deg), and the max velocity (deg/s)
+        float getPositionP() const;
+        float getVelocityP() const;
+        float getVelocityI() const;
+        float getMaxVelocity() const;
+
+        // Set functions for the gains (negative values are ignored), and the max velocity (must be positive)
+        void setPositionP(float newPositionP);
+        void setVelocityP(float newVelocityP);
+        void setVelocityI(float newVelocityI);
+        void setMaxVelocity(float newMaxVelocity);
+
+        // Runs both loops on the position error (increments), the measured velocity, and the velocity of the step input (both
+        // increments/s). The step input already moves the coils, so the output is the correction on top of it. The feedforward
+        // is added to the output (PID_GAIN_SHIFT fraction bits)
+        int32_t compute(int32_t error, int32_t velocity, int32_t inputVelocity, int64_t accelFeedforward = 0);
+
+        // Clears the velocity integral
+        void reset();
+
+        // Returns the output of the velocity integral alone
+        int32_t getIntegralOutput() const;
+
+    private:
+        // Gains
+        float kPosition = DEFAULT_POSITION_P;
+        float kVelocityP = DEFAULT_VELOCITY_P;
+        float kVelocityI = DEFAULT_VELOCITY_I;
+        float maxVelocity = DEFAULT_MAX_VELOCITY;
+
+        // Fixed point versions of the gains (the integral gains are per update, in CASCADE_INTEGRAL_SHIFT fraction bits)
+        int32_t kPositionFixed = CASCADE_FIXED_GAIN(DEFAULT_POSITION_P);
+        int32_t kVelocityPFixed = PID_FIXED_GAIN(DEFAULT_VELOCITY_P);
+        int32_t kVelocityIUpdate = CASCADE_PER_UPDATE_GAIN(PID_FIXED_GAIN(DEFAULT_VELOCITY_I));
+        int32_t kAntiWindupUpdate = CASCADE_PER_UPDATE_GAIN(CASCADE_FIXED_GAIN(CASCADE_ANTIWINDUP_RATE));
+        int32_t maxVelocityFixed = DEG_TO_INCREMENTS(DEFAULT_MAX_VELOCITY);
+
+        // Integral of the velocity loop (output, in CASCADE_INTEGRAL_SHIFT fraction bits)
+        int64_t velocityIntegral = 0;
+};
+
+#endif // ! ENABLE_CASCADED_CONTROL
+
+#endif // ! ENABLE_PID
+
+#endif // ! __FIXED_PID_H__
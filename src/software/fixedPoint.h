@@ -0,0 +1,18 @@
+#ifndef __FIXED_POINT_H__
+#define __FIXED_POINT_H__
+
+// Only needs the standard libraries, so the conversions can be used by the host tests
+#include <stdint.h>
+#include <math.h>
+
+// Fixed point positions are kept in encoder increments (2^15 per revolution)
+// Degrees are only computed at the UI/serial boundary
+#define INCREMENTS_PER_REV_BITS     15
+#define INCREMENTS_PER_REV          (1L << INCREMENTS_PER_REV_BITS)
+#define INCREMENTS_TO_DEG(INC)      ((INC) * (360.0 / INCREMENTS_PER_REV))
+#define DEG_TO_INCREMENTS(DEG)      ((int32_t)round((DEG) * (INCREMENTS_PER_REV / 360.0)))
+
+// Wraps a difference of increments into a half revolution in either direction
+#define WRAP_INCREMENTS(INC)        ((((INC) + (INCREMENTS_PER_REV / 2)) & (INCREMENTS_PER_REV - 1)) - (INCREMENTS_PER_REV / 2))
+
+#endif // ! __FIXED_POINT_H__
@@ -0,0 +1,87 @@
+// Import the header file
+#include "linearization.h"
+
+// Only compile this file if the linearization is enabled
+#ifdef ENABLE_ENCODER_LINEARIZATION
+
+// Builds the table from the readings of each full step of a revolution
+void buildLinearizationTable(int32_t* readings, int32_t fullSteps, int16_t* table) {
+
+    // Storage for the errors of each of the full steps
+    int16_t* errors = new int16_t[fullSteps];
+
+    // Find which way the encoder turns when stepping forward
+    int32_t direction = (WRAP_INCREMENTS(readings[1] - readings[0]) >= 0) ? 1 : -1;
+
+    // Find the error of each step from an even spacing, as well as the average error (the offset of the spacing)
+    int32_t totalError = 0;
+    for (int32_t step = 0; step < fullSteps; step++) {
+        int32_t idealReading = direction * (((step * INCREMENTS_PER_REV) + (fullSteps / 2)) / fullSteps);
+        errors[step] = WRAP_INCREMENTS(readings[step] - idealReading);
+        totalError += WRAP_INCREMENTS(errors[step] - errors[0]);
+    }
+    int32_t averageError = errors[0] + (totalError / fullSteps);
+
+    // Remove the offset, only the nonlinearity is left. Also wrap the readings into a revolution
+    int32_t lowestStep = 0;
+    for (int32_t step = 0; step < fullSteps; step++) {
+        errors[step] = WRAP_INCREMENTS(errors[step] - averageError);
+        readings[step] &= (INCREMENTS_PER_REV - 1);
+
+        // Keep track of the lowest reading (the table is built in order of the readings)
+        if (readings[step] < readings[lowestStep]) {
+            lowestStep = step;
+        }
+    }
+
+    // Start with the readings around 0 (the one below is from the previous revolution)
+    int32_t lowStep = (lowestStep + fullSteps - direction) % fullSteps;
+    int32_t lowReading = readings[lowStep] - INCREMENTS_PER_REV;
+    int32_t highStep = lowestStep;
+    int32_t highReading = readings[lowestStep];
+
+    // Interpolate the error at the start of each slice of the revolution
+    for (int32_t point = 0; point < ENCODER_LINEARIZATION_POINTS; point++) {
+
+        // Angle at the start of the slice
+        int32_t angle = point << LINEARIZATION_BIN_BITS;
+
+        // Move up to the pair of readings around the angle
+        while (highReading <= angle) {
+            lowStep = highStep;
+            lowReading = highReading;
+            highStep = (highStep + fullSteps + direction) % fullSteps;
+            highReading = readings[highStep];
+
+            // The last reading wraps around to the next revolution
+            if (highReading < lowReading) {
+                highReading += INCREMENTS_PER_REV;
+            }
+        }
+
+        // Interpolate between the errors of the readings
+        table[point] = errors[lowStep] + (((errors[highStep] - errors[lowStep]) * (angle - lowReading)) / (highReading - lowReading));
+    }
+
+    // Done with the errors
+    delete[] errors;
+}
+
+
+// Removes the error in the table from a raw reading
+int32_t applyLinearization(const int16_t* table, uint16_t rawIncrements) {
+
+    // Find the slice of the revolution, as well as how far through the slice the reading is
+    uint16_t index = rawIncrements >> LINEARIZATION_BIN_BITS;
+    int32_t fraction = rawIncrements & ((1 << LINEARIZATION_BIN_BITS) - 1);
+
+    // Interpolate between the start of this slice and the start of the next (the last slice wraps to the first)
+    int32_t lowCorrection = table[index];
+    int32_t highCorrection = table[(index + 1) & (ENCODER_LINEARIZATION_POINTS - 1)];
+    int32_t correction = lowCorrection + (((highCorrection - lowCorrection) * fraction) >> LINEARIZATION_BIN_BITS);
+
+    // Remove the error from the reading
+    return (rawIncrements - correction);
+}
+
+#endif // ! ENABLE_ENCODER_LINEARIZATION
@@ -0,0 +1,28 @@
+#ifndef __LINEARIZATION_H__
+#define __LINEARIZATION_H__
+
+// Include main config
+#include "config.h"
+
+// Only build this file if the linearization is enabled
+#ifdef ENABLE_ENCODER_LINEARIZATION
+
+// For the increment units
+#include "fixedPoint.h"
+
+// Encoder linearization
+// The table holds the error of the encoder at the start of each slice of a revolution (in increments, indexed by the raw
+// reading). The error in between is interpolated, then removed from the reading
+#define ENCODER_LINEARIZATION_POINTS (1 << ENCODER_LINEARIZATION_BITS)
+#define LINEARIZATION_BIN_BITS       (INCREMENTS_PER_REV_BITS - ENCODER_LINEARIZATION_BITS)
+
+// Builds the table from the readings of each full step of a revolution (in step order, in increments). The readings don't need
+// to be wrapped into a revolution, they're wrapped in place. The encoder can turn either way when stepping forward
+void buildLinearizationTable(int32_t* readings, int32_t fullSteps, int16_t* table);
+
+// Removes the error in the table from a raw reading
+int32_t applyLinearization(const int16_t* table, uint16_t rawIncrements);
+
+#endif // ! ENABLE_ENCODER_LINEARIZATION
+
+#endif // ! __LINEARIZATION_H__
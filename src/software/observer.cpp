@@ -0,0 +1,95 @@
+// Import the header file
+#include "observer.h"
+
+// The gain that is applied to the acceleration has to stay inside 64 bits through the correction (at the largest residual and the
+// smallest time between samples, before the first shift)
+static_assert(2 * OBSERVER_GAMMA * (1L << OBSERVER_SHIFT) * ((double)OBSERVER_MAX_RESIDUAL * (1L << OBSERVER_SHIFT)) * 1000000.0 / OBSERVER_MIN_DT < 9.2e18,
+              "OBSERVER_GAMMA is too large, the acceleration correction would overflow");
+
+
+// Updates the estimates with a new position sample
+void PositionObserver::update(int32_t newPosition, uint64_t timestamp) {
+
+    // Time since the last sample (us). Anything over the max restarts the observer, so it's only converted if it's shorter
+    uint64_t dtCycles = timestamp - time;
+    int32_t dt = (dtCycles > microsToCycles(OBSERVER_MAX_DT)) ? (OBSERVER_MAX_DT + 1) : (int32_t)cyclesToMicros((uint32_t)dtCycles);
+
+    // Samples that are too close together are from the same sensor update, nothing new to learn
+    if (started && (dt < OBSERVER_MIN_DT)) {
+        return;
+    }
+
+    // Restart the observer if it isn't running or hasn't been updated in a while
+    if (!started || (dt > OBSERVER_MAX_DT)) {
+        restartAt(newPosition, timestamp);
+        return;
+    }
+
+    // Predict the velocity and position at the sample time (both in Q16)
+    // The velocity changes by a * dt / 10^6 (2^16 / 10^6 is 2^10 / 15625), and the position by the average velocity * dt / 10^6
+    int64_t predictedVelocity = velocity + ((((int64_t)accel * dt) << (OBSERVER_SHIFT - 6)) / 15625);
+    int64_t predictedPosition = position + ((((velocity + predictedVelocity) >> 7) * dt) / 15625);
+
+    // Error between the prediction and the sample
+    int64_t residual = ((int64_t)newPosition << OBSERVER_SHIFT) - predictedPosition;
+
+    // Restart the observer if the position jumped (such as after zeroing)
+    if ((residual > ((int64_t)OBSERVER_MAX_RESIDUAL << OBSERVER_SHIFT)) || (residual < -((int64_t)OBSERVER_MAX_RESIDUAL << OBSERVER_SHIFT))) {
+        restartAt(newPosition, timestamp);
+        return;
+    }
+
+    // Correct the estimates
+    // Position: alpha * r, velocity: beta * r / dt, acceleration: 2 * gamma * r / dt^2
+    // The times are in us, so the velocity is scaled by 10^6 and the acceleration by 10^12. Each 10^6 / dt of the acceleration
+    // is applied in turn, with a shift after each, so that it stays inside 64 bits
+    int64_t accelChange = ((((((OBSERVER_FIXED(2 * OBSERVER_GAMMA) * residual) / dt) * 1000000) / dt) >> OBSERVER_SHIFT) * 1000000) >> OBSERVER_SHIFT;
+    position = predictedPosition + ((OBSERVER_FIXED(OBSERVER_ALPHA) * residual) >> OBSERVER_SHIFT);
+    velocity = predictedVelocity + ((((OBSERVER_FIXED(OBSERVER_BETA) * residual) / dt) * 1000000) >> OBSERVER_SHIFT);
+    accel = (int32_t)constrain(accel + accelChange, (int64_t)INT32_MIN, (int64_t)INT32_MAX);
+    velocityEstimate = (int32_t)(velocity >> OBSERVER_SHIFT);
+
+    // Save the sample time
+    time = timestamp;
+}
+
+
+// Restarts the observer from the next sample
+void PositionObserver::restart() {
+    started = false;
+}
+
+
+// Restarts the observer at rest, at a position sample
+void PositionObserver::restartAt(int32_t newPosition, uint64_t timestamp) {
+    position = (int64_t)newPosition << OBSERVER_SHIFT;
+    velocity = 0;
+    velocityEstimate = 0;
+    accel = 0;
+    time = timestamp;
+    started = true;
+}
+
+
+// Returns if the observer has been started by a sample
+bool PositionObserver::isStarted() const {
+    return started;
+}
+
+
+// Returns the position estimate (in increments)
+int32_t PositionObserver::getPosition() const {
+    return (int32_t)(position >> OBSERVER_SHIFT);
+}
+
+
+// Returns the velocity estimate (in increments/s)
+int32_t PositionObserver::getVelocity() const {
+    return velocityEstimate;
+}
+
+
+// Returns the acceleration estimate (in increments/s^2)
+int32_t PositionObserver::getAccel() const {
+    return accel;
+}
@@ -0,0 +1,54 @@
+#ifndef __OBSERVER_H__
+#define __OBSERVER_H__
+
+// Include main config
+#include "config.h"
+
+// Sample times are cycle counts
+#include "cycleTimer.h"
+
+// Observer settings
+// The gains are in Q16, the position is kept in Q16 increments
+#define OBSERVER_SHIFT          16
+#define OBSERVER_FIXED(GAIN)    ((int64_t)((GAIN) * (1L << OBSERVER_SHIFT) + 0.5))
+#define OBSERVER_MIN_DT         20      // Samples closer than this are from the same sensor update (us)
+#define OBSERVER_MAX_DT         100000  // Samples further apart than this restart the observer (us)
+#define OBSERVER_MAX_RESIDUAL   1024    // Prediction errors larger than this restart the observer (increments)
+
+// Position, velocity, and acceleration observer (alpha-beta-gamma tracking filter)
+// Each sample is compared to the position predicted from the last estimates, and a share of the error (the residual) corrects
+// each of the estimates. Everything is integer math, the position is in Q16 increments
+class PositionObserver {
+
+    public:
+        // Updates the estimates with a new position sample (increments), taken at a 64 bit cycle count
+        void update(int32_t position, uint64_t timestamp);
+
+        // Restarts the observer from the next sample (the position jumped, such as after zeroing)
+        void restart();
+
+        // Returns if the observer has been started by a sample
+        bool isStarted() const;
+
+        // Returns the estimates (increments, increments/s, and increments/s^2)
+        // The position is 64 bits, so the caller has to make sure that an update can't interrupt the read
+        int32_t getPosition() const;
+        int32_t getVelocity() const;
+        int32_t getAccel() const;
+
+    private:
+        // Restarts the observer at rest, at a position sample
+        void restartAt(int32_t newPosition, uint64_t timestamp);
+
+        // State (position in Q16 increments, velocity in Q16 increments/s, acceleration in increments/s^2)
+        // The low gains make small corrections, so the position and velocity keep the fraction. The velocity estimate is
+        // a copy of the velocity in increments/s that can be read in one go
+        bool started = false;
+        int64_t position = 0;
+        int64_t velocity = 0;
+        volatile int32_t velocityEstimate = 0;
+        volatile int32_t accel = 0;
+        uint64_t time = 0;
+};
+
+#endif // ! __OBSERVER_H__
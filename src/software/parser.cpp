@@ -15,15 +15,23 @@ String parseCommand(String buffer) {
     //  - M93 (ex M93 V1.8 or M93) - Sets the angle of a full step. This value should be 1.8° or 0.9°. If no value is provided, then the current value will be returned.
     //  - M115 (ex M115) - Prints out firmware information, consisting of the version and any enabled features.
     //  - M116 (ex M116 S1 M"A message") - Simple forward command that will forward a message across the CAN bus. Can be used for pinging or allowing a Serial to connect to the CAN network
+    //  - M122 (ex M122 or M122 S0) - Prints the encoder communication error counters (system, interface, invalid angle, CRC, failed reads, and revolution mismatches). S0 clears the counters.
     //  - M306 (ex M306 P1 I1 D1 W10 or M306) - Sets or gets the PID values for the motor. W term is the maximum value of the I windup. If no values are provided, then the current values will be returned.
-    //  - M307 (ex M307) - Runs an autotune sequence for the PID loop
+    //  - M307 (ex M307 A1.8 S1 or M307) - Runs a relay autotune of the PID loop (or the cascaded control), oscillating the motor around the desired position. A is the amplitude of the oscillation (deg), S1 saves the gains found to flash. Returns the ultimate gain and period, and the gains
     //  - M308 (ex M308) - Runs the manual PID tuning interface. Serial is filled with encoder angles
-    //  - M350 (ex M350 V16 or M350) - Sets or gets the microstepping divisor for the motor. This value can be 1, 2, 4, 8, 16, or 32. If no value is provided, then the current microstepping divisor will be returned.
+    //  - M309 (ex M309 P50 V1 I100 L3600 or M309) - Sets or gets the cascaded control gains: position loop P (P), velocity loop P (V) and I (I), and the max velocity of the position loop (L, deg/s). If no values are provided, then the current values will be returned.
+    //  - M310 (ex M310 V1 A0 C10 or M310) - Sets or gets the step rate feedforward gains: velocity (V, output per deg/s, only used by the PID), acceleration (A, output per deg/s^2), and current (C, mA per 1000 deg/s^2, only with dynamic current). If no values are provided, then the current values will be returned.
+    //  - M350 (ex M350 V16 or M350) - Sets or gets the microstepping divisor for the motor. This value can be 1, 2, 4, 8, 16, 32, 64, 128, or 256. If no value is provided, then the current microstepping divisor will be returned.
     //  - M352 (ex M352 S1 or M352) - Sets or gets the direction pin inversion for the motor (0 is standard, 1 is inverted). If no value is provided, then the current value will be returned.
     //  - M353 (ex M353 S1 or M353) - Sets or gets the enable pin inversion for the motor (0 is standard, 1 is inverted). If no value is provided, then the current value will be returned.
     //  - M354 (ex M354 S1 or M354) - Sets or gets if the motor dip switches were installed incorrectly (reversed) (0 is standard, 1 is inverted). If no value is provided, then the current value will be returned.
-    //  - M355 (ex M355 V1.34 or M355) - Sets or gets the microstep multiplier for the board. Allows to use multiple motors connected to the same mainboard pin, yet have different rates. If no value is provided, then the current value will be returned.
+    //  - M355 (ex M355 V1.34, M355 N67 D50, or M355) - Sets or gets the microstep multiplier for the board, either as a decimal (V) or an exact ratio of microsteps per step pulse (N/D). Allows to use multiple motors connected to the same mainboard pin, yet have different rates. If no value is provided, then the current value will be returned.
     //  - M356 (ex M356 V1 or M356 VX2 or M356) - Sets or gets the CAN ID of the board. Can be set using the axis character or actual ID. If no value is provided, then the current value will be returned.
+    //  - M357 (ex M357 R0 P1 or M357) - Sets or gets the encoder update rate (R, 0 = 21.3us, 1 = 42.7us, 2 = 85.3us, 3 = 170.6us) and angle prediction (P, 0 is off, 1 is on). If no values are provided, then the current values will be returned.
+    //  - M358 (ex M358 or M358 P1) - Benchmarks the angle noise and step latency of the encoder at every update rate, with the prediction set by P (defaults to the current setting). The motor will move.
+    //  - M359 (ex M359 or M359 S0) - Reports the step pulses counted by the hardware counter and the steps followed by the motor since the counts were last reset (with their average rates), and the missed steps. With ENABLE_HARDWARE_STEP_COUNTING, also the most steps counted in a coil update (as a rate), the coil update time and overruns, and the longest interrupt block (the direction has to be set before a step for longer than this). S0 resets the counts. Used to find the maximum step rate: raise the step frequency until steps are missed or updates overrun (steps must only come from the step pin).
+    //  - M360 (ex M360 D1000 P50 or M360) - Sets or gets the standstill current reduction. D is the time (ms) without steps before the current is reduced (0 disables), P is the holding current (percent of the full current). If no values are provided, then the current values will be returned.
+    //  - M361 (ex M361 or M361 S0) - Reports the control loop timing: the CPU cycles taken by each stage (acquire, estimate, control, output) in the last tick and at most, the control loop and correction timer rates, the cycle budget of a tick (a period of the correction timer), the number of ticks that went over it, and the cycles taken by driveCoils() if CHECK_DRIVE_COILS_TIME is defined. S0 resets the max times and counts.
     //  - M500 (ex M500) - Saves the currently loaded parameters into flash
     //  - M501 (ex M501) - Loads all saved parameters from flash
     //  - M502 (ex M502) - Wipes all parameters from flash, then reboots the system
@@ -76,8 +84,23 @@ String parseCommand(String buffer) {
                 // M116 (ex M116 S1) - Simple forward command that will forward a message across the CAN bus. Can be used for pinging or allowing a Serial to connect to the CAN network
                 // The buffer.substring prevents the first M from being read
                 txCANString(parseValue(buffer, 'S').toInt(), parseString(buffer.substring(1), 'M'));
+                return FEEDBACK_OK;
             #endif
 
+            case 122: {
+                // M122 (ex M122 or M122 S0) - Prints the encoder communication error counters (system, interface, invalid angle, CRC, failed reads, and revolution mismatches). S0 clears the counters.
+                if (parseValue(buffer, 'S').toInt() == 0) {
+
+                    // Clear the counters and return ok
+                    motor.encoder.clearErrorCounts();
+                    return FEEDBACK_OK;
+                }
+                else {
+                    // No value exists, return the current counts
+                    return ("SYS: " + String(motor.encoder.getErrorCount(SYSTEM_ERROR)) + " | IF: " + String(motor.encoder.getErrorCount(INTERFACE_ACCESS_ERROR)) + " | ANG: " + String(motor.encoder.getErrorCount(INVALID_ANGLE_ERROR)) + " | CRC: " + String(motor.encoder.getErrorCount(CRC_ERROR)) + " | FAIL: " + String(motor.encoder.getFailedReadCount()) + " | REV: " + String(motor.encoder.getRevMismatchCount()));
+                }
+            }
+
             #ifdef ENABLE_PID
             case 306: {
                 // M306 (ex M306 P1 I1 D1 or M306) - Sets or gets the PID values for the motor. If no values are provided, then the current values will be returned.
@@ -110,10 +133,19 @@ String parseCommand(String buffer) {
             }
             #endif
 
-            case 307:
-                // M307 (ex M307) - Runs a automatic calibration sequence for the PID loop and encoder
-                motor.calibrate();
-                return FEEDBACK_OK;
+            case 307: {
+                // M307 (ex M307 A1.8 S1 or M307) - Runs a relay autotune of the PID loop (or the cascaded control), oscillating the motor around the desired position. A is the amplitude of the oscillation (deg), S1 saves the gains found to flash. Returns the ultimate gain and period, and the gains
+                #ifdef ENABLE_PID_AUTOTUNE
+                    float amplitude = parseValue(buffer, 'A').toFloat();
+                    if (amplitude <= 0) {
+                        amplitude = AUTOTUNE_AMPLITUDE;
+                    }
+                    return runAutotune(amplitude, (parseValue(buffer, 'S').toInt() == 1));
+                #else
+                    // Return that the feature is not enabled
+                    return FEEDBACK_CAN_NOT_ENABLED;
+                #endif
+            }
 
             case 308:
                 // M308 (ex M308) - Runs the manual PID tuning interface. Serial is filled with encoder angles
@@ -137,14 +169,70 @@ String parseCommand(String buffer) {
                 // When all done, the exit is acknowledged
                 return FEEDBACK_OK;
 
+            case 309: {
+                // M309 (ex M309 P50 V1 I100 L3600 or M309) - Sets or gets the cascaded control gains: position loop P (P), velocity loop P (V) and I (I), and the max velocity of the position loop (L, deg/s). If no values are provided, then the current values will be returned.
+                #ifdef ENABLE_CASCADED_CONTROL
+                    float positionP =   parseValue(buffer, 'P').toFloat();
+                    float velocityP =   parseValue(buffer, 'V').toFloat();
+                    float velocityI =   parseValue(buffer, 'I').toFloat();
+                    float maxVelocity = parseValue(buffer, 'L').toFloat();
+                    if (!((positionP == -1) && (velocityP == -1) && (velocityI == -1) && (maxVelocity == -1))) {
+
+                        // There is at least one valid value (the setters ignore the missing ones, they're -1)
+                        pid.setPositionP(positionP);
+                        pid.setVelocityP(velocityP);
+                        pid.setVelocityI(velocityI);
+                        pid.setMaxVelocity(maxVelocity);
+                        return FEEDBACK_OK;
+                    }
+                    else {
+                        // No values are included, get and return the current values
+                        return ("P: " + String(pid.getPositionP()) + " | V: " + String(pid.getVelocityP()) + " | I: " + String(pid.getVelocityI()) + " | L: " + String(pid.getMaxVelocity()));
+                    }
+                #else
+                    // Return that the feature is not enabled
+                    return FEEDBACK_CAN_NOT_ENABLED;
+                #endif
+            }
+
+            case 310: {
+                // M310 (ex M310 V1 A0 C10 or M310) - Sets or gets the step rate feedforward gains: velocity (V, output per deg/s, only used by the PID), acceleration (A, output per deg/s^2), and current (C, mA per 1000 deg/s^2, only with dynamic current). If no values are provided, then the current values will be returned.
+                #ifdef ENABLE_STEP_FEEDFORWARD
+                    float velocityFF = parseValue(buffer, 'V').toFloat();
+                    float accelFF =    parseValue(buffer, 'A').toFloat();
+                    int32_t currentFF = parseValue(buffer, 'C').toInt();
+                    if (!((velocityFF == -1) && (accelFF == -1) && (currentFF == -1))) {
+
+                        // There is at least one valid value (the setters ignore the missing ones, they're -1)
+                        pid.setVelocityFF(velocityFF);
+                        pid.setAccelFF(accelFF);
+                        #ifdef ENABLE_DYNAMIC_CURRENT
+                            motor.setCurrentFeedforward(currentFF);
+                        #endif
+                        return FEEDBACK_OK;
+                    }
+                    else {
+                        // No values are included, get and return the current values
+                        #ifdef ENABLE_DYNAMIC_CURRENT
+                            return ("V: " + String(pid.getVelocityFF()) + " | A: " + String(pid.getAccelFF()) + " | C: " + String(motor.getCurrentFeedforward()));
+                        #else
+                            return ("V: " + String(pid.getVelocityFF()) + " | A: " + String(pid.getAccelFF()));
+                        #endif
+                    }
+                #else
+                    // Return that the feature is not enabled
+                    return FEEDBACK_CAN_NOT_ENABLED;
+                #endif
+            }
+
             case 350: {
-                // M350 (ex M350 V16 or M350) - Sets the microstepping divisor for the motor. This value can be 1, 2, 4, 8, 16, or 32. Sets or gets the microstepping divisor for the motor. This value can be 1, 2, 4, 8, 16, or 32. If no value is provided, then the current microstepping divisor will be returned.
+                // M350 (ex M350 V16 or M350) - Sets the microstepping divisor for the motor. This value can be 1, 2, 4, 8, 16, 32, 64, 128, or 256. Sets or gets the microstepping divisor for the motor. This value can be 1, 2, 4, 8, 16, 32, 64, 128, or 256. If no value is provided, then the current microstepping divisor will be returned.
                 int16_t setValue = parseValue(buffer, 'V').toInt();
                 if (setValue != -1) {
 
                     // Value is valid, set and return ok
                     motor.setMicrostepping(setValue);
-                    updateCorrectionTimer();
+                    updateCorrectionRate();
                     return FEEDBACK_OK;
                 }
                 else {
@@ -199,9 +287,23 @@ String parseCommand(String buffer) {
             }
 
             case 355: {
-                // M355 (ex M355 V1.34 or M355) - Sets or gets the microstep multiplier for the board. Allows to use multiple motors connected to the same mainboard pin, yet have different rates. If no value is provided, then the current value will be returned.
+                // M355 (ex M355 V1.34, M355 N67 D50, or M355) - Sets or gets the microstep multiplier for the board, either as a decimal (V) or an exact ratio of microsteps per step pulse (N/D). Allows to use multiple motors connected to the same mainboard pin, yet have different rates. If no value is provided, then the current value will be returned.
                 float setValue = parseValue(buffer, 'V').toFloat();
-                if (setValue != -1) {
+                int32_t numeratorValue = parseValue(buffer, 'N').toInt();
+                int32_t denominatorValue = parseValue(buffer, 'D').toInt();
+                if (numeratorValue > 0 || denominatorValue > 0) {
+
+                    // Ratio is set, a missing half keeps its current value
+                    if (numeratorValue <= 0) {
+                        numeratorValue = motor.getMicrostepGearNumerator();
+                    }
+                    if (denominatorValue <= 0) {
+                        denominatorValue = motor.getMicrostepGearDenominator();
+                    }
+                    motor.setMicrostepGearing(min(numeratorValue, (int32_t)UINT16_MAX), min(denominatorValue, (int32_t)UINT16_MAX));
+                    return FEEDBACK_OK;
+                }
+                else if (setValue > 0) {
 
                     // Value is valid, set and return ok
                     motor.setMicrostepMultiplier(setValue);
@@ -209,7 +311,7 @@ String parseCommand(String buffer) {
                 }
                 else {
                     // No value exists, get and return the current value
-                    return String(motor.getMicrostepMultiplier());
+                    return ("N: " + String(motor.getMicrostepGearNumerator()) + " | D: " + String(motor.getMicrostepGearDenominator()) + " (" + String(motor.getMicrostepMultiplier(), 4) + ")");
                 }
             }
 
@@ -315,6 +417,113 @@ String parseCommand(String buffer) {
                 #endif
             }
 
+            case 357: {
+                // M357 (ex M357 R0 P1 or M357) - Sets or gets the encoder update rate (R, 0 = 21.3us, 1 = 42.7us, 2 = 85.3us, 3 = 170.6us) and angle prediction (P, 0 is off, 1 is on). If no values are provided, then the current values will be returned.
+                int16_t rateValue = parseValue(buffer, 'R').toInt();
+                int16_t predictionValue = parseValue(buffer, 'P').toInt();
+                if ((rateValue >= UPDATE_RATE_21US && rateValue <= UPDATE_RATE_171US) || predictionValue == 0 || predictionValue == 1) {
+
+                    // Set the values that were provided, making sure that the sensor took them
+                    if (rateValue >= UPDATE_RATE_21US && rateValue <= UPDATE_RATE_171US) {
+                        if (motor.encoder.setUpdateRate((ENCODER_UPDATE_RATE)rateValue) != NO_ERROR) {
+                            return FEEDBACK_ENCODER_REJECTED;
+                        }
+                    }
+                    if (predictionValue == 0 || predictionValue == 1) {
+                        if (motor.encoder.setPrediction(predictionValue == 1) != NO_ERROR) {
+                            return FEEDBACK_ENCODER_REJECTED;
+                        }
+                    }
+                    return FEEDBACK_OK;
+                }
+                else {
+                    // No value exists, return the current values
+                    return ("R: " + String(motor.encoder.getUpdateRate()) + " (" + String(motor.encoder.getUpdatePeriod()) + "us) | P: " + String(motor.encoder.getPrediction()));
+                }
+            }
+
+            case 358: {
+                // M358 (ex M358 or M358 P1) - Benchmarks the angle noise and step latency of the encoder at every update rate, with the prediction set by P (defaults to the current setting). The motor will move.
+                int16_t predictionValue = parseValue(buffer, 'P').toInt();
+                if (predictionValue == 0 || predictionValue == 1) {
+                    return motor.benchmarkEncoder(predictionValue == 1);
+                }
+                else {
+                    return motor.benchmarkEncoder(motor.encoder.getPrediction());
+                }
+            }
+
+            case 359: {
+                // M359 (ex M359 or M359 S0) - Reports the step pulses counted by the hardware counter and the steps followed by the motor since the counts were last reset (with their average rates), and the missed steps. With ENABLE_HARDWARE_STEP_COUNTING, also the most steps counted in a coil update (as a rate), the coil update time and overruns, and the longest interrupt block (the direction has to be set before a step for longer than this). S0 resets the counts. Used to find the maximum step rate: raise the step frequency until steps are missed or updates overrun (steps must only come from the step pin).
+                static int32_t hardStepStart = 0;
+                static int32_t softStepStart = 0;
+                static uint32_t countStartTime = 0;
+                if (parseValue(buffer, 'S').toInt() == 0) {
+
+                    // Reset the counts
+                    hardStepStart = motor.getHardStepCNT();
+                    softStepStart = motor.getSoftStepCNT();
+                    countStartTime = millis();
+                    #ifdef ENABLE_HARDWARE_STEP_COUNTING
+                        resetStepCounterStats();
+                    #endif
+                    return FEEDBACK_OK;
+                }
+                else {
+                    // Each followed step moves the desired step by the multiplier
+                    int32_t countedSteps = abs(motor.getHardStepCNT() - hardStepStart);
+                    int32_t followedSteps = ((int64_t)abs(motor.getSoftStepCNT() - softStepStart) * motor.getMicrostepGearDenominator()) / motor.getMicrostepGearNumerator();
+
+                    // Average rates since the reset (steps/s)
+                    uint32_t countTime = max(millis() - countStartTime, (uint32_t)1);
+                    String report = "Counted: " + String(countedSteps) + " (" + String((uint32_t)(((int64_t)countedSteps * 1000) / countTime)) + " steps/s) | Followed: " +
+                        String(followedSteps) + " (" + String((uint32_t)(((int64_t)followedSteps * 1000) / countTime)) + " steps/s) | Missed: " + String(countedSteps - followedSteps);
+
+                    // The counter's own limits
+                    #ifdef ENABLE_HARDWARE_STEP_COUNTING
+                        report += " | " + getStepCounterReport();
+                    #endif
+                    return report;
+                }
+            }
+
+            case 360: {
+                // M360 (ex M360 D1000 P50 or M360) - Sets or gets the standstill current reduction. D is the time (ms) without steps before the current is reduced (0 disables), P is the holding current (percent of the full current). If no values are provided, then the current values will be returned.
+                #ifdef ENABLE_STANDSTILL_REDUCTION
+                    int32_t delayValue = parseValue(buffer, 'D').toInt();
+                    int32_t currentValue = parseValue(buffer, 'P').toInt();
+                    if (delayValue >= 0 || currentValue >= 0) {
+
+                        // Set the values that were provided
+                        if (delayValue >= 0) {
+                            motor.setStandstillDelay(constrain(delayValue, 0, UINT16_MAX - 1));
+                        }
+                        if (currentValue >= 0) {
+                            motor.setStandstillCurrent(constrain(currentValue, 0, 100));
+                        }
+                        return FEEDBACK_OK;
+                    }
+                    else {
+                        // No value exists, return the current values
+                        return ("D: " + String(motor.getStandstillDelay()) + " | P: " + String(motor.getStandstillCurrent()) + " | Active: " + String(motor.getStandstillActive()));
+                    }
+                #else
+                    // Return that the feature is not enabled
+                    return FEEDBACK_CAN_NOT_ENABLED;
+                #endif
+            }
+
+            case 361: {
+                // M361 (ex M361 or M361 S0) - Reports the control loop timing: the CPU cycles taken by each stage (acquire, estimate, control, output) in the last tick and at most, the control loop and correction timer rates, the cycle budget of a tick (a period of the correction timer), the number of ticks that went over it, and the cycles taken by driveCoils() if CHECK_DRIVE_COILS_TIME is defined. S0 resets the max times and counts.
+                if (parseValue(buffer, 'S').toInt() == 0) {
+                    resetControlLoopStats();
+                    return FEEDBACK_OK;
+                }
+                else {
+                    return getControlLoopReport();
+                }
+            }
+
             case 500:
                 // M500 (ex M500) - Saves the currently loaded parameters into flash
                 saveParameters();
@@ -333,10 +542,10 @@ String parseCommand(String buffer) {
             case 907: {
                 // Sets or gets the RMS(R) or Peak(P) current in mA. If dynamic current is enabled, then the accel(A), idle(I), and/or max(M) can be set or retrieved. If no value is set, then the current RMS current (no dynamic current) or the accel, idle, and max terms (dynamic current) will be returned.
                 #ifdef ENABLE_DYNAMIC_CURRENT
-                    // Read the set values
-                    uint16_t accelCurrent = parseValue(buffer, 'A').toInt();
-                    uint16_t idleCurrent = parseValue(buffer, 'I').toInt();
-                    uint16_t maxCurrent = parseValue(buffer, 'M').toInt();
+                    // Read the set values (missing values are -1, the setters ignore them)
+                    int32_t accelCurrent = parseValue(buffer, 'A').toInt();
+                    int32_t idleCurrent = parseValue(buffer, 'I').toInt();
+                    int32_t maxCurrent = parseValue(buffer, 'M').toInt();
 
                     // Check to make sure that at least one isn't -1 (there is at least one that is valid)
                     if (!((accelCurrent == -1) && (idleCurrent == -1) && (maxCurrent == -1))) {
@@ -345,10 +554,11 @@ String parseCommand(String buffer) {
                         motor.setDynamicAccelCurrent(accelCurrent);
                         motor.setDynamicIdleCurrent(idleCurrent);
                         motor.setDynamicMaxCurrent(maxCurrent);
+                        return FEEDBACK_OK;
                     }
                     else {
-                        // No valid values, therefore just return the current values
-                        return ("A:" + String(motor.getDynamicAccelCurrent()) + " I: " + String(motor.getDynamicIdleCurrent()) + " M: " + String(motor.getDynamicMaxCurrent()) + "\n");
+                        // No valid values, therefore just return the current values (and the current that the dynamic current is at)
+                        return ("A:" + String(motor.getDynamicAccelCurrent()) + " I: " + String(motor.getDynamicIdleCurrent()) + " M: " + String(motor.getDynamicMaxCurrent()) + " C: " + String(motor.getDynamicCurrent()) + "\n");
                     }
 
                 #else
@@ -5,6 +5,7 @@
 #include "main.h"
 #include "flash.h"
 #include "config.h"
+#include "autotune.h"
 
 // Defines for strings that are used repeatedly
 #define FEEDBACK_NO_VALUE          F("No value specified! Make sure to specify a value with a letter before it")
@@ -13,6 +14,7 @@
 #define FEEDBACK_INVALID_STRING    F("Invalid string. Make sure that the string had double quotations on each side")
 #define FEEDBACK_NO_CMD_SPECIFIED  F("No command specified")
 #define FEEDBACK_CMD_NOT_AVAILABLE F("Command number not recognized")
+#define FEEDBACK_ENCODER_REJECTED  F("The encoder did not accept the setting")
 
 // Parse a string for commands, returning the feedback on the command
 String parseCommand(String buffer);
@@ -12,123 +12,234 @@ StepperPID::StepperPID() {
 
 // Returns the Proportional value of the PID loop
 float StepperPID::getP() const {
-    return (this -> kP);
+    return fixedPID.getP();
 }
 
 
 // Returns the Integral value fo the PID loop
 float StepperPID::getI() const {
-    return (this -> kI);
+    return fixedPID.getI();
 }
 
 
 // Returns the Derivative value for the PID loop
 float StepperPID::getD() const {
-    return (this -> kD);
+    return fixedPID.getD();
 }
 
 
 // Returns the maximum value of the I term of the PID loop
 float StepperPID::getMaxI() const {
-    return (this -> maxI);
+    return fixedPID.getMaxI();
 }
 
 
-// Sets the Proportional term of the PID loop
+// Sets the Proportional term of the PID loop (negative values are ignored)
 void StepperPID::setP(float newP) {
-
-    // Update the term if the new value isn't negative
-    if (newP >= 0) {
-        kP = newP;
-    }
+    fixedPID.setP(newP);
 }
 
 
-// Sets the Integral term of the PID loop
+// Sets the Integral term of the PID loop (negative values are ignored)
 void StepperPID::setI(float newI) {
-
-    // Update the term if the new value isn't negative
-    if (newI >= 0) {
-        kI = newI;
-    }
+    fixedPID.setI(newI);
 }
 
 
-// Sets the Derivative of the PID loop
+// Sets the Derivative of the PID loop (negative values are ignored)
 void StepperPID::setD(float newD) {
-
-    // Update the term if the new value isn't negative
-    if (newD >= 0) {
-        kD = newD;
-    }
+    fixedPID.setD(newD);
 }
 
 
-// Sets the maximum value of the I term of the PID loop
+// Sets the maximum value of the I term of the PID loop (negative values are ignored)
 void StepperPID::setMaxI(float newMaxI) {
-
-    // Update the term if the new value isn't negative
-    if (newMaxI >= 0) {
-        maxI = newMaxI;
-    }
+    fixedPID.setMaxI(newMaxI);
 }
 
 // Get the desired position
-float StepperPID::getDesiredPosition() {
+int32_t StepperPID::getDesiredPosition() {
     return (this -> setpoint);
 }
 
 
 // Set the desired position
-void StepperPID::setDesiredPosition(float angle) {
-    this -> setpoint = angle;
+void StepperPID::setDesiredPosition(int32_t position) {
+    this -> setpoint = position;
 }
 
 
 // Set the output limits of the loop
-void StepperPID::setOutputLimits(float newMin, float newMax) {
+void StepperPID::setOutputLimits(int32_t newMin, int32_t newMax) {
     this -> min = newMin;
     this -> max = newMax;
 }
 
 
 // Update the PID loop, returning the output
-float StepperPID::compute() {
+// Everything is done with integers, the gains are converted to fixed point when they are set
+int32_t StepperPID::compute() {
 
-    // Update the input
-    this -> input = motor.encoder.getAbsoluteAngleAvgFloat();
+    // The cascaded control replaces the PID
+    #ifdef ENABLE_CASCADED_CONTROL
+        return computeCascade();
+    #else
 
-    // Update the setpoint
-    this -> setpoint = motor.getDesiredAngle();
+        // Update the input
+        this -> input = motor.encoder.getAbsolutePositionAvg();
 
-    // Compute the PID
-    // Update the current time
-    this -> currentTime = millis();
+        // Update the setpoint
+        this -> setpoint = motor.getDesiredPosition();
 
-    // Calculate the elapsed time
-    this -> elapsedTime = (float)((this -> currentTime) - (this -> previousTime));
+        // Compute the PID
+        // Update the current time (cycle count)
+        this -> currentTime = cycleCount64();
 
-    // Calculate the error
-    this -> error = (setpoint - input);
+        // Calculate the elapsed time (us), capped at a second so a long pause between computations isn't all integrated at once
+        uint64_t elapsedCycles = (this -> currentTime) - (this -> previousTime);
+        this -> elapsedTime = (elapsedCycles > microsToCycles(PID_MAX_ELAPSED_TIME)) ? PID_MAX_ELAPSED_TIME : (int32_t)cyclesToMicros((uint32_t)elapsedCycles);
+
+        // Calculate the error
+        this -> error = (setpoint - input);
+
+        // Feed the step input's velocity and acceleration forward
+        int64_t feedforward = 0;
+        #ifdef ENABLE_STEP_FEEDFORWARD
+            feedforward = ((int64_t)(this -> kVelocityFFFixed) * motor.getStepVelocity()) + ((int64_t)(this -> kAccelFFFixed) * motor.getStepAccel());
+        #endif
+
+        // Run the PID on the error, with the observer's velocity for the D term
+        this -> output = fixedPID.compute(this -> error, motor.encoder.getObserverVelocity(), this -> elapsedTime, feedforward);
+
+        // Update the last computation parameters
+        this -> previousTime = this -> currentTime;
+
+        // Return the output of the PID loop
+        return (this -> output);
+    #endif // ! ENABLE_CASCADED_CONTROL
+}
+
+
+// Clears the integral and the history of the last computation
+void StepperPID::reset() {
+    fixedPID.reset();
+    this -> previousTime = cycleCount64();
+
+    // Also clear the velocity integral of the cascade
+    #ifdef ENABLE_CASCADED_CONTROL
+        fixedCascade.reset();
+    #endif
+}
+
+
+// Step rate feedforward
+#ifdef ENABLE_STEP_FEEDFORWARD
+
+// Returns the velocity feedforward gain
+float StepperPID::getVelocityFF() const {
+    return (this -> kVelocityFF);
+}
+
+
+// Returns the acceleration feedforward gain
+float StepperPID::getAccelFF() const {
+    return (this -> kAccelFF);
+}
+
+
+// Sets the velocity feedforward gain
+void StepperPID::setVelocityFF(float newVelocityFF) {
+
+    // Update the gain if the new value isn't negative
+    if (newVelocityFF >= 0) {
+        kVelocityFF = newVelocityFF;
+        kVelocityFFFixed = PID_FIXED_GAIN(newVelocityFF);
+    }
+}
 
-    // Calculate the cumulative error (used with I term)
-    this -> cumulativeError += ((this -> error) * (this -> elapsedTime));
 
-    // Clamp the cumulative error, preventing I term windup
-    this -> cumulativeError = constrain(cumulativeError, -maxI, maxI);
+// Sets the acceleration feedforward gain
+void StepperPID::setAccelFF(float newAccelFF) {
 
-    // Calculate the rate error
-    this -> rateError = ((this -> error) - (this -> lastError)) / elapsedTime;
+    // Update the gain if the new value isn't negative
+    if (newAccelFF >= 0) {
+        kAccelFF = newAccelFF;
+        kAccelFFFixed = PID_FIXED_GAIN(newAccelFF);
+    }
+}
+
+#endif // ! ENABLE_STEP_FEEDFORWARD
+
+
+// Cascaded control
+#ifdef ENABLE_CASCADED_CONTROL
+
+// Returns the gain of the position loop
+float StepperPID::getPositionP() const {
+    return fixedCascade.getPositionP();
+}
+
+
+// Returns the proportional gain of the velocity loop
+float StepperPID::getVelocityP() const {
+    return fixedCascade.getVelocityP();
+}
+
+
+// Returns the integral gain of the velocity loop
+float StepperPID::getVelocityI() const {
+    return fixedCascade.getVelocityI();
+}
+
+
+// Returns the max velocity that the position loop can command
+float StepperPID::getMaxVelocity() const {
+    return fixedCascade.getMaxVelocity();
+}
 
-    // Calculate the output with the errors and the coefficients
-    this -> output = ((this -> kP) * (this -> error)) + ((this -> kI) * (this -> cumulativeError)) + ((this -> kD) * (this -> rateError));
 
-    // Update the last computation parameters
-    this -> lastError = this -> error;
-    this -> previousTime = this -> currentTime;
+// Sets the gain of the position loop
+void StepperPID::setPositionP(float newPositionP) {
+    fixedCascade.setPositionP(newPositionP);
+}
+
+
+// Sets the proportional gain of the velocity loop
+void StepperPID::setVelocityP(float newVelocityP) {
+    fixedCascade.setVelocityP(newVelocityP);
+}
+
+
+// Sets the integral gain of the velocity loop
+void StepperPID::setVelocityI(float newVelocityI) {
+    fixedCascade.setVelocityI(newVelocityI);
+}
+
+
+// Sets the max velocity that the position loop can command
+void StepperPID::setMaxVelocity(float newMaxVelocity) {
+    fixedCascade.setMaxVelocity(newMaxVelocity);
+}
+
+
+// Runs the position and velocity loops (called on every control loop update out of position)
+int32_t StepperPID::computeCascade() {
+
+    // Update the input and the setpoint
+    this -> input = motor.encoder.getAbsolutePositionAvg();
+    this -> setpoint = motor.getDesiredPosition();
+    this -> error = (setpoint - input);
+
+    // Feed the step input's acceleration forward
+    int64_t accelFeedforward = 0;
+    #ifdef ENABLE_STEP_FEEDFORWARD
+        accelFeedforward = (int64_t)(this -> kAccelFFFixed) * motor.getStepAccel();
+    #endif
 
-    // Return the output of the PID loop
-    return constrain(this -> output, -DEFAULT_PID_STEP_MAX, DEFAULT_PID_STEP_MAX);
+    // Run both loops on the error, with the observer's velocity for the velocity loop (following the step input's velocity)
+    this -> output = fixedCascade.compute(this -> error, motor.encoder.getObserverVelocity(), motor.getStepVelocity(), accelFeedforward);
+    return (this -> output);
 }
+#endif // ! ENABLE_CASCADED_CONTROL
 
 #endif
\ No newline at end of file
@@ -16,6 +16,12 @@
 // Main (for stepper motor class)
 #include "main.h"
 
+// Cycle counter (for timing the computations)
+#include "cycleTimer.h"
+
+// The fixed point PID and cascade math
+#include "fixedPID.h"
+
 // Main class for controlling the motor
 // NOTE: This should be used for time increments between stepping
 class StepperPID {
@@ -38,48 +44,92 @@ class StepperPID {
         void setD(float newD);
         void setMaxI(float newMaxI);
 
-        // Gets the desired motor angle
-        float getDesiredPosition();
+        // Gets the desired motor position (in encoder increments)
+        int32_t getDesiredPosition();
 
-        // Set the desired motor angle (this is in absolute postioning,
-        // meaning that something like 1500 is a valid position)
-        void setDesiredPosition(float angle);
+        // Set the desired motor position (in encoder increments). This is in absolute postioning,
+        // meaning that something like 150000 is a valid position
+        void setDesiredPosition(int32_t position);
 
         // Sets the min and max outputs of the PID loop
-        void setOutputLimits(float min, float max);
+        void setOutputLimits(int32_t min, int32_t max);
 
         // Runs the PID calculations and returns the output
-        float compute();
+        int32_t compute();
+
+        // Clears the integral and the history of the last computation (the next computation starts fresh)
+        void reset();
+
+        // Step rate feedforward
+        #ifdef ENABLE_STEP_FEEDFORWARD
+
+            // Get functions for the feedforward gains
+            float getVelocityFF() const;
+            float getAccelFF() const;
+
+            // Set functions for the feedforward gains (negative values are ignored)
+            void setVelocityFF(float newVelocityFF);
+            void setAccelFF(float newAccelFF);
+        #endif
+
+        // Cascaded control
+        #ifdef ENABLE_CASCADED_CONTROL
+
+            // Get functions for the cascade gains
+            float getPositionP() const;
+            float getVelocityP() const;
+            float getVelocityI() const;
+            float getMaxVelocity() const;
+
+            // Set functions for the cascade gains (negative values are ignored)
+            void setPositionP(float newPositionP);
+            void setVelocityP(float newVelocityP);
+            void setVelocityI(float newVelocityI);
+            void setMaxVelocity(float newMaxVelocity);
+        #endif
 
     // Private info (usually just variables)
     private:
 
-        // Main variables for storing input, output, and setpoint
-        float input = 0, output = 0, setpoint = 0;
-
-        // P, I, and D terms for loop
-        // Term is multiplied by degrees of error to find stepping rate back
-        float kP = DEFAULT_P;
-        float kI = DEFAULT_I;
-        float kD = DEFAULT_D;
+        // Main variables for storing input, output, and setpoint (positions are in encoder increments)
+        int32_t input = 0, output = 0, setpoint = 0;
 
-        // I windup clamping
-        float maxI = DEFAULT_MAX_I;
+        // The PID math (gains, and the cumulative error)
+        FixedPID fixedPID;
 
         // Min and max caps
-        float min = 0;
-        float max = 0;
+        int32_t min = 0;
+        int32_t max = 0;
 
-        // Time storage
-        uint32_t currentTime;
-        uint32_t previousTime = 0;
-        float elapsedTime;
+        // Time storage (cycle counts, then the elapsed time in us)
+        uint64_t currentTime;
+        uint64_t previousTime = 0;
+        int32_t elapsedTime;
 
         // Intermediate calculation variables
-        float error;
-        float lastError = 0;
-        float cumulativeError;
-        float rateError;
+        int32_t error;
+
+        // Step rate feedforward
+        #ifdef ENABLE_STEP_FEEDFORWARD
+
+            // Gains (velocity FF in output per deg/s, only used by the PID, and accel FF in output per deg/s^2)
+            float kVelocityFF = DEFAULT_VELOCITY_FF;
+            float kAccelFF = DEFAULT_ACCEL_FF;
+
+            // Fixed point versions of the gains
+            int32_t kVelocityFFFixed = PID_FIXED_GAIN(DEFAULT_VELOCITY_FF);
+            int32_t kAccelFFFixed = PID_FIXED_GAIN(DEFAULT_ACCEL_FF);
+        #endif
+
+        // Cascaded control
+        #ifdef ENABLE_CASCADED_CONTROL
+
+            // Runs the position and velocity loops
+            int32_t computeCascade();
+
+            // The cascade math (gains, and the velocity integral)
+            FixedCascade fixedCascade;
+        #endif
 };
 
 #endif // ! ENABLE_PID
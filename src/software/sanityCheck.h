@@ -60,11 +60,81 @@
 #if IS_POWER_2(SINE_VAL_COUNT) != 0
     #error SINE_VAL_COUNT must be a power of 2 to use in fastSin() and fastCos() defines!!!
 #endif
+#if (SINE_VAL_COUNT < 256) || (SINE_VAL_COUNT > 4096)
+    #error SINE_VAL_COUNT must be between 256 and 4096!
+#endif
+#if defined(SINE_INTERPOLATION) && ((SINE_INTERPOLATION_BITS < 1) || (SINE_INTERPOLATION_BITS > 8))
+    #error SINE_INTERPOLATION_BITS must be between 1 and 8!
+#endif
 #if IS_POWER_2(SINE_MAX) != 0
     #error SINE_MAX must be a power of 2 to fast division to SINE_MAX, i.e { y = x / SINE_MAX } is equal to  { y = x >> SINE_POWER }
 #endif
 
 
+// Check to make sure that the coils can be driven to every microstep (the divisor has a cast, so it can't be checked by the preprocessor)
+#ifdef SINE_INTERPOLATION
+    static_assert((SINE_VAL_COUNT << SINE_INTERPOLATION_BITS) / 4 >= MAX_MICROSTEP_DIVISOR, "The sine table must have at least MAX_MICROSTEP_DIVISOR steps in each full step!");
+#else
+    static_assert(SINE_VAL_COUNT / 4 >= MAX_MICROSTEP_DIVISOR, "The sine table must have at least MAX_MICROSTEP_DIVISOR entries in each full step!");
+#endif
+
+
+// Check the control loop rate (frequencies have casts, so they can't be checked by the preprocessor)
+static_assert((CONTROL_UPDATE_FREQ >= 1000) && (CONTROL_UPDATE_FREQ <= 20000), "CONTROL_UPDATE_FREQ must be between 1kHz and 20kHz!");
+
+// Check to make sure that the step counter updates are a multiple of the control loop rate (the control loop runs on every few updates)
+#ifdef ENABLE_HARDWARE_STEP_COUNTING
+    static_assert((STEP_COUNTER_UPDATE_FREQ >= CONTROL_UPDATE_FREQ) && (STEP_COUNTER_UPDATE_FREQ % CONTROL_UPDATE_FREQ == 0), "STEP_COUNTER_UPDATE_FREQ must be a multiple of CONTROL_UPDATE_FREQ!");
+#endif
+
+// Same for the step interpolation, which also needs at least one update in the longest interpolated step
+#ifdef ENABLE_STEP_INTERPOLATION
+    static_assert((STEP_INTERPOLATION_FREQ >= CONTROL_UPDATE_FREQ) && (STEP_INTERPOLATION_FREQ % CONTROL_UPDATE_FREQ == 0), "STEP_INTERPOLATION_FREQ must be a multiple of CONTROL_UPDATE_FREQ!");
+    static_assert((STEP_INTERPOLATION_MAX_PERIOD > 0) && (STEP_INTERPOLATION_MAX_PERIOD <= 1000000), "STEP_INTERPOLATION_MAX_PERIOD must be between 1us and 1s!");
+    static_assert((STEP_INTERPOLATION_FREQ % 100 == 0) && ((uint64_t)STEP_INTERPOLATION_MAX_PERIOD * (STEP_INTERPOLATION_FREQ / 100) <= UINT32_MAX),
+                  "STEP_INTERPOLATION_FREQ must be a multiple of 100Hz, and the update count of the longest step must fit in 32 bits!");
+#endif
+
+// The hardware step counting and the step interpolation both move the coils on the correction timer at a fixed rate
+// The correction is then run on every few updates
+#if defined(ENABLE_HARDWARE_STEP_COUNTING) && defined(ENABLE_STEP_INTERPOLATION)
+    #error ENABLE_STEP_INTERPOLATION cannot be used with ENABLE_HARDWARE_STEP_COUNTING!
+#elif defined(ENABLE_HARDWARE_STEP_COUNTING)
+    #define ENABLE_FIXED_RATE_COMMUTATION
+    #define COMMUTATION_UPDATE_FREQ STEP_COUNTER_UPDATE_FREQ
+#elif defined(ENABLE_STEP_INTERPOLATION)
+    #define ENABLE_FIXED_RATE_COMMUTATION
+    #define COMMUTATION_UPDATE_FREQ STEP_INTERPOLATION_FREQ
+#endif
+
+
+// Check to make sure that the coil direction pins can all be set with a single write (pin names are enums, so they can't be checked by the preprocessor)
+static_assert((STM_PORT(COIL_A_DIR_1_PIN) == STM_PORT(COIL_A_DIR_2_PIN)) && (STM_PORT(COIL_A_DIR_1_PIN) == STM_PORT(COIL_B_DIR_1_PIN)) && (STM_PORT(COIL_A_DIR_1_PIN) == STM_PORT(COIL_B_DIR_2_PIN)),
+              "All of the coil direction pins must be on the same port!");
+
+
+// Check to make sure that the observer gains are stable (floating point, so it can't be checked by the preprocessor)
+static_assert((OBSERVER_ALPHA > 0) && (OBSERVER_ALPHA < 2) && (OBSERVER_BETA > 0) && (OBSERVER_BETA < (4 - 2 * OBSERVER_ALPHA)) && (OBSERVER_GAMMA > 0) && (OBSERVER_GAMMA < (4 * OBSERVER_ALPHA * OBSERVER_BETA / (2 - OBSERVER_ALPHA))),
+              "The observer gains are outside of the stable region!");
+
+
+// Check to make sure that the linearization table fits in its flash page (1KB, minus the marker and point count)
+#ifdef ENABLE_ENCODER_LINEARIZATION
+    #if (ENCODER_LINEARIZATION_BITS < 1) || (ENCODER_LINEARIZATION_BITS > 8)
+        #error ENCODER_LINEARIZATION_BITS must be between 1 and 8!
+    #endif
+#endif
+
+
+// Check the encoder configuration
+#if (ENCODER_DEFAULT_UPDATE_RATE < 0) || (ENCODER_DEFAULT_UPDATE_RATE > 3)
+    #error ENCODER_DEFAULT_UPDATE_RATE must be between 0 and 3!
+#endif
+#if (ENCODER_BENCHMARK_STEPS % 2) != 0
+    #error ENCODER_BENCHMARK_STEPS must be even!
+#endif
+
+
 // Create the firmware print string
 // Firmware feature prints
 #define VERSION_STRING            String(MAJOR_VERSION) + "." + String(MINOR_VERSION) + "." + String(PATCH_VERSION)
@@ -109,8 +179,20 @@
     #define FIRMWARE_FEATURE_OVERTEMP_PROTECTION    ""
 #endif
 
+#ifdef ENABLE_HARDWARE_STEP_COUNTING
+    #define FIRMWARE_FEATURE_HARDWARE_STEP_COUNTING    "\nHardware Step Counting"
+#else
+    #define FIRMWARE_FEATURE_HARDWARE_STEP_COUNTING    ""
+#endif
+
+#ifdef ENABLE_STEP_INTERPOLATION
+    #define FIRMWARE_FEATURE_STEP_INTERPOLATION    "\nStep Interpolation"
+#else
+    #define FIRMWARE_FEATURE_STEP_INTERPOLATION    ""
+#endif
+
 // Main firmware print string
-#define FIRMWARE_FEATURE_PRINT String(FIRMWARE_FEATURE_VERSION + FIRMWARE_BUILD_INFO + FIRMWARE_FEATURE_HEADER + FIRMWARE_FEATURE_OLED + FIRMWARE_FEATURE_SERIAL + FIRMWARE_FEATURE_CAN + FIRMWARE_FEATURE_STALLFAULT + FIRMWARE_FEATURE_DYNAMIC_CURRENT + FIRMWARE_FEATURE_OVERTEMP_PROTECTION)
+#define FIRMWARE_FEATURE_PRINT String(FIRMWARE_FEATURE_VERSION + FIRMWARE_BUILD_INFO + FIRMWARE_FEATURE_HEADER + FIRMWARE_FEATURE_OLED + FIRMWARE_FEATURE_SERIAL + FIRMWARE_FEATURE_CAN + FIRMWARE_FEATURE_STALLFAULT + FIRMWARE_FEATURE_DYNAMIC_CURRENT + FIRMWARE_FEATURE_OVERTEMP_PROTECTION + FIRMWARE_FEATURE_HARDWARE_STEP_COUNTING + FIRMWARE_FEATURE_STEP_INTERPOLATION)
 
 
 // Check for defines that have conflicts
@@ -118,6 +200,64 @@
     #error Only one of the following is allowed at a time: ENABLE_BLINK, CHECK_STEPPING_RATE, CHECK_CORRECT_MOTOR_RATE, or CHECK_ENCODER_SPEED
 #endif
 
+#if defined(ENABLE_PHASE_LEAD) && defined(ENABLE_PID)
+    #error ENABLE_PHASE_LEAD replaces the stepping correction, only one can be enabled at a time
+#endif
+
+#if defined(ENABLE_SERVO_OUTPUT) && ((SERVO_FULL_OUTPUT <= 0) || (SERVO_MIN_CURRENT < 0) || (SERVO_MIN_CURRENT > 100))
+    #error SERVO_FULL_OUTPUT must be positive, and SERVO_MIN_CURRENT must be between 0 and 100!
+#endif
+
+#if defined(ENABLE_DYNAMIC_CURRENT) && ((DYNAMIC_IDLE_CURRENT > DYNAMIC_MAX_CURRENT) || (DYNAMIC_CURRENT_SLEW <= 0))
+    #error DYNAMIC_IDLE_CURRENT must not be larger than DYNAMIC_MAX_CURRENT, and DYNAMIC_CURRENT_SLEW must be positive!
+#endif
+
+// The cascaded control replaces the PID, so PID needs to be enabled
+#if defined(ENABLE_CASCADED_CONTROL) && !defined(ENABLE_PID)
+    #error ENABLE_CASCADED_CONTROL requires ENABLE_PID!
+#endif
+
+// Check the cascaded control gains (floats, so they can't be checked by the preprocessor)
+#ifdef ENABLE_CASCADED_CONTROL
+    static_assert((DEFAULT_POSITION_P >= 0) && (DEFAULT_VELOCITY_P >= 0) && (DEFAULT_VELOCITY_I >= 0) && (DEFAULT_MAX_VELOCITY > 0) && (CASCADE_ANTIWINDUP_RATE >= 0),
+                  "The cascaded control gains must not be negative, and DEFAULT_MAX_VELOCITY must be positive!");
+    static_assert(CASCADE_ANTIWINDUP_RATE <= CONTROL_UPDATE_FREQ, "CASCADE_ANTIWINDUP_RATE must not be faster than CONTROL_UPDATE_FREQ!");
+#endif
+
+// Check the autotune settings (floats, so they can't be checked by the preprocessor)
+#ifdef ENABLE_PID_AUTOTUNE
+    static_assert((AUTOTUNE_HYSTERESIS >= 0) && (AUTOTUNE_AMPLITUDE > 0) && (AUTOTUNE_AMPLITUDE >= 2 * AUTOTUNE_HYSTERESIS), "AUTOTUNE_AMPLITUDE must be positive and at least double AUTOTUNE_HYSTERESIS!");
+    static_assert((AUTOTUNE_CYCLES > 0) && (AUTOTUNE_ABORT_FACTOR > 1) && (AUTOTUNE_TIMEOUT > 0), "AUTOTUNE_CYCLES and AUTOTUNE_TIMEOUT must be positive, and AUTOTUNE_ABORT_FACTOR must be larger than 1!");
+#endif
+
+// Check the feedforward gains (floats, so they can't be checked by the preprocessor)
+#ifdef ENABLE_STEP_FEEDFORWARD
+    static_assert((DEFAULT_VELOCITY_FF >= 0) && (DEFAULT_ACCEL_FF >= 0), "DEFAULT_VELOCITY_FF and DEFAULT_ACCEL_FF must not be negative!");
+#endif
+
+// Both the step rate feedforward and the cascaded control use the velocity and acceleration of the step input
+#if defined(ENABLE_STEP_FEEDFORWARD) || defined(ENABLE_CASCADED_CONTROL)
+    #define ENABLE_STEP_RATE_ESTIMATE
+#endif
+
+// Check the microstep gearing (has a cast, so it can't be checked by the preprocessor)
+static_assert((MICROSTEP_GEAR_NUMERATOR > 0) && (MICROSTEP_GEAR_DENOMINATOR > 0), "MICROSTEP_GEAR_NUMERATOR and MICROSTEP_GEAR_DENOMINATOR must be positive!");
+
+// Check the standstill current (has a cast, so it can't be checked by the preprocessor)
+#ifdef ENABLE_STANDSTILL_REDUCTION
+    static_assert(STANDSTILL_CURRENT <= 100, "STANDSTILL_CURRENT must be a percentage of the full current!");
+#endif
+
+// Both the phase lead and the servo output drive the coils from the measured rotor angle
+#if defined(ENABLE_PHASE_LEAD) || defined(ENABLE_SERVO_OUTPUT)
+    #define ENABLE_ROTOR_COMMUTATION
+#endif
+
+// Closed loop commutation drives the coils from the rotor, so there's nothing to interpolate
+#if defined(ENABLE_STEP_INTERPOLATION) && defined(ENABLE_ROTOR_COMMUTATION)
+    #error ENABLE_STEP_INTERPOLATION cannot be used with ENABLE_PHASE_LEAD or ENABLE_SERVO_OUTPUT!
+#endif
+
 #if defined(CHECK_MCO_OUTPUT) && defined(CHECK_GPIO_OUTPUT_SWITCHING)
     #error Only one of the following is allowed at a time: CHECK_MCO_OUTPUT, CHECK_GPIO_OUTPUT_SWITCHING
 #endif
\ No newline at end of file
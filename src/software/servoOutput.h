@@ -0,0 +1,28 @@
+#ifndef __SERVO_OUTPUT_H__
+#define __SERVO_OUTPUT_H__
+
+// Include main config
+#include "config.h"
+
+// Only build this file if the servo output is enabled
+#ifdef ENABLE_SERVO_OUTPUT
+
+// For the phase units and the current scale
+#include "fastSine.h"
+#include "coilPWM.h"
+
+// Converts a PID output to the angle that the coils are driven ahead of the rotor (SINE_STEPS per electrical cycle)
+// Reaches 90 electrical degrees (the most torque per amp) at SERVO_FULL_OUTPUT
+inline int32_t servoLoadAngle(int32_t output) {
+    return constrain(((int64_t)output * (SINE_STEPS / 4)) / SERVO_FULL_OUTPUT, -(SINE_STEPS / 4), (SINE_STEPS / 4));
+}
+
+// Converts a PID output to the scale of the coil current (CURRENT_SCALE_MAX is the full current)
+// Never drops below SERVO_MIN_CURRENT, so the rotor is still held near the target
+inline uint32_t servoCurrentScale(int32_t output) {
+    return constrain(((int64_t)abs(output) * CURRENT_SCALE_MAX) / SERVO_FULL_OUTPUT, (SERVO_MIN_CURRENT * CURRENT_SCALE_MAX) / 100, CURRENT_SCALE_MAX);
+}
+
+#endif // ! ENABLE_SERVO_OUTPUT
+
+#endif // ! __SERVO_OUTPUT_H__
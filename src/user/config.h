@@ -10,7 +10,7 @@
 // Version of the firmware (displayed on OLED) (follows semantic versioning)
 #define MAJOR_VERSION (uint16_t)0
 #define MINOR_VERSION (uint16_t)0
-#define PATCH_VERSION (uint16_t)44
+#define PATCH_VERSION (uint16_t)45
 
 // --------------  Settings  --------------
 
@@ -36,18 +36,53 @@
 #endif
 
 // Averages (number of readings in average)
-#define RPM_AVG_READINGS     (uint16_t)10
 #define SPEED_AVG_READINGS   (uint16_t)100
-#define ACCEL_AVG_READINGS   (uint16_t)10
 #define ANGLE_AVG_READINGS   (uint16_t)15
 #define TEMP_AVG_READINGS    (uint16_t)200
 
+// Position, velocity, and acceleration observer (alpha-beta-gamma tracking filter, updated with every encoder sample)
+// Larger values track faster, smaller values filter more noise. Must satisfy 0 < alpha < 2, 0 < beta < 4 - 2 * alpha, 0 < gamma < 4 * alpha * beta / (2 - alpha)
+// Tuned for the sensor's noise at the control loop rate (test/test_observer), with beta and gamma following from alpha
+// (beta = 2 * (2 - alpha) - 4 * sqrt(1 - alpha), gamma = beta^2 / (2 * alpha)). The acceleration is the second derivative of
+// the noise, so gamma has to be very small for it to be usable
+#define OBSERVER_ALPHA 0.08
+#define OBSERVER_BETA  0.0033
+#define OBSERVER_GAMMA 0.00007
+
 // If encoder estimation should be used
 #define ENCODER_SPEED_ESTIMATION
 #ifdef ENCODER_SPEED_ESTIMATION
     #define SPD_EST_MIN_INTERVAL 500 // The minimum sampling interval (us). Increase to get more steady readings at the cost of latency
 #endif
 
+// Encoder linearization (calibration sweeps every full step in both directions and saves a correction table, which
+// removes the sensor nonlinearity and magnet eccentricity that repeats every revolution)
+#define ENABLE_ENCODER_LINEARIZATION
+#ifdef ENABLE_ENCODER_LINEARIZATION
+    #define ENCODER_LINEARIZATION_BITS 8 // Log2 of the number of points in the table (256 points, one every 1.4 deg)
+    #define LINEARIZATION_SETTLE_TIME 50 // Time to let the motor settle after each full step of the calibration sweep (ms)
+#endif
+
+// Encoder sample cache. Each correction tick acquires one sample, every other reader uses it unless it asks for a fresh one
+#define ENCODER_CACHE_MAX_AGE 20000 // The maximum age of the cached sample before a reader acquires a new one (us). Should be longer than the correction period
+
+// Background encoder sampling (reads the angle registers with DMA on every correction tick, so the
+// control loop never waits on the SPI bus or disables interrupts to read the angle)
+#define ENCODER_DMA_SAMPLING
+#ifdef ENCODER_DMA_SAMPLING
+    #define ENCODER_DMA_IRQ_PRIO 5 // Priority of the DMA interrupt that completes each sample
+#endif
+
+// Encoder sensor configuration, applied at startup (can be changed with M357 and saved to flash)
+#define ENCODER_DEFAULT_UPDATE_RATE 1 // Sensor update rate. 0 = 21.3us, 1 = 42.7us (sensor default), 2 = 85.3us, 3 = 170.6us. Faster rates have less latency but more noise
+#define ENCODER_DEFAULT_PREDICTION false // If the sensor should predict the angle from the angle speed. Reduces the latency at speed, but overshoots on sudden changes
+
+// Encoder benchmark (M358), measures the angle noise and latency of every update rate
+#define ENCODER_BENCHMARK_SAMPLES 1000 // Number of readings taken while holding the motor to measure the noise
+#define ENCODER_BENCHMARK_STEPS 10 // Number of full steps taken to measure the latency. Must be even, so the motor returns to where it started
+#define ENCODER_BENCHMARK_SETTLE_TIME 100 // Time to let the motor and sensor settle after each change (ms)
+#define ENCODER_BENCHMARK_TIMEOUT 50000 // The maximum time to wait for the encoder to see a step (us)
+
 // Serial configuration settings
 #define ENABLE_SERIAL
 #ifdef ENABLE_SERIAL
@@ -74,7 +109,8 @@
 
 // Motor characteristics
 #define STEP_ANGLE (float)1.8 // ! Check to see for .9 deg motors as well
-#define STEP_UPDATE_FREQ (uint32_t)78 // in Hz, to step the motor back to the correct position. Multiplied by the microstepping for actual update freq
+#define STEP_UPDATE_FREQ (uint32_t)78 // in Hz, to step the motor back to the correct position. Multiplied by the microstepping for actual step rate
+#define CONTROL_UPDATE_FREQ (uint32_t)10000 // in Hz, the fixed rate that the control loop runs at (reads the encoder, then corrects the position)
 
 // Board characteristics
 // ! Do not modify unless you know what you are doing!
@@ -86,12 +122,14 @@
 // required from the motor)
 //#define ENABLE_DYNAMIC_CURRENT
 #ifdef ENABLE_DYNAMIC_CURRENT
-    // A dynamically controller current loop. Uses the equation: accel * accelCurrent + idleCurrent
+    // A dynamically controlled current. Computed by the correction using the equation: idleCurrent + (accel * accelCurrent) + (tracking error * errorCurrent)
     // Limited by the max dynamic current, which will limit the maximum that the dynamic loop can output
     // All current values are in RMS
-    #define DYNAMIC_ACCEL_CURRENT 10 // Multiplied by deg/s/s, in mA
+    #define DYNAMIC_ACCEL_CURRENT 10 // In mA per 1000 deg/s/s of estimated acceleration
     #define DYNAMIC_IDLE_CURRENT  500 // In mA
     #define DYNAMIC_MAX_CURRENT   750 // In mA
+    #define DYNAMIC_ERROR_CURRENT 250 // In mA per full step of tracking error
+    #define DYNAMIC_CURRENT_SLEW  10 // The most that the current can change in a single correction (in mA)
 #else
     // Classic, static current
     #define STATIC_RMS_CURRENT     (uint16_t)500 // This is the rating of the motor from the manufacturer
@@ -128,6 +166,106 @@
 
     // PID output that the motor should disable at (set to 0 to never disable motor)
     #define DEFAULT_PID_DISABLE_THRESHOLD 0 //1000
+
+    // Servo output. On every update, the PID output sets the electrical angle and current of the coils directly
+    // (relative to the measured rotor angle), instead of being used as a step rate. Gives correction finer than a microstep
+    // The output is a torque instead of a speed, so the PID terms need to be retuned (a D term is needed for damping)
+    //#define ENABLE_SERVO_OUTPUT
+    #ifdef ENABLE_SERVO_OUTPUT
+
+        // PID output that drives the full current 90 electrical degrees ahead of the rotor (smaller outputs are scaled down)
+        #define SERVO_FULL_OUTPUT 2000
+
+        // The smallest current (percent of the peak current) to drive the coils with, even when the output is 0
+        #define SERVO_MIN_CURRENT 20
+    #endif
+
+    // Cascaded control. Replaces the PID with an outer position loop (P) that commands a velocity on top of the step input's, and an
+    // inner velocity loop (PI) on the encoder's observer velocity that sets the output. Runs out of position, with all of the math in fixed point
+    // When the output is limited, the difference is fed back into the velocity integral (back-calculation anti-windup)
+    //#define ENABLE_CASCADED_CONTROL
+    #ifdef ENABLE_CASCADED_CONTROL
+
+        // Position loop gain (deg/s of velocity per deg of position error)
+        #define DEFAULT_POSITION_P   (float)50
+
+        // The fastest that the position loop can command the motor to move (deg/s)
+        #define DEFAULT_MAX_VELOCITY (float)3600
+
+        // Velocity loop gains (output per deg/s of velocity error, and output per deg of accumulated velocity error)
+        #define DEFAULT_VELOCITY_P   (float)1
+        #define DEFAULT_VELOCITY_I   (float)100
+
+        // How quickly the velocity integral is pulled back once the output is limited (1/s)
+        #define CASCADE_ANTIWINDUP_RATE (float)100
+    #endif
+
+    // Relay autotune (M307). A relay replaces the controller, oscillating the motor around the desired position. The period
+    // and amplitude of the oscillation give the ultimate gain and period, which the gains are found from (Ziegler-Nichols)
+    #define ENABLE_PID_AUTOTUNE
+    #ifdef ENABLE_PID_AUTOTUNE
+
+        // Default amplitude of the oscillation (deg). The relay output is adjusted until the amplitude is within 25% of it
+        #define AUTOTUNE_AMPLITUDE    (float)1.8
+
+        // How far past the desired position the motor has to go before the relay switches (deg), so noise can't switch it
+        #define AUTOTUNE_HYSTERESIS   (float)0.1
+
+        // Number of cycles at the amplitude that are averaged for the measurement
+        #define AUTOTUNE_CYCLES       8
+
+        // The autotune is stopped if the motor gets this many amplitudes away from the desired position
+        #define AUTOTUNE_ABORT_FACTOR 4
+
+        // The longest that the autotune can run for (ms)
+        #define AUTOTUNE_TIMEOUT      10000
+    #endif
+
+    // Step rate feedforward. The velocity and acceleration of the step input are measured on every control loop update (from
+    // the change in the desired position), then fed forward into the controller and the dynamic current. The controller doesn't
+    // have to wait for a tracking error to build up before it reacts to a move
+    //#define ENABLE_STEP_FEEDFORWARD
+    #ifdef ENABLE_STEP_FEEDFORWARD
+
+        // Velocity feedforward. Output per deg/s of the step input's velocity, only used by the PID (the velocity loop of the
+        // cascaded control always follows the step input's velocity)
+        #define DEFAULT_VELOCITY_FF (float)0
+
+        // Acceleration feedforward (output per deg/s^2 of the step input's acceleration)
+        #define DEFAULT_ACCEL_FF    (float)0
+
+        // Current feedforward, added to the dynamic current (mA per 1000 deg/s^2 of the step input's acceleration)
+        // The current for the acceleration is taken from the step input or the motor's acceleration, whichever needs more
+        #define DEFAULT_CURRENT_FF  (uint16_t)10
+    #endif
+#endif
+
+// Standstill current reduction. Once there haven't been any steps for a while and the motor is in position, the current is
+// ramped down to a holding percentage. The full current comes back on the next step, or if the motor is pushed out of position
+#define ENABLE_STANDSTILL_REDUCTION
+#ifdef ENABLE_STANDSTILL_REDUCTION
+
+    // Time (ms) without steps before the current is reduced (0 disables the reduction)
+    #define STANDSTILL_DELAY   (uint16_t)1000
+
+    // The holding current (percent of the full current)
+    #define STANDSTILL_CURRENT (uint8_t)50
+#endif
+
+// Closed loop commutation (only used without PID, replaces stepping back to the correct position)
+// When the motor is out of position, the coils are driven ahead of the measured rotor angle instead of a step at a time
+// Keeps the field near 90 electrical degrees from the rotor, giving the most torque per amp and a higher top speed
+//#define ENABLE_PHASE_LEAD
+#ifdef ENABLE_PHASE_LEAD
+
+    // Electrical angle (deg) to drive the coils ahead of the rotor. 90 gives the most torque
+    #define PHASE_LEAD_ADVANCE (float)90
+
+    // Extra lead that scales with speed, as the time (us) that the coil current lags behind the drive (coil L/R plus the loop delay)
+    #define PHASE_LEAD_TIME_US 150
+
+    // The most extra lead that can be added by the speed (electrical deg)
+    #define PHASE_LEAD_MAX (float)60
 #endif
 
 // Direct step functionality (used to command motor to move over Serial/CAN)
@@ -138,16 +276,46 @@
     #define DEFAULT_STEPPING_RATE 1000
 #endif
 
+// Count the step pulses in hardware (TIM2), then move the coils to the count at a fixed rate
+// Removes the interrupt on every step, so the maximum step rate no longer depends on the interrupt time. Only direction changes are interrupted on
+//#define ENABLE_HARDWARE_STEP_COUNTING
+#ifdef ENABLE_HARDWARE_STEP_COUNTING
+
+    // The rate that the coils are moved to the step count (in Hz). The step correction runs on every few of these updates
+    #define STEP_COUNTER_UPDATE_FREQ (uint32_t)20000
+
+    // The minimum time (in us) that the direction has to be set before the next step edge. The counting direction is set by the
+    // direction pin's interrupt (and checked again on every update), so steps that come before the interrupt runs are counted
+    // the wrong way. The interrupt can be held off by the longest section with the interrupts blocked, which M359 reports
+    // (a few us with ENCODER_DMA_SAMPLING, the whole SPI read without it). The host's direction setup time has to be longer
+    #define STEP_COUNTER_DIR_SETUP_TIME (uint32_t)20
+#endif
+
+// Spread each step pulse into smaller coil movements, timed from the measured step period (similar to TMC's microPlyer)
+// Coarse host microstepping (ex. 1/8) is then driven at the full resolution of the sine table, making the motor smoother and quieter
+// Movement lags the steps by up to one step period. Can't be used with hardware step counting or closed loop commutation
+//#define ENABLE_STEP_INTERPOLATION
+#ifdef ENABLE_STEP_INTERPOLATION
+
+    // The rate that the coils are moved between the steps (in Hz). The step correction runs on every few of these updates
+    #define STEP_INTERPOLATION_FREQ (uint32_t)20000
+
+    // The longest step period that is interpolated (in us). Slower steps (i.e. the first step of a move) are moved to directly
+    #define STEP_INTERPOLATION_MAX_PERIOD (uint32_t)20000
+#endif
+
 // Motor settings
-// The number of microsteps to move per step pulse
+// The number of microsteps to move per step pulse, as a ratio (NUMERATOR / DENOMINATOR microsteps per pulse)
+// Fractions of a microstep are carried over to the next pulse, so any ratio is followed without drifting
 // Doesn't affect correctional movements
-#define MICROSTEP_MULTIPLIER    (uint32_t)1
+#define MICROSTEP_GEAR_NUMERATOR   (uint16_t)1
+#define MICROSTEP_GEAR_DENOMINATOR (uint16_t)1
 
 // The min/max microstepping divisors
 // Microstepping divisors are the numbers underneath the fraction of the microstepping
 // For example, 1/16th microstepping would have a divisor of 16
 #define MIN_MICROSTEP_DIVISOR   (uint8_t)1
-#define MAX_MICROSTEP_DIVISOR   (uint8_t)32
+#define MAX_MICROSTEP_DIVISOR   (uint16_t)256
 
 #define MOTOR_PWM_FREQ          (uint32_t)124000 // in Hz
 // https://deepbluembedded.com/wp-content/uploads/2020/06/STM32-PWM-Resolution-Example-STM32-Timer-PWM-Mode-Output-Compare-768x291.jpg
@@ -285,7 +453,11 @@
 
 // --------------  Internal defines  --------------
 // Under the hood motor setup
-#define SINE_VAL_COUNT (128)
+#define SINE_VAL_COUNT (1024) // Number of sine table entries per electrical cycle (256 to 4096, the table is generated while compiling)
+#define SINE_INTERPOLATION // Linearly interpolate between the table entries, allowing commutation between them
+#ifdef SINE_INTERPOLATION
+    #define SINE_INTERPOLATION_BITS 2 // Number of extra bits of resolution between each of the table entries
+#endif
 //#define SINE_MAX ((int16_t)(10000))
 #define SINE_MAX (16384) // 2^SINE_POWER == 2^14 == 16384
 
@@ -352,6 +524,9 @@
 //#define ENABLE_STEPPING_VELOCITY
 //#define IGNORE_FLASH_VERSION
 
+// Times each call of driveCoils() with the cycle counter (the last and the most cycles taken are reported by M361)
+//#define CHECK_DRIVE_COILS_TIME
+
 // LED related debugging
 #ifdef ENABLE_LED
     //#define CHECK_STEPPING_RATE
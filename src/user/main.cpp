@@ -8,6 +8,7 @@
 #include "oled.h"
 #include "led.h"
 #include "cube.h"
+#include "cycleTimer.h"
 
 // Create a new motor instance
 StepperMotor motor = StepperMotor();
@@ -50,6 +51,9 @@ void setup() {
         MCO_GPIO_Init();
     #endif
 
+    // Start the cycle counter (everything that needs precise timing uses it)
+    setupCycleTimer();
+
     // Initialize the LED
     #ifdef ENABLE_LED
         initLED();
@@ -57,6 +61,14 @@ void setup() {
 
     // Zero the encoder
     motor.encoder.zero();
+
+    // Configure the update rate and prediction of the sensor, retrying if the sensor doesn't take them
+    // The settings are only cached once the sensor takes them, so if it never does it keeps running at its power-on settings
+    bool encoderConfigured = false;
+    for (uint8_t attempt = 0; (attempt < ENCODER_SETUP_ATTEMPTS) && !encoderConfigured; attempt++) {
+        encoderConfigured = (motor.encoder.setUpdateRate((ENCODER_UPDATE_RATE)ENCODER_DEFAULT_UPDATE_RATE) == NO_ERROR) &&
+                            (motor.encoder.setPrediction(ENCODER_DEFAULT_PREDICTION) == NO_ERROR);
+    }
     #ifdef CHECK_ENCODER_SPEED
         while(true) {
             GPIO_WRITE(LED_PIN, HIGH);
@@ -97,6 +109,11 @@ void setup() {
     // Initialize the serial bus
     #ifdef ENABLE_SERIAL
         initSerial();
+
+        // Report if the sensor didn't take its settings
+        if (!encoderConfigured) {
+            Serial.println(F("Encoder did not accept the update rate or prediction"));
+        }
     #endif
 
     // Initialize the CAN bus
@@ -0,0 +1,137 @@
+#ifndef __SIMULATED_MOTOR_H__
+#define __SIMULATED_MOTOR_H__
+
+// Simulated motor shared by the host control tests (pio test -e native)
+// A hybrid stepper is simulated (rotor inertia, the magnetic spring of the coils, the lag of the coil current, and friction),
+// driven like StepperMotor::driveCoils and read like the encoder. The simulated clock is supplied to the cycle timer
+
+#include "config.h"
+#include "fixedPoint.h"
+#include "fastSine.h"
+#include "coilPWM.h"
+
+// Simulated core clock (Hz)
+#define SIMULATED_CLOCK 128000000
+
+// Time between the control loop updates (us), and the time step of the motor simulation (us)
+#define TICK_PERIOD     (1000000 / CONTROL_UPDATE_FREQ)
+#define SIMULATION_STEP 1
+
+// Simulated motor: a 1.8 deg, 42mm stepper (50 pole pairs) at 1/16 microstepping, with a small load
+#define POLE_PAIRS              50
+#define MICROSTEPS_PER_ROTATION 3200
+#define MICROSTEP_PHASE         (SINE_STEPS_PER_FULL_STEP / 16)
+#define HOLDING_TORQUE          0.4     // At the full current (N m)
+#define INERTIA                 1.2e-5  // Rotor and load (kg m^2)
+#define FRICTION                3e-3    // Viscous, a damping ratio of about 0.1 on the magnetic spring (N m s / rad)
+#define CURRENT_LAG             150e-6  // Time constant of the coil current (s)
+
+
+// The simulated 32 bit counter
+static uint32_t simulatedCycles = 0;
+
+
+// Mocks supplied to the cycle timer
+uint32_t mockCycleCount() {
+    return simulatedCycles;
+}
+
+
+// The simulated motor
+class SimulatedMotor {
+    public:
+        // Drives the coils at a phase (SINE_STEPS per electrical cycle), with a current scale (like StepperMotor::driveCoils)
+        void driveCoils(int32_t phase, uint32_t outputScale = CURRENT_SCALE_MAX) {
+            uint32_t cyclePhase = phase & (SINE_STEPS - 1);
+            targetCurrentA = (double)lookupPhase(sineTable.values, cyclePhase) * outputScale / (SINE_MAX * CURRENT_SCALE_MAX);
+            targetCurrentB = (double)lookupPhase(sineTable.values, cyclePhase + (SINE_STEPS / 4)) * outputScale / (SINE_MAX * CURRENT_SCALE_MAX);
+        }
+
+        // Holds the rotor in place (a jam or a hard stop), or lets it go again
+        void setBlocked(bool newBlocked) {
+            blocked = newBlocked;
+            if (blocked) {
+                velocity = 0;
+            }
+        }
+
+        // Advances the motor by a time step (s)
+        void advance(double time) {
+
+            // The currents follow the drive with a lag
+            currentA += (targetCurrentA - currentA) * time / CURRENT_LAG;
+            currentB += (targetCurrentB - currentB) * time / CURRENT_LAG;
+
+            // The torque pulls the rotor toward the angle of the current (the A coil is the sine, the B coil the cosine)
+            if (!blocked) {
+                double electricalAngle = POLE_PAIRS * angle;
+                double torque = HOLDING_TORQUE * ((currentA * cos(electricalAngle)) - (currentB * sin(electricalAngle))) - (FRICTION * velocity);
+                velocity += torque * time / INERTIA;
+                angle += velocity * time;
+            }
+        }
+
+        // Encoder reading (increments)
+        int32_t readEncoder() const {
+            return (int32_t)lround(angle * INCREMENTS_PER_REV / (2 * PI));
+        }
+
+        // Phase of the rotor (SINE_STEPS per electrical cycle, aligned with the coils at the start)
+        int32_t rotorPhase() const {
+            return (int32_t)(((int64_t)readEncoder() * MICROSTEPS_PER_ROTATION * MICROSTEP_PHASE) >> INCREMENTS_PER_REV_BITS);
+        }
+
+    private:
+        double angle = 0;
+        double velocity = 0;
+        double currentA = 0;
+        double currentB = 0;
+        double targetCurrentA = 0;
+        double targetCurrentB = 0;
+        bool blocked = false;
+};
+
+
+// Steps the coils of the simulated motor at the rate of the step schedule (like the step schedule timer)
+class SimulatedStepSchedule {
+    public:
+        // Sets the step rate (steps/s, the sign is the direction, 0 stops). The first step is a period after it's started
+        void setRate(int32_t newRate) {
+            if ((rate == 0) && (newRate != 0)) {
+                timer = 1.0 / abs(newRate);
+            }
+            rate = newRate;
+        }
+
+        // Advances the schedule by a time step (s), returning the phase change of the coils
+        int32_t advance(double time) {
+            if (rate == 0) {
+                return 0;
+            }
+            timer -= time;
+            if (timer > 0) {
+                return 0;
+            }
+            timer += 1.0 / abs(rate);
+            return ((rate > 0) ? 1 : -1) * MICROSTEP_PHASE;
+        }
+
+    private:
+        int32_t rate = 0;
+        double timer = 0;
+};
+
+
+// Converts an encoder position (in increments) to the nearest microstep (like StepperMotor::positionToMicrosteps)
+static int32_t positionToMicrosteps(int32_t position) {
+    int64_t scaledPosition = (int64_t)position * MICROSTEPS_PER_ROTATION;
+    return (int32_t)((scaledPosition + (INCREMENTS_PER_REV / 2)) >> INCREMENTS_PER_REV_BITS);
+}
+
+
+// Converts a microstep to an encoder position (like StepperMotor::getDesiredPosition)
+static int32_t microstepsToPosition(int32_t microsteps) {
+    return (int32_t)(((int64_t)microsteps * INCREMENTS_PER_REV) / MICROSTEPS_PER_ROTATION);
+}
+
+#endif // ! __SIMULATED_MOTOR_H__
@@ -0,0 +1,42 @@
+// Minimal stand-in for the Arduino core, so that the modules without hardware access can be built on the host for the
+// unit tests (pio test -e native). Only has what config.h and those modules use
+#ifndef __ARDUINO_STUB_H__
+#define __ARDUINO_STUB_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+
+// Math
+#define PI 3.1415926535897932384626433832795
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+using std::min;
+using std::max;
+
+// Digital levels
+#define LOW  0
+#define HIGH 1
+
+// Pin names (packed the same way as the STM32 core, port in the high nibble and pin in the low one)
+typedef enum {
+    PA_0 = 0x00, PA_1, PA_2, PA_3, PA_4, PA_5, PA_6, PA_7, PA_8, PA_9, PA_10, PA_11, PA_12, PA_13, PA_14, PA_15,
+    PB_0 = 0x10, PB_1, PB_2, PB_3, PB_4, PB_5, PB_6, PB_7, PB_8, PB_9, PB_10, PB_11, PB_12, PB_13, PB_14, PB_15,
+    PC_13 = 0x2D, PC_14, PC_15,
+    NC = 0xFF
+} PinName;
+#define STM_PORT(X) (((uint32_t)(X) >> 4) & 0xF)
+#define STM_PIN(X)  ((uint32_t)(X) & 0xF)
+
+// Timer compare formats (the same values as the STM32 core, each resolution format is its number of bits)
+typedef enum {
+    MICROSEC_COMPARE_FORMAT,
+    TICK_COMPARE_FORMAT,
+    RESOLUTION_1B_COMPARE_FORMAT = 1, RESOLUTION_2B_COMPARE_FORMAT, RESOLUTION_3B_COMPARE_FORMAT, RESOLUTION_4B_COMPARE_FORMAT,
+    RESOLUTION_5B_COMPARE_FORMAT, RESOLUTION_6B_COMPARE_FORMAT, RESOLUTION_7B_COMPARE_FORMAT, RESOLUTION_8B_COMPARE_FORMAT,
+    RESOLUTION_9B_COMPARE_FORMAT, RESOLUTION_10B_COMPARE_FORMAT, RESOLUTION_11B_COMPARE_FORMAT, RESOLUTION_12B_COMPARE_FORMAT,
+    RESOLUTION_13B_COMPARE_FORMAT, RESOLUTION_14B_COMPARE_FORMAT, RESOLUTION_15B_COMPARE_FORMAT, RESOLUTION_16B_COMPARE_FORMAT,
+    PERCENT_COMPARE_FORMAT
+} TimerCompareFormat_t;
+
+#endif // ! __ARDUINO_STUB_H__
@@ -0,0 +1,309 @@
+// Host simulation of the cascaded control against the single loop PID (pio test -e native)
+// Both controllers are the firmware's (FixedCascade and FixedPID, the math of StepperPID::computeCascade and StepperPID::compute),
+// run on the simulated motor (simulatedMotor.h) from the same averaged position and observer velocity. Like the control loop,
+// both only run while out of position, and their output is the step rate of the step schedule. The step input moves the coils
+// and the desired position together
+#include <unity.h>
+#include <stdio.h>
+#include "config.h"
+#include "fixedPID.h"
+#include "MovingAverage.h"
+#include "observer.h"
+#include "simulatedMotor.h"
+
+// Move: a full step (16 microsteps) given at once, then held
+#define MOVE_MICROSTEPS 16
+#define MOVE_TIME       0.3
+
+// Feed: the step input ramps up to a constant rate, then holds it (microsteps/s, and s)
+#define FEED_RATE       16000
+#define FEED_RAMP_TIME  0.1
+#define FEED_TIME       0.4
+
+// Jam: the rotor is held while a move is given, then let go (s)
+#define JAM_TIME        0.1
+#define JAM_RECOVERY    0.4
+
+// Saturation: the output is held at the limit for a short and a long time (s), and has to turn around before the timeout (s)
+#define SHORT_SATURATION   0.1
+#define LONG_SATURATION    2.0
+#define SATURATION_TIMEOUT 4.0
+
+// The band that the rotor has to settle within (microsteps). The control stops once the averaged position rounds to within a
+// microstep of the target, so it can rest up to one and a half microsteps away
+#define IN_POSITION_BAND 1.5
+
+
+// The controllers compared
+enum CONTROLLER {
+    SINGLE_LOOP_PID,
+    CASCADE
+};
+
+
+// A run of the simulation
+struct Run {
+    double moveMicrosteps = 0;  // Given at once at the start (microsteps)
+    double feedRate = 0;        // Constant rate of the step input once ramped up (microsteps/s)
+    double jamTime = 0;         // Time that the rotor is held for at the start (s)
+    double time = 0;            // Time simulated (s)
+};
+
+
+// Result of a run
+struct RunResult {
+    double settlingTime = 0;        // Time until the rotor stays within the in position band of the target (ms)
+    double overshoot = 0;           // Largest distance past the target once released (microsteps)
+    double finalError = 0;          // Distance from the target at the end (microsteps)
+    double followingError = 0;      // Mean distance behind the target over the last half of the run (microsteps)
+    int32_t releaseIntegral = 0;    // Output of the cascade's integral when the rotor was let go
+};
+
+
+// Simulates a run with one of the controllers
+static RunResult simulate(CONTROLLER controller, const Run &run) {
+    SimulatedMotor simulatedMotor;
+    SimulatedStepSchedule stepSchedule;
+    FixedPID pid;
+    FixedCascade cascade;
+    MovingAverage<int32_t, int64_t> positionAvg;
+    positionAvg.begin(ANGLE_AVG_READINGS);
+    PositionObserver observer;
+    simulatedCycles = 0;
+    setupCycleTimer(SIMULATED_CLOCK);
+
+    // The motor starts at rest, aligned with the coils
+    int32_t coilPhase = 0;
+    simulatedMotor.driveCoils(coilPhase);
+    for (uint32_t tick = 0; tick < ANGLE_AVG_READINGS; tick++) {
+        positionAvg.add(0);
+    }
+
+    // The move is given at once (held in place if jammed)
+    simulatedMotor.setBlocked(run.jamTime > 0);
+    int32_t hardStep = run.moveMicrosteps;
+    coilPhase += hardStep * MICROSTEP_PHASE;
+    simulatedMotor.driveCoils(coilPhase);
+
+    // Position and velocity of the step input (microsteps, and microsteps/s)
+    double feedPosition = 0;
+    double feedVelocity = 0;
+
+    RunResult result;
+    uint32_t ticks = run.time * CONTROL_UPDATE_FREQ;
+    uint32_t followingTicks = 0;
+    for (uint32_t tick = 0; tick < ticks; tick++) {
+        double time = (double)tick / CONTROL_UPDATE_FREQ;
+
+        // Let go of the rotor
+        if ((run.jamTime > 0) && (time >= run.jamTime) && (time - (1.0 / CONTROL_UPDATE_FREQ) < run.jamTime)) {
+            simulatedMotor.setBlocked(false);
+            result.releaseIntegral = cascade.getIntegralOutput();
+        }
+
+        // Read the encoder, and update the average and the observer
+        int32_t reading = simulatedMotor.readEncoder();
+        positionAvg.add(reading);
+        observer.update(reading, cycleCount64());
+        int32_t averagePosition = positionAvg.get();
+
+        // Control
+        int32_t error = microstepsToPosition(hardStep) - averagePosition;
+        bool outOfPosition = (abs(positionToMicrosteps(averagePosition) - hardStep) > 1);
+        int32_t output = 0;
+        if (outOfPosition) {
+            if (controller == SINGLE_LOOP_PID) {
+                output = pid.compute(error, observer.getVelocity(), TICK_PERIOD);
+            }
+            else {
+                output = cascade.compute(error, observer.getVelocity(), microstepsToPosition(feedVelocity));
+            }
+        }
+        stepSchedule.setRate(outOfPosition ? output : 0);
+
+        // Run the motor, the step input, and the step schedule until the next update
+        for (uint32_t subTime = 0; subTime < TICK_PERIOD; subTime += SIMULATION_STEP) {
+
+            // The step input ramps up to the feed rate
+            if (run.feedRate > 0) {
+                feedVelocity = min(feedVelocity + (run.feedRate * SIMULATION_STEP * 1e-6 / FEED_RAMP_TIME), run.feedRate);
+                feedPosition += feedVelocity * SIMULATION_STEP * 1e-6;
+                while (hardStep < (run.moveMicrosteps + (int32_t)feedPosition)) {
+                    hardStep++;
+                    coilPhase += MICROSTEP_PHASE;
+                    simulatedMotor.driveCoils(coilPhase);
+                }
+            }
+
+            int32_t phaseChange = stepSchedule.advance(SIMULATION_STEP * 1e-6);
+            if (phaseChange != 0) {
+                coilPhase += phaseChange;
+                simulatedMotor.driveCoils(coilPhase);
+            }
+            simulatedMotor.advance(SIMULATION_STEP * 1e-6);
+        }
+        simulatedCycles += TICK_PERIOD * (SIMULATED_CLOCK / 1000000);
+
+        // Track the settling, the overshoot once released, and the following error
+        double positionError = (double)(simulatedMotor.readEncoder() - microstepsToPosition(hardStep)) * MICROSTEPS_PER_ROTATION / INCREMENTS_PER_REV;
+        double updateTime = (tick + 1) * 1000.0 / CONTROL_UPDATE_FREQ;
+        if (fabs(positionError) > IN_POSITION_BAND) {
+            result.settlingTime = updateTime;
+        }
+        if (time >= run.jamTime) {
+            result.overshoot = max(result.overshoot, positionError);
+        }
+        if (tick >= ticks / 2) {
+            result.followingError -= positionError;
+            followingTicks++;
+        }
+        result.finalError = positionError;
+    }
+    result.followingError /= followingTicks;
+    return result;
+}
+
+
+// Reports a result
+static void report(const char* name, const RunResult &result) {
+    char message[256];
+    snprintf(message, sizeof(message), "%s: settling %.1f ms, overshoot %.2f, final error %.2f, following error %.2f microsteps",
+        name, result.settlingTime, result.overshoot, result.finalError, result.followingError);
+    TEST_MESSAGE(message);
+}
+
+
+void setUp() {}
+void tearDown() {}
+
+
+// A full step given at once. The velocity loop damps the swing of the rotor, so the cascade has to overshoot less and settle
+// sooner than the PID
+void test_step_response() {
+    Run run;
+    run.moveMicrosteps = MOVE_MICROSTEPS;
+    run.time = MOVE_TIME;
+    RunResult pidResult = simulate(SINGLE_LOOP_PID, run);
+    RunResult cascadeResult = simulate(CASCADE, run);
+    report("Step, PID", pidResult);
+    report("Step, cascade", cascadeResult);
+
+    TEST_ASSERT_TRUE(cascadeResult.settlingTime < (MOVE_TIME * 1000) / 2);
+    TEST_ASSERT_TRUE(cascadeResult.settlingTime <= pidResult.settlingTime);
+    TEST_ASSERT_TRUE(cascadeResult.overshoot <= pidResult.overshoot);
+    TEST_ASSERT_TRUE(fabs(cascadeResult.finalError) <= IN_POSITION_BAND);
+}
+
+
+// A high constant feed. With the velocity fed forward, the position loop only has to correct the lag of the rotor, so the
+// cascade has to follow at least as closely as the PID
+void test_constant_feed() {
+    Run run;
+    run.feedRate = FEED_RATE;
+    run.time = FEED_TIME;
+    RunResult pidResult = simulate(SINGLE_LOOP_PID, run);
+    RunResult cascadeResult = simulate(CASCADE, run);
+    report("Feed, PID", pidResult);
+    report("Feed, cascade", cascadeResult);
+
+    TEST_ASSERT_TRUE(fabs(cascadeResult.followingError) <= fabs(pidResult.followingError));
+}
+
+
+// The rotor is jammed while a move is given, then let go. The velocity integral builds up while the rotor is held, so the
+// cascade has to settle without running far past the target once it's let go
+void test_jam_recovery() {
+    Run run;
+    run.moveMicrosteps = MOVE_MICROSTEPS;
+    run.jamTime = JAM_TIME;
+    run.time = JAM_TIME + JAM_RECOVERY;
+    RunResult pidResult = simulate(SINGLE_LOOP_PID, run);
+    RunResult cascadeResult = simulate(CASCADE, run);
+    report("Jam, PID", pidResult);
+    report("Jam, cascade", cascadeResult);
+
+    char message[64];
+    snprintf(message, sizeof(message), "Cascade integral at the release: %d", cascadeResult.releaseIntegral);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_TRUE(cascadeResult.settlingTime < (JAM_TIME + JAM_RECOVERY / 2) * 1000);
+    TEST_ASSERT_TRUE(cascadeResult.settlingTime <= pidResult.settlingTime);
+    TEST_ASSERT_TRUE(cascadeResult.overshoot <= IN_POSITION_BAND);
+    TEST_ASSERT_TRUE(fabs(cascadeResult.finalError) <= IN_POSITION_BAND);
+}
+
+
+// Holds the rotor of the simulated motor far behind the target until the output has been at the limit for a while, then moves
+// the target behind the rotor. Returns the time until the output turns around (ms), or -1 if it never reached the limit
+static double saturate(double limitTime) {
+    SimulatedMotor simulatedMotor;
+    FixedCascade cascade;
+    PositionObserver observer;
+    simulatedCycles = 0;
+    setupCycleTimer(SIMULATED_CLOCK);
+    simulatedMotor.setBlocked(true);
+
+    // The rotor is held at 0, the target is a revolution ahead of it
+    int32_t target = INCREMENTS_PER_REV;
+    double limitedTime = 0;
+    double reversedTime = 0;
+    for (uint32_t tick = 0; tick < SATURATION_TIMEOUT * CONTROL_UPDATE_FREQ; tick++) {
+        int32_t reading = simulatedMotor.readEncoder();
+        observer.update(reading, cycleCount64());
+        int32_t output = cascade.compute(target - reading, observer.getVelocity(), 0);
+
+        // The integral alone can never be past the limit
+        TEST_ASSERT_TRUE(abs(cascade.getIntegralOutput()) <= DEFAULT_PID_STEP_MAX);
+
+        // Once the output has been limited for long enough, move the target a revolution behind the rotor
+        if (target > 0) {
+            if (output == DEFAULT_PID_STEP_MAX) {
+                limitedTime += 1000.0 / CONTROL_UPDATE_FREQ;
+            }
+            if (limitedTime >= limitTime * 1000) {
+                target = -INCREMENTS_PER_REV;
+            }
+        }
+        else {
+            reversedTime += 1000.0 / CONTROL_UPDATE_FREQ;
+            if (output < 0) {
+                return reversedTime;
+            }
+        }
+
+        simulatedMotor.advance(TICK_PERIOD * 1e-6);
+        simulatedCycles += TICK_PERIOD * (SIMULATED_CLOCK / 1000000);
+    }
+    return -1;
+}
+
+
+// The output runs into its limit while the rotor is held. The integral can't wind past the limit, so the output has to turn
+// around within the time that the velocity integral takes to come down from the limit, however long it was limited for
+void test_saturation_recovery() {
+    double shortRecovery = saturate(SHORT_SATURATION);
+    double longRecovery = saturate(LONG_SATURATION);
+
+    // The integral comes down at the max velocity error, times the velocity I (output per deg, so output/s per deg/s)
+    double unwindTime = 1000.0 * DEFAULT_PID_STEP_MAX / (DEFAULT_VELOCITY_I * DEFAULT_MAX_VELOCITY);
+
+    char message[128];
+    snprintf(message, sizeof(message), "Turnaround after %.1f s limited: %.1f ms, after %.1f s: %.1f ms (integral unwinds in %.1f ms)",
+        SHORT_SATURATION, shortRecovery, LONG_SATURATION, longRecovery, unwindTime);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_TRUE(shortRecovery > 0);
+    TEST_ASSERT_TRUE(longRecovery > 0);
+    TEST_ASSERT_TRUE(shortRecovery <= unwindTime + (1000.0 / CONTROL_UPDATE_FREQ));
+    TEST_ASSERT_TRUE(fabs(longRecovery - shortRecovery) <= 1000.0 / CONTROL_UPDATE_FREQ);
+}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_step_response);
+    RUN_TEST(test_constant_feed);
+    RUN_TEST(test_jam_recovery);
+    RUN_TEST(test_saturation_recovery);
+    return UNITY_END();
+}
@@ -0,0 +1,197 @@
+// Host benchmark of the coil PWM lookup (coilPWM.h, used by StepperMotor::driveCoils) against the conversion it replaced
+// (pio test -e native). The old path scaled the sine of each coil by the peak current, then converted each current to a PWM
+// value with the float math of currentToPWM. The new path looks both PWM values up in a table filled with currentToPWM. The
+// host has an FPU, so the float times here are a lower bound. On the Cortex-M3 every float operation is a call into the
+// soft-float library, so the number of float operations per update is counted as well. The cycles taken on the target are
+// reported by M361 with CHECK_DRIVE_COILS_TIME
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "config.h"
+#include "coilPWM.h"
+
+// Peak current of the default settings (mA)
+#define PEAK_CURRENT (uint16_t)(STATIC_RMS_CURRENT * 1.414)
+
+// Coil updates timed for each path (a few electrical cycles)
+#define BENCHMARK_UPDATES (8 * SINE_STEPS)
+
+
+// Counts of the float operations done (each one is a soft-float library call on the target)
+static uint32_t mulCount = 0;
+static uint32_t divCount = 0;
+static uint32_t convertCount = 0;
+
+
+// A float that counts the operations done on it
+struct CountedFloat {
+    float value;
+
+    CountedFloat(float newValue = 0) : value(newValue) {}
+    explicit CountedFloat(uint32_t newValue) : value(newValue) { convertCount++; }
+
+    CountedFloat operator*(CountedFloat other) const { mulCount++; return CountedFloat(value * other.value); }
+    CountedFloat operator/(CountedFloat other) const { divCount++; return CountedFloat(value / other.value); }
+    uint32_t toUnsigned() const { convertCount++; return (uint32_t)value; }
+};
+
+
+// Converts the number type of the float math to an integer
+static uint32_t toUnsigned(float value) { return (uint32_t)value; }
+static uint32_t toUnsigned(CountedFloat value) { return value.toUnsigned(); }
+
+
+// The float math of currentToPWM, with the number type swapped so the operations can be counted (the constants are folded by
+// the compiler, the current is converted). test_conversion_matches checks it against currentToPWM
+template <typename Real>
+static uint32_t oldCurrentToPWM(uint16_t current) {
+    uint32_t PWMValue = toUnsigned((Real(CURRENT_SENSE_RESISTOR * PWM_MAX_VALUE) * Real((uint32_t)current)) / Real(BOARD_VOLTAGE * 100));
+    return constrain(PWMValue, 0, PWM_MAX_VALUE);
+}
+
+
+// The old coil update: the current of each coil from the sine, then the PWM value of each current (signed by the direction)
+template <typename Real>
+static void oldCoilPWM(uint32_t phase, int32_t &coilAPWM, int32_t &coilBPWM) {
+    uint32_t cyclePhase = phase & (SINE_STEPS - 1);
+    int16_t coilAPower = ((int16_t)PEAK_CURRENT * fastSin(cyclePhase)) >> SINE_POWER;
+    int16_t coilBPower = ((int16_t)PEAK_CURRENT * fastCos(cyclePhase)) >> SINE_POWER;
+    coilAPWM = (coilAPower < 0) ? -(int32_t)oldCurrentToPWM<Real>(-coilAPower) : oldCurrentToPWM<Real>(coilAPower);
+    coilBPWM = (coilBPower < 0) ? -(int32_t)oldCurrentToPWM<Real>(-coilBPower) : oldCurrentToPWM<Real>(coilBPower);
+}
+
+
+// The PWM table of the motor
+static int16_t pwmTable[SINE_VAL_COUNT];
+
+
+void setUp() {
+    fillPWMTable(pwmTable, PEAK_CURRENT);
+}
+void tearDown() {}
+
+
+// The counted copy of the conversion has to be the same math as currentToPWM, up to and past the board's limit
+void test_conversion_matches() {
+    for (uint32_t current = 0; current <= 2 * MAX_PEAK_BOARD_CURRENT; current++) {
+        TEST_ASSERT_EQUAL_UINT32(currentToPWM(current), oldCurrentToPWM<float>(current));
+        TEST_ASSERT_EQUAL_UINT32(currentToPWM(current), oldCurrentToPWM<CountedFloat>(current));
+    }
+    TEST_ASSERT_EQUAL_UINT32(PWM_MAX_VALUE, currentToPWM(UINT16_MAX));
+}
+
+
+// The table holds the signed conversion of each sine entry, and the scale is applied after the lookup
+void test_table_and_scale() {
+    TEST_ASSERT_EQUAL_INT16(0, pwmTable[0]);
+    TEST_ASSERT_EQUAL_INT16(currentToPWM(PEAK_CURRENT), pwmTable[SINE_VAL_COUNT / 4]);
+    TEST_ASSERT_EQUAL_INT16(-(int32_t)currentToPWM(PEAK_CURRENT), pwmTable[3 * SINE_VAL_COUNT / 4]);
+
+    for (uint32_t phase = 0; phase < SINE_STEPS; phase++) {
+        int32_t fullA, fullB, halfA, halfB;
+        lookupCoilPWM(pwmTable, phase, CURRENT_SCALE_MAX, fullA, fullB);
+        lookupCoilPWM(pwmTable, phase, CURRENT_SCALE_MAX / 2, halfA, halfB);
+        TEST_ASSERT_EQUAL_INT32(lookupPhase(pwmTable, phase), fullA);
+        TEST_ASSERT_EQUAL_INT32(lookupPhase(pwmTable, phase + (SINE_STEPS / 4)), fullB);
+        TEST_ASSERT_EQUAL_INT32(fullA >> 1, halfA);
+        TEST_ASSERT_EQUAL_INT32(fullB >> 1, halfB);
+    }
+
+    // The phase wraps every electrical cycle
+    int32_t coilAPWM, coilBPWM, wrappedA, wrappedB;
+    lookupCoilPWM(pwmTable, SINE_STEPS / 8, CURRENT_SCALE_MAX, coilAPWM, coilBPWM);
+    lookupCoilPWM(pwmTable, (uint32_t)(-7 * SINE_STEPS + (SINE_STEPS / 8)), CURRENT_SCALE_MAX, wrappedA, wrappedB);
+    TEST_ASSERT_EQUAL_INT32(coilAPWM, wrappedA);
+    TEST_ASSERT_EQUAL_INT32(coilBPWM, wrappedB);
+}
+
+
+// Both paths have to drive the same PWM values. On the entries they match exactly, between them the table is interpolated
+// after the conversion instead of before it, so the truncations can differ by one
+void test_paths_agree() {
+    for (uint32_t phase = 0; phase < SINE_STEPS; phase++) {
+        int32_t oldA, oldB, newA, newB;
+        oldCoilPWM<float>(phase, oldA, oldB);
+        lookupCoilPWM(pwmTable, phase, CURRENT_SCALE_MAX, newA, newB);
+
+        char message[64];
+        snprintf(message, sizeof(message), "phase %u", phase);
+        #ifdef SINE_INTERPOLATION
+            int32_t tolerance = ((phase & ((1 << SINE_INTERPOLATION_BITS) - 1)) == 0) ? 0 : 1;
+        #else
+            int32_t tolerance = 0;
+        #endif
+        TEST_ASSERT_INT_WITHIN_MESSAGE(tolerance, oldA, newA, message);
+        TEST_ASSERT_INT_WITHIN_MESSAGE(tolerance, oldB, newB, message);
+    }
+}
+
+
+// Counts the float operations in a coil update of the old path
+void test_float_operations_per_update() {
+    mulCount = divCount = convertCount = 0;
+    int32_t coilAPWM, coilBPWM;
+    oldCoilPWM<CountedFloat>(SINE_STEPS / 8, coilAPWM, coilBPWM);
+
+    uint32_t totalCount = mulCount + divCount + convertCount;
+    TEST_ASSERT_GREATER_THAN(0, totalCount);
+
+    char message[160];
+    snprintf(message, sizeof(message), "Old path, soft-float calls per coil update: %u mul, %u div, %u convert (%u total). Table lookup: 0",
+        mulCount, divCount, convertCount, totalCount);
+    TEST_MESSAGE(message);
+}
+
+
+// Times the coil updates of each path, at the full current and at a reduced one. Only reported, the host timing doesn't
+// match the target
+void test_benchmark() {
+
+    // The outputs are accumulated so the loops can't be optimized out
+    volatile int64_t sink = 0;
+    int64_t oldTotal = 0;
+    int64_t newTotal = 0;
+    int64_t scaledTotal = 0;
+    int32_t coilAPWM, coilBPWM;
+
+    auto startTime = std::chrono::steady_clock::now();
+    for (uint32_t update = 0; update < BENCHMARK_UPDATES; update++) {
+        oldCoilPWM<float>(update * 7, coilAPWM, coilBPWM);
+        oldTotal += coilAPWM + coilBPWM;
+    }
+    auto oldTime = std::chrono::steady_clock::now() - startTime;
+
+    startTime = std::chrono::steady_clock::now();
+    for (uint32_t update = 0; update < BENCHMARK_UPDATES; update++) {
+        lookupCoilPWM(pwmTable, update * 7, CURRENT_SCALE_MAX, coilAPWM, coilBPWM);
+        newTotal += coilAPWM + coilBPWM;
+    }
+    auto newTime = std::chrono::steady_clock::now() - startTime;
+
+    startTime = std::chrono::steady_clock::now();
+    for (uint32_t update = 0; update < BENCHMARK_UPDATES; update++) {
+        lookupCoilPWM(pwmTable, update * 7, CURRENT_SCALE_MAX / 2, coilAPWM, coilBPWM);
+        scaledTotal += coilAPWM + coilBPWM;
+    }
+    auto scaledTime = std::chrono::steady_clock::now() - startTime;
+    sink = oldTotal + newTotal + scaledTotal;
+    (void)sink;
+
+    char message[160];
+    snprintf(message, sizeof(message), "Cost per coil update on the host: float conversion %.1f ns, table lookup %.1f ns (%.1f ns with a reduced current)",
+        std::chrono::duration<double, std::nano>(oldTime).count() / BENCHMARK_UPDATES,
+        std::chrono::duration<double, std::nano>(newTime).count() / BENCHMARK_UPDATES,
+        std::chrono::duration<double, std::nano>(scaledTime).count() / BENCHMARK_UPDATES);
+    TEST_MESSAGE(message);
+}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_conversion_matches);
+    RUN_TEST(test_table_and_scale);
+    RUN_TEST(test_paths_agree);
+    RUN_TEST(test_float_operations_per_update);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
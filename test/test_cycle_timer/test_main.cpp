@@ -0,0 +1,111 @@
+// Host tests of the cycle counter timing (pio test -e native)
+// The counter and the critical section are mocked, so the 64 bit extension can be checked across wraps of the 32 bit counter
+#include <unity.h>
+#include "cycleTimer.h"
+
+// Simulated core clock (Hz)
+#define SIMULATED_CLOCK 128000000
+
+
+// The simulated 32 bit counter
+static uint32_t simulatedCycles = 0;
+
+// Depth of the simulated interrupt blocks, the deepest it got, and how many times they were blocked
+static int32_t interruptBlockDepth = 0;
+static int32_t maxInterruptBlockDepth = 0;
+static uint32_t interruptBlockCount = 0;
+
+
+// Mocks supplied to the cycle timer
+uint32_t mockCycleCount() {
+    return simulatedCycles;
+}
+void mockDisableInterrupts() {
+    interruptBlockDepth++;
+    interruptBlockCount++;
+    maxInterruptBlockDepth = max(maxInterruptBlockDepth, interruptBlockDepth);
+}
+void mockEnableInterrupts() {
+    interruptBlockDepth--;
+}
+
+
+void setUp() {
+    simulatedCycles = 0;
+    interruptBlockDepth = 0;
+    maxInterruptBlockDepth = 0;
+    interruptBlockCount = 0;
+    setupCycleTimer(SIMULATED_CLOCK);
+}
+void tearDown() {}
+
+
+// The conversions follow the clock that the timer was set up with
+void test_conversions() {
+    TEST_ASSERT_EQUAL_UINT32(128, cyclesPerMicro);
+    TEST_ASSERT_EQUAL_UINT32(100, cyclesToMicros(12800));
+    TEST_ASSERT_EQUAL_UINT32(12800, microsToCycles(100));
+
+    // Partial microseconds are rounded down
+    TEST_ASSERT_EQUAL_UINT32(99, cyclesToMicros(12799));
+
+    // Other clocks
+    setupCycleTimer(72000000);
+    TEST_ASSERT_EQUAL_UINT32(72, cyclesPerMicro);
+    TEST_ASSERT_EQUAL_UINT32(7200, microsToCycles(100));
+
+    // A clock under a MHz still counts
+    setupCycleTimer(500000);
+    TEST_ASSERT_EQUAL_UINT32(1, cyclesPerMicro);
+}
+
+
+// The 64 bit count keeps counting up across the wraps of the 32 bit counter
+void test_extension_across_wraps() {
+    simulatedCycles = 0xFFFFFF00;
+    setupCycleTimer(SIMULATED_CLOCK);
+    uint64_t startCount = cycleCount64();
+
+    // Step through several wraps, a little less than half of the counter at a time
+    uint64_t expectedCount = startCount;
+    for (uint8_t step = 0; step < 20; step++) {
+        simulatedCycles += 0x7FFFFFF0;
+        expectedCount += 0x7FFFFFF0;
+        TEST_ASSERT_TRUE(cycleCount64() == expectedCount);
+    }
+    TEST_ASSERT_TRUE(expectedCount > 0x100000000ULL * 9);
+
+    // The time since the start is the full time, not the time since the last wrap
+    TEST_ASSERT_TRUE(cyclesSince(startCount) == 20ULL * 0x7FFFFFF0);
+}
+
+
+// The differences of the 32 bit count are right across a wrap
+void test_32_bit_difference() {
+    simulatedCycles = 0xFFFFFFF0;
+    uint32_t startCount = cycleCount();
+    simulatedCycles += 0x20;
+    TEST_ASSERT_EQUAL_UINT32(0x20, cycleCount() - startCount);
+}
+
+
+// Every extension is done with the interrupts blocked, and the blocks are all released
+void test_critical_section() {
+    for (uint8_t read = 0; read < 10; read++) {
+        simulatedCycles += 1000;
+        cycleCount64();
+    }
+    TEST_ASSERT_EQUAL_UINT32(10, interruptBlockCount);
+    TEST_ASSERT_EQUAL_INT32(1, maxInterruptBlockDepth);
+    TEST_ASSERT_EQUAL_INT32(0, interruptBlockDepth);
+}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_conversions);
+    RUN_TEST(test_extension_across_wraps);
+    RUN_TEST(test_32_bit_difference);
+    RUN_TEST(test_critical_section);
+    return UNITY_END();
+}
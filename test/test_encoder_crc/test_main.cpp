@@ -0,0 +1,164 @@
+// Host tests for the CRC of the encoder's safety word (pio test -e native)
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "encoderCRC.h"
+
+// Example transfer from the TLE5012B user manual (CRC generation example): the command writes one word to MOD_2 (0x08),
+// and the sensor answers with the safety word FE89 (no errors, sensor 00, CRC 0x89)
+#define MANUAL_COMMAND 0x5081
+#define MANUAL_DATA    0x0804
+#define MANUAL_SAFETY  0xFE89
+
+// Read command for a sample burst (4 words starting at AVAL, 0x02)
+#define SAMPLE_COMMAND 0x8024
+#define SAMPLE_WORDS   4
+
+// Frames run through each CRC for the benchmark
+#define BENCHMARK_FRAMES 200000
+
+
+// Reference CRC, shifted out one bit at a time (the first example of the user manual)
+static uint8_t bitwiseCRC(const uint8_t *data, uint8_t length) {
+    uint8_t crc = CRC_SEED;
+    for (uint8_t byte = 0; byte < length; byte++) {
+        crc ^= data[byte];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ CRC_POLYNOMIAL) : (uint8_t)(crc << 1);
+        }
+    }
+    return (uint8_t)~crc;
+}
+
+
+// Splits a command and its data words into the bytes that go through the CRC
+static uint8_t frameBytes(uint16_t command, const uint16_t *words, uint16_t length, uint8_t *bytes) {
+    bytes[0] = (uint8_t)(command >> 8);
+    bytes[1] = (uint8_t)command;
+    for (uint16_t index = 0; index < length; index++) {
+        bytes[2 + 2 * index] = (uint8_t)(words[index] >> 8);
+        bytes[3 + 2 * index] = (uint8_t)words[index];
+    }
+    return (uint8_t)(2 + 2 * length);
+}
+
+
+void setUp() {}
+void tearDown() {}
+
+
+// Each entry of the table has to match the CRC of that byte with a zero register
+void test_table_matches_polynomial() {
+    for (uint16_t value = 0; value < 256; value++) {
+
+        // Undo the seed and the inversion, so that the only thing left is the table entry
+        uint8_t byte = (uint8_t)(value ^ CRC_SEED);
+        uint8_t expected = (uint8_t)~bitwiseCRC(&byte, 1);
+        uint8_t actual = (uint8_t)~calcEncoderCRC(&byte, 1);
+        TEST_ASSERT_EQUAL_HEX8_MESSAGE(expected, actual, "table entry");
+    }
+}
+
+
+// The example transfer from the user manual has to give its CRC and pass the check
+void test_manual_frame() {
+    uint8_t bytes[4] = { 0x50, 0x81, 0x08, 0x04 };
+    TEST_ASSERT_EQUAL_HEX8(0x89, calcEncoderCRC(bytes, 4));
+    TEST_ASSERT_EQUAL_HEX8(0x89, bitwiseCRC(bytes, 4));
+
+    uint16_t data = MANUAL_DATA;
+    TEST_ASSERT_TRUE(checkEncoderCRC(MANUAL_SAFETY, MANUAL_COMMAND, &data, 1));
+}
+
+
+// The status bits in the high byte of the safety word aren't covered by the CRC
+void test_status_bits_not_checked() {
+    uint16_t data = MANUAL_DATA;
+    TEST_ASSERT_TRUE(checkEncoderCRC(MANUAL_SAFETY & 0x00FF, MANUAL_COMMAND, &data, 1));
+    TEST_ASSERT_TRUE(checkEncoderCRC(MANUAL_SAFETY | 0xFF00, MANUAL_COMMAND, &data, 1));
+}
+
+
+// Every single bit error in the command, the data, or the CRC has to be caught
+void test_corrupted_frames() {
+    uint16_t data = MANUAL_DATA;
+
+    for (uint8_t bit = 0; bit < 16; bit++) {
+        uint16_t corruptData = data ^ (1 << bit);
+        TEST_ASSERT_FALSE(checkEncoderCRC(MANUAL_SAFETY, MANUAL_COMMAND, &corruptData, 1));
+        TEST_ASSERT_FALSE(checkEncoderCRC(MANUAL_SAFETY, MANUAL_COMMAND ^ (1 << bit), &data, 1));
+    }
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        TEST_ASSERT_FALSE(checkEncoderCRC(MANUAL_SAFETY ^ (1 << bit), MANUAL_COMMAND, &data, 1));
+    }
+
+    // A burst error of two swapped bytes
+    uint16_t swapped = (uint16_t)((data << 8) | (data >> 8));
+    TEST_ASSERT_FALSE(checkEncoderCRC(MANUAL_SAFETY, MANUAL_COMMAND, &swapped, 1));
+}
+
+
+// A full sample burst (four words) has to match the reference, and fail once a word is changed
+void test_sample_frame() {
+    uint16_t words[SAMPLE_WORDS] = { 0x9A3C, 0x0012, 0x81F4, 0x0003 };
+    uint8_t bytes[2 + 2 * SAMPLE_WORDS];
+    uint8_t length = frameBytes(SAMPLE_COMMAND, words, SAMPLE_WORDS, bytes);
+
+    uint8_t crc = bitwiseCRC(bytes, length);
+    TEST_ASSERT_EQUAL_HEX8(crc, calcEncoderCRC(bytes, length));
+    TEST_ASSERT_TRUE(checkEncoderCRC(0xF000 | crc, SAMPLE_COMMAND, words, SAMPLE_WORDS));
+
+    words[SAMPLE_WORDS - 1] ^= 0x0100;
+    TEST_ASSERT_FALSE(checkEncoderCRC(0xF000 | crc, SAMPLE_COMMAND, words, SAMPLE_WORDS));
+}
+
+
+// Times the table against the bitwise CRC for a sample burst. Only reported, the host timing doesn't match the target
+void test_benchmark() {
+    uint16_t words[SAMPLE_WORDS] = { 0x9A3C, 0x0012, 0x81F4, 0x0003 };
+    uint8_t bytes[2 + 2 * SAMPLE_WORDS];
+    uint8_t length = frameBytes(SAMPLE_COMMAND, words, SAMPLE_WORDS, bytes);
+
+    // The results are accumulated so the loops can't be optimized out
+    volatile uint8_t sink = 0;
+    uint8_t tableResult = 0;
+    uint8_t bitwiseResult = 0;
+
+    auto startTime = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+        bytes[length - 1] = (uint8_t)frame;
+        tableResult ^= calcEncoderCRC(bytes, length);
+    }
+    auto tableTime = std::chrono::steady_clock::now() - startTime;
+
+    startTime = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+        bytes[length - 1] = (uint8_t)frame;
+        bitwiseResult ^= bitwiseCRC(bytes, length);
+    }
+    auto bitwiseTime = std::chrono::steady_clock::now() - startTime;
+    sink = tableResult ^ bitwiseResult;
+    (void)sink;
+
+    // Both have to agree over all of the frames
+    TEST_ASSERT_EQUAL_HEX8(bitwiseResult, tableResult);
+
+    char message[128];
+    snprintf(message, sizeof(message), "CRC of a %u byte burst: table %.1f ns, bitwise %.1f ns",
+        length,
+        std::chrono::duration<double, std::nano>(tableTime).count() / BENCHMARK_FRAMES,
+        std::chrono::duration<double, std::nano>(bitwiseTime).count() / BENCHMARK_FRAMES);
+    TEST_MESSAGE(message);
+}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_table_matches_polynomial);
+    RUN_TEST(test_manual_frame);
+    RUN_TEST(test_status_bits_not_checked);
+    RUN_TEST(test_corrupted_frames);
+    RUN_TEST(test_sample_frame);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
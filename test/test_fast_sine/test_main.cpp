@@ -0,0 +1,145 @@
+// Host tests of the generated sine table and the phase lookup (pio test -e native)
+// The table is checked against the standard library's sin() at the smallest, the configured, and the largest sizes allowed
+// by the sanity check (256, SINE_VAL_COUNT, and 4096 entries)
+#include <unity.h>
+#include <stdio.h>
+#include "fastSine.h"
+
+// Tables of the other sizes, generated while compiling like the firmware's
+static constexpr SineTableOfSize<256> smallTable;
+static constexpr SineTableOfSize<4096> largeTable;
+
+
+// Returns the sine of an angle in the units of the table (not rounded)
+static double referenceSine(double cycles) {
+    return SINE_MAX * sin(2 * PI * cycles);
+}
+
+
+// Checks every entry of a table against the reference. The generator rounds to the nearest integer, so only exact halves
+// can round the other way
+template <uint32_t ENTRIES>
+static void checkTable(const int16_t* table) {
+    for (uint32_t index = 0; index < ENTRIES; index++) {
+        char message[64];
+        snprintf(message, sizeof(message), "%u entries, index %u", ENTRIES, index);
+        TEST_ASSERT_FLOAT_WITHIN_MESSAGE(0.5 + 1e-6, referenceSine((double)index / ENTRIES), table[index], message);
+    }
+
+    // The quarters are exact mirrors of each other (so the two coils always get matching currents)
+    for (uint32_t index = 0; index < ENTRIES / 4; index++) {
+        TEST_ASSERT_EQUAL_INT16(table[index], table[(ENTRIES / 2) - index]);
+        TEST_ASSERT_EQUAL_INT16(-table[index], table[(ENTRIES / 2) + index]);
+        TEST_ASSERT_EQUAL_INT16(-table[index], table[(ENTRIES - index) & (ENTRIES - 1)]);
+    }
+    TEST_ASSERT_EQUAL_INT16(0, table[0]);
+    TEST_ASSERT_EQUAL_INT16(SINE_MAX, table[ENTRIES / 4]);
+    TEST_ASSERT_EQUAL_INT16(-SINE_MAX, table[3 * ENTRIES / 4]);
+}
+
+
+// Checks every phase of an electrical cycle (and a cycle past it) against the reference
+// Between the entries, the linear interpolation is off by at most (step^2 / 8) of the curvature, plus the rounding of the
+// entries and of the interpolation
+template <uint32_t ENTRIES>
+static void checkLookup(const int16_t* table) {
+    #ifdef SINE_INTERPOLATION
+        const uint32_t steps = ENTRIES << SINE_INTERPOLATION_BITS;
+        double entryStep = 2 * PI / ENTRIES;
+        double tolerance = (SINE_MAX * entryStep * entryStep / 8) + 1.0;
+    #else
+        const uint32_t steps = ENTRIES;
+        double tolerance = 0.5;
+    #endif
+
+    for (uint32_t phase = 0; phase < 2 * steps; phase++) {
+        char message[64];
+        snprintf(message, sizeof(message), "%u entries, phase %u", ENTRIES, phase);
+        TEST_ASSERT_FLOAT_WITHIN_MESSAGE(tolerance + 1e-6, referenceSine((double)phase / steps), lookupPhase<ENTRIES>(table, phase), message);
+
+        #ifdef SINE_INTERPOLATION
+            // The phases on an entry give the entry itself, and the ones between stay between the two entries
+            uint32_t index = (phase >> SINE_INTERPOLATION_BITS) & (ENTRIES - 1);
+            int16_t low = table[index];
+            int16_t high = table[(index + 1) & (ENTRIES - 1)];
+            if ((phase & ((1 << SINE_INTERPOLATION_BITS) - 1)) == 0) {
+                TEST_ASSERT_EQUAL_INT16_MESSAGE(low, lookupPhase<ENTRIES>(table, phase), message);
+            }
+            else {
+                TEST_ASSERT_TRUE_MESSAGE(lookupPhase<ENTRIES>(table, phase) >= min(low, high), message);
+                TEST_ASSERT_TRUE_MESSAGE(lookupPhase<ENTRIES>(table, phase) <= max(low, high), message);
+            }
+        #endif
+    }
+}
+
+
+void setUp() {}
+void tearDown() {}
+
+
+// 256 entries (the smallest table allowed)
+void test_256_entries() {
+    checkTable<256>(smallTable.values);
+    checkLookup<256>(smallTable.values);
+}
+
+
+// The firmware's table
+void test_configured_entries() {
+    checkTable<SINE_VAL_COUNT>(sineTable.values);
+    checkLookup<SINE_VAL_COUNT>(sineTable.values);
+
+    // The default size is the firmware's
+    for (uint32_t phase = 0; phase < SINE_STEPS; phase++) {
+        TEST_ASSERT_EQUAL_INT16(lookupPhase<SINE_VAL_COUNT>(sineTable.values, phase), fastSin(phase));
+    }
+}
+
+
+// 4096 entries (the largest table allowed)
+void test_4096_entries() {
+    checkTable<4096>(largeTable.values);
+    checkLookup<4096>(largeTable.values);
+}
+
+
+// The cosine is a quarter cycle ahead of the sine, and the two always have the magnitude of the wave
+void test_cosine() {
+    for (uint32_t phase = 0; phase < SINE_STEPS; phase++) {
+        TEST_ASSERT_EQUAL_INT16(fastSin(phase + (SINE_STEPS / 4)), fastCos(phase));
+        double magnitude = sqrt((double)fastSin(phase) * fastSin(phase) + (double)fastCos(phase) * fastCos(phase));
+        TEST_ASSERT_FLOAT_WITHIN(SINE_MAX / 1000.0, SINE_MAX, magnitude);
+    }
+}
+
+
+// Interpolation between two known entries rounds to the nearest unit
+#ifdef SINE_INTERPOLATION
+void test_interpolation_rounding() {
+    const uint32_t entries = 4;
+    int16_t table[entries] = { 0, 1000, 7, -1001 };
+    const uint32_t fractions = 1 << SINE_INTERPOLATION_BITS;
+    for (uint32_t index = 0; index < entries; index++) {
+        int32_t low = table[index];
+        int32_t high = table[(index + 1) % entries];
+        for (uint32_t fraction = 0; fraction < fractions; fraction++) {
+            double exact = low + (double)(high - low) * fraction / fractions;
+            TEST_ASSERT_FLOAT_WITHIN(0.5 + 1e-6, exact, lookupPhase<entries>(table, (index * fractions) + fraction));
+        }
+    }
+}
+#endif
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_256_entries);
+    RUN_TEST(test_configured_entries);
+    RUN_TEST(test_4096_entries);
+    RUN_TEST(test_cosine);
+    #ifdef SINE_INTERPOLATION
+        RUN_TEST(test_interpolation_rounding);
+    #endif
+    return UNITY_END();
+}
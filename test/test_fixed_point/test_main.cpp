@@ -0,0 +1,222 @@
+// Host benchmark of the fixed point position pipeline against the double pipeline it replaced (pio test -e native)
+// Each tick averages the encoder position, converts it to a step error, and runs the PID on it. The host has an FPU, so the
+// double times here are a lower bound. On the Cortex-M3 every double operation is a call into the soft-float library, so the
+// number of double operations per tick is counted as well
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "config.h"
+#include "fixedPoint.h"
+#include "fixedPID.h"
+#include "MovingAverage.h"
+
+// Ticks simulated for each pipeline (one second of the control loop)
+#define BENCHMARK_TICKS CONTROL_UPDATE_FREQ
+
+// Time between the ticks (us)
+#define TICK_PERIOD (1000000 / CONTROL_UPDATE_FREQ)
+
+// Microsteps in a rotation (1/16 microstepping of a 1.8 deg motor)
+#define MICROSTEPS_PER_ROTATION 3200
+
+
+// Counts of the double operations done (each one is a soft-float library call on the target)
+static uint32_t addCount = 0;
+static uint32_t mulCount = 0;
+static uint32_t divCount = 0;
+static uint32_t compareCount = 0;
+static uint32_t convertCount = 0;
+
+
+// A double that counts the operations done on it
+struct CountedDouble {
+    double value;
+
+    CountedDouble(double newValue = 0) : value(newValue) {}
+    explicit CountedDouble(int32_t newValue) : value(newValue) { convertCount++; }
+    CountedDouble& operator=(int newValue) { value = newValue; return *this; }
+
+    CountedDouble operator+(CountedDouble other) const { addCount++; return CountedDouble(value + other.value); }
+    CountedDouble operator-(CountedDouble other) const { addCount++; return CountedDouble(value - other.value); }
+    CountedDouble operator*(CountedDouble other) const { mulCount++; return CountedDouble(value * other.value); }
+    CountedDouble operator/(CountedDouble other) const { divCount++; return CountedDouble(value / other.value); }
+    CountedDouble operator/(uint16_t other) const { convertCount++; divCount++; return CountedDouble(value / other); }
+    CountedDouble& operator+=(CountedDouble other) { addCount++; value += other.value; return *this; }
+    CountedDouble& operator-=(CountedDouble other) { addCount++; value -= other.value; return *this; }
+    bool operator<(CountedDouble other) const { compareCount++; return value < other.value; }
+    bool operator>(CountedDouble other) const { compareCount++; return value > other.value; }
+    int32_t toInt() const { convertCount++; return (int32_t)lround(value); }
+};
+
+
+// Converts the number type of the double pipeline to an integer
+static int32_t toInt(double value) { return (int32_t)lround(value); }
+static int32_t toInt(CountedDouble value) { return value.toInt(); }
+
+
+// The pipeline before the fixed point conversion. The position is averaged in degrees, the step error is the average divided
+// by the microstep angle, and the PID runs on degrees
+template <typename Real>
+class DoublePipeline {
+    public:
+        DoublePipeline() { average.begin(ANGLE_AVG_READINGS); }
+
+        void tick(int32_t position, int32_t desiredPosition, int32_t hardStep) {
+            average.add(Real(position) * Real(INCREMENTS_TO_DEG(1.0)));
+            Real angle = average.get();
+            Real desiredAngle = Real(desiredPosition) * Real(INCREMENTS_TO_DEG(1.0));
+
+            // Step error
+            stepError = toInt(angle / microstepAngle) - hardStep;
+
+            // PID (the I term is per deg ms)
+            Real error = desiredAngle - angle;
+            cumulativeError += error * Real(TICK_PERIOD / 1000.0);
+            cumulativeError = constrain(cumulativeError, Real(-1.0 * DEFAULT_MAX_I), Real(1.0 * DEFAULT_MAX_I));
+            Real velocity = (angle - lastAngle) / Real(TICK_PERIOD / 1000.0);
+            lastAngle = angle;
+            Real unlimited = (Real(1.0 * DEFAULT_P) * error) + (Real(1.0 * DEFAULT_I) * cumulativeError) - (Real(1.0 * DEFAULT_D) * velocity);
+            output = toInt(constrain(unlimited, Real(-1.0 * DEFAULT_PID_STEP_MAX), Real(1.0 * DEFAULT_PID_STEP_MAX)));
+        }
+
+        int32_t stepError = 0;
+        int32_t output = 0;
+
+    private:
+        MovingAverage<Real, Real> average;
+        Real microstepAngle = Real(360.0 / MICROSTEPS_PER_ROTATION);
+        Real cumulativeError = Real(0.0);
+        Real lastAngle = Real(0.0);
+};
+
+
+// The fixed point pipeline. The position is averaged in increments, the step error is a multiply and a rounding shift (the same
+// math as StepperMotor::positionToMicrosteps), and the PID is the firmware's (FixedPID, on increments with Q16 gains)
+class FixedPipeline {
+    public:
+        FixedPipeline() { average.begin(ANGLE_AVG_READINGS); }
+
+        void tick(int32_t position, int32_t desiredPosition, int32_t hardStep) {
+            average.add(position);
+            int32_t averagePosition = average.get();
+
+            // Step error
+            int64_t scaledPosition = (int64_t)averagePosition * MICROSTEPS_PER_ROTATION;
+            stepError = (int32_t)((scaledPosition + (INCREMENTS_PER_REV / 2)) >> INCREMENTS_PER_REV_BITS) - hardStep;
+
+            // PID (the velocity is in increments/s)
+            int32_t velocity = (averagePosition - lastPosition) * CONTROL_UPDATE_FREQ;
+            lastPosition = averagePosition;
+            output = pid.compute(desiredPosition - averagePosition, velocity, TICK_PERIOD);
+        }
+
+        int32_t stepError = 0;
+        int32_t output = 0;
+
+    private:
+        MovingAverage<int32_t, int64_t> average;
+        FixedPID pid;
+        int32_t lastPosition = 0;
+};
+
+
+// Encoder position of the test move at a tick (a few turns with noise, so the average and the errors all change)
+static int32_t simulatedPosition(uint32_t tick) {
+    int32_t noise = (int32_t)((tick * 2654435761u) >> 29) - 4;
+    return (int32_t)((int64_t)tick * 3 * INCREMENTS_PER_REV / BENCHMARK_TICKS) + noise;
+}
+
+
+// The desired position lags a little behind, so the PID has an error to work on
+static int32_t simulatedDesiredPosition(uint32_t tick) {
+    return simulatedPosition(tick) + 40;
+}
+
+
+// The microstep count of the driver at a tick
+static int32_t simulatedHardStep(uint32_t tick) {
+    return (int32_t)((int64_t)tick * 3 * MICROSTEPS_PER_ROTATION / BENCHMARK_TICKS);
+}
+
+
+void setUp() {}
+void tearDown() {}
+
+
+// Both pipelines have to give the same step error and PID output (the averages round differently, so off by one is allowed)
+void test_pipelines_agree() {
+    DoublePipeline<double> doublePipeline;
+    FixedPipeline fixedPipeline;
+
+    for (uint32_t tick = 0; tick < BENCHMARK_TICKS; tick++) {
+        doublePipeline.tick(simulatedPosition(tick), simulatedDesiredPosition(tick), simulatedHardStep(tick));
+        fixedPipeline.tick(simulatedPosition(tick), simulatedDesiredPosition(tick), simulatedHardStep(tick));
+        TEST_ASSERT_INT_WITHIN(1, doublePipeline.stepError, fixedPipeline.stepError);
+        TEST_ASSERT_INT_WITHIN(DEFAULT_P / 100, doublePipeline.output, fixedPipeline.output);
+    }
+}
+
+
+// Counts the double operations in a tick of the old pipeline
+void test_double_operations_per_tick() {
+    DoublePipeline<CountedDouble> countedPipeline;
+
+    // Fill the average first, so the count is for a tick in normal running
+    for (uint32_t tick = 0; tick < ANGLE_AVG_READINGS; tick++) {
+        countedPipeline.tick(simulatedPosition(tick), simulatedDesiredPosition(tick), simulatedHardStep(tick));
+    }
+    addCount = mulCount = divCount = compareCount = convertCount = 0;
+    countedPipeline.tick(simulatedPosition(ANGLE_AVG_READINGS), simulatedDesiredPosition(ANGLE_AVG_READINGS), simulatedHardStep(ANGLE_AVG_READINGS));
+
+    // The old pipeline can't do a tick without the soft-float library
+    uint32_t totalCount = addCount + mulCount + divCount + compareCount + convertCount;
+    TEST_ASSERT_GREATER_THAN(0, totalCount);
+
+    char message[160];
+    snprintf(message, sizeof(message), "Double pipeline, soft-float calls per tick: %u add/sub, %u mul, %u div, %u compare, %u convert (%u total). Fixed pipeline: 0",
+        addCount, mulCount, divCount, compareCount, convertCount, totalCount);
+    TEST_MESSAGE(message);
+}
+
+
+// Times a second of ticks of each pipeline. Only reported, the host timing doesn't match the target
+void test_benchmark() {
+    DoublePipeline<double> doublePipeline;
+    FixedPipeline fixedPipeline;
+
+    // The outputs are accumulated so the loops can't be optimized out
+    volatile int64_t sink = 0;
+    int64_t doubleTotal = 0;
+    int64_t fixedTotal = 0;
+
+    auto startTime = std::chrono::steady_clock::now();
+    for (uint32_t tick = 0; tick < BENCHMARK_TICKS; tick++) {
+        doublePipeline.tick(simulatedPosition(tick), simulatedDesiredPosition(tick), simulatedHardStep(tick));
+        doubleTotal += doublePipeline.stepError + doublePipeline.output;
+    }
+    auto doubleTime = std::chrono::steady_clock::now() - startTime;
+
+    startTime = std::chrono::steady_clock::now();
+    for (uint32_t tick = 0; tick < BENCHMARK_TICKS; tick++) {
+        fixedPipeline.tick(simulatedPosition(tick), simulatedDesiredPosition(tick), simulatedHardStep(tick));
+        fixedTotal += fixedPipeline.stepError + fixedPipeline.output;
+    }
+    auto fixedTime = std::chrono::steady_clock::now() - startTime;
+    sink = doubleTotal + fixedTotal;
+    (void)sink;
+
+    char message[128];
+    snprintf(message, sizeof(message), "Cost per tick on the host: double %.1f ns, fixed point %.1f ns",
+        std::chrono::duration<double, std::nano>(doubleTime).count() / BENCHMARK_TICKS,
+        std::chrono::duration<double, std::nano>(fixedTime).count() / BENCHMARK_TICKS);
+    TEST_MESSAGE(message);
+}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_pipelines_agree);
+    RUN_TEST(test_double_operations_per_tick);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
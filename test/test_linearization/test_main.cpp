@@ -0,0 +1,203 @@
+// Host tests of the encoder linearization table (pio test -e native)
+// The calibration sweep is simulated with an eccentric magnet: the reading is off from the true angle by a once per revolution
+// error (the eccentricity) and a twice per revolution error (the sensor nonlinearity). Once the table is applied, only a
+// constant offset can be left
+#include <unity.h>
+#include <stdio.h>
+#include "linearization.h"
+
+// Errors of the simulated magnet (increments, and radians of phase)
+#define ECCENTRICITY_ERROR  300
+#define ECCENTRICITY_PHASE  0.7
+#define NONLINEARITY_ERROR  40
+#define NONLINEARITY_PHASE  2.1
+
+// Hysteresis of the simulated motor (increments). The forward sweep reads this far ahead, and the backward sweep this far behind
+#define SWEEP_HYSTERESIS 9
+
+// Largest error left after the linearization (increments, from the rounding of the table and the interpolation)
+#define LINEARIZED_TOLERANCE 3
+
+// Largest difference between a point of the table and the error of the simulated magnet at that reading (increments). The
+// offset and the interpolation are found with truncating divisions, so each can be off by one
+#define TABLE_TOLERANCE 3
+
+// Encoder positions of step 0 that are checked (they move the lowest reading around the revolution and across the wrap). With
+// 200 steps, 111 leaves the highest reading below the last slice, so the table has to wrap around to the lowest reading
+static const int32_t startPositions[] = { 0, 1, 80, 111, 163, 12345, 16384, 32600, INCREMENTS_PER_REV - 1 };
+
+
+// Error of the simulated encoder at a true position (increments)
+static double simulatedError(double position) {
+    double angle = 2 * PI * position / INCREMENTS_PER_REV;
+    return ECCENTRICITY_ERROR * sin(angle + ECCENTRICITY_PHASE) + NONLINEARITY_ERROR * sin(2 * angle + NONLINEARITY_PHASE);
+}
+
+
+// Reading of the simulated encoder at a true position (increments, wrapped into a revolution)
+static int32_t simulatedReading(double position) {
+    return ((int32_t)lround(position + simulatedError(position))) & (INCREMENTS_PER_REV - 1);
+}
+
+
+// True position of a full step (the encoder turns the other way if the direction is negative)
+static double stepPosition(int32_t step, int32_t fullSteps, int32_t startPosition, int32_t direction) {
+    return startPosition + (direction * (double)step * INCREMENTS_PER_REV / fullSteps);
+}
+
+
+// Runs the calibration sweep like StepperMotor::calibrateLinearization, then builds the table from it
+static void calibrate(int16_t* table, int32_t fullSteps, int32_t startPosition, int32_t direction) {
+    int32_t* readings = new int32_t[fullSteps];
+
+    // Sweep forward, then backward, averaging the two readings
+    for (int32_t step = 0; step < fullSteps; step++) {
+        readings[step] = simulatedReading(stepPosition(step, fullSteps, startPosition, direction) + (direction * SWEEP_HYSTERESIS));
+    }
+    for (int32_t step = fullSteps - 1; step >= 0; step--) {
+        int32_t backwardReading = simulatedReading(stepPosition(step, fullSteps, startPosition, direction) - (direction * SWEEP_HYSTERESIS));
+        readings[step] += WRAP_INCREMENTS(backwardReading - readings[step]) / 2;
+    }
+
+    buildLinearizationTable(readings, fullSteps, table);
+    delete[] readings;
+}
+
+
+// Checks each point of the table against the error of the simulated magnet at the reading of the point. Both harmonics
+// average out over a revolution, so the table holds the error itself
+static void checkTable(const int16_t* table, int32_t fullSteps, int32_t startPosition, int32_t direction) {
+    for (int32_t point = 0; point < ENCODER_LINEARIZATION_POINTS; point++) {
+
+        // Find the true position that reads as the start of the slice
+        double reading = point << LINEARIZATION_BIN_BITS;
+        double position = reading;
+        for (uint8_t iteration = 0; iteration < 20; iteration++) {
+            position = reading - simulatedError(position);
+        }
+
+        char message[128];
+        snprintf(message, sizeof(message), "%d steps, direction %d, step 0 at %d, point %d", fullSteps, direction, startPosition, point);
+        TEST_ASSERT_INT_WITHIN_MESSAGE(TABLE_TOLERANCE, lround(simulatedError(position)), table[point], message);
+    }
+}
+
+
+// Checks the linearized readings over a whole revolution. The difference from the true position has to be the same
+// everywhere (within the tolerance), and the raw readings have to be off by more than that, or the test proves nothing
+static void checkRevolution(const int16_t* table, int32_t fullSteps, int32_t startPosition, int32_t direction) {
+    int32_t firstOffset = 0;
+    int32_t minLinearized = 0;
+    int32_t maxLinearized = 0;
+    int32_t minRaw = 0;
+    int32_t maxRaw = 0;
+
+    for (int32_t position = 0; position < INCREMENTS_PER_REV; position += 7) {
+        int32_t reading = simulatedReading(position);
+        int32_t rawOffset = WRAP_INCREMENTS(reading - position);
+        int32_t linearizedOffset = WRAP_INCREMENTS(applyLinearization(table, reading) - position);
+
+        // Everything is relative to the first position, so the constant offset doesn't matter
+        if (position == 0) {
+            firstOffset = linearizedOffset;
+        }
+        linearizedOffset = WRAP_INCREMENTS(linearizedOffset - firstOffset);
+        minLinearized = min(minLinearized, linearizedOffset);
+        maxLinearized = max(maxLinearized, linearizedOffset);
+        minRaw = min(minRaw, rawOffset);
+        maxRaw = max(maxRaw, rawOffset);
+    }
+
+    char message[128];
+    snprintf(message, sizeof(message), "%d steps, direction %d, step 0 at %d: raw %d..%d, linearized %d..%d",
+        fullSteps, direction, startPosition, minRaw, maxRaw, minLinearized, maxLinearized);
+    TEST_ASSERT_GREATER_THAN_MESSAGE(4 * LINEARIZED_TOLERANCE, maxRaw - minRaw, message);
+    TEST_ASSERT_TRUE_MESSAGE((maxLinearized - minLinearized) <= 2 * LINEARIZED_TOLERANCE, message);
+}
+
+
+// Calibrates and checks every start position for a motor
+static void checkMotor(int32_t fullSteps, int32_t direction) {
+    int16_t table[ENCODER_LINEARIZATION_POINTS];
+    for (uint8_t start = 0; start < sizeof(startPositions) / sizeof(startPositions[0]); start++) {
+        calibrate(table, fullSteps, startPositions[start], direction);
+        checkTable(table, fullSteps, startPositions[start], direction);
+        checkRevolution(table, fullSteps, startPositions[start], direction);
+    }
+}
+
+
+void setUp() {}
+void tearDown() {}
+
+
+// 1.8 deg motors
+void test_200_steps_forward() {
+    checkMotor(200, 1);
+}
+void test_200_steps_reversed() {
+    checkMotor(200, -1);
+}
+
+
+// 0.9 deg motors
+void test_400_steps_forward() {
+    checkMotor(400, 1);
+}
+void test_400_steps_reversed() {
+    checkMotor(400, -1);
+}
+
+
+// A perfect encoder gives an empty table, no matter where the steps start
+void test_perfect_encoder() {
+    int16_t table[ENCODER_LINEARIZATION_POINTS];
+    for (int32_t direction = -1; direction <= 1; direction += 2) {
+        int32_t readings[200];
+        for (int32_t step = 0; step < 200; step++) {
+            readings[step] = (12345 + direction * ((step * INCREMENTS_PER_REV + 100) / 200)) & (INCREMENTS_PER_REV - 1);
+        }
+        buildLinearizationTable(readings, 200, table);
+        for (int32_t point = 0; point < ENCODER_LINEARIZATION_POINTS; point++) {
+            TEST_ASSERT_INT_WITHIN(1, 0, table[point]);
+        }
+    }
+}
+
+
+// The readings don't have to be wrapped into a revolution (the averaging of the sweeps can push them just outside of it)
+void test_unwrapped_readings() {
+    int16_t wrappedTable[ENCODER_LINEARIZATION_POINTS];
+    int16_t unwrappedTable[ENCODER_LINEARIZATION_POINTS];
+    int32_t wrappedReadings[200];
+    int32_t unwrappedReadings[200];
+    for (int32_t step = 0; step < 200; step++) {
+        wrappedReadings[step] = simulatedReading(stepPosition(step, 200, 32700, 1));
+
+        // Push the readings near the wrap outside of the revolution
+        unwrappedReadings[step] = wrappedReadings[step];
+        if (unwrappedReadings[step] < 100) {
+            unwrappedReadings[step] += INCREMENTS_PER_REV;
+        }
+        else if (unwrappedReadings[step] > INCREMENTS_PER_REV - 100) {
+            unwrappedReadings[step] -= INCREMENTS_PER_REV;
+        }
+    }
+    buildLinearizationTable(wrappedReadings, 200, wrappedTable);
+    buildLinearizationTable(unwrappedReadings, 200, unwrappedTable);
+    for (int32_t point = 0; point < ENCODER_LINEARIZATION_POINTS; point++) {
+        TEST_ASSERT_EQUAL_INT(wrappedTable[point], unwrappedTable[point]);
+    }
+}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_200_steps_forward);
+    RUN_TEST(test_200_steps_reversed);
+    RUN_TEST(test_400_steps_forward);
+    RUN_TEST(test_400_steps_reversed);
+    RUN_TEST(test_perfect_encoder);
+    RUN_TEST(test_unwrapped_readings);
+    return UNITY_END();
+}
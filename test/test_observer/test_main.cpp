@@ -0,0 +1,336 @@
+// Host tests of the position observer (pio test -e native)
+// The encoder is simulated at the control loop rate, with the sample times coming from the mocked cycle counter (so the
+// simulated time can be run across the wrap of the counter). The noisy moves compare the observer against the moving
+// average estimate that it replaced (a 15 reading average of the position, differenced each update and averaged over 10
+// more readings)
+#include <unity.h>
+#include <stdio.h>
+#include "config.h"
+#include "fixedPoint.h"
+#include "MovingAverage.h"
+#include "observer.h"
+
+// Simulated core clock (Hz)
+#define SIMULATED_CLOCK 128000000
+
+// Time between the samples (us)
+#define SAMPLE_PERIOD (1000000 / CONTROL_UPDATE_FREQ)
+
+// Readings of the moving average estimate (the old RPM_AVG_READINGS and ACCEL_AVG_READINGS)
+#define BASELINE_SPEED_READINGS 10
+#define BASELINE_ACCEL_READINGS 10
+
+// Angle noise of the sensor (increments RMS). The TLE5012B is 0.08 deg RMS at the default filter (FIR_MD = 1)
+#define SENSOR_NOISE 7.3
+
+// Trapezoidal move: accelerate at 100 rev/s^2 up to 10 rev/s, cruise, then decelerate back to a stop (all in increments)
+#define MOVE_ACCEL          (100.0 * INCREMENTS_PER_REV)
+#define MOVE_RAMP_TIME      0.1
+#define MOVE_CRUISE_TIME    0.2
+#define MOVE_TIME           (2 * MOVE_RAMP_TIME + MOVE_CRUISE_TIME)
+
+// Time after each change of acceleration that isn't checked, while the estimates settle (s)
+#define SETTLING_TIME 0.02
+
+// Largest RMS acceleration noise at a constant speed (deg/s^2). The dynamic current adds DYNAMIC_ACCEL_CURRENT mA per
+// 1000 deg/s^2, so this is 50mA of noise on the current at the default 10mA
+#define MAX_ACCEL_NOISE 5000.0
+
+
+// The simulated 32 bit counter
+static uint32_t simulatedCycles = 0;
+
+// State of the noise generator
+static uint32_t noiseState = 1;
+
+
+// Mocks supplied to the cycle timer
+uint32_t mockCycleCount() {
+    return simulatedCycles;
+}
+
+
+// Returns a normally distributed value (Box-Muller, from a fixed generator so every run is the same)
+static double gaussianNoise() {
+    noiseState = noiseState * 1664525 + 1013904223;
+    double first = (noiseState + 1.0) / 4294967296.0;
+    noiseState = noiseState * 1664525 + 1013904223;
+    double second = noiseState / 4294967296.0;
+    return sqrt(-2 * log(first)) * cos(2 * PI * second);
+}
+
+
+// True position, velocity, and acceleration of the trapezoidal move at a time (increments, increments/s, and increments/s^2)
+static void trapezoidalMove(double time, double &position, double &velocity, double &accel) {
+    double cruiseVelocity = MOVE_ACCEL * MOVE_RAMP_TIME;
+    double rampDistance = 0.5 * MOVE_ACCEL * MOVE_RAMP_TIME * MOVE_RAMP_TIME;
+    if (time < MOVE_RAMP_TIME) {
+        accel = MOVE_ACCEL;
+        velocity = MOVE_ACCEL * time;
+        position = 0.5 * MOVE_ACCEL * time * time;
+    }
+    else if (time < MOVE_RAMP_TIME + MOVE_CRUISE_TIME) {
+        accel = 0;
+        velocity = cruiseVelocity;
+        position = rampDistance + cruiseVelocity * (time - MOVE_RAMP_TIME);
+    }
+    else if (time < MOVE_TIME) {
+        double decelTime = time - MOVE_RAMP_TIME - MOVE_CRUISE_TIME;
+        accel = -MOVE_ACCEL;
+        velocity = cruiseVelocity - MOVE_ACCEL * decelTime;
+        position = rampDistance + cruiseVelocity * MOVE_CRUISE_TIME + cruiseVelocity * decelTime - 0.5 * MOVE_ACCEL * decelTime * decelTime;
+    }
+    else {
+        accel = 0;
+        velocity = 0;
+        position = 2 * rampDistance + cruiseVelocity * MOVE_CRUISE_TIME;
+    }
+}
+
+
+// Returns if a time is far enough from the changes of acceleration of the move for the estimates to have settled
+static bool settled(double time) {
+    const double changes[] = { 0, MOVE_RAMP_TIME, MOVE_RAMP_TIME + MOVE_CRUISE_TIME, MOVE_TIME };
+    for (uint8_t change = 0; change < sizeof(changes) / sizeof(changes[0]); change++) {
+        if ((time >= changes[change]) && (time < changes[change] + SETTLING_TIME)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// The moving average estimate (the velocity is in increments/s, the acceleration in increments/s^2)
+class MovingAverageEstimate {
+    public:
+        MovingAverageEstimate() {
+            positionAvg.begin(ANGLE_AVG_READINGS);
+            speedAvg.begin(BASELINE_SPEED_READINGS);
+            accelAvg.begin(BASELINE_ACCEL_READINGS);
+        }
+
+        void update(int32_t position) {
+            positionAvg.add(position);
+            double averagePosition = positionAvg.getDouble();
+            speedAvg.add(1000000.0 * (averagePosition - lastPosition) / SAMPLE_PERIOD);
+            lastPosition = averagePosition;
+            double averageVelocity = speedAvg.get();
+            accelAvg.add(1000000.0 * (averageVelocity - lastVelocity) / SAMPLE_PERIOD);
+            lastVelocity = averageVelocity;
+        }
+
+        double getVelocity() { return speedAvg.get(); }
+        double getAccel() { return accelAvg.get(); }
+
+    private:
+        MovingAverage<int32_t, int64_t> positionAvg;
+        MovingAverage<double> speedAvg;
+        MovingAverage<double> accelAvg;
+        double lastPosition = 0;
+        double lastVelocity = 0;
+};
+
+
+// RMS errors of an estimate over the settled parts of a move
+struct EstimateErrors {
+    double velocitySquares = 0;
+    double rampAccelSquares = 0;
+    double cruiseAccelSquares = 0;
+    uint32_t samples = 0;
+    uint32_t rampSamples = 0;
+    uint32_t cruiseSamples = 0;
+
+    void add(double velocityError, double accelError, bool cruising) {
+        velocitySquares += velocityError * velocityError;
+        samples++;
+        if (cruising) {
+            cruiseAccelSquares += accelError * accelError;
+            cruiseSamples++;
+        }
+        else {
+            rampAccelSquares += accelError * accelError;
+            rampSamples++;
+        }
+    }
+
+    // In deg/s and deg/s^2
+    double velocity() const { return INCREMENTS_TO_DEG(sqrt(velocitySquares / samples)); }
+    double rampAccel() const { return INCREMENTS_TO_DEG(sqrt(rampAccelSquares / rampSamples)); }
+    double cruiseAccel() const { return INCREMENTS_TO_DEG(sqrt(cruiseAccelSquares / cruiseSamples)); }
+};
+
+
+// Runs the move through both estimates, with the cycle counter starting from a count
+static void runMove(double noise, uint32_t startCycles, EstimateErrors &observerErrors, EstimateErrors &baselineErrors) {
+    PositionObserver observer;
+    MovingAverageEstimate baseline;
+    simulatedCycles = startCycles;
+    setupCycleTimer(SIMULATED_CLOCK);
+    noiseState = 1;
+
+    // Half a second at rest on either side of the move
+    for (int32_t sample = -(int32_t)CONTROL_UPDATE_FREQ / 2; sample < (MOVE_TIME + 0.5) * CONTROL_UPDATE_FREQ; sample++) {
+        double time = (double)sample / CONTROL_UPDATE_FREQ;
+        double position, velocity, accel;
+        trapezoidalMove(max(time, 0.0), position, velocity, accel);
+
+        // The sensor reading is quantized to whole increments
+        int32_t reading = (int32_t)lround(position + noise * gaussianNoise());
+        observer.update(reading, cycleCount64());
+        baseline.update(reading);
+        simulatedCycles += SAMPLE_PERIOD * (SIMULATED_CLOCK / 1000000);
+
+        // Only the move and the stop after it are checked
+        if ((time >= 0) && settled(time)) {
+            bool cruising = (accel == 0);
+            observerErrors.add(observer.getVelocity() - velocity, observer.getAccel() - accel, cruising);
+            baselineErrors.add(baseline.getVelocity() - velocity, baseline.getAccel() - accel, cruising);
+        }
+    }
+}
+
+
+void setUp() {
+    simulatedCycles = 0;
+    setupCycleTimer(SIMULATED_CLOCK);
+}
+void tearDown() {}
+
+
+// The first sample starts the observer at rest, at the sample's position
+void test_start() {
+    PositionObserver observer;
+    TEST_ASSERT_FALSE(observer.isStarted());
+    observer.update(12345, cycleCount64());
+    TEST_ASSERT_TRUE(observer.isStarted());
+    TEST_ASSERT_EQUAL_INT32(12345, observer.getPosition());
+    TEST_ASSERT_EQUAL_INT32(0, observer.getVelocity());
+    TEST_ASSERT_EQUAL_INT32(0, observer.getAccel());
+}
+
+
+// At a constant acceleration (without noise), the estimates have to converge on the true values. This is the check of the
+// units of the acceleration correction (each 10^6 / dt has to be applied). The quantization of the readings is still noise
+// to the acceleration, so the tolerance is a percent
+void test_constant_acceleration() {
+    PositionObserver observer;
+    for (uint32_t sample = 0; sample <= CONTROL_UPDATE_FREQ / 5; sample++) {
+        double time = (double)sample / CONTROL_UPDATE_FREQ;
+        observer.update((int32_t)lround(0.5 * MOVE_ACCEL * time * time), cycleCount64());
+        simulatedCycles += SAMPLE_PERIOD * (SIMULATED_CLOCK / 1000000);
+    }
+
+    // After 0.2s, the velocity is 20 rev/s and the position is 2 rev
+    TEST_ASSERT_INT_WITHIN(MOVE_ACCEL / 100, (int32_t)MOVE_ACCEL, observer.getAccel());
+    TEST_ASSERT_INT_WITHIN(INCREMENTS_PER_REV / 100, 20 * INCREMENTS_PER_REV, observer.getVelocity());
+    TEST_ASSERT_INT_WITHIN(2, 2 * INCREMENTS_PER_REV, observer.getPosition());
+}
+
+
+// A jump in the position (such as after zeroing) or a long gap between the samples restarts the observer
+void test_restarts() {
+    PositionObserver observer;
+    for (int32_t sample = 0; sample < (int32_t)CONTROL_UPDATE_FREQ; sample++) {
+        observer.update(sample * 10, cycleCount64());
+        simulatedCycles += SAMPLE_PERIOD * (SIMULATED_CLOCK / 1000000);
+    }
+    TEST_ASSERT_INT_WITHIN(1000, 100000, observer.getVelocity());
+
+    // Jump
+    observer.update(500000, cycleCount64());
+    TEST_ASSERT_EQUAL_INT32(500000, observer.getPosition());
+    TEST_ASSERT_EQUAL_INT32(0, observer.getVelocity());
+
+    // Gap
+    observer.update(500010, cycleCount64() + (uint64_t)(OBSERVER_MAX_DT + 1) * (SIMULATED_CLOCK / 1000000));
+    TEST_ASSERT_EQUAL_INT32(500010, observer.getPosition());
+    TEST_ASSERT_EQUAL_INT32(0, observer.getVelocity());
+}
+
+
+// Samples closer together than the sensor update are skipped
+void test_repeated_samples() {
+    PositionObserver observer;
+    observer.update(0, cycleCount64());
+    simulatedCycles += (OBSERVER_MIN_DT - 1) * (SIMULATED_CLOCK / 1000000);
+    observer.update(500, cycleCount64());
+    TEST_ASSERT_EQUAL_INT32(0, observer.getPosition());
+    TEST_ASSERT_EQUAL_INT32(0, observer.getVelocity());
+}
+
+
+// The largest residual at the shortest time between samples can't overflow the acceleration (it saturates instead of
+// wrapping around to the other sign)
+void test_largest_correction() {
+    PositionObserver observer;
+    observer.update(0, cycleCount64());
+    for (uint8_t sample = 0; sample < 20; sample++) {
+        simulatedCycles += OBSERVER_MIN_DT * (SIMULATED_CLOCK / 1000000);
+        observer.update(observer.getPosition() + OBSERVER_MAX_RESIDUAL, cycleCount64());
+        TEST_ASSERT_TRUE(observer.getAccel() >= 0);
+    }
+}
+
+
+// Without noise, the observer follows the move with less error than the moving average (it doesn't lag)
+void test_move_without_noise() {
+    EstimateErrors observerErrors, baselineErrors;
+    runMove(0, 0, observerErrors, baselineErrors);
+
+    char message[192];
+    snprintf(message, sizeof(message), "No noise, RMS velocity error (deg/s): observer %.1f, moving average %.1f. RMS accel error while accelerating (deg/s^2): observer %.0f, moving average %.0f",
+        observerErrors.velocity(), baselineErrors.velocity(), observerErrors.rampAccel(), baselineErrors.rampAccel());
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE_MESSAGE(observerErrors.velocity() < baselineErrors.velocity(), message);
+    TEST_ASSERT_TRUE_MESSAGE(observerErrors.rampAccel() < baselineErrors.rampAccel(), message);
+}
+
+
+// With the sensor's noise, the observer has to track the move with less velocity error than the moving average, and keep
+// the acceleration noise low enough for the dynamic current
+void test_move_with_noise() {
+    EstimateErrors observerErrors, baselineErrors;
+    runMove(SENSOR_NOISE, 0, observerErrors, baselineErrors);
+
+    char message[256];
+    snprintf(message, sizeof(message), "%.1f increments RMS of noise. RMS velocity error (deg/s): observer %.1f, moving average %.1f. RMS accel error (deg/s^2), accelerating: observer %.0f, moving average %.0f, constant speed: observer %.0f, moving average %.0f",
+        SENSOR_NOISE, observerErrors.velocity(), baselineErrors.velocity(), observerErrors.rampAccel(), baselineErrors.rampAccel(),
+        observerErrors.cruiseAccel(), baselineErrors.cruiseAccel());
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE_MESSAGE(observerErrors.velocity() < baselineErrors.velocity(), message);
+    TEST_ASSERT_TRUE_MESSAGE(observerErrors.cruiseAccel() < MAX_ACCEL_NOISE, message);
+    TEST_ASSERT_TRUE_MESSAGE(observerErrors.rampAccel() < baselineErrors.rampAccel(), message);
+}
+
+
+// The 32 bit cycle counter wraps every 33.5s, so the move is run again with a wrap in the middle of it. The sample times
+// come from the extended count, so the estimates have to come out exactly the same
+void test_move_across_counter_wrap() {
+    EstimateErrors observerErrors, baselineErrors;
+    runMove(SENSOR_NOISE, 0, observerErrors, baselineErrors);
+
+    // The move starts half a second before the wrap (rest), so the wrap is during the acceleration
+    EstimateErrors wrappedObserverErrors, wrappedBaselineErrors;
+    uint32_t startCycles = (uint32_t)(0x100000000ULL - (SIMULATED_CLOCK / 2) - (SIMULATED_CLOCK / 20));
+    runMove(SENSOR_NOISE, startCycles, wrappedObserverErrors, wrappedBaselineErrors);
+    TEST_ASSERT_TRUE(simulatedCycles < startCycles);
+
+    TEST_ASSERT_EQUAL_UINT32(observerErrors.samples, wrappedObserverErrors.samples);
+    TEST_ASSERT_TRUE(observerErrors.velocitySquares == wrappedObserverErrors.velocitySquares);
+    TEST_ASSERT_TRUE(observerErrors.rampAccelSquares == wrappedObserverErrors.rampAccelSquares);
+    TEST_ASSERT_TRUE(observerErrors.cruiseAccelSquares == wrappedObserverErrors.cruiseAccelSquares);
+}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_start);
+    RUN_TEST(test_constant_acceleration);
+    RUN_TEST(test_restarts);
+    RUN_TEST(test_repeated_samples);
+    RUN_TEST(test_largest_correction);
+    RUN_TEST(test_move_without_noise);
+    RUN_TEST(test_move_with_noise);
+    RUN_TEST(test_move_across_counter_wrap);
+    return UNITY_END();
+}
@@ -0,0 +1,178 @@
+// Host simulation of the settling of a move, with the servo output against the step scheduling (pio test -e native)
+// The simulated motor (simulatedMotor.h) is read by the encoder at the control loop rate. Both outputs are driven by the
+// firmware's PID (FixedPID, the math of StepperPID::compute), from the same averaged position and observer velocity. The step
+// scheduling (the default) turns the output into a step rate, only while out of position. The servo output
+// (ENABLE_SERVO_OUTPUT) turns it into a load angle and a current (servoOutput.h, used by StepperMotor::driveServo), on every
+// update
+#include <unity.h>
+#include <stdio.h>
+
+// The servo output is off by default, so it's turned on here for its settings
+#define ENABLE_SERVO_OUTPUT
+#include "config.h"
+#include "servoOutput.h"
+#include "fixedPID.h"
+#include "MovingAverage.h"
+#include "observer.h"
+#include "simulatedMotor.h"
+
+// Move: a full step (16 microsteps) given at once, then held
+#define MOVE_MICROSTEPS 16
+
+// Time that each move is simulated for (s)
+#define SIMULATED_TIME 0.3
+
+// The step scheduling runs the default gains. The servo output is a torque instead of a step rate, so it needs its own
+// gains (the PID is run on the same units, output per deg, per deg ms, and per deg/ms). The simulated load has no steady
+// torque to hold against, so the integral only winds up past the target
+#define SERVO_P 100.0
+#define SERVO_I 0.0
+#define SERVO_D 20.0
+
+// Bands that the rotor has to settle within (microsteps). The step scheduling stops once the averaged position rounds to
+// within a microstep of the target, so it can rest up to one and a half microsteps away
+#define IN_POSITION_BAND 1.5
+#define FINE_BAND        0.25
+
+
+// Result of a move
+struct MoveResult {
+    double settlingTime = 0;    // Time until the rotor stays within the in position band of the target (ms)
+    double fineSettlingTime = 0;// Time until it stays within the fine band (ms, or the whole move if it never does)
+    double overshoot = 0;       // Largest distance past the target (microsteps)
+    double finalError = 0;      // Distance from the target at the end (microsteps)
+};
+
+
+// Simulates the move with one of the outputs
+static MoveResult runMove(bool servo) {
+    SimulatedMotor simulatedMotor;
+    FixedPID pid;
+    if (servo) {
+        pid.setP(SERVO_P);
+        pid.setI(SERVO_I);
+        pid.setD(SERVO_D);
+    }
+    MovingAverage<int32_t, int64_t> positionAvg;
+    positionAvg.begin(ANGLE_AVG_READINGS);
+    PositionObserver observer;
+    simulatedCycles = 0;
+    setupCycleTimer(SIMULATED_CLOCK);
+
+    // The motor starts at rest, aligned with the coils (so the commutation offset is 0)
+    int32_t coilPhase = 0;
+    simulatedMotor.driveCoils(coilPhase);
+    for (uint32_t tick = 0; tick < ANGLE_AVG_READINGS; tick++) {
+        positionAvg.add(0);
+    }
+
+    // The step input moves the coils with the step scheduling, and only the desired position with the servo output
+    int32_t hardStep = MOVE_MICROSTEPS;
+    int32_t desiredPosition = microstepsToPosition(hardStep);
+    if (!servo) {
+        coilPhase += MOVE_MICROSTEPS * MICROSTEP_PHASE;
+        simulatedMotor.driveCoils(coilPhase);
+    }
+
+    // Step schedule of the correction
+    SimulatedStepSchedule stepSchedule;
+
+    MoveResult result;
+    double microstep = (double)INCREMENTS_PER_REV / MICROSTEPS_PER_ROTATION;
+    for (uint32_t tick = 0; tick < SIMULATED_TIME * CONTROL_UPDATE_FREQ; tick++) {
+
+        // Read the encoder, and update the average and the observer
+        int32_t reading = simulatedMotor.readEncoder();
+        positionAvg.add(reading);
+        observer.update(reading, cycleCount64());
+        int32_t averagePosition = positionAvg.get();
+
+        // Control
+        if (servo) {
+            int32_t output = pid.compute(desiredPosition - averagePosition, observer.getVelocity(), TICK_PERIOD);
+
+            // The angle ahead of the rotor and the current both scale with the output (StepperMotor::driveServo)
+            coilPhase = simulatedMotor.rotorPhase() + servoLoadAngle(output);
+            simulatedMotor.driveCoils(coilPhase, servoCurrentScale(output));
+        }
+        else {
+            // The PID only runs out of position, its output is the step rate of the schedule
+            if (abs(positionToMicrosteps(averagePosition) - hardStep) > 1) {
+                stepSchedule.setRate(pid.compute(desiredPosition - averagePosition, observer.getVelocity(), TICK_PERIOD));
+            }
+            else {
+                stepSchedule.setRate(0);
+            }
+        }
+
+        // Run the motor (and the step schedule) until the next update
+        for (uint32_t time = 0; time < TICK_PERIOD; time += SIMULATION_STEP) {
+            int32_t phaseChange = stepSchedule.advance(SIMULATION_STEP * 1e-6);
+            if (phaseChange != 0) {
+                coilPhase += phaseChange;
+                simulatedMotor.driveCoils(coilPhase);
+            }
+            simulatedMotor.advance(SIMULATION_STEP * 1e-6);
+        }
+        simulatedCycles += TICK_PERIOD * (SIMULATED_CLOCK / 1000000);
+
+        // Track the settling (the last time that the rotor was outside of each band)
+        double error = (simulatedMotor.readEncoder() - desiredPosition) / microstep;
+        double time = (tick + 1) * 1000.0 / CONTROL_UPDATE_FREQ;
+        if (fabs(error) > IN_POSITION_BAND) {
+            result.settlingTime = time;
+        }
+        if (fabs(error) > FINE_BAND) {
+            result.fineSettlingTime = time;
+        }
+        result.overshoot = max(result.overshoot, error);
+        result.finalError = error;
+    }
+    return result;
+}
+
+
+void setUp() {}
+void tearDown() {}
+
+
+// The load angle reaches a quarter cycle at the full output, and the current never drops below the minimum
+void test_servo_output() {
+    TEST_ASSERT_EQUAL_INT32(0, servoLoadAngle(0));
+    TEST_ASSERT_EQUAL_INT32(SINE_STEPS / 8, servoLoadAngle(SERVO_FULL_OUTPUT / 2));
+    TEST_ASSERT_EQUAL_INT32(SINE_STEPS / 4, servoLoadAngle(SERVO_FULL_OUTPUT));
+    TEST_ASSERT_EQUAL_INT32(SINE_STEPS / 4, servoLoadAngle(DEFAULT_PID_STEP_MAX));
+    TEST_ASSERT_EQUAL_INT32(-(SINE_STEPS / 4), servoLoadAngle(-DEFAULT_PID_STEP_MAX));
+
+    TEST_ASSERT_EQUAL_UINT32((SERVO_MIN_CURRENT * CURRENT_SCALE_MAX) / 100, servoCurrentScale(0));
+    TEST_ASSERT_EQUAL_UINT32(CURRENT_SCALE_MAX / 2, servoCurrentScale(-SERVO_FULL_OUTPUT / 2));
+    TEST_ASSERT_EQUAL_UINT32(CURRENT_SCALE_MAX, servoCurrentScale(SERVO_FULL_OUTPUT));
+    TEST_ASSERT_EQUAL_UINT32(CURRENT_SCALE_MAX, servoCurrentScale(-DEFAULT_PID_STEP_MAX));
+}
+
+
+// Both outputs have to settle the move in position, and the servo output has to hold it finer than a microstep
+void test_settling() {
+    MoveResult stepResult = runMove(false);
+    MoveResult servoResult = runMove(true);
+
+    char message[320];
+    snprintf(message, sizeof(message), "Full step move, settling to %.2f / %.2f microsteps: step scheduling %.1f / %.1f ms (overshoot %.2f, final error %.2f microsteps), servo output %.1f / %.1f ms (overshoot %.2f, final error %.2f microsteps)",
+        IN_POSITION_BAND, FINE_BAND,
+        stepResult.settlingTime, stepResult.fineSettlingTime, stepResult.overshoot, stepResult.finalError,
+        servoResult.settlingTime, servoResult.fineSettlingTime, servoResult.overshoot, servoResult.finalError);
+    TEST_MESSAGE(message);
+
+    double simulatedTime = SIMULATED_TIME * 1000;
+    TEST_ASSERT_TRUE_MESSAGE(stepResult.settlingTime < simulatedTime / 2, message);
+    TEST_ASSERT_TRUE_MESSAGE(servoResult.settlingTime < simulatedTime / 2, message);
+    TEST_ASSERT_TRUE_MESSAGE(servoResult.fineSettlingTime < simulatedTime / 2, message);
+}
+
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_servo_output);
+    RUN_TEST(test_settling);
+    return UNITY_END();
+}